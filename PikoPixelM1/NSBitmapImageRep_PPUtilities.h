@@ -25,6 +25,7 @@
 #import <Cocoa/Cocoa.h>
 #import "NSImageRep_PPUtilities.h"
 #import "PPBitmapPixelTypes.h"
+#import "PPPixelCore.h"
 #import "PPGridType.h"
 
 
@@ -32,6 +33,15 @@
 
 - (bool) ppIsEqualToBitmap: (NSBitmapImageRep *) comparisonBitmap;
 
+// ppMemorySize returns the size of the bitmap's pixel data buffer (shallow duplicates report
+// the size of the buffer they share)
+- (size_t) ppMemorySize;
+
+// ppMemorySizeIfUncountedInTable: returns ppMemorySize & adds the bitmap to countedObjects
+// (a table of nonowned pointers), or returns zero if the bitmap's already in the table, so
+// bitmaps referenced from several places are only counted once
+- (size_t) ppMemorySizeIfUncountedInTable: (NSHashTable *) countedObjects;
+
 - (bool) ppImportedBitmapHasAnimationFrames;
 
 - (NSData *) ppCompressedTIFFData;
@@ -56,6 +66,10 @@
 
 - (NSBitmapImageRep *) ppBitmapCroppedToBounds: (NSRect) croppingBounds;
 
+// ppPooledCopy's pixel buffer is recycled when the copy deallocates (PPPooledBitmapImageRep);
+// it's only for short-lived scratch bitmaps that are never drawn (interactive-move buffers)
+- (NSBitmapImageRep *) ppPooledCopy;
+
 //  ppShallowDuplicateFromBounds: returns an autoreleased copy that uses the same bitmapData
 // pointer as the original (depending on croppingBounds, it may be offset).
 //  It's faster than ppBitmapCroppedToBounds:, which allocates a new buffer and copies the
@@ -74,6 +88,12 @@
 - (NSBitmapImageRep *) ppBitmapRotated90Counterclockwise;
 - (NSBitmapImageRep *) ppBitmapRotated180;
 
+// ppGetPixelBuffer: & ppPixelRectForBounds: pass the bitmap's data to the PPPixelCore kernels;
+// bounds are converted from (bottom-up) bitmap coordinates to (top-down) buffer coordinates,
+// & should already be clipped to the bitmap's frame
+- (bool) ppGetPixelBuffer: (PPPixelBuffer *) returnedPixelBuffer;
+- (PPPixelRect) ppPixelRectForBounds: (NSRect) bounds;
+
 @end
 
 @interface NSBitmapImageRep (PPUtilities_ImageBitmaps)
@@ -91,6 +111,10 @@
 
 - (bool) ppImageBitmapHasTransparentPixels;
 
+// ppImageBitmapIsClearInBounds: returns YES if every pixel in bounds is zero (as set by
+// ppClearBitmap), so the area can be skipped when compositing
+- (bool) ppImageBitmapIsClearInBounds: (NSRect) bounds;
+
 - (void) ppMaskedFillUsingMask: (NSBitmapImageRep *) maskBitmap
             inBounds: (NSRect) fillBounds
             fillPixelValue: (PPImageBitmapPixel) fillPixelValue;
@@ -125,6 +149,11 @@
 
 - (NSBitmapImageRep *) ppImageBitmapWithMaxDimension: (float) maxDimension;
 
+// ppImageBitmapAveragedDownToMaxDimension: downsamples by averaging (box filter) instead of
+// drawing, so it's safe to call on a background thread; returns self if the bitmap already
+// fits within maxDimension
+- (NSBitmapImageRep *) ppImageBitmapAveragedDownToMaxDimension: (unsigned) maxDimension;
+
 - (NSBitmapImageRep *) ppImageBitmapCompositedWithBackgroundColor: (NSColor *) backgroundColor
                         andBackgroundImage: (NSImage *) backgroundImage
                         backgroundImageInterpolation:
@@ -150,11 +179,21 @@
 
 @interface NSBitmapImageRep (PPUtilities_LinearRGB16Bitmaps)
 
+// ppLinearBitmapOfSize: returns a bitmap in the current linear working format - LinearRGB16 by
+// default, or Compact32 (see PPBitmapPixelTypes.h) if ppSetLinearBitmapsUseCompactFormat: was
+// called with YES; the format should only be set at launch, before any linear bitmaps exist.
+// The ppLinear... copy/blend methods below accept bitmaps in either format, as long as the
+// linear source & destination bitmaps are in the same format.
++ (void) ppSetLinearBitmapsUseCompactFormat: (bool) useCompactFormat;
++ (bool) ppLinearBitmapsUseCompactFormat;
+
++ (NSBitmapImageRep *) ppLinearBitmapOfSize: (NSSize) size;
 + (NSBitmapImageRep *) ppLinearRGB16BitmapOfSize: (NSSize) size;
 
 - (NSBitmapImageRep *) ppLinearRGB16BitmapFromImageBitmap;
-- (NSBitmapImageRep *) ppImageBitmapFromLinearRGB16Bitmap;
+- (NSBitmapImageRep *) ppImageBitmapFromLinearBitmap;
 
+- (bool) ppIsLinearBitmap;
 - (bool) ppIsLinearRGB16Bitmap;
 
 - (void) ppLinearCopyFromImageBitmap: (NSBitmapImageRep *) sourceBitmap
@@ -173,6 +212,28 @@
 
 @end
 
+@interface NSBitmapImageRep (PPUtilities_LinearCompact32Bitmaps)
+
++ (NSBitmapImageRep *) ppLinearCompact32BitmapOfSize: (NSSize) size;
+
+- (bool) ppIsLinearCompact32Bitmap;
+
+- (void) ppLinearCompact32CopyFromImageBitmap: (NSBitmapImageRep *) sourceBitmap
+            inBounds: (NSRect) bounds;
+
+- (void) ppLinearCompact32CopyToImageBitmap: (NSBitmapImageRep *) destinationBitmap
+            inBounds: (NSRect) bounds;
+
+- (void) ppLinearCompact32BlendFromLinearBitmapUnderneath: (NSBitmapImageRep *) sourceBitmap
+            sourceOpacity: (float) sourceOpacity
+            inBounds: (NSRect) blendingBounds;
+
+- (void) ppLinearCompact32CopyFromLinearBitmap: (NSBitmapImageRep *) sourceBitmap
+            opacity: (float) opacity
+            inBounds: (NSRect) copyBounds;
+
+@end
+
 @interface NSBitmapImageRep (PPUtilities_MaskBitmaps)
 
 + (NSBitmapImageRep *) ppMaskBitmapOfSize: (NSSize) size;
@@ -254,6 +315,32 @@
 
 @end
 
+@interface NSBitmapImageRep (PPUtilities_TileEncoding)
+
+// Tile-encoded data: image bitmap pixels split into fixed-size tiles; clear tiles aren't
+// stored, & each stored tile is run-length encoded, palette-indexed, or stored raw (whichever's
+// smallest), so tiles can be decoded independently. Used for layer data in the native file
+// format (v3 & later).
+- (NSData *) ppTileEncodedData;
+
+// ppDecodeTileEncodedData: only writes the stored (nonclear) tiles, so the receiver should
+// be a cleared image bitmap of the encoded size
+- (bool) ppDecodeTileEncodedData: (NSData *) tileEncodedData;
+
++ (bool) ppTileEncodedData: (NSData *) tileEncodedData isValidForSize: (NSSize) size;
+
+// ppStoredTileBoundsInTileEncodedData:forSize: reads the stored tiles' bounds (as NSValue
+// rects) from the data's tile table, without decoding any pixels; returns nil if the data's
+// invalid for the size
++ (NSArray *) ppStoredTileBoundsInTileEncodedData: (NSData *) tileEncodedData
+                forSize: (NSSize) size;
+
+// ppTileEncodedDataUsesIndexedTiles: checks the data's tile table for indexed tiles (which
+// native file format readers older than v4 can't decode); returns YES if the table's invalid
++ (bool) ppTileEncodedDataUsesIndexedTiles: (NSData *) tileEncodedData;
+
+@end
+
 @interface NSBitmapImageRep (PPUtilities_ColorMasking)
 
 - (void) ppMaskNeighboringPixelsMatchingColorAtPoint: (NSPoint) point
@@ -25,6 +25,9 @@
 #import "NSBitmapImageRep_PPUtilities.h"
 
 #import "PPGeometry.h"
+#import "PPPNGEncoder.h"
+#import "PPPooledBitmapImageRep.h"
+#import "PPTrace.h"
 
 
 #define kMinimumBitmapAreaToUseTIFFDataLZWCompression       60
@@ -48,11 +51,18 @@
 
 - (bool) ppIsEqualToBitmap: (NSBitmapImageRep *) comparisonBitmap
 {
+    macroTraceMethodScope();
+
     int bytesPerPixel, sourceBytesPerRow, comparisonBytesPerRow, rowCounter;
     NSSize sizeInPixels;
     unsigned char *sourceRow, *comparisonRow;
     size_t numBytesToCheckPerRow;
 
+    if (self == comparisonBitmap)
+    {
+        return YES;
+    }
+
     bytesPerPixel = [self ppBytesPerPixel];
 
     if (bytesPerPixel != [comparisonBitmap ppBytesPerPixel])
@@ -78,9 +88,24 @@
     sourceBytesPerRow = [self bytesPerRow];
     comparisonBytesPerRow = [comparisonBitmap bytesPerRow];
 
+    // bitmaps sharing the same pixel buffer (shallow duplicates) are equal without checking
+    if ((sourceRow == comparisonRow) && (sourceBytesPerRow == comparisonBytesPerRow))
+    {
+        return YES;
+    }
+
     numBytesToCheckPerRow = sizeInPixels.width * bytesPerPixel;
     rowCounter = sizeInPixels.height;
 
+    // if neither bitmap has row padding, the pixel data is contiguous & can be compared in a
+    // single call
+    if ((sourceBytesPerRow == numBytesToCheckPerRow)
+        && (comparisonBytesPerRow == numBytesToCheckPerRow))
+    {
+        numBytesToCheckPerRow *= rowCounter;
+        rowCounter = 1;
+    }
+
     while (rowCounter--)
     {
         if (memcmp(sourceRow, comparisonRow, numBytesToCheckPerRow) != 0)
@@ -95,6 +120,21 @@
     return YES;
 }
 
+- (size_t) ppMemorySize
+{
+    return (size_t) [self bytesPerRow] * (size_t) [self pixelsHigh];
+}
+
+- (size_t) ppMemorySizeIfUncountedInTable: (NSHashTable *) countedObjects
+{
+    if (!countedObjects || NSHashInsertIfAbsent(countedObjects, self))
+    {
+        return 0;
+    }
+
+    return [self ppMemorySize];
+}
+
 - (bool) ppImportedBitmapHasAnimationFrames
 {
     return ([[self valueForProperty: NSImageFrameCount] intValue] > 1) ? YES : NO;
@@ -102,6 +142,8 @@
 
 - (NSData *) ppCompressedTIFFData
 {
+    macroTraceMethodScope();
+
     NSSize bitmapSize;
     int bitmapArea;
     NSTIFFCompression compressionType;
@@ -137,7 +179,24 @@
 
 - (NSData *) ppCompressedPNGData
 {
-    return [self representationUsingType: NSPNGFileType properties: nil];
+    macroTraceMethodScope();
+
+    NSData *pngData = nil;
+
+    // image bitmaps are encoded with PPPNGEncoder (parallel filtering & deflate); other
+    // bitmaps, or if the encoder fails, fall back to AppKit's encoder
+
+    if ([self ppIsImageBitmap])
+    {
+        pngData = [PPPNGEncoder pngDataFromImageBitmap: self];
+    }
+
+    if (!pngData)
+    {
+        pngData = [self representationUsingType: NSPNGFileType properties: nil];
+    }
+
+    return pngData;
 }
 
 - (void) ppSetAsCurrentGraphicsContext
@@ -158,6 +217,8 @@
 
 - (void) ppClearBitmap
 {
+    macroTraceMethodScope();
+
     unsigned char *bitmapData;
     unsigned bytesPerRow, numBytesToClear, numPaddingBytesPerRow;
 
@@ -186,6 +247,8 @@ ERROR:
 
 - (void) ppClearBitmapInBounds: (NSRect) bounds
 {
+    macroTraceMethodScope();
+
     NSRect bitmapFrame;
     unsigned char *bitmapData;
     unsigned numRowsToSkip, bytesPerRow, bytesPerPixel, numBytesToClearPerRow, rowCounter;
@@ -238,6 +301,8 @@ ERROR:
             inRect: (NSRect) sourceRect
             toPoint: (NSPoint) targetPoint
 {
+    macroTraceMethodScope();
+
     int bytesPerPixel, destinationBytesPerRow, destinationDataOffset, sourceBytesPerRow,
             sourceDataOffset, rowOffset, bytesToCopyPerRow, rowCounter;
     NSRect destinationFrame, destinationRect, sourceFrame;
@@ -338,6 +403,8 @@ ERROR:
 
 - (NSBitmapImageRep *) ppBitmapCroppedToBounds: (NSRect) croppingBounds
 {
+    macroTraceMethodScope();
+
     NSRect sourceBitmapFrame;
     NSBitmapImageRep *croppedBitmap;
     unsigned char *sourceData, *croppedData, *sourceRow, *croppedRow;
@@ -397,6 +464,57 @@ ERROR:
     return nil;
 }
 
+- (NSBitmapImageRep *) ppPooledCopy
+{
+    macroTraceMethodScope();
+
+    NSBitmapImageRep *pooledCopy;
+    unsigned char *sourceRow, *copyRow;
+    int sourceBytesPerRow, copyBytesPerRow, rowCounter;
+    size_t numBytesToCopyPerRow;
+
+    pooledCopy = [PPPooledBitmapImageRep pooledBitmapWithPixelsWide: [self pixelsWide]
+                                            pixelsHigh: [self pixelsHigh]
+                                            bitsPerSample: [self bitsPerSample]
+                                            samplesPerPixel: [self samplesPerPixel]
+                                            hasAlpha: [self hasAlpha]
+                                            colorSpaceName: [self colorSpaceName]
+                                            shouldClear: NO];
+
+    if (!pooledCopy)
+        goto ERROR;
+
+    [pooledCopy ppAttachColorProfileFromBitmap: self];
+
+    sourceRow = [self bitmapData];
+    copyRow = [pooledCopy bitmapData];
+
+    if (!sourceRow || !copyRow)
+    {
+        goto ERROR;
+    }
+
+    sourceBytesPerRow = [self bytesPerRow];
+    copyBytesPerRow = [pooledCopy bytesPerRow];
+
+    numBytesToCopyPerRow = [self ppBytesPerPixel] * [self pixelsWide];
+
+    rowCounter = [self pixelsHigh];
+
+    while (rowCounter--)
+    {
+        memcpy(copyRow, sourceRow, numBytesToCopyPerRow);
+
+        copyRow += copyBytesPerRow;
+        sourceRow += sourceBytesPerRow;
+    }
+
+    return pooledCopy;
+
+ERROR:
+    return nil;
+}
+
 //  ppShallowDuplicateFromBounds: returns an autoreleased copy that uses the same bitmapData
 // pointer as the original (depending on croppingBounds, it may be offset).
 //  It's faster than ppBitmapCroppedToBounds:, which allocates a new buffer and copies the
@@ -461,6 +579,8 @@ ERROR:
 
 - (NSBitmapImageRep *) ppBitmapResizedToSize: (NSSize) newSize shouldScale: (bool) shouldScale
 {
+    macroTraceMethodScope();
+
     NSBitmapImageRep *resizedBitmap = nil;
 
     newSize = PPGeometry_SizeClippedToIntegerValues(newSize);
@@ -482,6 +602,8 @@ ERROR:
 
 - (NSBitmapImageRep *) ppBitmapMirroredHorizontally
 {
+    macroTraceMethodScope();
+
     NSSize bitmapSize;
     NSBitmapImageRep *mirroredBitmap;
     unsigned int bytesPerPixel, pixelsPerRow, rowCounter, sourceBytesPerRow,
@@ -599,6 +721,8 @@ ERROR:
 
 - (NSBitmapImageRep *) ppBitmapMirroredVertically
 {
+    macroTraceMethodScope();
+
     NSSize bitmapSize;
     NSBitmapImageRep *mirroredBitmap;
     unsigned char *sourceData, *destinationData, *sourceRow, *destinationRow;
@@ -646,6 +770,8 @@ ERROR:
 
 - (NSBitmapImageRep *) ppBitmapRotated90Clockwise
 {
+    macroTraceMethodScope();
+
     NSSize sourceBitmapSize, destinationBitmapSize;
     NSBitmapImageRep *destinationBitmap;
     unsigned char *sourceData, *destinationData, *sourceColumn, *destinationRow, *sourcePixel;
@@ -767,6 +893,8 @@ ERROR:
 
 - (NSBitmapImageRep *) ppBitmapRotated90Counterclockwise
 {
+    macroTraceMethodScope();
+
     NSSize sourceBitmapSize, destinationBitmapSize;
     NSBitmapImageRep *destinationBitmap;
     unsigned char *sourceData, *destinationData, *sourceColumn, *destinationRow, *sourcePixel;
@@ -887,6 +1015,36 @@ ERROR:
     return [[self ppBitmapMirroredHorizontally] ppBitmapMirroredVertically];
 }
 
+- (bool) ppGetPixelBuffer: (PPPixelBuffer *) returnedPixelBuffer
+{
+    unsigned char *bitmapData;
+
+    if (!returnedPixelBuffer)
+        goto ERROR;
+
+    bitmapData = [self bitmapData];
+
+    if (!bitmapData)
+        goto ERROR;
+
+    returnedPixelBuffer->data = bitmapData;
+    returnedPixelBuffer->width = [self pixelsWide];
+    returnedPixelBuffer->height = [self pixelsHigh];
+    returnedPixelBuffer->bytesPerRow = [self bytesPerRow];
+
+    return YES;
+
+ERROR:
+    return NO;
+}
+
+- (PPPixelRect) ppPixelRectForBounds: (NSRect) bounds
+{
+    return PPPixelRect_Make(bounds.origin.x,
+                            [self pixelsHigh] - (bounds.origin.y + bounds.size.height),
+                            bounds.size.width, bounds.size.height);
+}
+
 #pragma mark Private methods
 
 - (int) ppBytesPerPixel
@@ -896,6 +1054,8 @@ ERROR:
 
 - (NSBitmapImageRep *) ppUnclearedMatchedBitmapOfSize: (NSSize) bitmapSize
 {
+    macroTraceMethodScope();
+
     NSBitmapImageRep *matchedBitmap;
 
     if (PPGeometry_IsZeroSize(bitmapSize))
@@ -928,6 +1088,8 @@ ERROR:
 
 - (NSBitmapImageRep *) ppBitmapScaledToSize: (NSSize) scaledSize
 {
+    macroTraceMethodScope();
+
     NSBitmapImageRep *scaledBitmap = [self ppUnclearedMatchedBitmapOfSize: scaledSize];
 
     if (!scaledBitmap)
@@ -948,6 +1110,8 @@ ERROR:
 
 - (NSBitmapImageRep *) ppBitmapCroppedToUncontainedBounds: (NSRect) croppingBounds
 {
+    macroTraceMethodScope();
+
     NSBitmapImageRep *croppedBitmap = [self ppUnclearedMatchedBitmapOfSize: croppingBounds.size];
 
     if (!croppedBitmap)
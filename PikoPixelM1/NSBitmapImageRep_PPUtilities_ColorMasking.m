@@ -25,6 +25,7 @@
 #import "NSBitmapImageRep_PPUtilities.h"
 
 #import "PPGeometry.h"
+#import "PPTrace.h"
 
 
 #define kMaxMatchTolerance      kMaxImagePixelComponentValue
@@ -96,6 +97,8 @@ static bool GetMinAndMaxMatchingPixelsForImagePixelWithTolerance(
             selectionMaskBounds: (NSRect) selectionMaskBounds
             matchDiagonally: (bool) matchDiagonally
 {
+    macroTraceMethodScope();
+
     NSRect bitmapFrame, matchBounds;
     int maskHeight, row, startCol, endCol, rowToCheck, lastRowToCheck, bottomRow, rowAbove,
         rowBelow;
@@ -265,6 +268,8 @@ ERROR:
             selectionMask: (NSBitmapImageRep *) selectionMask
             selectionMaskBounds: (NSRect) selectionMaskBounds
 {
+    macroTraceMethodScope();
+
     NSRect bitmapFrame, matchBounds;
     unsigned char *destinationMaskData, *destinationMaskRow, *sourceBitmapData,
                     *sourceBitmapRow;
@@ -440,6 +445,8 @@ ERROR:
 - (void) ppMaskVisiblePixelsInImageBitmap: (NSBitmapImageRep *) sourceBitmap
             selectionMask: (NSBitmapImageRep *) selectionMask
 {
+    macroTraceMethodScope();
+
     int maskWidth, maskHeight, destinationMaskBytesPerRow, sourceBitmapBytesPerRow,
         selectionMaskBytesPerRow, rowCounter, columnCounter;
     unsigned char *destinationMaskRow, *sourceBitmapRow, *selectionMaskRow;
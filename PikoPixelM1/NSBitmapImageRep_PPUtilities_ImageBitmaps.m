@@ -28,6 +28,7 @@
 #import "PPGeometry.h"
 #import "NSColor_PPUtilities.h"
 #import "NSImage_PPUtilities.h"
+#import "PPTrace.h"
 
 
 #define kImageBitmapBitsPerSample                                           \
@@ -45,6 +46,8 @@
 
 + (NSBitmapImageRep *) ppImageBitmapOfSize: (NSSize) size
 {
+    macroTraceMethodScope();
+
     NSBitmapImageRep *imageBitmap;
 
     size = PPGeometry_SizeClippedToIntegerValues(size);
@@ -87,6 +90,8 @@ ERROR:
 
 + (NSBitmapImageRep *) ppImageBitmapFromImageResource: (NSString *) imageName
 {
+    macroTraceMethodScope();
+
     NSString *imageResourcePath;
     NSData *imageData;
 
@@ -194,47 +199,45 @@ ERROR:
 
 - (bool) ppImageBitmapHasTransparentPixels
 {
-    unsigned char *bitmapRow;
-    int bytesPerRow, pixelsPerRow, rowCounter, pixelCounter;
-    NSSize bitmapSize;
-    PPImageBitmapPixel *bitmapPixel;
+    macroTraceMethodScope();
 
-    if (![self ppIsImageBitmap])
+    PPPixelBuffer imageBuffer;
+
+    if (![self ppIsImageBitmap] || ![self ppGetPixelBuffer: &imageBuffer])
     {
         goto ERROR;
     }
 
-    bitmapRow = [self bitmapData];
+    return PPPixelCore_ImageHasTransparentPixelsInRect(&imageBuffer,
+                                                        PPPixelBuffer_Frame(&imageBuffer));
 
-    if (!bitmapRow)
-        goto ERROR;
-
-    bytesPerRow = [self bytesPerRow];
+ERROR:
+    return NO;
+}
 
-    bitmapSize = [self ppSizeInPixels];
+- (bool) ppImageBitmapIsClearInBounds: (NSRect) bounds
+{
+    macroTraceMethodScope();
 
-    pixelsPerRow = bitmapSize.width;
-    rowCounter = bitmapSize.height;
+    PPPixelBuffer imageBuffer;
 
-    while (rowCounter--)
+    if (![self ppIsImageBitmap])
     {
-        bitmapPixel = (PPImageBitmapPixel *) bitmapRow;
-        pixelCounter = pixelsPerRow;
-
-        while (pixelCounter--)
-        {
-            if (macroImagePixelComponent_Alpha(bitmapPixel) != kMaxImagePixelComponentValue)
-            {
-                return YES;
-            }
+        goto ERROR;
+    }
 
-            bitmapPixel++;
-        }
+    bounds = NSIntersectionRect(PPGeometry_PixelBoundsCoveredByRect(bounds),
+                                [self ppFrameInPixels]);
 
-        bitmapRow += bytesPerRow;
+    if (NSIsEmptyRect(bounds))
+    {
+        return YES;
     }
 
-    return NO;
+    if (![self ppGetPixelBuffer: &imageBuffer])
+        goto ERROR;
+
+    return PPPixelCore_ImageIsClearInRect(&imageBuffer, [self ppPixelRectForBounds: bounds]);
 
 ERROR:
     return NO;
@@ -244,71 +247,32 @@ ERROR:
             inBounds: (NSRect) fillBounds
             fillPixelValue: (PPImageBitmapPixel) fillPixelValue
 {
-    NSRect bitmapFrame;
-    unsigned char *destinationData, *maskData, *destinationRow, *maskRow;
-    int destinationBytesPerRow, maskBytesPerRow, rowOffset, destinationDataOffset,
-            maskDataOffset, pixelsPerRow, rowCounter, pixelCounter;
-    PPImageBitmapPixel *destinationPixel;
-    PPMaskBitmapPixel *maskPixel;
+    macroTraceMethodScope();
+
+    PPPixelBuffer destinationBuffer, maskBuffer;
 
     if (![self ppIsImageBitmapAndSameSizeAsMaskBitmap: maskBitmap])
     {
         goto ERROR;
     }
 
-    bitmapFrame = [self ppFrameInPixels];
-
-    fillBounds =
-            NSIntersectionRect(PPGeometry_PixelBoundsCoveredByRect(fillBounds), bitmapFrame);
+    fillBounds = NSIntersectionRect(PPGeometry_PixelBoundsCoveredByRect(fillBounds),
+                                    [self ppFrameInPixels]);
 
     if (NSIsEmptyRect(fillBounds))
     {
         goto ERROR;
     }
 
-    destinationData = [self bitmapData];
-    maskData = [maskBitmap bitmapData];
-
-    if (!destinationData || !maskData)
+    if (![self ppGetPixelBuffer: &destinationBuffer]
+        || ![maskBitmap ppGetPixelBuffer: &maskBuffer])
     {
         goto ERROR;
     }
 
-    rowOffset = bitmapFrame.size.height - fillBounds.size.height - fillBounds.origin.y;
-
-    destinationBytesPerRow = [self bytesPerRow];
-    destinationDataOffset =
-        rowOffset * destinationBytesPerRow + fillBounds.origin.x * sizeof(PPImageBitmapPixel);
-    destinationRow = &destinationData[destinationDataOffset];
-
-    maskBytesPerRow = [maskBitmap bytesPerRow];
-    maskDataOffset =
-            rowOffset * maskBytesPerRow + fillBounds.origin.x * sizeof(PPMaskBitmapPixel);
-    maskRow = &maskData[maskDataOffset];
-
-    pixelsPerRow = fillBounds.size.width;
-    rowCounter = fillBounds.size.height;
-
-    while (rowCounter--)
-    {
-        destinationPixel = (PPImageBitmapPixel *) destinationRow;
-        maskPixel = (PPMaskBitmapPixel *) maskRow;
-
-        pixelCounter = pixelsPerRow;
-
-        while (pixelCounter--)
-        {
-            if (*maskPixel++)
-            {
-                *destinationPixel = fillPixelValue;
-            }
-
-            destinationPixel++;
-        }
-
-        destinationRow += destinationBytesPerRow;
-        maskRow += maskBytesPerRow;
-    }
+    PPPixelCore_MaskedFillImageInRect(&destinationBuffer, &maskBuffer,
+                                        [self ppPixelRectForBounds: fillBounds],
+                                        fillPixelValue);
 
     return;
 
@@ -343,14 +307,11 @@ ERROR:
             usingMask: (NSBitmapImageRep *) maskBitmap
             inBounds: (NSRect) copyBounds
 {
+    macroTraceMethodScope();
+
     NSRect bitmapFrame;
-    unsigned char *destinationData, *sourceData, *maskData, *destinationRow, *sourceRow,
-                    *maskRow;
-    int destinationBytesPerRow, sourceBytesPerRow, maskBytesPerRow, rowOffset,
-            destinationDataOffset, sourceDataOffset, maskDataOffset,
-            pixelsPerRow, rowCounter, pixelCounter;
-    PPImageBitmapPixel *destinationPixel, *sourcePixel;
-    PPMaskBitmapPixel *maskPixel;
+    PPPixelBuffer destinationBuffer, sourceBuffer, maskBuffer;
+    PPPixelRect copyRect;
 
     if (![self ppIsImageBitmap]
         || ![sourceBitmap ppIsImageBitmapAndSameSizeAsMaskBitmap: maskBitmap])
@@ -373,60 +334,17 @@ ERROR:
         goto ERROR;
     }
 
-    destinationData = [self bitmapData];
-    sourceData = [sourceBitmap bitmapData];
-    maskData = [maskBitmap bitmapData];
-
-    if (!destinationData || !sourceData || !maskData)
+    if (![self ppGetPixelBuffer: &destinationBuffer]
+        || ![sourceBitmap ppGetPixelBuffer: &sourceBuffer]
+        || ![maskBitmap ppGetPixelBuffer: &maskBuffer])
     {
         goto ERROR;
     }
 
-    destinationBytesPerRow = [self bytesPerRow];
-    sourceBytesPerRow = [sourceBitmap bytesPerRow];
-    maskBytesPerRow = [maskBitmap bytesPerRow];
-
-    rowOffset = bitmapFrame.size.height - copyBounds.size.height - copyBounds.origin.y;
+    copyRect = [self ppPixelRectForBounds: copyBounds];
 
-    destinationDataOffset =
-        rowOffset * destinationBytesPerRow + copyBounds.origin.x * sizeof(PPImageBitmapPixel);
-
-    sourceDataOffset =
-        rowOffset * sourceBytesPerRow + copyBounds.origin.x * sizeof(PPImageBitmapPixel);
-
-    maskDataOffset =
-        rowOffset * maskBytesPerRow + copyBounds.origin.x * sizeof(PPMaskBitmapPixel);
-
-    destinationRow = &destinationData[destinationDataOffset];
-    sourceRow = &sourceData[sourceDataOffset];
-    maskRow = &maskData[maskDataOffset];
-
-    pixelsPerRow = copyBounds.size.width;
-    rowCounter = copyBounds.size.height;
-
-    while (rowCounter--)
-    {
-        destinationPixel = (PPImageBitmapPixel *) destinationRow;
-        sourcePixel = (PPImageBitmapPixel *) sourceRow;
-        maskPixel = (PPMaskBitmapPixel *) maskRow;
-
-        pixelCounter = pixelsPerRow;
-
-        while (pixelCounter--)
-        {
-            if (*maskPixel++)
-            {
-                *destinationPixel = *sourcePixel;
-            }
-
-            destinationPixel++;
-            sourcePixel++;
-        }
-
-        destinationRow += destinationBytesPerRow;
-        sourceRow += sourceBytesPerRow;
-        maskRow += maskBytesPerRow;
-    }
+    PPPixelCore_MaskedCopyImage(&destinationBuffer, copyRect.x, copyRect.y,
+                                &sourceBuffer, &maskBuffer, copyRect);
 
     return;
 
@@ -438,14 +356,11 @@ ERROR:
             usingMask: (NSBitmapImageRep *) maskBitmap
             toPoint: (NSPoint) targetPoint
 {
+    macroTraceMethodScope();
+
     NSRect destinationFrame, sourceFrame, destinationCopyBounds, sourceCopyBounds;
-    unsigned char *destinationData, *sourceData, *maskData, *destinationRow, *sourceRow,
-                    *maskRow;
-    int destinationBytesPerRow, sourceBytesPerRow, maskBytesPerRow, rowOffset,
-            destinationDataOffset, sourceDataOffset, maskDataOffset,
-            pixelsPerRow, rowCounter, pixelCounter;
-    PPImageBitmapPixel *destinationPixel, *sourcePixel;
-    PPMaskBitmapPixel *maskPixel;
+    PPPixelBuffer destinationBuffer, sourceBuffer, maskBuffer;
+    PPPixelRect destinationCopyRect;
 
     if (![self ppIsImageBitmap]
         || ![sourceBitmap ppIsImageBitmapAndSameSizeAsMaskBitmap: maskBitmap])
@@ -469,64 +384,18 @@ ERROR:
 
     sourceCopyBounds = NSOffsetRect(destinationCopyBounds, -targetPoint.x, -targetPoint.y);
 
-    destinationData = [self bitmapData];
-    sourceData = [sourceBitmap bitmapData];
-    maskData = [maskBitmap bitmapData];
-
-    if (!destinationData || !sourceData || !maskData)
+    if (![self ppGetPixelBuffer: &destinationBuffer]
+        || ![sourceBitmap ppGetPixelBuffer: &sourceBuffer]
+        || ![maskBitmap ppGetPixelBuffer: &maskBuffer])
     {
         goto ERROR;
     }
 
-    destinationBytesPerRow = [self bytesPerRow];
-    sourceBytesPerRow = [sourceBitmap bytesPerRow];
-    maskBytesPerRow = [maskBitmap bytesPerRow];
-
-    rowOffset = destinationFrame.size.height - destinationCopyBounds.size.height
-                - destinationCopyBounds.origin.y;
+    destinationCopyRect = [self ppPixelRectForBounds: destinationCopyBounds];
 
-    destinationDataOffset = rowOffset * destinationBytesPerRow
-                            + destinationCopyBounds.origin.x * sizeof(PPImageBitmapPixel);
-
-    rowOffset = sourceFrame.size.height - sourceCopyBounds.size.height
-                - sourceCopyBounds.origin.y;
-
-    sourceDataOffset = rowOffset * sourceBytesPerRow
-                        + sourceCopyBounds.origin.x * sizeof(PPImageBitmapPixel);
-
-    maskDataOffset = rowOffset * maskBytesPerRow
-                        + sourceCopyBounds.origin.x * sizeof(PPMaskBitmapPixel);
-
-    destinationRow = &destinationData[destinationDataOffset];
-    sourceRow = &sourceData[sourceDataOffset];
-    maskRow = &maskData[maskDataOffset];
-
-    pixelsPerRow = destinationCopyBounds.size.width;
-    rowCounter = destinationCopyBounds.size.height;
-
-    while (rowCounter--)
-    {
-        destinationPixel = (PPImageBitmapPixel *) destinationRow;
-        sourcePixel = (PPImageBitmapPixel *) sourceRow;
-        maskPixel = (PPMaskBitmapPixel *) maskRow;
-
-        pixelCounter = pixelsPerRow;
-
-        while (pixelCounter--)
-        {
-            if (*maskPixel++)
-            {
-                *destinationPixel = *sourcePixel;
-            }
-
-            destinationPixel++;
-            sourcePixel++;
-        }
-
-        destinationRow += destinationBytesPerRow;
-        sourceRow += sourceBytesPerRow;
-        maskRow += maskBytesPerRow;
-    }
+    PPPixelCore_MaskedCopyImage(&destinationBuffer, destinationCopyRect.x,
+                                destinationCopyRect.y, &sourceBuffer, &maskBuffer,
+                                [sourceBitmap ppPixelRectForBounds: sourceCopyBounds]);
 
     return;
 
@@ -539,6 +408,8 @@ ERROR:
             toPoint: (NSPoint) destinationPoint
             scalingFactor: (unsigned) scalingFactor
 {
+    macroTraceMethodScope();
+
     NSRect destinationRect, sourceBitmapFrame, destinationBitmapFrame;
     unsigned char *sourceData, *destinationData, *scaledRowData, *sourceRow, *destinationRow;
     int sourceBytesPerRow, numSourceRowsToSkip, sourceDataOffset, destinationBytesPerRow,
@@ -656,6 +527,8 @@ ERROR:
             gridType: (PPGridType) gridType
             gridPixelValue: (PPImageBitmapPixel) gridPixelValue
 {
+    macroTraceMethodScope();
+
     NSRect destinationRect, sourceBitmapFrame, destinationBitmapFrame;
     unsigned char *sourceData, *destinationData, *sourceRow, *destinationRow, *scaledRowData;
     int scaledRowDataSize, sourceBytesPerRow, numSourceRowsToSkip, sourceDataOffset,
@@ -1014,6 +887,8 @@ ERROR:
 
 - (NSBitmapImageRep *) ppImageBitmapWithMaxDimension: (float) maxDimension
 {
+    macroTraceMethodScope();
+
     NSSize originalBitmapSize, maxSize, shrunkenBitmapSize;
     NSBitmapImageRep *shrunkenBitmap;
     NSImage *originalBitmapImage;
@@ -1056,11 +931,167 @@ ERROR:
     return nil;
 }
 
+- (NSBitmapImageRep *) ppImageBitmapAveragedDownToMaxDimension: (unsigned) maxDimension
+{
+    macroTraceMethodScope();
+
+    NSSize sourceSize, destinationSize;
+    NSBitmapImageRep *destinationBitmap;
+    unsigned char *sourceData, *destinationData, *sourceRow;
+    unsigned sourceWidth, sourceHeight, destinationWidth, destinationHeight,
+                sourceBytesPerRow, destinationBytesPerRow, sourceRowIndex, sourceColIndex,
+                destinationRowIndex, destinationColIndex, numBinPixels, componentIndex;
+    uint32_t *componentSums = NULL, *binPixelCounts = NULL, *componentSum;
+    PPImageBitmapPixel *sourcePixel, *destinationPixel;
+
+    if (![self ppIsImageBitmap] || !maxDimension)
+    {
+        goto ERROR;
+    }
+
+    sourceSize = [self ppSizeInPixels];
+
+    if (!PPGeometry_SizeExceedsDimension(sourceSize, maxDimension))
+    {
+        return self;
+    }
+
+    destinationSize =
+        PPGeometry_ScaledBoundsForFrameOfSizeToFitFrameOfSize(
+                                            sourceSize,
+                                            NSMakeSize(maxDimension, maxDimension)).size;
+
+    destinationBitmap = [NSBitmapImageRep ppImageBitmapOfSize: destinationSize];
+
+    if (!destinationBitmap)
+        goto ERROR;
+
+    sourceData = [self bitmapData];
+    destinationData = [destinationBitmap bitmapData];
+
+    if (!sourceData || !destinationData)
+    {
+        goto ERROR;
+    }
+
+    sourceWidth = sourceSize.width;
+    sourceHeight = sourceSize.height;
+    destinationWidth = destinationSize.width;
+    destinationHeight = destinationSize.height;
+
+    sourceBytesPerRow = [self bytesPerRow];
+    destinationBytesPerRow = [destinationBitmap bytesPerRow];
+
+    // box filter: each source pixel is summed into the destination pixel that covers its
+    // position; summing premultiplied components averages correctly across transparency
+    // (the sums can't overflow: 255 * kMaxCanvasDimension^2 fits in 32 bits); doesn't use a
+    // graphics context, so it's safe to call on a background thread
+
+    componentSums = (uint32_t *) calloc(destinationWidth * kNumPPImagePixelComponents,
+                                        sizeof(uint32_t));
+    binPixelCounts = (uint32_t *) calloc(destinationWidth, sizeof(uint32_t));
+
+    if (!componentSums || !binPixelCounts)
+    {
+        goto ERROR;
+    }
+
+    sourceRow = sourceData;
+
+    for (sourceRowIndex=0; sourceRowIndex<sourceHeight; sourceRowIndex++)
+    {
+        sourcePixel = (PPImageBitmapPixel *) sourceRow;
+
+        for (sourceColIndex=0; sourceColIndex<sourceWidth; sourceColIndex++)
+        {
+            destinationColIndex =
+                (unsigned) (((uint64_t) sourceColIndex * destinationWidth) / sourceWidth);
+
+            componentSum = &componentSums[destinationColIndex * kNumPPImagePixelComponents];
+
+            componentSum[0] += macroImagePixelComponent_Red(sourcePixel);
+            componentSum[1] += macroImagePixelComponent_Green(sourcePixel);
+            componentSum[2] += macroImagePixelComponent_Blue(sourcePixel);
+            componentSum[3] += macroImagePixelComponent_Alpha(sourcePixel);
+
+            binPixelCounts[destinationColIndex]++;
+
+            sourcePixel++;
+        }
+
+        sourceRow += sourceBytesPerRow;
+
+        destinationRowIndex =
+            (unsigned) (((uint64_t) sourceRowIndex * destinationHeight) / sourceHeight);
+
+        // write the destination row once its last source row's been summed
+
+        if ((sourceRowIndex + 1 < sourceHeight)
+            && ((((uint64_t) (sourceRowIndex + 1) * destinationHeight) / sourceHeight)
+                    == destinationRowIndex))
+        {
+            continue;
+        }
+
+        destinationPixel = (PPImageBitmapPixel *)
+                                &destinationData[destinationRowIndex * destinationBytesPerRow];
+
+        componentSum = componentSums;
+
+        for (destinationColIndex=0; destinationColIndex<destinationWidth; destinationColIndex++)
+        {
+            numBinPixels = binPixelCounts[destinationColIndex];
+
+            if (numBinPixels)
+            {
+                macroImagePixelComponent_Red(destinationPixel) =
+                                    (componentSum[0] + numBinPixels / 2) / numBinPixels;
+                macroImagePixelComponent_Green(destinationPixel) =
+                                    (componentSum[1] + numBinPixels / 2) / numBinPixels;
+                macroImagePixelComponent_Blue(destinationPixel) =
+                                    (componentSum[2] + numBinPixels / 2) / numBinPixels;
+                macroImagePixelComponent_Alpha(destinationPixel) =
+                                    (componentSum[3] + numBinPixels / 2) / numBinPixels;
+            }
+
+            for (componentIndex=0; componentIndex<kNumPPImagePixelComponents; componentIndex++)
+            {
+                componentSum[componentIndex] = 0;
+            }
+
+            binPixelCounts[destinationColIndex] = 0;
+
+            componentSum += kNumPPImagePixelComponents;
+            destinationPixel++;
+        }
+    }
+
+    free(componentSums);
+    free(binPixelCounts);
+
+    return destinationBitmap;
+
+ERROR:
+    if (componentSums)
+    {
+        free(componentSums);
+    }
+
+    if (binPixelCounts)
+    {
+        free(binPixelCounts);
+    }
+
+    return nil;
+}
+
 - (NSBitmapImageRep *) ppImageBitmapCompositedWithBackgroundColor: (NSColor *) backgroundColor
                         andBackgroundImage: (NSImage *) backgroundImage
                         backgroundImageInterpolation:
                                         (NSImageInterpolation) backgroundImageInterpolation
 {
+    macroTraceMethodScope();
+
     NSRect bitmapFrame;
     NSBitmapImageRep *compositedBitmap;
     NSImage *bitmapImage;
@@ -1124,6 +1155,8 @@ ERROR:
 
 - (NSBitmapImageRep *) ppImageBitmapDissolvedToOpacity: (float) opacity
 {
+    macroTraceMethodScope();
+
     NSBitmapImageRep *dissolvedBitmap;
 
     if (![self ppIsImageBitmap])
@@ -1173,6 +1206,8 @@ ERROR:
 
 - (NSBitmapImageRep *) ppImageBitmapMaskedWithMask: (NSBitmapImageRep *) maskBitmap
 {
+    macroTraceMethodScope();
+
     NSBitmapImageRep *maskedBitmap;
 
     if (![self ppIsImageBitmapAndSameSizeAsMaskBitmap: maskBitmap])
@@ -1199,6 +1234,8 @@ ERROR:
                         gridType: (PPGridType) gridType
                         gridColor: (NSColor *) gridColor
 {
+    macroTraceMethodScope();
+
     NSRect bitmapFrame;
     NSSize scaledBitmapSize;
     NSBitmapImageRep *scaledBitmap;
@@ -1243,6 +1280,8 @@ ERROR:
 
 - (NSBitmapImageRep *) ppMaskBitmapForVisiblePixelsInImageBitmap
 {
+    macroTraceMethodScope();
+
     NSSize bitmapSize;
     NSBitmapImageRep *maskBitmap;
 
@@ -24,9 +24,11 @@
 
 #import "NSBitmapImageRep_PPUtilities.h"
 
+#import <pthread.h>
 #import "PPGeometry.h"
 #import "PPImagePixelAlphaPremultiplyTables.h"
 #import "PPSRGBUtilities.h"
+#import "PPTrace.h"
 
 
 #define kLinearRGB16BitmapBitsPerSample                                             \
@@ -35,6 +37,12 @@
 #define kLinearRGB16BitmapSamplesPerPixel                                           \
             (sizeof(PPLinearRGB16BitmapPixel) / sizeof(PPLinear16PixelComponent))
 
+#define kLinearCompact32BitmapBitsPerSample                                         \
+            (sizeof(PPLinearCompact32PixelComponent) * 8)
+
+#define kLinearCompact32BitmapSamplesPerPixel                                       \
+            (sizeof(PPLinearCompact32BitmapPixel) / sizeof(PPLinearCompact32PixelComponent))
+
 
 #define kImagePixelComponentToLinear16PixelComponentConversionFactor                \
             (kMaxLinear16PixelComponentValue / kMaxImagePixelComponentValue)
@@ -49,27 +57,64 @@
 #define kLinear16PixelComponentPrenormalizationRoundoff                             \
             macroRoundoffValueForDivisor(kMaxLinear16PixelComponentValue)
 
+#define kLinearCompact32PixelComponentPrenormalizationRoundoff                      \
+            macroRoundoffValueForDivisor(kMaxLinearCompact32PixelComponentValue)
+
 
 #define macroClampFloatValueTo0_1(floatValue)                                       \
             ((floatValue >= 1.0f) ? 1.0f : ((floatValue <= 0.0f) ? 0.0f : floatValue))
 
-
+// blends two sRGB-encoded Compact32 components in linear space, returns sRGB-encoded result
+#define macroCompact32BlendedComponent(destinationComponent, destinationAlphaFactor,         \
+                                        sourceComponent, sourceAlphaFactor,                 \
+                                        sumOfAlphaFactors, prenormalizationRoundoff)        \
+            gSRGBValuesForLinear16ValuesTable[                                              \
+                ((destinationAlphaFactor)                                                   \
+                        * gLinear16ValuesForSRGBValuesTable[destinationComponent]           \
+                    + (sourceAlphaFactor)                                                   \
+                        * gLinear16ValuesForSRGBValuesTable[sourceComponent]                \
+                    + (prenormalizationRoundoff))                                           \
+                / (sumOfAlphaFactors)]
+
+
+// conversion tables are set up on first use (only documents with linear blending enabled use
+// them), rather than at launch
 static PPImagePixelComponent *gSRGBValuesForLinear16ValuesTable;
 static PPLinear16PixelComponent *gLinear16ValuesForSRGBValuesTable;
 
+static pthread_once_t gSetupLinearConversionTablesOnceControl = PTHREAD_ONCE_INIT;
 
+static bool gLinearBitmapsUseCompactFormat = NO;
+
+
+static bool SetupGlobalLinearConversionTablesIfNeeded(void);
+static void SetupGlobalLinearConversionTablesOnce(void);
 static bool SetupGlobalLinearConversionTables(void);
 
 
 @implementation NSBitmapImageRep (PPUtilities_LinearRGB16Bitmaps)
 
-+ (void) load
++ (void) ppSetLinearBitmapsUseCompactFormat: (bool) useCompactFormat
 {
-    SetupGlobalLinearConversionTables();
+    gLinearBitmapsUseCompactFormat = (useCompactFormat) ? YES : NO;
+}
+
++ (bool) ppLinearBitmapsUseCompactFormat
+{
+    return gLinearBitmapsUseCompactFormat;
+}
+
++ (NSBitmapImageRep *) ppLinearBitmapOfSize: (NSSize) size
+{
+    return (gLinearBitmapsUseCompactFormat) ?
+                [self ppLinearCompact32BitmapOfSize: size] :
+                [self ppLinearRGB16BitmapOfSize: size];
 }
 
 + (NSBitmapImageRep *) ppLinearRGB16BitmapOfSize: (NSSize) size
 {
+    macroTraceMethodScope();
+
     NSBitmapImageRep *linearBitmap;
 
     size = PPGeometry_SizeClippedToIntegerValues(size);
@@ -107,6 +152,8 @@ ERROR:
 
 - (NSBitmapImageRep *) ppLinearRGB16BitmapFromImageBitmap
 {
+    macroTraceMethodScope();
+
     NSRect frame;
     NSBitmapImageRep *linearBitmap;
 
@@ -135,12 +182,14 @@ ERROR:
     return nil;
 }
 
-- (NSBitmapImageRep *) ppImageBitmapFromLinearRGB16Bitmap
+- (NSBitmapImageRep *) ppImageBitmapFromLinearBitmap
 {
+    macroTraceMethodScope();
+
     NSRect frame;
     NSBitmapImageRep *imageBitmap;
 
-    if (![self ppIsLinearRGB16Bitmap])
+    if (![self ppIsLinearBitmap])
     {
         goto ERROR;
     }
@@ -165,6 +214,11 @@ ERROR:
     return nil;
 }
 
+- (bool) ppIsLinearBitmap
+{
+    return ([self ppIsLinearRGB16Bitmap] || [self ppIsLinearCompact32Bitmap]) ? YES : NO;
+}
+
 - (bool) ppIsLinearRGB16Bitmap
 {
     return (([self bitsPerSample] == kLinearRGB16BitmapBitsPerSample)
@@ -175,6 +229,8 @@ ERROR:
 - (void) ppLinearCopyFromImageBitmap: (NSBitmapImageRep *) sourceBitmap
             inBounds: (NSRect) copyBounds
 {
+    macroTraceMethodScope();
+
     NSRect bitmapFrame;
     unsigned char *destinationData, *sourceData, *destinationRow, *sourceRow;
     int destinationBytesPerRow, sourceBytesPerRow, rowOffset, destinationDataOffset,
@@ -183,6 +239,12 @@ ERROR:
     PPImageBitmapPixel *sourcePixel;
     PPImagePixelComponent *unpremultiplyTable;
 
+    if ([self ppIsLinearCompact32Bitmap])
+    {
+        [self ppLinearCompact32CopyFromImageBitmap: sourceBitmap inBounds: copyBounds];
+        return;
+    }
+
     if (![self ppIsLinearRGB16Bitmap]
         || ![sourceBitmap ppIsImageBitmap])
     {
@@ -212,6 +274,11 @@ ERROR:
         goto ERROR;
     }
 
+    if (!SetupGlobalLinearConversionTablesIfNeeded() || !PPImageAlphaPremultiplyTables_Setup())
+    {
+        goto ERROR;
+    }
+
     destinationBytesPerRow = [self bytesPerRow];
     sourceBytesPerRow = [sourceBitmap bytesPerRow];
 
@@ -300,6 +367,8 @@ ERROR:
 - (void) ppLinearCopyToImageBitmap: (NSBitmapImageRep *) destinationBitmap
             inBounds: (NSRect) copyBounds
 {
+    macroTraceMethodScope();
+
     NSRect bitmapFrame;
     unsigned char *destinationData, *sourceData, *destinationRow, *sourceRow;
     int destinationBytesPerRow, sourceBytesPerRow, rowOffset, destinationDataOffset,
@@ -308,6 +377,12 @@ ERROR:
     PPLinearRGB16BitmapPixel *sourcePixel;
     PPImagePixelComponent *premultiplyTable;
 
+    if ([self ppIsLinearCompact32Bitmap])
+    {
+        [self ppLinearCompact32CopyToImageBitmap: destinationBitmap inBounds: copyBounds];
+        return;
+    }
+
     if (![self ppIsLinearRGB16Bitmap]
         || ![destinationBitmap ppIsImageBitmap])
     {
@@ -337,6 +412,11 @@ ERROR:
         goto ERROR;
     }
 
+    if (!SetupGlobalLinearConversionTablesIfNeeded() || !PPImageAlphaPremultiplyTables_Setup())
+    {
+        goto ERROR;
+    }
+
     destinationBytesPerRow = [destinationBitmap bytesPerRow];
     sourceBytesPerRow = [self bytesPerRow];
 
@@ -425,6 +505,8 @@ ERROR:
             sourceOpacity: (float) sourceOpacity
             inBounds: (NSRect) blendingBounds
 {
+    macroTraceMethodScope();
+
     NSRect bitmapFrame;
     unsigned char *destinationData, *sourceData, *destinationRow, *sourceRow;
     unsigned int sourceOpacityFactor, destinationComponentAlphaFactor,
@@ -434,6 +516,15 @@ ERROR:
             destinationDataOffset, sourceDataOffset, pixelsPerRow, rowCounter, pixelCounter;
     PPLinearRGB16BitmapPixel *destinationPixel, *sourcePixel;
 
+    if ([self ppIsLinearCompact32Bitmap])
+    {
+        [self ppLinearCompact32BlendFromLinearBitmapUnderneath: sourceBitmap
+                sourceOpacity: sourceOpacity
+                inBounds: blendingBounds];
+
+        return;
+    }
+
     if (![self ppIsLinearRGB16Bitmap]
         || ![sourceBitmap ppIsLinearRGB16Bitmap])
     {
@@ -672,6 +763,8 @@ ERROR:
             opacity: (float) opacity
             inBounds: (NSRect) copyBounds
 {
+    macroTraceMethodScope();
+
     NSRect bitmapFrame;
     unsigned char *destinationData, *sourceData, *destinationRow, *sourceRow;
     unsigned int opacityFactor;
@@ -680,6 +773,15 @@ ERROR:
             rowCounter, pixelCounter;
     PPLinearRGB16BitmapPixel *destinationPixel;
 
+    if ([self ppIsLinearCompact32Bitmap])
+    {
+        [self ppLinearCompact32CopyFromLinearBitmap: sourceBitmap
+                opacity: opacity
+                inBounds: copyBounds];
+
+        return;
+    }
+
     if (![self ppIsLinearRGB16Bitmap]
         || ![sourceBitmap ppIsLinearRGB16Bitmap])
     {
@@ -780,8 +882,604 @@ ERROR:
 
 @end
 
+@implementation NSBitmapImageRep (PPUtilities_LinearCompact32Bitmaps)
+
+// Compact32 blending error bound, relative to LinearRGB16 blending: Compact32 bitmaps round
+// each blended color component to the nearest 8-bit sRGB value (max error: 0.5 sRGB steps) &
+// each alpha to the nearest 8-bit value, instead of to 16-bit linear values, so a merge of N
+// layers can differ from the LinearRGB16 result by up to N/2 sRGB steps (rounded up) per color
+// component; in practice, pixels merged over an opaque destination or a clear source don't
+// accumulate error, and fully-opaque pixels copied from image bitmaps are exact.
+
++ (NSBitmapImageRep *) ppLinearCompact32BitmapOfSize: (NSSize) size
+{
+    macroTraceMethodScope();
+
+    NSBitmapImageRep *linearBitmap;
+
+    size = PPGeometry_SizeClippedToIntegerValues(size);
+
+    if (PPGeometry_IsZeroSize(size))
+    {
+        goto ERROR;
+    }
+
+    // Compact32 bitmaps are distinguished from image bitmaps (same pixel size) by their
+    // unpremultiplied bitmap format
+
+    linearBitmap =
+            [[[NSBitmapImageRep alloc] initWithBitmapDataPlanes: NULL
+                                        pixelsWide: size.width
+                                        pixelsHigh: size.height
+                                        bitsPerSample: kLinearCompact32BitmapBitsPerSample
+                                        samplesPerPixel: kLinearCompact32BitmapSamplesPerPixel
+                                        hasAlpha: YES
+                                        isPlanar: NO
+                                        colorSpaceName: NSDeviceRGBColorSpace
+                                        bitmapFormat: NSAlphaNonpremultipliedBitmapFormat
+                                        bytesPerRow: 0
+                                        bitsPerPixel: 0]
+                                autorelease];
+
+    if (!linearBitmap)
+        goto ERROR;
+
+    [linearBitmap ppClearBitmap];
+
+    return linearBitmap;
+
+ERROR:
+    return nil;
+}
+
+- (bool) ppIsLinearCompact32Bitmap
+{
+    return (([self bitsPerSample] == kLinearCompact32BitmapBitsPerSample)
+                && ([self samplesPerPixel] == kLinearCompact32BitmapSamplesPerPixel)
+                && ([self bitmapFormat] & NSAlphaNonpremultipliedBitmapFormat))
+            ? YES : NO;
+}
+
+- (void) ppLinearCompact32CopyFromImageBitmap: (NSBitmapImageRep *) sourceBitmap
+            inBounds: (NSRect) copyBounds
+{
+    macroTraceMethodScope();
+
+    NSRect bitmapFrame;
+    unsigned char *destinationData, *sourceData, *destinationRow, *sourceRow;
+    int destinationBytesPerRow, sourceBytesPerRow, rowOffset, destinationDataOffset,
+            sourceDataOffset, pixelsPerRow, rowCounter, pixelCounter;
+    PPLinearCompact32BitmapPixel *destinationPixel;
+    PPImageBitmapPixel *sourcePixel;
+    PPImagePixelComponent *unpremultiplyTable;
+
+    if (![self ppIsLinearCompact32Bitmap]
+        || ![sourceBitmap ppIsImageBitmap])
+    {
+        goto ERROR;
+    }
+
+    bitmapFrame = [self ppFrameInPixels];
+
+    if (!NSEqualSizes(bitmapFrame.size, [sourceBitmap ppSizeInPixels]))
+    {
+        goto ERROR;
+    }
+
+    copyBounds =
+            NSIntersectionRect(PPGeometry_PixelBoundsCoveredByRect(copyBounds), bitmapFrame);
+
+    if (NSIsEmptyRect(copyBounds))
+    {
+        goto ERROR;
+    }
+
+    destinationData = [self bitmapData];
+    sourceData = [sourceBitmap bitmapData];
+
+    if (!destinationData || !sourceData)
+    {
+        goto ERROR;
+    }
+
+    if (!SetupGlobalLinearConversionTablesIfNeeded() || !PPImageAlphaPremultiplyTables_Setup())
+    {
+        goto ERROR;
+    }
+
+    destinationBytesPerRow = [self bytesPerRow];
+    sourceBytesPerRow = [sourceBitmap bytesPerRow];
+
+    rowOffset = bitmapFrame.size.height - copyBounds.size.height - copyBounds.origin.y;
+
+    destinationDataOffset =
+        rowOffset * destinationBytesPerRow
+            + copyBounds.origin.x * sizeof(PPLinearCompact32BitmapPixel);
+
+    sourceDataOffset =
+        rowOffset * sourceBytesPerRow + copyBounds.origin.x * sizeof(PPImageBitmapPixel);
+
+    destinationRow = &destinationData[destinationDataOffset];
+    sourceRow = &sourceData[sourceDataOffset];
+
+    pixelsPerRow = copyBounds.size.width;
+    rowCounter = copyBounds.size.height;
+
+    while (rowCounter--)
+    {
+        destinationPixel = (PPLinearCompact32BitmapPixel *) destinationRow;
+        sourcePixel = (PPImageBitmapPixel *) sourceRow;
+
+        pixelCounter = pixelsPerRow;
+
+        while (pixelCounter--)
+        {
+            if (macroImagePixelComponent_Alpha(sourcePixel) == 0)
+            {
+                *destinationPixel = 0;
+            }
+            else if (macroImagePixelComponent_Alpha(sourcePixel)
+                        == kMaxImagePixelComponentValue)
+            {
+                *destinationPixel = *sourcePixel;
+            }
+            else
+            {
+                unpremultiplyTable = macroAlphaUnpremultiplyTableForImagePixel(sourcePixel);
+
+                macroLinearCompact32PixelComponent_Red(destinationPixel) =
+                            unpremultiplyTable[macroImagePixelComponent_Red(sourcePixel)];
+
+                macroLinearCompact32PixelComponent_Green(destinationPixel) =
+                            unpremultiplyTable[macroImagePixelComponent_Green(sourcePixel)];
+
+                macroLinearCompact32PixelComponent_Blue(destinationPixel) =
+                            unpremultiplyTable[macroImagePixelComponent_Blue(sourcePixel)];
+
+                macroLinearCompact32PixelComponent_Alpha(destinationPixel) =
+                            macroImagePixelComponent_Alpha(sourcePixel);
+            }
+
+            destinationPixel++;
+            sourcePixel++;
+        }
+
+        destinationRow += destinationBytesPerRow;
+        sourceRow += sourceBytesPerRow;
+    }
+
+    return;
+
+ERROR:
+    return;
+}
+
+- (void) ppLinearCompact32CopyToImageBitmap: (NSBitmapImageRep *) destinationBitmap
+            inBounds: (NSRect) copyBounds
+{
+    macroTraceMethodScope();
+
+    NSRect bitmapFrame;
+    unsigned char *destinationData, *sourceData, *destinationRow, *sourceRow;
+    int destinationBytesPerRow, sourceBytesPerRow, rowOffset, destinationDataOffset,
+            sourceDataOffset, pixelsPerRow, rowCounter, pixelCounter;
+    PPImageBitmapPixel *destinationPixel;
+    PPLinearCompact32BitmapPixel *sourcePixel;
+    PPImagePixelComponent *premultiplyTable;
+
+    if (![self ppIsLinearCompact32Bitmap]
+        || ![destinationBitmap ppIsImageBitmap])
+    {
+        goto ERROR;
+    }
+
+    bitmapFrame = [self ppFrameInPixels];
+
+    if (!NSEqualSizes(bitmapFrame.size, [destinationBitmap ppSizeInPixels]))
+    {
+        goto ERROR;
+    }
+
+    copyBounds =
+            NSIntersectionRect(PPGeometry_PixelBoundsCoveredByRect(copyBounds), bitmapFrame);
+
+    if (NSIsEmptyRect(copyBounds))
+    {
+        goto ERROR;
+    }
+
+    destinationData = [destinationBitmap bitmapData];
+    sourceData = [self bitmapData];
+
+    if (!destinationData || !sourceData)
+    {
+        goto ERROR;
+    }
+
+    if (!SetupGlobalLinearConversionTablesIfNeeded() || !PPImageAlphaPremultiplyTables_Setup())
+    {
+        goto ERROR;
+    }
+
+    destinationBytesPerRow = [destinationBitmap bytesPerRow];
+    sourceBytesPerRow = [self bytesPerRow];
+
+    rowOffset = bitmapFrame.size.height - copyBounds.size.height - copyBounds.origin.y;
+
+    destinationDataOffset =
+        rowOffset * destinationBytesPerRow + copyBounds.origin.x * sizeof(PPImageBitmapPixel);
+
+    sourceDataOffset =
+        rowOffset * sourceBytesPerRow
+            + copyBounds.origin.x * sizeof(PPLinearCompact32BitmapPixel);
+
+    destinationRow = &destinationData[destinationDataOffset];
+    sourceRow = &sourceData[sourceDataOffset];
+
+    pixelsPerRow = copyBounds.size.width;
+    rowCounter = copyBounds.size.height;
+
+    while (rowCounter--)
+    {
+        destinationPixel = (PPImageBitmapPixel *) destinationRow;
+        sourcePixel = (PPLinearCompact32BitmapPixel *) sourceRow;
+
+        pixelCounter = pixelsPerRow;
+
+        while (pixelCounter--)
+        {
+            if (macroLinearCompact32PixelComponent_Alpha(sourcePixel) == 0)
+            {
+                *destinationPixel = 0;
+            }
+            else if (macroLinearCompact32PixelComponent_Alpha(sourcePixel)
+                        == kMaxLinearCompact32PixelComponentValue)
+            {
+                *destinationPixel = *sourcePixel;
+            }
+            else
+            {
+                macroImagePixelComponent_Alpha(destinationPixel) =
+                                    macroLinearCompact32PixelComponent_Alpha(sourcePixel);
+
+                premultiplyTable = macroAlphaPremultiplyTableForImagePixel(destinationPixel);
+
+                macroImagePixelComponent_Red(destinationPixel) =
+                    premultiplyTable[macroLinearCompact32PixelComponent_Red(sourcePixel)];
+
+                macroImagePixelComponent_Green(destinationPixel) =
+                    premultiplyTable[macroLinearCompact32PixelComponent_Green(sourcePixel)];
+
+                macroImagePixelComponent_Blue(destinationPixel) =
+                    premultiplyTable[macroLinearCompact32PixelComponent_Blue(sourcePixel)];
+            }
+
+            destinationPixel++;
+            sourcePixel++;
+        }
+
+        destinationRow += destinationBytesPerRow;
+        sourceRow += sourceBytesPerRow;
+    }
+
+    return;
+
+ERROR:
+    return;
+}
+
+- (void) ppLinearCompact32BlendFromLinearBitmapUnderneath: (NSBitmapImageRep *) sourceBitmap
+            sourceOpacity: (float) sourceOpacity
+            inBounds: (NSRect) blendingBounds
+{
+    macroTraceMethodScope();
+
+    NSRect bitmapFrame;
+    unsigned char *destinationData, *sourceData, *destinationRow, *sourceRow;
+    unsigned int sourceOpacityFactor, destinationComponentAlphaFactor,
+                    sourceComponentAlphaFactor, sumOfAlphaFactors,
+                    alphaFactorsPrenormalizationRoundoff;
+    int destinationBytesPerRow, sourceBytesPerRow, rowOffset,
+            destinationDataOffset, sourceDataOffset, pixelsPerRow, rowCounter, pixelCounter;
+    PPLinearCompact32BitmapPixel *destinationPixel, *sourcePixel;
+
+    if (![self ppIsLinearCompact32Bitmap]
+        || ![sourceBitmap ppIsLinearCompact32Bitmap])
+    {
+        goto ERROR;
+    }
+
+    sourceOpacity = macroClampFloatValueTo0_1(sourceOpacity);
+
+    sourceOpacityFactor = roundf(sourceOpacity * kMaxLinearCompact32PixelComponentValue);
+
+    if (sourceOpacityFactor == 0)
+    {
+        return;
+    }
+
+    bitmapFrame = [self ppFrameInPixels];
+
+    if (!NSEqualSizes(bitmapFrame.size, [sourceBitmap ppSizeInPixels]))
+    {
+        goto ERROR;
+    }
+
+    blendingBounds =
+        NSIntersectionRect(PPGeometry_PixelBoundsCoveredByRect(blendingBounds), bitmapFrame);
+
+    if (NSIsEmptyRect(blendingBounds))
+    {
+        goto ERROR;
+    }
+
+    destinationData = [self bitmapData];
+    sourceData = [sourceBitmap bitmapData];
+
+    if (!destinationData || !sourceData)
+    {
+        goto ERROR;
+    }
+
+    if (!SetupGlobalLinearConversionTablesIfNeeded())
+        goto ERROR;
+
+    destinationBytesPerRow = [self bytesPerRow];
+    sourceBytesPerRow = [sourceBitmap bytesPerRow];
+
+    rowOffset = bitmapFrame.size.height - blendingBounds.size.height - blendingBounds.origin.y;
+
+    destinationDataOffset =
+        rowOffset * destinationBytesPerRow
+        + blendingBounds.origin.x * sizeof(PPLinearCompact32BitmapPixel);
+
+    sourceDataOffset =
+        rowOffset * sourceBytesPerRow
+        + blendingBounds.origin.x * sizeof(PPLinearCompact32BitmapPixel);
+
+    destinationRow = &destinationData[destinationDataOffset];
+    sourceRow = &sourceData[sourceDataOffset];
+
+    pixelsPerRow = blendingBounds.size.width;
+    rowCounter = blendingBounds.size.height;
+
+    // Same blending math as the LinearRGB16 method, but with 8-bit alpha factors; when
+    // sourceOpacityFactor is at its max value, the opacity multiplication is exact, so there's
+    // no separate fully-opaque loop
+
+    while (rowCounter--)
+    {
+        destinationPixel = (PPLinearCompact32BitmapPixel *) destinationRow;
+        sourcePixel = (PPLinearCompact32BitmapPixel *) sourceRow;
+
+        pixelCounter = pixelsPerRow;
+
+        while (pixelCounter--)
+        {
+            if (macroLinearCompact32PixelComponent_Alpha(destinationPixel) > 0)
+            {
+                if ((macroLinearCompact32PixelComponent_Alpha(destinationPixel)
+                            < kMaxLinearCompact32PixelComponentValue)
+                    && (macroLinearCompact32PixelComponent_Alpha(sourcePixel) > 0))
+                {
+                    destinationComponentAlphaFactor =
+                                macroLinearCompact32PixelComponent_Alpha(destinationPixel);
+
+                    sourceComponentAlphaFactor =
+                        (sourceOpacityFactor
+                            * (kMaxLinearCompact32PixelComponentValue
+                                - destinationComponentAlphaFactor)
+                            + kLinearCompact32PixelComponentPrenormalizationRoundoff)
+                        / kMaxLinearCompact32PixelComponentValue;
+
+                    if (macroLinearCompact32PixelComponent_Alpha(sourcePixel)
+                            < kMaxLinearCompact32PixelComponentValue)
+                    {
+                        sourceComponentAlphaFactor =
+                            (sourceComponentAlphaFactor
+                                * macroLinearCompact32PixelComponent_Alpha(sourcePixel)
+                                + kLinearCompact32PixelComponentPrenormalizationRoundoff)
+                            / kMaxLinearCompact32PixelComponentValue;
+                    }
+
+                    if (sourceComponentAlphaFactor > 0)
+                    {
+                        sumOfAlphaFactors =
+                            destinationComponentAlphaFactor + sourceComponentAlphaFactor;
+
+                        alphaFactorsPrenormalizationRoundoff =
+                            macroRoundoffValueForDivisor(sumOfAlphaFactors);
+
+                        macroLinearCompact32PixelComponent_Red(destinationPixel) =
+                            macroCompact32BlendedComponent(
+                                    macroLinearCompact32PixelComponent_Red(destinationPixel),
+                                    destinationComponentAlphaFactor,
+                                    macroLinearCompact32PixelComponent_Red(sourcePixel),
+                                    sourceComponentAlphaFactor,
+                                    sumOfAlphaFactors,
+                                    alphaFactorsPrenormalizationRoundoff);
+
+                        macroLinearCompact32PixelComponent_Green(destinationPixel) =
+                            macroCompact32BlendedComponent(
+                                    macroLinearCompact32PixelComponent_Green(destinationPixel),
+                                    destinationComponentAlphaFactor,
+                                    macroLinearCompact32PixelComponent_Green(sourcePixel),
+                                    sourceComponentAlphaFactor,
+                                    sumOfAlphaFactors,
+                                    alphaFactorsPrenormalizationRoundoff);
+
+                        macroLinearCompact32PixelComponent_Blue(destinationPixel) =
+                            macroCompact32BlendedComponent(
+                                    macroLinearCompact32PixelComponent_Blue(destinationPixel),
+                                    destinationComponentAlphaFactor,
+                                    macroLinearCompact32PixelComponent_Blue(sourcePixel),
+                                    sourceComponentAlphaFactor,
+                                    sumOfAlphaFactors,
+                                    alphaFactorsPrenormalizationRoundoff);
+
+                        macroLinearCompact32PixelComponent_Alpha(destinationPixel) =
+                            sumOfAlphaFactors;
+                    }
+                }
+            }
+            else if (macroLinearCompact32PixelComponent_Alpha(sourcePixel) > 0)
+            {
+                *destinationPixel = *sourcePixel;
+
+                macroLinearCompact32PixelComponent_Alpha(destinationPixel) =
+                    (sourceOpacityFactor
+                            * macroLinearCompact32PixelComponent_Alpha(destinationPixel)
+                            + kLinearCompact32PixelComponentPrenormalizationRoundoff)
+                        / kMaxLinearCompact32PixelComponentValue;
+            }
+
+            destinationPixel++;
+            sourcePixel++;
+        }
+
+        destinationRow += destinationBytesPerRow;
+        sourceRow += sourceBytesPerRow;
+    }
+
+    return;
+
+ERROR:
+    return;
+}
+
+- (void) ppLinearCompact32CopyFromLinearBitmap: (NSBitmapImageRep *) sourceBitmap
+            opacity: (float) opacity
+            inBounds: (NSRect) copyBounds
+{
+    macroTraceMethodScope();
+
+    NSRect bitmapFrame;
+    unsigned char *destinationData, *sourceData, *destinationRow, *sourceRow;
+    unsigned int opacityFactor;
+    int destinationBytesPerRow, sourceBytesPerRow, rowOffset,
+            destinationDataOffset, sourceDataOffset, pixelsPerRow, bytesToCopyPerRow,
+            rowCounter, pixelCounter;
+    PPLinearCompact32BitmapPixel *destinationPixel;
+
+    if (![self ppIsLinearCompact32Bitmap]
+        || ![sourceBitmap ppIsLinearCompact32Bitmap])
+    {
+        goto ERROR;
+    }
+
+    opacity = macroClampFloatValueTo0_1(opacity);
+
+    opacityFactor = roundf(opacity * kMaxLinearCompact32PixelComponentValue);
+
+    if (opacityFactor >= kMaxLinearCompact32PixelComponentValue)
+    {
+        [self ppCopyFromBitmap: sourceBitmap inRect: copyBounds toPoint: copyBounds.origin];
+        return;
+    }
+    else if (opacityFactor == 0)
+    {
+        [self ppClearBitmapInBounds: copyBounds];
+        return;
+    }
+
+    bitmapFrame = [self ppFrameInPixels];
+
+    if (!NSEqualSizes(bitmapFrame.size, [sourceBitmap ppSizeInPixels]))
+    {
+        goto ERROR;
+    }
+
+    copyBounds =
+        NSIntersectionRect(PPGeometry_PixelBoundsCoveredByRect(copyBounds), bitmapFrame);
+
+    if (NSIsEmptyRect(copyBounds))
+    {
+        goto ERROR;
+    }
+
+    destinationData = [self bitmapData];
+    sourceData = [sourceBitmap bitmapData];
+
+    if (!destinationData || !sourceData)
+    {
+        goto ERROR;
+    }
+
+    destinationBytesPerRow = [self bytesPerRow];
+    sourceBytesPerRow = [sourceBitmap bytesPerRow];
+
+    rowOffset = bitmapFrame.size.height - copyBounds.size.height - copyBounds.origin.y;
+
+    destinationDataOffset =
+        rowOffset * destinationBytesPerRow
+        + copyBounds.origin.x * sizeof(PPLinearCompact32BitmapPixel);
+
+    sourceDataOffset =
+        rowOffset * sourceBytesPerRow
+        + copyBounds.origin.x * sizeof(PPLinearCompact32BitmapPixel);
+
+    destinationRow = &destinationData[destinationDataOffset];
+    sourceRow = &sourceData[sourceDataOffset];
+
+    pixelsPerRow = copyBounds.size.width;
+    bytesToCopyPerRow = pixelsPerRow * sizeof(PPLinearCompact32BitmapPixel);
+
+    rowCounter = copyBounds.size.height;
+
+    while (rowCounter--)
+    {
+        // copy the row's pixel data
+
+        memcpy(destinationRow, sourceRow, bytesToCopyPerRow);
+
+        // loop over the copied pixels & multiply the alpha components by the opacity
+
+        destinationPixel = (PPLinearCompact32BitmapPixel *) destinationRow;
+
+        pixelCounter = pixelsPerRow;
+
+        while (pixelCounter--)
+        {
+            macroLinearCompact32PixelComponent_Alpha(destinationPixel) =
+                (opacityFactor
+                    * macroLinearCompact32PixelComponent_Alpha(destinationPixel)
+                    + kLinearCompact32PixelComponentPrenormalizationRoundoff)
+                / kMaxLinearCompact32PixelComponentValue;
+
+            destinationPixel++;
+        }
+
+        destinationRow += destinationBytesPerRow;
+        sourceRow += sourceBytesPerRow;
+    }
+
+    return;
+
+ERROR:
+    return;
+}
+
+@end
+
 #pragma mark Private functions
 
+// SetupGlobalLinearConversionTablesIfNeeded() is thread-safe (linear bitmaps may be converted
+// or blended on background threads), & only costs a pthread_once() check after the first call,
+// so it's called once per bitmap operation, outside of the pixel loops
+
+static bool SetupGlobalLinearConversionTablesIfNeeded(void)
+{
+    pthread_once(&gSetupLinearConversionTablesOnceControl,
+                    SetupGlobalLinearConversionTablesOnce);
+
+    return (gSRGBValuesForLinear16ValuesTable) ? YES : NO;
+}
+
+static void SetupGlobalLinearConversionTablesOnce(void)
+{
+    SetupGlobalLinearConversionTables();
+}
+
 static bool SetupGlobalLinearConversionTables(void)
 {
     int sizeOfSRGBValuesForLinearValuesTable, sizeOfLinearValuesForSRGBValuesTable,
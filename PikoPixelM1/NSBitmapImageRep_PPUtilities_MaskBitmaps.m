@@ -25,6 +25,7 @@
 #import "NSBitmapImageRep_PPUtilities.h"
 
 #import "PPGeometry.h"
+#import "PPTrace.h"
 
 
 #define kMaskBitmapBitsPerSample        (sizeof(PPMaskBitmapPixel) * 8)
@@ -36,6 +37,8 @@
 
 + (NSBitmapImageRep *) ppMaskBitmapOfSize: (NSSize) size
 {
+    macroTraceMethodScope();
+
     NSBitmapImageRep *maskBitmap;
 
     size = PPGeometry_SizeClippedToIntegerValues(size);
@@ -80,84 +83,34 @@ ERROR:
 
 - (NSRect) ppMaskBoundsInRect: (NSRect) checkBounds
 {
-    NSRect frame;
-    int bytesPerRow, maskLeft, maskTop, maskBottom, maskRight,
-        checkLeft, checkRight, checkBottom, checkTop, row, col;
-    unsigned char *upperLeftBoundedData, *rowData;
-    PPMaskBitmapPixel *maskPixel;
+    macroTraceMethodScope();
 
-    if (![self ppIsMaskBitmap])
+    PPPixelBuffer maskBuffer;
+    PPPixelRect maskBounds;
+
+    if (![self ppIsMaskBitmap] || ![self ppGetPixelBuffer: &maskBuffer])
     {
         goto ERROR;
     }
 
-    frame = [self ppFrameInPixels];
-
-    checkBounds = NSIntersectionRect(frame, PPGeometry_PixelBoundsCoveredByRect(checkBounds));
+    checkBounds = NSIntersectionRect([self ppFrameInPixels],
+                                        PPGeometry_PixelBoundsCoveredByRect(checkBounds));
 
     if (NSIsEmptyRect(checkBounds))
     {
         goto ERROR;
     }
 
-    checkBottom = checkBounds.origin.y;
-    checkTop = checkBottom + checkBounds.size.height - 1;
-    checkLeft = checkBounds.origin.x;
-    checkRight = checkLeft + checkBounds.size.width - 1;
+    PPPixelCore_GetMaskBoundsInRect(&maskBuffer, [self ppPixelRectForBounds: checkBounds],
+                                    &maskBounds);
 
-    bytesPerRow = [self bytesPerRow];
-
-    upperLeftBoundedData = [self bitmapData];
-    upperLeftBoundedData +=
-        checkLeft
-        + bytesPerRow
-            * (int) (frame.size.height - (checkBounds.origin.y + checkBounds.size.height));
-
-    maskRight = checkLeft;
-    maskLeft = checkRight;
-    maskTop = checkBottom;
-    maskBottom = checkTop + 1;
-
-    rowData = upperLeftBoundedData;
-
-    for (row=checkTop; row>=checkBottom; row--)
-    {
-        maskPixel = (PPMaskBitmapPixel *) rowData;
-
-        for (col=checkLeft; col<=checkRight; col++)
-        {
-            if (*maskPixel)
-            {
-                if (maskLeft > col)
-                {
-                    maskLeft = col;
-                }
-
-                if (maskRight < col)
-                {
-                    maskRight = col;
-                }
-
-                if (maskTop < row)
-                {
-                    maskTop = row;
-                }
-
-                maskBottom = row;
-            }
-
-            maskPixel++;
-        }
-
-        rowData += bytesPerRow;
-    }
-
-    if (maskBottom > checkTop)
+    if (PPPixelRect_IsEmpty(maskBounds))
     {
         return NSZeroRect;
     }
 
-    return NSMakeRect(maskLeft, maskBottom, maskRight - maskLeft + 1, maskTop - maskBottom + 1);
+    return NSMakeRect(maskBounds.x, maskBuffer.height - (maskBounds.y + maskBounds.height),
+                        maskBounds.width, maskBounds.height);
 
 ERROR:
     return NSZeroRect;
@@ -165,45 +118,17 @@ ERROR:
 
 - (bool) ppMaskIsNotEmpty
 {
-    unsigned char *maskRow;
-    NSSize maskSize;
-    int bytesPerRow, pixelsPerRow, rowCounter, pixelCounter;
-    PPMaskBitmapPixel *maskPixel;
-
-    if (![self ppIsMaskBitmap])
-    {
-        goto ERROR;
-    }
-
-    maskRow = [self bitmapData];
-
-    if (!maskRow)
-        goto ERROR;
-
-    bytesPerRow = [self bytesPerRow];
-
-    maskSize = [self ppSizeInPixels];
+    macroTraceMethodScope();
 
-    pixelsPerRow = maskSize.width;
-    rowCounter = maskSize.height;
+    PPPixelBuffer maskBuffer;
 
-    while (rowCounter--)
+    if (![self ppIsMaskBitmap] || ![self ppGetPixelBuffer: &maskBuffer])
     {
-        maskPixel = (PPMaskBitmapPixel *) maskRow;
-        pixelCounter = pixelsPerRow;
-
-        while (pixelCounter--)
-        {
-            if (*maskPixel++)
-            {
-                return YES;
-            }
-        }
-
-        maskRow += bytesPerRow;
+        goto ERROR;
     }
 
-    return NO;
+    return PPPixelCore_MaskHasNonzeroPixelsInRect(&maskBuffer,
+                                                    PPPixelBuffer_Frame(&maskBuffer));
 
 ERROR:
     return NO;
@@ -211,45 +136,17 @@ ERROR:
 
 - (bool) ppMaskCoversAllPixels
 {
-    unsigned char *maskRow;
-    NSSize maskSize;
-    int bytesPerRow, pixelsPerRow, rowCounter, pixelCounter;
-    PPMaskBitmapPixel *maskPixel;
-
-    if (![self ppIsMaskBitmap])
-    {
-        goto ERROR;
-    }
-
-    maskRow = [self bitmapData];
-
-    if (!maskRow)
-        goto ERROR;
-
-    bytesPerRow = [self bytesPerRow];
+    macroTraceMethodScope();
 
-    maskSize = [self ppSizeInPixels];
+    PPPixelBuffer maskBuffer;
 
-    pixelsPerRow = maskSize.width;
-    rowCounter = maskSize.height;
-
-    while (rowCounter--)
+    if (![self ppIsMaskBitmap] || ![self ppGetPixelBuffer: &maskBuffer])
     {
-        maskPixel = (PPMaskBitmapPixel *) maskRow;
-        pixelCounter = pixelsPerRow;
-
-        while (pixelCounter--)
-        {
-            if (!*maskPixel++)
-            {
-                return NO;
-            }
-        }
-
-        maskRow += bytesPerRow;
+        goto ERROR;
     }
 
-    return YES;
+    return PPPixelCore_MaskCoversAllPixelsInRect(&maskBuffer,
+                                                    PPPixelBuffer_Frame(&maskBuffer));
 
 ERROR:
     return NO;
@@ -294,44 +191,25 @@ ERROR:
 
 - (void) ppMaskPixelsInBounds: (NSRect) bounds
 {
-    NSRect bitmapFrame;
-    unsigned char *bitmapData;
-    unsigned numRowsToSkip, bytesPerRow, bytesPerPixel, numBytesToSetPerRow, rowCounter;
+    macroTraceMethodScope();
 
-    if (![self ppIsMaskBitmap])
+    PPPixelBuffer maskBuffer;
+
+    if (![self ppIsMaskBitmap] || ![self ppGetPixelBuffer: &maskBuffer])
     {
         goto ERROR;
     }
 
-    bitmapFrame = [self ppFrameInPixels];
-
-    bounds = NSIntersectionRect(PPGeometry_PixelBoundsCoveredByRect(bounds), bitmapFrame);
+    bounds = NSIntersectionRect(PPGeometry_PixelBoundsCoveredByRect(bounds),
+                                [self ppFrameInPixels]);
 
     if (NSIsEmptyRect(bounds))
     {
         return;
     }
 
-    bitmapData = [self bitmapData];
-
-    if (!bitmapData)
-        goto ERROR;
-
-    numRowsToSkip = bitmapFrame.size.height - (bounds.origin.y + bounds.size.height);
-    bytesPerRow = [self bytesPerRow];
-    bytesPerPixel = sizeof(PPMaskBitmapPixel);
-    numBytesToSetPerRow = bounds.size.width * bytesPerPixel;
-
-    bitmapData += numRowsToSkip * bytesPerRow + (int) bounds.origin.x * bytesPerPixel;
-
-    rowCounter = bounds.size.height;
-
-    while (rowCounter--)
-    {
-        memset(bitmapData, kMaskPixelValue_ON, numBytesToSetPerRow);
-
-        bitmapData += bytesPerRow;
-    }
+    PPPixelCore_FillMaskInRect(&maskBuffer, [self ppPixelRectForBounds: bounds],
+                                kMaskPixelValue_ON);
 
     return;
 
@@ -347,11 +225,10 @@ ERROR:
 - (void) ppIntersectMaskWithMaskBitmap: (NSBitmapImageRep *) maskBitmap
             inBounds: (NSRect) intersectBounds
 {
+    macroTraceMethodScope();
+
     NSRect bitmapFrame;
-    unsigned char *destinationData, *maskData, *destinationRow, *maskRow;
-    int destinationBytesPerRow, maskBytesPerRow, rowOffset, destinationDataOffset,
-            maskDataOffset, pixelsPerRow, rowCounter, pixelCounter;
-    PPMaskBitmapPixel *destinationPixel, *maskPixel;
+    PPPixelBuffer destinationBuffer, maskBuffer;
 
     if (![self ppIsMaskBitmap] || ![maskBitmap ppIsMaskBitmap])
     {
@@ -373,53 +250,14 @@ ERROR:
         goto ERROR;
     }
 
-    destinationData = [self bitmapData];
-    maskData = [maskBitmap bitmapData];
-
-    if (!destinationData || !maskData)
+    if (![self ppGetPixelBuffer: &destinationBuffer]
+        || ![maskBitmap ppGetPixelBuffer: &maskBuffer])
     {
         goto ERROR;
     }
 
-    destinationBytesPerRow = [self bytesPerRow];
-    maskBytesPerRow = [maskBitmap bytesPerRow];
-
-    rowOffset =
-        bitmapFrame.size.height - intersectBounds.size.height - intersectBounds.origin.y;
-
-    destinationDataOffset = rowOffset * destinationBytesPerRow
-                                + intersectBounds.origin.x * sizeof(PPMaskBitmapPixel);
-
-    maskDataOffset =
-        rowOffset * maskBytesPerRow + intersectBounds.origin.x * sizeof(PPMaskBitmapPixel);
-
-    destinationRow = &destinationData[destinationDataOffset];
-    maskRow = &maskData[maskDataOffset];
-
-    pixelsPerRow = intersectBounds.size.width;
-    rowCounter = intersectBounds.size.height;
-
-    while (rowCounter--)
-    {
-        destinationPixel = (PPMaskBitmapPixel *) destinationRow;
-        maskPixel = (PPMaskBitmapPixel *) maskRow;
-
-        pixelCounter = pixelsPerRow;
-
-        while (pixelCounter--)
-        {
-            if (*destinationPixel && !*maskPixel)
-            {
-                *destinationPixel = kMaskPixelValue_OFF;
-            }
-
-            destinationPixel++;
-            maskPixel++;
-        }
-
-        destinationRow += destinationBytesPerRow;
-        maskRow += maskBytesPerRow;
-    }
+    PPPixelCore_IntersectMaskWithMaskInRect(&destinationBuffer, &maskBuffer,
+                                            [self ppPixelRectForBounds: intersectBounds]);
 
     return;
 
@@ -435,11 +273,10 @@ ERROR:
 - (void) ppSubtractMaskBitmap: (NSBitmapImageRep *) maskBitmap
             inBounds: (NSRect) subtractBounds
 {
+    macroTraceMethodScope();
+
     NSRect bitmapFrame;
-    unsigned char *destinationData, *maskData, *destinationRow, *maskRow;
-    int destinationBytesPerRow, maskBytesPerRow, rowOffset, destinationDataOffset,
-            maskDataOffset, pixelsPerRow, rowCounter, pixelCounter;
-    PPMaskBitmapPixel *destinationPixel, *maskPixel;
+    PPPixelBuffer destinationBuffer, maskBuffer;
 
     if (![self ppIsMaskBitmap] || ![maskBitmap ppIsMaskBitmap])
     {
@@ -461,52 +298,14 @@ ERROR:
         goto ERROR;
     }
 
-    destinationData = [self bitmapData];
-    maskData = [maskBitmap bitmapData];
-
-    if (!destinationData || !maskData)
+    if (![self ppGetPixelBuffer: &destinationBuffer]
+        || ![maskBitmap ppGetPixelBuffer: &maskBuffer])
     {
         goto ERROR;
     }
 
-    destinationBytesPerRow = [self bytesPerRow];
-    maskBytesPerRow = [maskBitmap bytesPerRow];
-
-    rowOffset = bitmapFrame.size.height - subtractBounds.size.height - subtractBounds.origin.y;
-
-    destinationDataOffset = rowOffset * destinationBytesPerRow
-                                + subtractBounds.origin.x * sizeof(PPMaskBitmapPixel);
-
-    maskDataOffset =
-        rowOffset * maskBytesPerRow + subtractBounds.origin.x * sizeof(PPMaskBitmapPixel);
-
-    destinationRow = &destinationData[destinationDataOffset];
-    maskRow = &maskData[maskDataOffset];
-
-    pixelsPerRow = subtractBounds.size.width;
-    rowCounter = subtractBounds.size.height;
-
-    while (rowCounter--)
-    {
-        destinationPixel = (PPMaskBitmapPixel *) destinationRow;
-        maskPixel = (PPMaskBitmapPixel *) maskRow;
-
-        pixelCounter = pixelsPerRow;
-
-        while (pixelCounter--)
-        {
-            if (*destinationPixel && *maskPixel)
-            {
-                *destinationPixel = kMaskPixelValue_OFF;
-            }
-
-            destinationPixel++;
-            maskPixel++;
-        }
-
-        destinationRow += destinationBytesPerRow;
-        maskRow += maskBytesPerRow;
-    }
+    PPPixelCore_SubtractMaskFromMaskInRect(&destinationBuffer, &maskBuffer,
+                                           [self ppPixelRectForBounds: subtractBounds]);
 
     return;
 
@@ -522,11 +321,10 @@ ERROR:
 - (void) ppMergeMaskWithMaskBitmap: (NSBitmapImageRep *) maskBitmap
             inBounds: (NSRect) mergeBounds
 {
+    macroTraceMethodScope();
+
     NSRect bitmapFrame;
-    unsigned char *destinationData, *maskData, *destinationRow, *maskRow;
-    int destinationBytesPerRow, maskBytesPerRow, rowOffset, destinationDataOffset,
-            maskDataOffset, pixelsPerRow, rowCounter, pixelCounter;
-    PPMaskBitmapPixel *destinationPixel, *maskPixel;
+    PPPixelBuffer destinationBuffer, maskBuffer;
 
     if (![self ppIsMaskBitmap] || ![maskBitmap ppIsMaskBitmap])
     {
@@ -548,52 +346,14 @@ ERROR:
         goto ERROR;
     }
 
-    destinationData = [self bitmapData];
-    maskData = [maskBitmap bitmapData];
-
-    if (!destinationData || !maskData)
+    if (![self ppGetPixelBuffer: &destinationBuffer]
+        || ![maskBitmap ppGetPixelBuffer: &maskBuffer])
     {
         goto ERROR;
     }
 
-    destinationBytesPerRow = [self bytesPerRow];
-    maskBytesPerRow = [maskBitmap bytesPerRow];
-
-    rowOffset = bitmapFrame.size.height - mergeBounds.size.height - mergeBounds.origin.y;
-
-    destinationDataOffset = rowOffset * destinationBytesPerRow
-                                + mergeBounds.origin.x * sizeof(PPMaskBitmapPixel);
-
-    maskDataOffset =
-            rowOffset * maskBytesPerRow + mergeBounds.origin.x * sizeof(PPMaskBitmapPixel);
-
-    destinationRow = &destinationData[destinationDataOffset];
-    maskRow = &maskData[maskDataOffset];
-
-    pixelsPerRow = mergeBounds.size.width;
-    rowCounter = mergeBounds.size.height;
-
-    while (rowCounter--)
-    {
-        destinationPixel = (PPMaskBitmapPixel *) destinationRow;
-        maskPixel = (PPMaskBitmapPixel *) maskRow;
-
-        pixelCounter = pixelsPerRow;
-
-        while (pixelCounter--)
-        {
-            if (!*destinationPixel && *maskPixel)
-            {
-                *destinationPixel = kMaskPixelValue_ON;
-            }
-
-            destinationPixel++;
-            maskPixel++;
-        }
-
-        destinationRow += destinationBytesPerRow;
-        maskRow += maskBytesPerRow;
-    }
+    PPPixelCore_MergeMaskWithMaskInRect(&destinationBuffer, &maskBuffer,
+                                        [self ppPixelRectForBounds: mergeBounds]);
 
     return;
 
@@ -603,43 +363,16 @@ ERROR:
 
 - (void) ppInvertMaskBitmap
 {
-    NSSize maskSize;
-    int bytesPerRow, pixelsPerRow, rowCounter, pixelCounter;
-    unsigned char *maskData, *maskRow;
-    PPMaskBitmapPixel *maskPixel;
+    macroTraceMethodScope();
 
-    if (![self ppIsMaskBitmap])
+    PPPixelBuffer maskBuffer;
+
+    if (![self ppIsMaskBitmap] || ![self ppGetPixelBuffer: &maskBuffer])
     {
         goto ERROR;
     }
 
-    maskData = [self bitmapData];
-
-    if (!maskData)
-        goto ERROR;
-
-    maskRow = maskData;
-    bytesPerRow = [self bytesPerRow];
-
-    maskSize = [self ppSizeInPixels];
-
-    pixelsPerRow = maskSize.width;
-    rowCounter = maskSize.height;
-
-    while (rowCounter--)
-    {
-        maskPixel = (PPMaskBitmapPixel *) maskRow;
-        pixelCounter = pixelsPerRow;
-
-        while (pixelCounter--)
-        {
-            *maskPixel = ~*maskPixel;
-
-            maskPixel++;
-        }
-
-        maskRow += bytesPerRow;
-    }
+    PPPixelCore_InvertMaskInRect(&maskBuffer, PPPixelBuffer_Frame(&maskBuffer));
 
     return;
 
@@ -649,6 +382,8 @@ ERROR:
 
 - (void) ppCloseHolesInMaskBitmap
 {
+    macroTraceMethodScope();
+
     NSRect maskBounds;
     NSBitmapImageRep *workingMaskBitmap, *workingImageBitmap, *scratchMaskBitmap;
     NSInteger lastRow, lastCol, row, col;
@@ -782,56 +517,24 @@ ERROR:
 
 - (void) ppThresholdMaskBitmapPixelValuesInBounds: (NSRect) bounds
 {
-    NSRect bitmapFrame;
-    unsigned char *maskData, *maskRow;
-    int numRowsToSkip, bytesPerRow, maskDataOffset, pixelsPerRow, rowCounter, pixelCounter;
-    PPMaskBitmapPixel *maskPixel;
+    macroTraceMethodScope();
 
-    if (![self ppIsMaskBitmap])
+    PPPixelBuffer maskBuffer;
+
+    if (![self ppIsMaskBitmap] || ![self ppGetPixelBuffer: &maskBuffer])
     {
         goto ERROR;
     }
 
-    bitmapFrame = [self ppFrameInPixels];
-
-    bounds = NSIntersectionRect(bitmapFrame, PPGeometry_PixelBoundsCoveredByRect(bounds));
+    bounds = NSIntersectionRect([self ppFrameInPixels],
+                                PPGeometry_PixelBoundsCoveredByRect(bounds));
 
     if (NSIsEmptyRect(bounds))
     {
         goto ERROR;
     }
 
-    maskData = [self bitmapData];
-
-    if (!maskData)
-        goto ERROR;
-
-    numRowsToSkip = bitmapFrame.size.height - (bounds.origin.y + bounds.size.height);
-    bytesPerRow = [self bytesPerRow];
-    maskDataOffset = numRowsToSkip * bytesPerRow
-                        + (int) bounds.origin.x * sizeof(PPMaskBitmapPixel);
-
-    maskRow = &maskData[maskDataOffset];
-
-    pixelsPerRow = bounds.size.width;
-    rowCounter = bounds.size.height;
-
-    while (rowCounter--)
-    {
-        maskPixel = (PPMaskBitmapPixel *) maskRow;
-        pixelCounter = pixelsPerRow;
-
-        while (pixelCounter--)
-        {
-            *maskPixel =
-                (*maskPixel > kMaskPixelValue_Threshold) ?
-                    kMaskPixelValue_ON : kMaskPixelValue_OFF;
-
-            maskPixel++;
-        }
-
-        maskRow += bytesPerRow;
-    }
+    PPPixelCore_ThresholdMaskInRect(&maskBuffer, [self ppPixelRectForBounds: bounds]);
 
     return;
 
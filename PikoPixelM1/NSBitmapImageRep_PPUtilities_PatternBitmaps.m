@@ -28,6 +28,7 @@
 #import "PPGeometry.h"
 #import "PPSRGBUtilities.h"
 #import "PPImagePixelAlphaPremultiplyTables.h"
+#import "PPTrace.h"
 
 
 #define kMinPatternSizeForPixelFramingInFillOverlayPattern          (4.0f)
@@ -54,6 +55,8 @@ static PPImageBitmapPixel *PPImagePixelGradientArrayOfSizeWithEndColors(unsigned
                             color1: (NSColor *) color1
                             color2: (NSColor *) color2
 {
+    macroTraceMethodScope();
+
     NSSize patternSize;
     NSBitmapImageRep *patternBitmap;
     unsigned char *patternRow;
@@ -186,6 +189,8 @@ ERROR:
                             color1: (NSColor *) color1
                             color2: (NSColor *) color2
 {
+    macroTraceMethodScope();
+
     NSSize patternSize;
     NSBitmapImageRep *patternBitmap;
     NSColor *averageColor;
@@ -280,6 +285,8 @@ ERROR:
                             color1: (NSColor *) color1
                             color2: (NSColor *) color2
 {
+    macroTraceMethodScope();
+
     NSSize patternSize;
     NSBitmapImageRep *patternBitmap;
     NSColor *averageColor, *mixed25PercentColor, *mixed75PercentColor;
@@ -383,6 +390,8 @@ ERROR:
                             color1: (NSColor *) color1
                             color2: (NSColor *) color2
 {
+    macroTraceMethodScope();
+
     NSSize patternSize;
     NSBitmapImageRep *patternBitmap;
     unsigned char *patternRow;
@@ -464,6 +473,8 @@ ERROR:
                             color1: (NSColor *) color1
                             color2: (NSColor *) color2
 {
+    macroTraceMethodScope();
+
     NSSize patternSize;
     NSBitmapImageRep *patternBitmap;
     unsigned char *patternRow;
@@ -551,6 +562,8 @@ ERROR:
                             leftColor: (NSColor *) leftColor
                             rightColor: (NSColor *) rightColor
 {
+    macroTraceMethodScope();
+
     NSBitmapImageRep *gradientBitmap;
     PPImageBitmapPixel *gradientPixelValuesArray = NULL;
     unsigned char *gradientBitmapData;
@@ -595,6 +608,8 @@ ERROR:
                             topColor: (NSColor *) topColor
                             bottomColor: (NSColor *) bottomColor
 {
+    macroTraceMethodScope();
+
     NSBitmapImageRep *gradientBitmap;
     PPImageBitmapPixel *gradientPixelValuesArray = NULL, *gradientBitmapPixel,
                         *gradientArrayPixel;
@@ -656,6 +671,8 @@ ERROR:
                             innerColor: (NSColor *) innerColor
                             outerColor: (NSColor *) outerColor
 {
+    macroTraceMethodScope();
+
     NSBitmapImageRep *gradientBitmap;
     NSInteger arraySize, bytesPerRow, pixelCounter;
     PPImageBitmapPixel *gradientPixelValuesArray = NULL, *gradientBitmapPixel,
@@ -743,6 +760,8 @@ ERROR:
 + (NSBitmapImageRep *) ppFillOverlayPatternBitmapWithSize: (float) patternSize
                             fillColor: (NSColor *) fillColor
 {
+    macroTraceMethodScope();
+
     NSBitmapImageRep *patternBitmap;
     NSRect pixelFrame;
 
@@ -789,6 +808,8 @@ ERROR:
 + (NSBitmapImageRep *) ppPixelCheckerboardPatternBitmapWithColor1: (NSColor *) color1
                                                         color2: (NSColor *) color2
 {
+    macroTraceMethodScope();
+
     NSSize patternSize;
     NSBitmapImageRep *patternBitmap;
     unsigned char *patternRow;
@@ -851,6 +872,9 @@ static PPImageBitmapPixel *PPImagePixelGradientArrayOfSizeWithEndColors(unsigned
     if (!arraySize)
         goto ERROR;
 
+    if (!PPImageAlphaPremultiplyTables_Setup())
+        goto ERROR;
+
     firstColor = [firstColor ppSRGBColor];
     lastColor = [lastColor ppSRGBColor];
 
@@ -0,0 +1,959 @@
+/*
+    NSBitmapImageRep_PPUtilities_TileEncoding.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "NSBitmapImageRep_PPUtilities.h"
+
+#import "PPGeometry.h"
+#import "PPTrace.h"
+
+
+/*
+Tile-encoded data layout (all header & table values are little-endian uint32s):
+-----------
+1. Header (PPTileEncodedDataHeader)
+-----------
+2. Tile table (PPTileEncodedDataTileEntry for each stored tile)
+-----------
+3. Tile payloads (each tile's pixels, top row first, encoded as described by its table entry)
+
+Tiles are numbered left-to-right, top-to-bottom; tiles along the right & bottom edges may be
+smaller than kTileEncodingTileDimension. Payload pixels are the image bitmap's pixel bytes
+(premultiplied RGBA), so they don't depend on the host's byte order.
+
+Run-length encoding (PackBits-style, in units of pixels): each run starts with a control
+byte - control values 0-127 are followed by (control + 1) literal pixels; control values
+128-255 are followed by a single pixel that repeats (control - 126) times.
+
+Indexed encoding (tiles with at most 256 colors): a byte containing (number of colors - 1),
+followed by the tile's palette (the colors' pixels), followed by each pixel's palette index,
+bit-packed (most significant bits first) using the smallest of 0 (single color), 1, 2, 4, or 8
+bits per index that fits the palette; pixel-art tiles typically have few colors, so indexed
+tiles are usually a fraction of the raw size, and decoding expands the indices straight into
+the destination bitmap.
+*/
+
+#define kTileEncodedDataSignature                   'ppTE'
+
+#define kTileEncodingTileDimension                  64
+
+#define kMaxPixelsPerTile                           \
+            (kTileEncodingTileDimension * kTileEncodingTileDimension)
+
+#define kMaxLiteralPixelsPerRun                     128
+#define kMinRepeatedPixelsPerRun                    2
+#define kMaxRepeatedPixelsPerRun                    129
+#define kRepeatedRunControlOffset                   126
+
+#define kMaxIndexedTileColors                       256
+
+// palette lookup table for indexed encoding: power-of-2 size, at least twice the max colors
+#define kIndexedPaletteHashTableSize                512
+#define kIndexedPaletteHashMultiplier               0x9E3779B1U
+
+
+typedef enum
+{
+    kPPTileEncodingType_Raw,
+    kPPTileEncodingType_RunLength,
+    kPPTileEncodingType_Indexed,
+
+    kNumPPTileEncodingTypes
+
+} PPTileEncodingType;
+
+typedef struct
+{
+    uint32_t signature;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileDimension;
+    uint32_t numStoredTiles;
+
+} PPTileEncodedDataHeader;
+
+typedef struct
+{
+    uint32_t tileIndex;
+    uint32_t payloadOffset;
+    uint32_t payloadLength;
+    uint32_t encodingType;
+
+} PPTileEncodedDataTileEntry;
+
+
+static bool GetHeaderAndTileEntriesFromTileEncodedData(NSData *tileEncodedData,
+                                                        NSSize size,
+                                                        PPTileEncodedDataHeader *returnedHeader,
+                                                        const unsigned char **returnedEntries,
+                                                        const unsigned char **returnedPayload);
+static void GetTileEntryAtIndex(const unsigned char *entries, unsigned entryIndex,
+                                    PPTileEncodedDataTileEntry *returnedEntry);
+static void GetTileFrame(unsigned tileIndex, unsigned width, unsigned height,
+                            unsigned *returnedX, unsigned *returnedY,
+                            unsigned *returnedWidth, unsigned *returnedHeight);
+static unsigned RunLengthEncodePixels(const PPImageBitmapPixel *pixels, unsigned numPixels,
+                                        unsigned char *encodedBuffer,
+                                        unsigned encodedBufferSize);
+static bool RunLengthDecodePixels(const unsigned char *encodedBytes, unsigned numEncodedBytes,
+                                    PPImageBitmapPixel *pixels, unsigned numPixels);
+static bool RunLengthEncodedPixelsAreValid(const unsigned char *encodedBytes,
+                                            unsigned numEncodedBytes, unsigned numPixels);
+static unsigned IndexedEncodePixels(const PPImageBitmapPixel *pixels, unsigned numPixels,
+                                    unsigned char *encodedBuffer, unsigned encodedBufferSize);
+static void IndexedDecodePixelsToRows(const unsigned char *encodedBytes,
+                                        unsigned char *destinationRow,
+                                        unsigned destinationBytesPerRow,
+                                        unsigned width, unsigned height);
+static bool IndexedEncodedPixelsAreValid(const unsigned char *encodedBytes,
+                                            unsigned numEncodedBytes, unsigned numPixels);
+static unsigned BitsPerIndexForNumColors(unsigned numColors);
+
+
+@implementation NSBitmapImageRep (PPUtilities_TileEncoding)
+
+- (NSData *) ppTileEncodedData
+{
+    macroTraceMethodScope();
+
+    unsigned char *bitmapData, *tileRow;
+    unsigned width, height, bytesPerRow, numTileColumns, numTileRows, numTiles, tileIndex,
+                tileX, tileY, tileWidth, tileHeight, numTilePixels, row, pixelIndex,
+                numStoredTiles = 0, payloadLength, encodedLength;
+    PPImageBitmapPixel tilePixels[kMaxPixelsPerTile], *tilePixel;
+    unsigned char encodedBuffer[kMaxPixelsPerTile * sizeof(PPImageBitmapPixel)],
+                    indexedBuffer[kMaxPixelsPerTile * sizeof(PPImageBitmapPixel)];
+    unsigned indexedLength;
+    bool tileIsClear;
+    NSMutableData *tileEntriesData, *payloadData, *tileEncodedData;
+    PPTileEncodedDataTileEntry tileEntry;
+    PPTileEncodedDataHeader header;
+
+    if (![self ppIsImageBitmap])
+    {
+        goto ERROR;
+    }
+
+    bitmapData = [self bitmapData];
+
+    if (!bitmapData)
+        goto ERROR;
+
+    width = [self pixelsWide];
+    height = [self pixelsHigh];
+    bytesPerRow = [self bytesPerRow];
+
+    numTileColumns = (width + kTileEncodingTileDimension - 1) / kTileEncodingTileDimension;
+    numTileRows = (height + kTileEncodingTileDimension - 1) / kTileEncodingTileDimension;
+    numTiles = numTileColumns * numTileRows;
+
+    tileEntriesData = [NSMutableData data];
+    payloadData = [NSMutableData data];
+
+    if (!tileEntriesData || !payloadData)
+    {
+        goto ERROR;
+    }
+
+    for (tileIndex=0; tileIndex<numTiles; tileIndex++)
+    {
+        GetTileFrame(tileIndex, width, height, &tileX, &tileY, &tileWidth, &tileHeight);
+
+        // gather the tile's pixels into a contiguous buffer, checking whether they're all clear
+
+        tileRow = &bitmapData[tileY * bytesPerRow + tileX * sizeof(PPImageBitmapPixel)];
+        tilePixel = tilePixels;
+        tileIsClear = YES;
+
+        for (row=0; row<tileHeight; row++)
+        {
+            memcpy(tilePixel, tileRow, tileWidth * sizeof(PPImageBitmapPixel));
+
+            if (tileIsClear)
+            {
+                for (pixelIndex=0; pixelIndex<tileWidth; pixelIndex++)
+                {
+                    if (tilePixel[pixelIndex])
+                    {
+                        tileIsClear = NO;
+                        break;
+                    }
+                }
+            }
+
+            tilePixel += tileWidth;
+            tileRow += bytesPerRow;
+        }
+
+        if (tileIsClear)
+        {
+            continue;
+        }
+
+        numTilePixels = tileWidth * tileHeight;
+
+        encodedLength = RunLengthEncodePixels(tilePixels, numTilePixels, encodedBuffer,
+                                                numTilePixels * sizeof(PPImageBitmapPixel));
+
+        // indexed encoding only needs to beat the smaller of the raw & run-length sizes
+
+        indexedLength = IndexedEncodePixels(tilePixels, numTilePixels, indexedBuffer,
+                                            (encodedLength) ?
+                                                encodedLength :
+                                                numTilePixels * sizeof(PPImageBitmapPixel));
+
+        tileEntry.tileIndex = NSSwapHostIntToLittle(tileIndex);
+        tileEntry.payloadOffset = NSSwapHostIntToLittle([payloadData length]);
+
+        if (indexedLength)
+        {
+            [payloadData appendBytes: indexedBuffer length: indexedLength];
+
+            payloadLength = indexedLength;
+            tileEntry.encodingType = NSSwapHostIntToLittle(kPPTileEncodingType_Indexed);
+        }
+        else if (encodedLength)
+        {
+            [payloadData appendBytes: encodedBuffer length: encodedLength];
+
+            payloadLength = encodedLength;
+            tileEntry.encodingType = NSSwapHostIntToLittle(kPPTileEncodingType_RunLength);
+        }
+        else
+        {
+            // run-length encoding wouldn't be smaller than the raw pixels
+            payloadLength = numTilePixels * sizeof(PPImageBitmapPixel);
+
+            [payloadData appendBytes: tilePixels length: payloadLength];
+
+            tileEntry.encodingType = NSSwapHostIntToLittle(kPPTileEncodingType_Raw);
+        }
+
+        tileEntry.payloadLength = NSSwapHostIntToLittle(payloadLength);
+
+        [tileEntriesData appendBytes: &tileEntry length: sizeof(tileEntry)];
+
+        numStoredTiles++;
+    }
+
+    header.signature = NSSwapHostIntToLittle(kTileEncodedDataSignature);
+    header.width = NSSwapHostIntToLittle(width);
+    header.height = NSSwapHostIntToLittle(height);
+    header.tileDimension = NSSwapHostIntToLittle(kTileEncodingTileDimension);
+    header.numStoredTiles = NSSwapHostIntToLittle(numStoredTiles);
+
+    tileEncodedData =
+        [NSMutableData dataWithCapacity:
+                        sizeof(header) + [tileEntriesData length] + [payloadData length]];
+
+    if (!tileEncodedData)
+        goto ERROR;
+
+    [tileEncodedData appendBytes: &header length: sizeof(header)];
+    [tileEncodedData appendData: tileEntriesData];
+    [tileEncodedData appendData: payloadData];
+
+    return tileEncodedData;
+
+ERROR:
+    return nil;
+}
+
+- (bool) ppDecodeTileEncodedData: (NSData *) tileEncodedData
+{
+    macroTraceMethodScope();
+
+    PPTileEncodedDataHeader header;
+    const unsigned char *tileEntries, *payload;
+    PPTileEncodedDataTileEntry tileEntry;
+    unsigned char *bitmapData, *tileRow;
+    unsigned bytesPerRow, entryIndex, tileX, tileY, tileWidth, tileHeight, numTilePixels, row;
+    PPImageBitmapPixel tilePixels[kMaxPixelsPerTile];
+    const PPImageBitmapPixel *tilePixel;
+
+    if (![self ppIsImageBitmap])
+    {
+        goto ERROR;
+    }
+
+    if (!GetHeaderAndTileEntriesFromTileEncodedData(tileEncodedData, [self ppSizeInPixels],
+                                                    &header, &tileEntries, &payload))
+    {
+        goto ERROR;
+    }
+
+    bitmapData = [self bitmapData];
+
+    if (!bitmapData)
+        goto ERROR;
+
+    bytesPerRow = [self bytesPerRow];
+
+    for (entryIndex=0; entryIndex<header.numStoredTiles; entryIndex++)
+    {
+        GetTileEntryAtIndex(tileEntries, entryIndex, &tileEntry);
+
+        GetTileFrame(tileEntry.tileIndex, header.width, header.height, &tileX, &tileY,
+                        &tileWidth, &tileHeight);
+
+        numTilePixels = tileWidth * tileHeight;
+
+        tileRow = &bitmapData[tileY * bytesPerRow + tileX * sizeof(PPImageBitmapPixel)];
+
+        // raw & indexed tiles are copied (or expanded) straight from the payload into the
+        // bitmap; run-length tiles are decoded into the (cache-sized) tile buffer first, since
+        // runs can span rows
+
+        if (tileEntry.encodingType == kPPTileEncodingType_Indexed)
+        {
+            IndexedDecodePixelsToRows(&payload[tileEntry.payloadOffset], tileRow, bytesPerRow,
+                                        tileWidth, tileHeight);
+
+            continue;
+        }
+        else if (tileEntry.encodingType == kPPTileEncodingType_RunLength)
+        {
+            if (!RunLengthDecodePixels(&payload[tileEntry.payloadOffset],
+                                        tileEntry.payloadLength, tilePixels, numTilePixels))
+            {
+                goto ERROR;
+            }
+
+            tilePixel = tilePixels;
+        }
+        else
+        {
+            tilePixel = (const PPImageBitmapPixel *) &payload[tileEntry.payloadOffset];
+        }
+
+        for (row=0; row<tileHeight; row++)
+        {
+            memcpy(tileRow, tilePixel, tileWidth * sizeof(PPImageBitmapPixel));
+
+            tilePixel += tileWidth;
+            tileRow += bytesPerRow;
+        }
+    }
+
+    return YES;
+
+ERROR:
+    return NO;
+}
+
++ (bool) ppTileEncodedData: (NSData *) tileEncodedData isValidForSize: (NSSize) size
+{
+    PPTileEncodedDataHeader header;
+    const unsigned char *tileEntries, *payload;
+
+    return GetHeaderAndTileEntriesFromTileEncodedData(tileEncodedData, size, &header,
+                                                        &tileEntries, &payload);
+}
+
++ (NSArray *) ppStoredTileBoundsInTileEncodedData: (NSData *) tileEncodedData
+                forSize: (NSSize) size
+{
+    PPTileEncodedDataHeader header;
+    const unsigned char *tileEntries, *payload;
+    PPTileEncodedDataTileEntry tileEntry;
+    NSMutableArray *storedTileBoundsArray;
+    unsigned entryIndex, tileX, tileY, tileWidth, tileHeight;
+    NSRect tileBounds;
+
+    if (!GetHeaderAndTileEntriesFromTileEncodedData(tileEncodedData, size, &header,
+                                                    &tileEntries, &payload))
+    {
+        goto ERROR;
+    }
+
+    storedTileBoundsArray = [NSMutableArray arrayWithCapacity: header.numStoredTiles];
+
+    if (!storedTileBoundsArray)
+        goto ERROR;
+
+    for (entryIndex=0; entryIndex<header.numStoredTiles; entryIndex++)
+    {
+        GetTileEntryAtIndex(tileEntries, entryIndex, &tileEntry);
+
+        GetTileFrame(tileEntry.tileIndex, header.width, header.height, &tileX, &tileY,
+                        &tileWidth, &tileHeight);
+
+        // tile frames are in bitmap rows (top row first), but bounds' origin is at the bottom
+
+        tileBounds = NSMakeRect(tileX, header.height - (tileY + tileHeight), tileWidth,
+                                tileHeight);
+
+        [storedTileBoundsArray addObject: [NSValue valueWithRect: tileBounds]];
+    }
+
+    return storedTileBoundsArray;
+
+ERROR:
+    return nil;
+}
+
++ (bool) ppTileEncodedDataUsesIndexedTiles: (NSData *) tileEncodedData
+{
+    const unsigned char *dataBytes;
+    unsigned dataLength, numStoredTiles, entryIndex;
+    PPTileEncodedDataHeader header;
+    PPTileEncodedDataTileEntry tileEntry;
+
+    dataBytes = [tileEncodedData bytes];
+    dataLength = [tileEncodedData length];
+
+    if (!dataBytes || (dataLength < sizeof(header)))
+    {
+        goto ERROR;
+    }
+
+    memcpy(&header, dataBytes, sizeof(header));
+
+    numStoredTiles = NSSwapLittleIntToHost(header.numStoredTiles);
+
+    if (numStoredTiles > (dataLength - sizeof(header)) / sizeof(PPTileEncodedDataTileEntry))
+    {
+        goto ERROR;
+    }
+
+    for (entryIndex=0; entryIndex<numStoredTiles; entryIndex++)
+    {
+        GetTileEntryAtIndex(&dataBytes[sizeof(header)], entryIndex, &tileEntry);
+
+        if (tileEntry.encodingType == kPPTileEncodingType_Indexed)
+        {
+            return YES;
+        }
+    }
+
+    return NO;
+
+ERROR:
+    return YES;
+}
+
+@end
+
+#pragma mark Private functions
+
+// GetHeaderAndTileEntriesFromTileEncodedData() validates the header, all tile entries, and the
+// run-length payloads' runs (without decoding them), so once data's been validated, decoding it
+// can't fail
+
+static bool GetHeaderAndTileEntriesFromTileEncodedData(NSData *tileEncodedData,
+                                                        NSSize size,
+                                                        PPTileEncodedDataHeader *returnedHeader,
+                                                        const unsigned char **returnedEntries,
+                                                        const unsigned char **returnedPayload)
+{
+    const unsigned char *dataBytes, *payload;
+    unsigned long dataLength, tableLength, payloadLength;
+    PPTileEncodedDataHeader header;
+    PPTileEncodedDataTileEntry tileEntry;
+    unsigned numTiles, entryIndex, tileX, tileY, tileWidth, tileHeight, rawTileLength;
+
+    dataBytes = [tileEncodedData bytes];
+    dataLength = [tileEncodedData length];
+
+    if (!dataBytes || (dataLength < sizeof(header)))
+    {
+        goto ERROR;
+    }
+
+    memcpy(&header, dataBytes, sizeof(header));
+
+    header.signature = NSSwapLittleIntToHost(header.signature);
+    header.width = NSSwapLittleIntToHost(header.width);
+    header.height = NSSwapLittleIntToHost(header.height);
+    header.tileDimension = NSSwapLittleIntToHost(header.tileDimension);
+    header.numStoredTiles = NSSwapLittleIntToHost(header.numStoredTiles);
+
+    size = PPGeometry_SizeClippedToIntegerValues(size);
+
+    if ((header.signature != kTileEncodedDataSignature)
+        || (header.width != (unsigned) size.width)
+        || (header.height != (unsigned) size.height)
+        || (header.tileDimension != kTileEncodingTileDimension))
+    {
+        goto ERROR;
+    }
+
+    numTiles = ((header.width + kTileEncodingTileDimension - 1) / kTileEncodingTileDimension)
+                * ((header.height + kTileEncodingTileDimension - 1)
+                    / kTileEncodingTileDimension);
+
+    if (header.numStoredTiles > numTiles)
+    {
+        goto ERROR;
+    }
+
+    tableLength = header.numStoredTiles * sizeof(PPTileEncodedDataTileEntry);
+
+    if (dataLength < sizeof(header) + tableLength)
+    {
+        goto ERROR;
+    }
+
+    payloadLength = dataLength - sizeof(header) - tableLength;
+    payload = &dataBytes[sizeof(header) + tableLength];
+
+    for (entryIndex=0; entryIndex<header.numStoredTiles; entryIndex++)
+    {
+        GetTileEntryAtIndex(&dataBytes[sizeof(header)], entryIndex, &tileEntry);
+
+        if ((tileEntry.tileIndex >= numTiles)
+            || (tileEntry.encodingType >= kNumPPTileEncodingTypes)
+            || (tileEntry.payloadOffset > payloadLength)
+            || (tileEntry.payloadLength > payloadLength - tileEntry.payloadOffset))
+        {
+            goto ERROR;
+        }
+
+        GetTileFrame(tileEntry.tileIndex, header.width, header.height, &tileX, &tileY,
+                        &tileWidth, &tileHeight);
+
+        rawTileLength = tileWidth * tileHeight * sizeof(PPImageBitmapPixel);
+
+        if (tileEntry.encodingType == kPPTileEncodingType_Raw)
+        {
+            if (tileEntry.payloadLength != rawTileLength)
+            {
+                goto ERROR;
+            }
+        }
+        else if (tileEntry.encodingType == kPPTileEncodingType_Indexed)
+        {
+            if (!IndexedEncodedPixelsAreValid(&payload[tileEntry.payloadOffset],
+                                                tileEntry.payloadLength,
+                                                tileWidth * tileHeight))
+            {
+                goto ERROR;
+            }
+        }
+        else if (!RunLengthEncodedPixelsAreValid(&payload[tileEntry.payloadOffset],
+                                                    tileEntry.payloadLength,
+                                                    tileWidth * tileHeight))
+        {
+            goto ERROR;
+        }
+    }
+
+    *returnedHeader = header;
+    *returnedEntries = &dataBytes[sizeof(header)];
+    *returnedPayload = payload;
+
+    return YES;
+
+ERROR:
+    return NO;
+}
+
+static void GetTileEntryAtIndex(const unsigned char *entries, unsigned entryIndex,
+                                    PPTileEncodedDataTileEntry *returnedEntry)
+{
+    memcpy(returnedEntry, &entries[entryIndex * sizeof(PPTileEncodedDataTileEntry)],
+            sizeof(PPTileEncodedDataTileEntry));
+
+    returnedEntry->tileIndex = NSSwapLittleIntToHost(returnedEntry->tileIndex);
+    returnedEntry->payloadOffset = NSSwapLittleIntToHost(returnedEntry->payloadOffset);
+    returnedEntry->payloadLength = NSSwapLittleIntToHost(returnedEntry->payloadLength);
+    returnedEntry->encodingType = NSSwapLittleIntToHost(returnedEntry->encodingType);
+}
+
+// tile frames are in memory coordinates (top row is y = 0)
+
+static void GetTileFrame(unsigned tileIndex, unsigned width, unsigned height,
+                            unsigned *returnedX, unsigned *returnedY,
+                            unsigned *returnedWidth, unsigned *returnedHeight)
+{
+    unsigned numTileColumns, tileX, tileY;
+
+    numTileColumns = (width + kTileEncodingTileDimension - 1) / kTileEncodingTileDimension;
+
+    tileX = (tileIndex % numTileColumns) * kTileEncodingTileDimension;
+    tileY = (tileIndex / numTileColumns) * kTileEncodingTileDimension;
+
+    *returnedX = tileX;
+    *returnedY = tileY;
+
+    *returnedWidth = MIN(kTileEncodingTileDimension, width - tileX);
+    *returnedHeight = MIN(kTileEncodingTileDimension, height - tileY);
+}
+
+// RunLengthEncodePixels() returns the encoded length, or 0 if the encoded pixels won't fit in
+// the buffer (encodedBufferSize should be the raw pixels' size, so 0 means raw is smaller)
+
+static unsigned RunLengthEncodePixels(const PPImageBitmapPixel *pixels, unsigned numPixels,
+                                        unsigned char *encodedBuffer,
+                                        unsigned encodedBufferSize)
+{
+    unsigned pixelIndex = 0, encodedLength = 0, runLength, literalStartIndex;
+
+    while (pixelIndex < numPixels)
+    {
+        runLength = 1;
+
+        while ((pixelIndex + runLength < numPixels)
+                && (runLength < kMaxRepeatedPixelsPerRun)
+                && (pixels[pixelIndex + runLength] == pixels[pixelIndex]))
+        {
+            runLength++;
+        }
+
+        if (runLength >= kMinRepeatedPixelsPerRun)
+        {
+            if (encodedLength + 1 + sizeof(PPImageBitmapPixel) > encodedBufferSize)
+            {
+                return 0;
+            }
+
+            encodedBuffer[encodedLength++] = runLength + kRepeatedRunControlOffset;
+
+            memcpy(&encodedBuffer[encodedLength], &pixels[pixelIndex],
+                    sizeof(PPImageBitmapPixel));
+            encodedLength += sizeof(PPImageBitmapPixel);
+
+            pixelIndex += runLength;
+        }
+        else
+        {
+            literalStartIndex = pixelIndex;
+            runLength = 0;
+
+            while ((pixelIndex < numPixels)
+                    && (runLength < kMaxLiteralPixelsPerRun)
+                    && !((pixelIndex + 1 < numPixels)
+                            && (pixels[pixelIndex + 1] == pixels[pixelIndex])))
+            {
+                pixelIndex++;
+                runLength++;
+            }
+
+            if (encodedLength + 1 + runLength * sizeof(PPImageBitmapPixel)
+                    > encodedBufferSize)
+            {
+                return 0;
+            }
+
+            encodedBuffer[encodedLength++] = runLength - 1;
+
+            memcpy(&encodedBuffer[encodedLength], &pixels[literalStartIndex],
+                    runLength * sizeof(PPImageBitmapPixel));
+            encodedLength += runLength * sizeof(PPImageBitmapPixel);
+        }
+    }
+
+    if (encodedLength >= encodedBufferSize)
+    {
+        return 0;
+    }
+
+    return encodedLength;
+}
+
+static bool RunLengthDecodePixels(const unsigned char *encodedBytes, unsigned numEncodedBytes,
+                                    PPImageBitmapPixel *pixels, unsigned numPixels)
+{
+    unsigned encodedIndex = 0, pixelIndex = 0, control, runLength;
+    PPImageBitmapPixel repeatedPixel;
+
+    while (encodedIndex < numEncodedBytes)
+    {
+        control = encodedBytes[encodedIndex++];
+
+        if (control < kMaxLiteralPixelsPerRun)
+        {
+            runLength = control + 1;
+
+            if ((pixelIndex + runLength > numPixels)
+                || (encodedIndex + runLength * sizeof(PPImageBitmapPixel) > numEncodedBytes))
+            {
+                return NO;
+            }
+
+            memcpy(&pixels[pixelIndex], &encodedBytes[encodedIndex],
+                    runLength * sizeof(PPImageBitmapPixel));
+
+            encodedIndex += runLength * sizeof(PPImageBitmapPixel);
+        }
+        else
+        {
+            runLength = control - kRepeatedRunControlOffset;
+
+            if ((pixelIndex + runLength > numPixels)
+                || (encodedIndex + sizeof(PPImageBitmapPixel) > numEncodedBytes))
+            {
+                return NO;
+            }
+
+            memcpy(&repeatedPixel, &encodedBytes[encodedIndex], sizeof(PPImageBitmapPixel));
+            encodedIndex += sizeof(PPImageBitmapPixel);
+
+            while (runLength--)
+            {
+                pixels[pixelIndex++] = repeatedPixel;
+            }
+
+            continue;
+        }
+
+        pixelIndex += runLength;
+    }
+
+    return (pixelIndex == numPixels) ? YES : NO;
+}
+
+static bool RunLengthEncodedPixelsAreValid(const unsigned char *encodedBytes,
+                                            unsigned numEncodedBytes, unsigned numPixels)
+{
+    unsigned encodedIndex = 0, pixelIndex = 0, control, runLength, runByteCount;
+
+    while (encodedIndex < numEncodedBytes)
+    {
+        control = encodedBytes[encodedIndex++];
+
+        if (control < kMaxLiteralPixelsPerRun)
+        {
+            runLength = control + 1;
+            runByteCount = runLength * sizeof(PPImageBitmapPixel);
+        }
+        else
+        {
+            runLength = control - kRepeatedRunControlOffset;
+            runByteCount = sizeof(PPImageBitmapPixel);
+        }
+
+        if ((pixelIndex + runLength > numPixels)
+            || (encodedIndex + runByteCount > numEncodedBytes))
+        {
+            return NO;
+        }
+
+        pixelIndex += runLength;
+        encodedIndex += runByteCount;
+    }
+
+    return (pixelIndex == numPixels) ? YES : NO;
+}
+
+// IndexedEncodePixels() returns the encoded length, or 0 if the pixels have more than
+// kMaxIndexedTileColors colors, or if the encoded length wouldn't be smaller than
+// encodedBufferSize
+
+static unsigned IndexedEncodePixels(const PPImageBitmapPixel *pixels, unsigned numPixels,
+                                    unsigned char *encodedBuffer, unsigned encodedBufferSize)
+{
+    PPImageBitmapPixel palette[kMaxIndexedTileColors], pixel;
+    int16_t hashTable[kIndexedPaletteHashTableSize];
+    unsigned char indices[kMaxPixelsPerTile], paletteIndex = 0, *packedIndex;
+    unsigned numColors = 0, pixelIndex, hashIndex, bitsPerIndex, encodedLength, bitOffset;
+
+    if (!numPixels || (numPixels > kMaxPixelsPerTile))
+    {
+        return 0;
+    }
+
+    memset(hashTable, 0xFF, sizeof(hashTable));   // all entries -1 (empty)
+
+    for (pixelIndex=0; pixelIndex<numPixels; pixelIndex++)
+    {
+        pixel = pixels[pixelIndex];
+
+        // runs of identical pixels are common, so check the previous pixel before hashing
+
+        if (!pixelIndex || (pixel != pixels[pixelIndex - 1]))
+        {
+            hashIndex = ((uint32_t) (pixel * kIndexedPaletteHashMultiplier))
+                            & (kIndexedPaletteHashTableSize - 1);
+
+            while ((hashTable[hashIndex] >= 0) && (palette[hashTable[hashIndex]] != pixel))
+            {
+                hashIndex = (hashIndex + 1) & (kIndexedPaletteHashTableSize - 1);
+            }
+
+            if (hashTable[hashIndex] < 0)
+            {
+                if (numColors >= kMaxIndexedTileColors)
+                {
+                    return 0;
+                }
+
+                palette[numColors] = pixel;
+                hashTable[hashIndex] = numColors++;
+            }
+
+            paletteIndex = hashTable[hashIndex];
+        }
+
+        indices[pixelIndex] = paletteIndex;
+    }
+
+    bitsPerIndex = BitsPerIndexForNumColors(numColors);
+
+    encodedLength = 1 + numColors * sizeof(PPImageBitmapPixel)
+                        + (numPixels * bitsPerIndex + 7) / 8;
+
+    if (encodedLength >= encodedBufferSize)
+    {
+        return 0;
+    }
+
+    encodedBuffer[0] = numColors - 1;
+    memcpy(&encodedBuffer[1], palette, numColors * sizeof(PPImageBitmapPixel));
+
+    packedIndex = &encodedBuffer[1 + numColors * sizeof(PPImageBitmapPixel)];
+
+    if (bitsPerIndex == 8)
+    {
+        memcpy(packedIndex, indices, numPixels);
+    }
+    else if (bitsPerIndex)
+    {
+        memset(packedIndex, 0, (numPixels * bitsPerIndex + 7) / 8);
+
+        for (pixelIndex=0; pixelIndex<numPixels; pixelIndex++)
+        {
+            bitOffset = pixelIndex * bitsPerIndex;
+
+            packedIndex[bitOffset / 8] |=
+                                    indices[pixelIndex] << (8 - bitsPerIndex - bitOffset % 8);
+        }
+    }
+
+    return encodedLength;
+}
+
+// IndexedDecodePixelsToRows() expects encodedBytes to have been checked by
+// IndexedEncodedPixelsAreValid()
+
+static void IndexedDecodePixelsToRows(const unsigned char *encodedBytes,
+                                        unsigned char *destinationRow,
+                                        unsigned destinationBytesPerRow,
+                                        unsigned width, unsigned height)
+{
+    PPImageBitmapPixel palette[kMaxIndexedTileColors], *destinationPixel;
+    const unsigned char *packedIndex;
+    unsigned numColors, bitsPerIndex, indexMask, row, col, bitOffset = 0;
+
+    numColors = encodedBytes[0] + 1;
+    bitsPerIndex = BitsPerIndexForNumColors(numColors);
+    indexMask = (1 << bitsPerIndex) - 1;
+
+    memcpy(palette, &encodedBytes[1], numColors * sizeof(PPImageBitmapPixel));
+
+    packedIndex = &encodedBytes[1 + numColors * sizeof(PPImageBitmapPixel)];
+
+    for (row=0; row<height; row++)
+    {
+        destinationPixel = (PPImageBitmapPixel *) destinationRow;
+
+        if (!bitsPerIndex)
+        {
+            for (col=0; col<width; col++)
+            {
+                destinationPixel[col] = palette[0];
+            }
+        }
+        else if (bitsPerIndex == 8)
+        {
+            for (col=0; col<width; col++)
+            {
+                destinationPixel[col] = palette[packedIndex[col]];
+            }
+
+            packedIndex += width;
+        }
+        else
+        {
+            for (col=0; col<width; col++)
+            {
+                destinationPixel[col] =
+                    palette[(packedIndex[bitOffset / 8] >> (8 - bitsPerIndex - bitOffset % 8))
+                                & indexMask];
+
+                bitOffset += bitsPerIndex;
+            }
+        }
+
+        destinationRow += destinationBytesPerRow;
+    }
+}
+
+static bool IndexedEncodedPixelsAreValid(const unsigned char *encodedBytes,
+                                            unsigned numEncodedBytes, unsigned numPixels)
+{
+    unsigned numColors, bitsPerIndex, indexMask, headerLength, pixelIndex, bitOffset;
+    const unsigned char *packedIndex;
+
+    if (!numEncodedBytes)
+        return NO;
+
+    numColors = encodedBytes[0] + 1;
+    bitsPerIndex = BitsPerIndexForNumColors(numColors);
+    headerLength = 1 + numColors * sizeof(PPImageBitmapPixel);
+
+    if (numEncodedBytes != headerLength + (numPixels * bitsPerIndex + 7) / 8)
+    {
+        return NO;
+    }
+
+    // indexes can only exceed the palette if its size isn't a power of 2
+
+    if (!bitsPerIndex || (numColors == (1U << bitsPerIndex)))
+    {
+        return YES;
+    }
+
+    indexMask = (1 << bitsPerIndex) - 1;
+    packedIndex = &encodedBytes[headerLength];
+
+    for (pixelIndex=0; pixelIndex<numPixels; pixelIndex++)
+    {
+        bitOffset = pixelIndex * bitsPerIndex;
+
+        if (((packedIndex[bitOffset / 8] >> (8 - bitsPerIndex - bitOffset % 8)) & indexMask)
+                >= numColors)
+        {
+            return NO;
+        }
+    }
+
+    return YES;
+}
+
+static unsigned BitsPerIndexForNumColors(unsigned numColors)
+{
+    if (numColors <= 1)
+        return 0;
+
+    if (numColors <= 2)
+        return 1;
+
+    if (numColors <= 4)
+        return 2;
+
+    if (numColors <= 16)
+        return 4;
+
+    return 8;
+}
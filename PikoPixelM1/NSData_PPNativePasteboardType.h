@@ -42,3 +42,7 @@
 @end
 
 extern NSString *kPPNativePasteboardType;
+
+// kPPLegacyNativePasteboardType: the pasteboard type used by earlier versions (TIFF data in an
+// NSArchiver archive); ppNativePasteboardDataGetImageBitmap:... can also read its data
+extern NSString *kPPLegacyNativePasteboardType;
@@ -26,10 +26,69 @@
 
 #import "NSBitmapImageRep_PPUtilities.h"
 #import "PPGeometry.h"
+#import "PPDefines.h"
 
 
-NSString *kPPNativePasteboardType = @"PikoPixel Native Pasteboard Type";
+NSString *kPPNativePasteboardType = @"PikoPixel Native Pasteboard Type v2";
 
+NSString *kPPLegacyNativePasteboardType = @"PikoPixel Native Pasteboard Type";
+
+
+/*
+Native pasteboard data (v2):
+
+PPNativePasteboardDataHeader, followed by the image bitmap's pixels (raw PPImageBitmapPixels,
+rows packed top-to-bottom, no row padding), followed by the mask bitmap's pixels - either
+packed 1 bit per pixel (rows padded to whole bytes, most significant bit first) if all the
+mask's pixels are ON or OFF, or raw PPMaskBitmapPixels otherwise
+
+Legacy native pasteboard data: NSArchiver archive of an NSArray containing the image & mask
+bitmaps' TIFF data, the position rect string, & the opacity number
+*/
+
+#define kNativePasteboardDataSignature          'ppPB'
+
+#define kMaskBitsPerByte                        8
+
+
+typedef enum
+{
+    kPPNativePasteboardMaskEncoding_Packed1Bit,
+    kPPNativePasteboardMaskEncoding_Raw8Bit,
+
+    kNumPPNativePasteboardMaskEncodings
+
+} PPNativePasteboardMaskEncoding;
+
+// stored in host byte order: pasteboard data doesn't outlive the machine it's copied on
+typedef struct
+{
+    uint32_t signature;
+    uint32_t width;
+    uint32_t height;
+    int32_t bitmapOriginX;
+    int32_t bitmapOriginY;
+    uint32_t canvasWidth;
+    uint32_t canvasHeight;
+    float opacity;
+    uint32_t maskEncoding;
+
+} PPNativePasteboardDataHeader;
+
+
+static bool MaskBitmapIsPackable(NSBitmapImageRep *maskBitmap);
+static unsigned MaskDataLengthForEncoding(PPNativePasteboardMaskEncoding maskEncoding,
+                                            unsigned width, unsigned height);
+
+
+@interface NSData (PPNativePasteboardTypePrivateMethods)
+
+- (bool) ppLegacyNativePasteboardDataGetImageBitmap: (NSBitmapImageRep **) returnedImageBitmap
+            maskBitmap: (NSBitmapImageRep **) returnedMaskBitmap
+            positionRect: (NSRect *) returnedPositionRect
+            opacity: (float *) returnedOpacity;
+
+@end
 
 @implementation NSData (PPNativePasteboardType)
 
@@ -39,37 +98,96 @@ NSString *kPPNativePasteboardType = @"PikoPixel Native Pasteboard Type";
                 canvasSize: (NSSize) canvasSize
                 opacity: (float) opacity
 {
-    NSData *imageBitmapData, *maskBitmapData;
-    NSString *positionRectString;
-    NSNumber *opacityNumber;
-    NSArray *nativePasteboardArray;
+    PPNativePasteboardDataHeader header;
+    unsigned width, height, imageRowLength, maskDataLength, row, col;
+    NSMutableData *nativePasteboardData;
+    unsigned char *imageData, *maskData, *destinationData, *packedByte;
+    unsigned imageBytesPerRow, maskBytesPerRow;
+    PPMaskBitmapPixel *maskRow;
 
     if (![imageBitmap ppIsImageBitmapAndSameSizeAsMaskBitmap: maskBitmap])
     {
         goto ERROR;
     }
 
-    imageBitmapData = [imageBitmap ppCompressedTIFFData];
+    header.signature = kNativePasteboardDataSignature;
+    header.width = width = [imageBitmap pixelsWide];
+    header.height = height = [imageBitmap pixelsHigh];
+    header.bitmapOriginX = bitmapOrigin.x;
+    header.bitmapOriginY = bitmapOrigin.y;
+    header.canvasWidth = canvasSize.width;
+    header.canvasHeight = canvasSize.height;
+    header.opacity = opacity;
+    header.maskEncoding = (MaskBitmapIsPackable(maskBitmap)) ?
+                            kPPNativePasteboardMaskEncoding_Packed1Bit :
+                            kPPNativePasteboardMaskEncoding_Raw8Bit;
 
-    maskBitmapData = [maskBitmap ppCompressedTIFFData];
+    imageRowLength = width * sizeof(PPImageBitmapPixel);
+    maskDataLength = MaskDataLengthForEncoding(header.maskEncoding, width, height);
 
-    positionRectString = NSStringFromRect(NSMakeRect(bitmapOrigin.x, bitmapOrigin.y,
-                                                        canvasSize.width, canvasSize.height));
+    nativePasteboardData = [NSMutableData dataWithLength:
+                                sizeof(header) + height * imageRowLength + maskDataLength];
 
-    opacityNumber = [NSNumber numberWithFloat: opacity];
+    imageData = [imageBitmap bitmapData];
+    maskData = [maskBitmap bitmapData];
 
-    if (!imageBitmapData || !maskBitmapData || !positionRectString || !opacityNumber)
+    if (!nativePasteboardData || !imageData || !maskData)
     {
         goto ERROR;
     }
 
-    nativePasteboardArray = [NSArray arrayWithObjects: imageBitmapData, maskBitmapData,
-                                                        positionRectString, opacityNumber, nil];
+    imageBytesPerRow = [imageBitmap bytesPerRow];
+    maskBytesPerRow = [maskBitmap bytesPerRow];
 
-    if (!nativePasteboardArray)
-        goto ERROR;
+    destinationData = [nativePasteboardData mutableBytes];
+
+    memcpy(destinationData, &header, sizeof(header));
+    destinationData += sizeof(header);
+
+    // image: raw rows
+
+    if (imageBytesPerRow == imageRowLength)
+    {
+        memcpy(destinationData, imageData, height * imageRowLength);
+        destinationData += height * imageRowLength;
+    }
+    else
+    {
+        for (row=0; row<height; row++)
+        {
+            memcpy(destinationData, &imageData[row * imageBytesPerRow], imageRowLength);
+            destinationData += imageRowLength;
+        }
+    }
+
+    // mask: packed bits or raw rows (nativePasteboardData is zeroed, so only ON bits are set)
+
+    for (row=0; row<height; row++)
+    {
+        maskRow = (PPMaskBitmapPixel *) &maskData[row * maskBytesPerRow];
+
+        if (header.maskEncoding == kPPNativePasteboardMaskEncoding_Raw8Bit)
+        {
+            memcpy(destinationData, maskRow, width * sizeof(PPMaskBitmapPixel));
+            destinationData += width * sizeof(PPMaskBitmapPixel);
+
+            continue;
+        }
 
-    return [NSArchiver archivedDataWithRootObject: nativePasteboardArray];
+        packedByte = destinationData;
+
+        for (col=0; col<width; col++)
+        {
+            if (maskRow[col])
+            {
+                packedByte[col / kMaskBitsPerByte] |= 0x80 >> (col % kMaskBitsPerByte);
+            }
+        }
+
+        destinationData += (width + kMaskBitsPerByte - 1) / kMaskBitsPerByte;
+    }
+
+    return nativePasteboardData;
 
 ERROR:
     return nil;
@@ -81,41 +199,117 @@ ERROR:
             canvasSize: (NSSize *) returnedCanvasSize
             opacity: (float *) returnedOpacity
 {
-    NSArray *nativePasteboardArray;
-    NSData *imageBitmapData, *maskBitmapData;
-    NSString *positionRectString;
-    NSNumber *opacityNumber;
+    const unsigned char *sourceData, *packedRow;
+    PPNativePasteboardDataHeader header;
+    unsigned width, height, imageRowLength, maskDataLength, row, col, imageBytesPerRow,
+                maskBytesPerRow;
     NSBitmapImageRep *imageBitmap, *maskBitmap;
+    unsigned char *imageData, *maskData;
+    PPMaskBitmapPixel *maskRow;
     NSRect positionRect;
     float opacity;
 
-    nativePasteboardArray = [NSUnarchiver unarchiveObjectWithData: self];
+    sourceData = [self bytes];
 
-    if (!nativePasteboardArray
-        || ![nativePasteboardArray isKindOfClass: [NSArray class]]
-        || ([nativePasteboardArray count] != 4))
+    if (!sourceData || ([self length] < sizeof(header)))
     {
         goto ERROR;
     }
 
-    imageBitmapData = [nativePasteboardArray objectAtIndex: 0];
-    maskBitmapData = [nativePasteboardArray objectAtIndex: 1];
-    positionRectString = [nativePasteboardArray objectAtIndex: 2];
-    opacityNumber = [nativePasteboardArray objectAtIndex: 3];
+    memcpy(&header, sourceData, sizeof(header));
 
-    if (!imageBitmapData || !maskBitmapData || !positionRectString || !opacityNumber)
+    if (header.signature != kNativePasteboardDataSignature)
     {
-        goto ERROR;
+        // data from the legacy pasteboard type has no header (it's an NSArchiver archive)
+
+        if (![self ppLegacyNativePasteboardDataGetImageBitmap: &imageBitmap
+                    maskBitmap: &maskBitmap
+                    positionRect: &positionRect
+                    opacity: &opacity])
+        {
+            goto ERROR;
+        }
     }
-
-    imageBitmap = [NSBitmapImageRep imageRepWithData: imageBitmapData];
-    maskBitmap = [NSBitmapImageRep imageRepWithData: maskBitmapData];
-    positionRect = NSRectFromString(positionRectString);
-    opacity = [opacityNumber floatValue];
-
-    if (!imageBitmap || !maskBitmap)
+    else
     {
-        goto ERROR;
+        width = header.width;
+        height = header.height;
+
+        if (!width || !height
+            || (width > kMaxCanvasDimension) || (height > kMaxCanvasDimension)
+            || (header.maskEncoding >= kNumPPNativePasteboardMaskEncodings))
+        {
+            goto ERROR;
+        }
+
+        imageRowLength = width * sizeof(PPImageBitmapPixel);
+        maskDataLength = MaskDataLengthForEncoding(header.maskEncoding, width, height);
+
+        if ([self length] != sizeof(header) + height * imageRowLength + maskDataLength)
+        {
+            goto ERROR;
+        }
+
+        imageBitmap = [NSBitmapImageRep ppImageBitmapOfSize: NSMakeSize(width, height)];
+        maskBitmap = [NSBitmapImageRep ppMaskBitmapOfSize: NSMakeSize(width, height)];
+
+        imageData = [imageBitmap bitmapData];
+        maskData = [maskBitmap bitmapData];
+
+        if (!imageData || !maskData)
+        {
+            goto ERROR;
+        }
+
+        imageBytesPerRow = [imageBitmap bytesPerRow];
+        maskBytesPerRow = [maskBitmap bytesPerRow];
+
+        sourceData += sizeof(header);
+
+        if (imageBytesPerRow == imageRowLength)
+        {
+            memcpy(imageData, sourceData, height * imageRowLength);
+            sourceData += height * imageRowLength;
+        }
+        else
+        {
+            for (row=0; row<height; row++)
+            {
+                memcpy(&imageData[row * imageBytesPerRow], sourceData, imageRowLength);
+                sourceData += imageRowLength;
+            }
+        }
+
+        // maskBitmap is cleared (ppMaskBitmapOfSize:), so only ON pixels are set
+
+        for (row=0; row<height; row++)
+        {
+            maskRow = (PPMaskBitmapPixel *) &maskData[row * maskBytesPerRow];
+
+            if (header.maskEncoding == kPPNativePasteboardMaskEncoding_Raw8Bit)
+            {
+                memcpy(maskRow, sourceData, width * sizeof(PPMaskBitmapPixel));
+                sourceData += width * sizeof(PPMaskBitmapPixel);
+
+                continue;
+            }
+
+            packedRow = sourceData;
+
+            for (col=0; col<width; col++)
+            {
+                if (packedRow[col / kMaskBitsPerByte] & (0x80 >> (col % kMaskBitsPerByte)))
+                {
+                    maskRow[col] = kMaskPixelValue_ON;
+                }
+            }
+
+            sourceData += (width + kMaskBitsPerByte - 1) / kMaskBitsPerByte;
+        }
+
+        positionRect = NSMakeRect(header.bitmapOriginX, header.bitmapOriginY,
+                                    header.canvasWidth, header.canvasHeight);
+        opacity = header.opacity;
     }
 
     if (returnedImageBitmap)
@@ -150,3 +344,103 @@ ERROR:
 }
 
 @end
+
+@implementation NSData (PPNativePasteboardTypePrivateMethods)
+
+- (bool) ppLegacyNativePasteboardDataGetImageBitmap: (NSBitmapImageRep **) returnedImageBitmap
+            maskBitmap: (NSBitmapImageRep **) returnedMaskBitmap
+            positionRect: (NSRect *) returnedPositionRect
+            opacity: (float *) returnedOpacity
+{
+    NSArray *nativePasteboardArray;
+    NSData *imageBitmapData, *maskBitmapData;
+    NSString *positionRectString;
+    NSNumber *opacityNumber;
+    NSBitmapImageRep *imageBitmap, *maskBitmap;
+
+    nativePasteboardArray = [NSUnarchiver unarchiveObjectWithData: self];
+
+    if (!nativePasteboardArray
+        || ![nativePasteboardArray isKindOfClass: [NSArray class]]
+        || ([nativePasteboardArray count] != 4))
+    {
+        goto ERROR;
+    }
+
+    imageBitmapData = [nativePasteboardArray objectAtIndex: 0];
+    maskBitmapData = [nativePasteboardArray objectAtIndex: 1];
+    positionRectString = [nativePasteboardArray objectAtIndex: 2];
+    opacityNumber = [nativePasteboardArray objectAtIndex: 3];
+
+    if (!imageBitmapData || !maskBitmapData || !positionRectString || !opacityNumber)
+    {
+        goto ERROR;
+    }
+
+    imageBitmap = [NSBitmapImageRep imageRepWithData: imageBitmapData];
+    maskBitmap = [NSBitmapImageRep imageRepWithData: maskBitmapData];
+
+    if (!imageBitmap || !maskBitmap)
+    {
+        goto ERROR;
+    }
+
+    *returnedImageBitmap = imageBitmap;
+    *returnedMaskBitmap = maskBitmap;
+    *returnedPositionRect = NSRectFromString(positionRectString);
+    *returnedOpacity = [opacityNumber floatValue];
+
+    return YES;
+
+ERROR:
+    return NO;
+}
+
+@end
+
+#pragma mark Private functions
+
+static bool MaskBitmapIsPackable(NSBitmapImageRep *maskBitmap)
+{
+    unsigned char *maskData;
+    unsigned width, height, bytesPerRow, row, col;
+    PPMaskBitmapPixel *maskRow;
+
+    maskData = [maskBitmap bitmapData];
+
+    if (!maskData)
+        goto ERROR;
+
+    width = [maskBitmap pixelsWide];
+    height = [maskBitmap pixelsHigh];
+    bytesPerRow = [maskBitmap bytesPerRow];
+
+    for (row=0; row<height; row++)
+    {
+        maskRow = (PPMaskBitmapPixel *) &maskData[row * bytesPerRow];
+
+        for (col=0; col<width; col++)
+        {
+            if ((maskRow[col] != kMaskPixelValue_ON) && (maskRow[col] != kMaskPixelValue_OFF))
+            {
+                return NO;
+            }
+        }
+    }
+
+    return YES;
+
+ERROR:
+    return NO;
+}
+
+static unsigned MaskDataLengthForEncoding(PPNativePasteboardMaskEncoding maskEncoding,
+                                            unsigned width, unsigned height)
+{
+    if (maskEncoding == kPPNativePasteboardMaskEncoding_Packed1Bit)
+    {
+        return height * ((width + kMaskBitsPerByte - 1) / kMaskBitsPerByte);
+    }
+
+    return height * width * sizeof(PPMaskBitmapPixel);
+}
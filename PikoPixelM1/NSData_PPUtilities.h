@@ -0,0 +1,41 @@
+/*
+    NSData_PPUtilities.h
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import <Foundation/Foundation.h>
+
+
+@interface NSData (PPUtilities)
+
+// ppSubdataWithRangeNoCopy: returns an immutable data object that references range's bytes
+// in the receiver (and retains the receiver) instead of copying them, for passing sections of
+// a large (possibly memory-mapped) file to decoders; mutable receivers' subdata is copied
+
+- (NSData *) ppSubdataWithRangeNoCopy: (NSRange) range;
+
+// ppIsNoCopySubdata returns YES if the receiver's bytes belong to another (usually
+// memory-mapped) data object, from ppSubdataWithRangeNoCopy:
+
+- (bool) ppIsNoCopySubdata;
+
+@end
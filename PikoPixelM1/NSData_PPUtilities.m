@@ -0,0 +1,136 @@
+/*
+    NSData_PPUtilities.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "NSData_PPUtilities.h"
+
+
+@interface PPSubrangeData : NSData
+{
+    NSData *_sourceData;
+    const void *_bytes;
+    NSUInteger _length;
+}
+
+- initWithSourceData: (NSData *) sourceData range: (NSRange) range;
+
+@end
+
+@implementation NSData (PPUtilities)
+
+- (NSData *) ppSubdataWithRangeNoCopy: (NSRange) range
+{
+    if (NSMaxRange(range) > [self length])
+    {
+        goto ERROR;
+    }
+
+    // mutable data's bytes can move, so its subranges are copied instead of referenced
+
+    if ([self isKindOfClass: [NSMutableData class]])
+    {
+        return [self subdataWithRange: range];
+    }
+
+    if (!range.location && (range.length == [self length]))
+    {
+        return [[self retain] autorelease];
+    }
+
+    return [[[PPSubrangeData alloc] initWithSourceData: self range: range] autorelease];
+
+ERROR:
+    return nil;
+}
+
+- (bool) ppIsNoCopySubdata
+{
+    return [self isKindOfClass: [PPSubrangeData class]] ? YES : NO;
+}
+
+@end
+
+@implementation PPSubrangeData
+
+- initWithSourceData: (NSData *) sourceData range: (NSRange) range
+{
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    if (!sourceData
+        || [sourceData isKindOfClass: [NSMutableData class]]
+        || (NSMaxRange(range) > [sourceData length]))
+    {
+        goto ERROR;
+    }
+
+    // referencing a subrange of another PPSubrangeData references its source data directly
+
+    if ([sourceData isKindOfClass: [PPSubrangeData class]])
+    {
+        range.location += (const unsigned char *) [sourceData bytes]
+                            - (const unsigned char *)
+                                    [((PPSubrangeData *) sourceData)->_sourceData bytes];
+
+        sourceData = ((PPSubrangeData *) sourceData)->_sourceData;
+    }
+
+    _sourceData = [sourceData retain];
+    _bytes = &((const unsigned char *) [sourceData bytes])[range.location];
+    _length = range.length;
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- init
+{
+    return [self initWithSourceData: nil range: NSMakeRange(0, 0)];
+}
+
+- (void) dealloc
+{
+    [_sourceData release];
+
+    [super dealloc];
+}
+
+#pragma mark NSData primitive methods
+
+- (const void *) bytes
+{
+    return _bytes;
+}
+
+- (NSUInteger) length
+{
+    return _length;
+}
+
+@end
@@ -35,4 +35,6 @@
 
 + (NSError *) ppError_UnableToCreateDataOfType: (NSString *) typeName;
 
++ (NSError *) ppError_SaveWasCancelled;
+
 @end
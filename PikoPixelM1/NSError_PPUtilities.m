@@ -88,4 +88,12 @@
                         userInfo: errorUserInfoDict];
 }
 
++ (NSError *) ppError_SaveWasCancelled
+{
+    // NSUserCancelledError isn't presented to the user
+    return [NSError errorWithDomain: NSCocoaErrorDomain
+                        code: NSUserCancelledError
+                        userInfo: nil];
+}
+
 @end
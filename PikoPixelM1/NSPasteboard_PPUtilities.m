@@ -29,9 +29,29 @@
 
 
 #define kPPPasteboardImportTypeNames        \
-                                {kPPNativePasteboardType, NSTIFFPboardType}
+            {kPPNativePasteboardType, kPPLegacyNativePasteboardType, NSTIFFPboardType}
 
 static NSArray *PPPasteboardImportTypes(void);
+static void SetupPasteboardWithNativeDataAndBitmapProvider(NSData *nativePasteboardData,
+                                                            NSBitmapImageRep *imageBitmap,
+                                                            float opacity);
+
+
+// PPPasteboardBitmapProvider is the general pasteboard's owner while it contains a bitmap
+// copied by PikoPixel: the (non-native) TIFF & PNG types are declared without data, and are
+// only encoded if another application requests them (pasteboard:provideDataForType:)
+
+@interface PPPasteboardBitmapProvider : NSObject
+{
+    NSBitmapImageRep *_imageBitmap;
+    float _opacity;
+}
+
+- initWithImageBitmap: (NSBitmapImageRep *) imageBitmap opacity: (float) opacity;
+
+@end
+
+static PPPasteboardBitmapProvider *gPasteboardBitmapProvider = nil;
 
 
 @implementation NSPasteboard (PPUtilities)
@@ -72,7 +92,8 @@ static NSArray *PPPasteboardImportTypes(void);
     if (!availableType)
         goto ERROR;
 
-    if ([availableType isEqualToString: kPPNativePasteboardType])
+    if ([availableType isEqualToString: kPPNativePasteboardType]
+        || [availableType isEqualToString: kPPLegacyNativePasteboardType])
     {
         NSData *pasteboardData = [pasteboard dataForType: availableType];
 
@@ -137,9 +158,7 @@ ERROR:
             canvasSize: (NSSize) canvasSize
             andOpacity: (float) opacity
 {
-    NSData *nativePasteboardData, *tiffData;
-    NSPasteboard *pasteboard;
-    NSArray *pasteboardTypes;
+    NSData *nativePasteboardData;
 
     if (!imageBitmap || !maskBitmap)
     {
@@ -160,32 +179,7 @@ ERROR:
     if (!nativePasteboardData)
         goto ERROR;
 
-    if (opacity < 1.0f)
-    {
-        imageBitmap = [imageBitmap ppImageBitmapDissolvedToOpacity: opacity];
-    }
-
-    tiffData = [imageBitmap ppCompressedTIFFData];
-
-    if (!tiffData)
-        goto ERROR;
-
-    pasteboard = [NSPasteboard generalPasteboard];
-    pasteboardTypes =
-                [NSArray arrayWithObjects: kPPNativePasteboardType, NSTIFFPboardType, nil];
-
-    if (!pasteboard || !pasteboardTypes)
-    {
-        goto ERROR;
-    }
-
-    [pasteboard declareTypes: pasteboardTypes owner: self];
-
-    [pasteboard setData: nativePasteboardData
-                forType: kPPNativePasteboardType];
-
-    [pasteboard setData: tiffData
-                forType: NSTIFFPboardType];
+    SetupPasteboardWithNativeDataAndBitmapProvider(nativePasteboardData, imageBitmap, opacity);
 
     return;
 
@@ -231,35 +225,100 @@ ERROR:
 
 + (void) ppSetImageBitmap: (NSBitmapImageRep *) imageBitmap
 {
-    NSData *tiffData;
-    NSPasteboard *pasteboard;
-    NSArray *pasteboardTypes;
+    if (!imageBitmap)
+        goto ERROR;
+
+    // copied, since the TIFF & PNG data's generated later, and the caller may modify the
+    // bitmap in the meantime
+
+    imageBitmap = [[imageBitmap copy] autorelease];
 
     if (!imageBitmap)
         goto ERROR;
 
-    tiffData = [imageBitmap ppCompressedTIFFData];
+    SetupPasteboardWithNativeDataAndBitmapProvider(nil, imageBitmap, 1.0f);
+
+    return;
+
+ERROR:
+    return;
+}
+
+@end
+
+@implementation PPPasteboardBitmapProvider
+
+- initWithImageBitmap: (NSBitmapImageRep *) imageBitmap opacity: (float) opacity
+{
+    self = [super init];
 
-    if (!tiffData)
+    if (!self)
         goto ERROR;
 
-    pasteboard = [NSPasteboard generalPasteboard];
-    pasteboardTypes = [NSArray arrayWithObjects: NSTIFFPboardType, nil];
+    if (!imageBitmap)
+        goto ERROR;
 
-    if (!pasteboard || !pasteboardTypes)
+    _imageBitmap = [imageBitmap retain];
+    _opacity = opacity;
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- init
+{
+    return [self initWithImageBitmap: nil opacity: 0.0f];
+}
+
+- (void) dealloc
+{
+    [_imageBitmap release];
+
+    [super dealloc];
+}
+
+#pragma mark NSPasteboard owner methods
+
+- (void) pasteboard: (NSPasteboard *) pasteboard provideDataForType: (NSString *) type
+{
+    NSBitmapImageRep *exportBitmap;
+    NSData *data = nil;
+
+    exportBitmap = _imageBitmap;
+
+    // other applications don't see the native data's opacity, so it's applied to the bitmap
+
+    if (_opacity < 1.0f)
     {
-        goto ERROR;
+        exportBitmap = [_imageBitmap ppImageBitmapDissolvedToOpacity: _opacity];
     }
 
-    [pasteboard declareTypes: pasteboardTypes owner: self];
+    if ([type isEqualToString: NSTIFFPboardType])
+    {
+        data = [exportBitmap ppCompressedTIFFData];
+    }
+    else if ([type isEqualToString: NSPasteboardTypePNG])
+    {
+        data = [exportBitmap ppCompressedPNGData];
+    }
 
-    [pasteboard setData: tiffData
-                forType: NSTIFFPboardType];
+    if (!data)
+        return;
 
-    return;
+    [pasteboard setData: data forType: type];
+}
 
-ERROR:
-    return;
+- (void) pasteboardChangedOwner: (NSPasteboard *) pasteboard
+{
+    if (gPasteboardBitmapProvider == self)
+    {
+        [gPasteboardBitmapProvider autorelease];
+        gPasteboardBitmapProvider = nil;
+    }
 }
 
 @end
@@ -279,3 +338,53 @@ static NSArray *PPPasteboardImportTypes(void)
 
     return pasteboardImportTypes;
 }
+
+// SetupPasteboardWithNativeDataAndBitmapProvider: nativePasteboardData is optional
+static void SetupPasteboardWithNativeDataAndBitmapProvider(NSData *nativePasteboardData,
+                                                            NSBitmapImageRep *imageBitmap,
+                                                            float opacity)
+{
+    NSPasteboard *pasteboard;
+    PPPasteboardBitmapProvider *bitmapProvider;
+    NSMutableArray *pasteboardTypes;
+
+    pasteboard = [NSPasteboard generalPasteboard];
+
+    bitmapProvider = [[[PPPasteboardBitmapProvider alloc] initWithImageBitmap: imageBitmap
+                                                            opacity: opacity]
+                                                    autorelease];
+
+    pasteboardTypes = [NSMutableArray array];
+
+    if (!pasteboard || !bitmapProvider || !pasteboardTypes)
+    {
+        goto ERROR;
+    }
+
+    if (nativePasteboardData)
+    {
+        [pasteboardTypes addObject: kPPNativePasteboardType];
+    }
+
+    [pasteboardTypes addObject: NSTIFFPboardType];
+    [pasteboardTypes addObject: NSPasteboardTypePNG];
+
+    // the pasteboard doesn't retain its owner, so the current provider's kept in a global
+    // until it's replaced
+
+    [gPasteboardBitmapProvider autorelease];
+    gPasteboardBitmapProvider = [bitmapProvider retain];
+
+    [pasteboard declareTypes: pasteboardTypes owner: gPasteboardBitmapProvider];
+
+    if (nativePasteboardData)
+    {
+        [pasteboard setData: nativePasteboardData
+                    forType: kPPNativePasteboardType];
+    }
+
+    return;
+
+ERROR:
+    return;
+}
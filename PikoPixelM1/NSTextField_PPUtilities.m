@@ -25,6 +25,7 @@
 #import "NSTextField_PPUtilities.h"
 
 #import "PPAppBootUtilities.h"
+#import "PPStartupTimeline.h"
 
 
 static NSCharacterSet *gNonDigitCharacterSet = nil;
@@ -39,6 +40,8 @@ static NSCharacterSet *gNonDigitCharacterSet = nil;
 
 + (void) load
 {
+    macroStartupTimelineMethodScope();
+
     macroPerformNSObjectSelectorAfterAppLoads(ppNSTextField_PPUtilities_SetupGlobals);
 }
 
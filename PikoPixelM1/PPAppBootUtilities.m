@@ -24,7 +24,9 @@
 
 #import "PPAppBootUtilities.h"
 
+#import <objc/runtime.h>
 #import "PPObjCUtilities.h"
+#import "PPStartupTimeline.h"
 
 
 #define kMaxNumStoredSelectors      50
@@ -75,6 +77,8 @@ ERROR:
 
 void PPAppBootUtils_HandleAppDidFinishLoading(void)
 {
+    macroStartupTimelineMethodScope();
+
     int selectorIndex;
 
     if (gAppDidFinishLoading)
@@ -109,6 +113,9 @@ void PPAppBootUtils_HandleAppDidFinishLoading(void)
 
         if (selector && [NSObject respondsToSelector: selector])
         {
+            // sel_getName() returns the runtime's (persistent) copy of the selector's name
+            macroStartupTimelineScope(sel_getName(selector));
+
             [NSObject performSelector: selector];
         }
         else
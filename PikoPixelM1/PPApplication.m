@@ -34,6 +34,9 @@
 #import "NSDocumentController_PPUtilities.h"
 #import "PPModifierKeyMasks.h"
 #import "PPAppBootUtilities.h"
+#import "PPUserDefaults.h"
+#import "NSBitmapImageRep_PPUtilities.h"
+#import "PPStartupTimeline.h"
 
 
 #define kNonzeroModifierMaskForMenuItemsWithArrowKeyEquivalents         (NSAlternateKeyMask)
@@ -113,8 +116,15 @@ ERROR:
 
 - (void) finishLaunching
 {
+    macroStartupTimelineMethodScope();
+
     PPAppBootUtils_HandleAppDidFinishLoading();
 
+    // linear working format must be set before any documents are opened (linear bitmaps
+    // can only be blended with bitmaps in the same format)
+    [NSBitmapImageRep ppSetLinearBitmapsUseCompactFormat:
+                                            [PPUserDefaults linearBlendingUsesCompactFormat]];
+
     [super finishLaunching];
 }
 
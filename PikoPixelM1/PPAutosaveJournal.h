@@ -0,0 +1,99 @@
+/*
+    PPAutosaveJournal.h
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import <Cocoa/Cocoa.h>
+
+
+@class PPDocument;
+
+// PPAutosaveJournal: Allows autosaving a document by appending only the layers that changed
+// since the last autosave to a journal file next to the autosave (checkpoint) file, instead of
+// rewriting the whole document. Each journal record contains the document's archive (which
+// references layer bitmap chunks stored in the checkpoint or earlier records) & any new layer
+// chunks. When the journal gets too long, the next autosave writes a new checkpoint instead
+// (compaction). Loading an autosave file restores the journal's most recent complete record.
+
+@interface PPAutosaveJournal : NSObject
+{
+    NSString *_checkpointPath;
+    NSString *_journalPath;
+
+    NSMutableArray *_storedChunks;
+    NSMutableData *_storedChunkReferences;
+    NSMutableData *_storedChunkContentHashes;
+    unsigned long _journalLength;
+    unsigned long _checkpointLength;
+    int _numRecords;
+
+    NSArray *_pendingCheckpointChunks;
+    unsigned long _pendingCheckpointLength;
+    uint64_t _pendingCheckpointHash;
+
+    NSMutableData *_recordChunksData;
+    NSMutableData *_recordChunkReferences;
+    unsigned _numRecordChunkReferences;
+    bool _isWritingRecord;
+
+    NSData *_preparedRecordData;
+    unsigned _numStoredChunksBeforePreparedRecord;
+    bool _hasPreparedRecord;
+
+    NSData *_journalData;
+    NSData *_archivedDocumentData;
+    id _checkpointLayerChunks;
+    const unsigned char *_recordChunkReferencesBytes;
+}
+
++ (NSString *) journalPathForCheckpointPath: (NSString *) checkpointPath;
+
+// Writing
+
+// setupPendingCheckpointWithData: is called with the native file format data of a full
+// autosave before it's written; beginJournalForPendingCheckpointAtPath: starts a new (empty)
+// journal once the data's successfully written to checkpointPath
+- (void) setupPendingCheckpointWithData: (NSData *) checkpointData
+            storedLayerChunks: (NSArray *) storedLayerChunks;
+
+- (bool) beginJournalForPendingCheckpointAtPath: (NSString *) checkpointPath;
+
+- (bool) canAppendRecordForCheckpointAtPath: (NSString *) checkpointPath;
+
+// prepareRecordForDocument: archives the document (must be called on the main thread, or while
+// the document's user interaction is blocked); appendPreparedRecord writes the prepared record
+// to the journal file & can be called afterwards from a background thread
+- (bool) prepareRecordForDocument: (PPDocument *) document;
+- (bool) appendPreparedRecord;
+
+- (void) removeJournal;
+- (void) removeJournalIfCheckpointIsMissing;
+
+// Reading
+
+- initForReadingLatestRecordInJournalData: (NSData *) journalData
+    checkpointData: (NSData *) checkpointData
+    checkpointLayerChunks: (id) checkpointLayerChunks;
+
+- (NSData *) archivedDocumentData;
+
+@end
@@ -0,0 +1,843 @@
+/*
+    PPAutosaveJournal.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPAutosaveJournal.h"
+
+#import <fcntl.h>
+#import <unistd.h>
+#import "PPDocument_NativeFileFormat.h"
+#import "PPDocumentLayer.h"
+#import "PPContentHash.h"
+#import "NSData_PPUtilities.h"
+#import "PPTrace.h"
+
+
+/*
+Autosave journal file layout (all header & table values are little-endian uint32s):
+-----------
+1. Journal header (PPAutosaveJournalHeader - length & hash of the checkpoint file the journal
+    belongs to)
+-----------
+2. Records, appended one per autosave:
+    a. Record header (PPAutosaveJournalRecordHeader)
+    b. New layer chunks (tile-encoded bitmap data of layers changed since they were last
+        stored), concatenated
+    c. Chunk references (PPAutosaveJournalChunkReference for each layer chunk referenced by the
+        record's archived document - either a chunk index in the checkpoint file, or an offset
+        & length in the journal file)
+    d. NSKeyedArchive of PPDocument (layers reference chunks by their index in part c)
+-----------
+
+A record's incomplete if the journal ends before the record's end (crash during an append), so
+loading restores the most recent complete record & ignores any incomplete data.
+*/
+
+#define kAutosaveJournalHeaderSignature             'ppAJ'
+#define kAutosaveJournalRecordSignature             'ppJR'
+
+#define kAutosaveJournalPathExtension               @"journal"
+
+// compaction thresholds: after either is reached, the next autosave writes a new checkpoint
+#define kMaxRecordsPerAutosaveJournal               32
+#define kMinAutosaveJournalLengthForCompaction      (4 * 1024 * 1024)
+
+
+typedef enum
+{
+    kPPAutosaveJournalChunkSource_Checkpoint,
+    kPPAutosaveJournalChunkSource_Journal,
+
+    kNumPPAutosaveJournalChunkSources
+
+} PPAutosaveJournalChunkSource;
+
+typedef struct
+{
+    uint32_t signature;
+    uint32_t checkpointLength;
+    uint32_t checkpointHashLow;
+    uint32_t checkpointHashHigh;
+
+} PPAutosaveJournalHeader;
+
+typedef struct
+{
+    uint32_t signature;
+    uint32_t newChunksDataLength;
+    uint32_t numChunkReferences;
+    uint32_t archivedDocumentDataLength;
+
+} PPAutosaveJournalRecordHeader;
+
+typedef struct
+{
+    uint32_t chunkSource;
+
+    // checkpoint chunks: chunkOffset is the chunk's index in the checkpoint file, chunkLength
+    // is unused; journal chunks: offset & length in the journal file
+    uint32_t chunkOffset;
+    uint32_t chunkLength;
+
+} PPAutosaveJournalChunkReference;
+
+// in-memory only: content hash of the layer a stored chunk was encoded from (unknown for
+// checkpoint chunks & for chunks of layers that already had cached encoded data)
+typedef struct
+{
+    uint64_t contentHash;
+    bool hasContentHash;
+
+} PPAutosaveJournalStoredChunkHash;
+
+
+static bool JournalDataIsValidForCheckpointData(NSData *journalData, NSData *checkpointData);
+static uint64_t HashOfData(NSData *data);
+static void PPAutosaveJournalChunkReference_FixByteOrder(
+                                            PPAutosaveJournalChunkReference *chunkReference);
+static bool WriteDataToFileAtOffset(NSData *data, NSString *filepath, unsigned long offset,
+                                    bool shouldCreateFile);
+
+
+@interface PPAutosaveJournal (PrivateMethods)
+
+- (void) discardPreparedRecord;
+- (void) resetStoredChunks;
+
+- (unsigned) indexOfStoredChunkWithContentHash: (uint64_t) contentHash;
+
+@end
+
+@implementation PPAutosaveJournal
+
++ (NSString *) journalPathForCheckpointPath: (NSString *) checkpointPath
+{
+    if (![checkpointPath length])
+    {
+        return nil;
+    }
+
+    return [checkpointPath stringByAppendingPathExtension: kAutosaveJournalPathExtension];
+}
+
+- init
+{
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    _storedChunks = [[NSMutableArray alloc] init];
+    _storedChunkReferences = [[NSMutableData alloc] init];
+    _storedChunkContentHashes = [[NSMutableData alloc] init];
+    _recordChunksData = [[NSMutableData alloc] init];
+    _recordChunkReferences = [[NSMutableData alloc] init];
+
+    if (!_storedChunks || !_storedChunkReferences || !_storedChunkContentHashes
+        || !_recordChunksData || !_recordChunkReferences)
+    {
+        goto ERROR;
+    }
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- (void) dealloc
+{
+    [_checkpointPath release];
+    [_journalPath release];
+
+    [_storedChunks release];
+    [_storedChunkReferences release];
+    [_storedChunkContentHashes release];
+
+    [_pendingCheckpointChunks release];
+
+    [_recordChunksData release];
+    [_recordChunkReferences release];
+    [_preparedRecordData release];
+
+    [_journalData release];
+    [_archivedDocumentData release];
+    [_checkpointLayerChunks release];
+
+    [super dealloc];
+}
+
+#pragma mark Writing
+
+- (void) setupPendingCheckpointWithData: (NSData *) checkpointData
+            storedLayerChunks: (NSArray *) storedLayerChunks
+{
+    [_pendingCheckpointChunks release];
+    _pendingCheckpointChunks = nil;
+
+    if (!checkpointData || !storedLayerChunks)
+    {
+        return;
+    }
+
+    _pendingCheckpointChunks = [storedLayerChunks copy];
+    _pendingCheckpointLength = [checkpointData length];
+    _pendingCheckpointHash = HashOfData(checkpointData);
+}
+
+- (bool) beginJournalForPendingCheckpointAtPath: (NSString *) checkpointPath
+{
+    NSString *journalPath;
+    PPAutosaveJournalHeader journalHeader;
+    PPAutosaveJournalChunkReference chunkReference;
+    unsigned chunkIndex, numChunks;
+
+    [self removeJournal];
+
+    journalPath = [PPAutosaveJournal journalPathForCheckpointPath: checkpointPath];
+
+    if (!journalPath || !_pendingCheckpointChunks
+        || (_pendingCheckpointLength > UINT32_MAX))
+    {
+        goto ERROR;
+    }
+
+    journalHeader.signature = NSSwapHostIntToLittle(kAutosaveJournalHeaderSignature);
+    journalHeader.checkpointLength = NSSwapHostIntToLittle(_pendingCheckpointLength);
+    journalHeader.checkpointHashLow =
+                    NSSwapHostIntToLittle((uint32_t) (_pendingCheckpointHash & 0xFFFFFFFF));
+    journalHeader.checkpointHashHigh =
+                    NSSwapHostIntToLittle((uint32_t) (_pendingCheckpointHash >> 32));
+
+    if (!WriteDataToFileAtOffset([NSData dataWithBytes: &journalHeader
+                                            length: sizeof(journalHeader)],
+                                    journalPath, 0, YES))
+    {
+        goto ERROR;
+    }
+
+    _checkpointPath = [checkpointPath retain];
+    _journalPath = [journalPath retain];
+
+    _journalLength = sizeof(journalHeader);
+    _checkpointLength = _pendingCheckpointLength;
+    _numRecords = 0;
+
+    // the checkpoint's layer chunks can be referenced by index from journal records
+
+    numChunks = [_pendingCheckpointChunks count];
+
+    for (chunkIndex=0; chunkIndex<numChunks; chunkIndex++)
+    {
+        chunkReference.chunkSource = kPPAutosaveJournalChunkSource_Checkpoint;
+        chunkReference.chunkOffset = chunkIndex;
+        chunkReference.chunkLength = 0;
+
+        [_storedChunkReferences appendBytes: &chunkReference length: sizeof(chunkReference)];
+    }
+
+    [_storedChunkContentHashes setLength: numChunks * sizeof(PPAutosaveJournalStoredChunkHash)];
+
+    [_storedChunks setArray: _pendingCheckpointChunks];
+
+    [_pendingCheckpointChunks release];
+    _pendingCheckpointChunks = nil;
+
+    return YES;
+
+ERROR:
+    [self removeJournal];
+
+    return NO;
+}
+
+- (bool) canAppendRecordForCheckpointAtPath: (NSString *) checkpointPath
+{
+    if (!_journalPath || !_checkpointPath || ![_checkpointPath isEqualToString: checkpointPath])
+    {
+        return NO;
+    }
+
+    if ((_numRecords >= kMaxRecordsPerAutosaveJournal)
+        || (_journalLength
+                >= MAX(_checkpointLength, kMinAutosaveJournalLengthForCompaction)))
+    {
+        return NO;
+    }
+
+    return [[NSFileManager defaultManager] fileExistsAtPath: _checkpointPath] ? YES : NO;
+}
+
+- (bool) prepareRecordForDocument: (PPDocument *) document
+{
+    macroTraceMethodScope();
+
+    NSData *archivedDocumentData;
+    NSMutableData *recordData;
+    PPAutosaveJournalRecordHeader recordHeader;
+
+    [self discardPreparedRecord];
+
+    if (!_journalPath || !document)
+    {
+        goto ERROR;
+    }
+
+    _numStoredChunksBeforePreparedRecord = [_storedChunks count];
+    _hasPreparedRecord = YES;
+
+    [_recordChunksData setLength: 0];
+    [_recordChunkReferences setLength: 0];
+    _numRecordChunkReferences = 0;
+
+    // changed layers' chunks are added to _recordChunksData by the
+    // ppIndexOfStoredBitmapChunkForLayer: delegate method while the document's archived
+
+    _isWritingRecord = YES;
+
+    archivedDocumentData = [document nativeArchivedDocumentDataUsingLayerChunksDelegate: self];
+
+    _isWritingRecord = NO;
+
+    if (![archivedDocumentData length])
+    {
+        goto ERROR;
+    }
+
+    recordHeader.signature = NSSwapHostIntToLittle(kAutosaveJournalRecordSignature);
+    recordHeader.newChunksDataLength = NSSwapHostIntToLittle([_recordChunksData length]);
+    recordHeader.numChunkReferences = NSSwapHostIntToLittle(_numRecordChunkReferences);
+    recordHeader.archivedDocumentDataLength =
+                                    NSSwapHostIntToLittle([archivedDocumentData length]);
+
+    recordData = [NSMutableData dataWithCapacity: sizeof(recordHeader)
+                                                    + [_recordChunksData length]
+                                                    + [_recordChunkReferences length]
+                                                    + [archivedDocumentData length]];
+
+    if (!recordData)
+        goto ERROR;
+
+    [recordData appendBytes: &recordHeader length: sizeof(recordHeader)];
+    [recordData appendData: _recordChunksData];
+    [recordData appendData: _recordChunkReferences];
+    [recordData appendData: archivedDocumentData];
+
+    [_recordChunksData setLength: 0];
+    [_recordChunkReferences setLength: 0];
+
+    if (((unsigned long long) _journalLength + [recordData length]) > UINT32_MAX)
+    {
+        goto ERROR;
+    }
+
+    _preparedRecordData = [recordData retain];
+
+    return YES;
+
+ERROR:
+    _isWritingRecord = NO;
+
+    [self discardPreparedRecord];
+
+    return NO;
+}
+
+- (bool) appendPreparedRecord
+{
+    macroTraceMethodScope();
+
+    if (!_preparedRecordData || !_journalPath)
+    {
+        goto ERROR;
+    }
+
+    if (!WriteDataToFileAtOffset(_preparedRecordData, _journalPath, _journalLength, NO))
+    {
+        goto ERROR;
+    }
+
+    _journalLength += [_preparedRecordData length];
+    _numRecords++;
+
+    _hasPreparedRecord = NO;
+
+    [_preparedRecordData release];
+    _preparedRecordData = nil;
+
+    return YES;
+
+ERROR:
+    [self discardPreparedRecord];
+
+    return NO;
+}
+
+- (void) removeJournal
+{
+    [self discardPreparedRecord];
+
+    if (_journalPath)
+    {
+        unlink([_journalPath fileSystemRepresentation]);
+
+        [_journalPath release];
+        _journalPath = nil;
+    }
+
+    [_checkpointPath release];
+    _checkpointPath = nil;
+
+    [self resetStoredChunks];
+}
+
+- (void) removeJournalIfCheckpointIsMissing
+{
+    if (_checkpointPath && ![[NSFileManager defaultManager] fileExistsAtPath: _checkpointPath])
+    {
+        [self removeJournal];
+    }
+}
+
+#pragma mark Reading
+
+- initForReadingLatestRecordInJournalData: (NSData *) journalData
+    checkpointData: (NSData *) checkpointData
+    checkpointLayerChunks: (id) checkpointLayerChunks
+{
+    const unsigned char *journalBytes;
+    unsigned long journalLength, recordOffset, chunkReferencesOffset, latestRecordOffset = 0;
+    unsigned long long recordLength;
+    PPAutosaveJournalRecordHeader recordHeader, latestRecordHeader;
+    PPAutosaveJournalChunkReference chunkReference;
+    unsigned referenceIndex;
+    bool recordIsValid;
+
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    if (!checkpointLayerChunks
+        || !JournalDataIsValidForCheckpointData(journalData, checkpointData))
+    {
+        goto ERROR;
+    }
+
+    journalBytes = [journalData bytes];
+    journalLength = [journalData length];
+
+    // find the last complete & valid record
+
+    recordOffset = sizeof(PPAutosaveJournalHeader);
+
+    while (recordOffset + sizeof(recordHeader) <= journalLength)
+    {
+        memcpy(&recordHeader, &journalBytes[recordOffset], sizeof(recordHeader));
+
+        recordHeader.signature = NSSwapLittleIntToHost(recordHeader.signature);
+        recordHeader.newChunksDataLength =
+                                    NSSwapLittleIntToHost(recordHeader.newChunksDataLength);
+        recordHeader.numChunkReferences =
+                                    NSSwapLittleIntToHost(recordHeader.numChunkReferences);
+        recordHeader.archivedDocumentDataLength =
+                            NSSwapLittleIntToHost(recordHeader.archivedDocumentDataLength);
+
+        recordLength = (unsigned long long) sizeof(recordHeader)
+                        + (unsigned long long) recordHeader.newChunksDataLength
+                        + (unsigned long long) recordHeader.numChunkReferences
+                                                    * sizeof(PPAutosaveJournalChunkReference)
+                        + (unsigned long long) recordHeader.archivedDocumentDataLength;
+
+        if ((recordHeader.signature != kAutosaveJournalRecordSignature)
+            || !recordHeader.archivedDocumentDataLength
+            || (recordLength > journalLength - recordOffset))
+        {
+            break;
+        }
+
+        // validate the record's chunk references (journal chunks must lie within the
+        // journal data preceding the references)
+
+        chunkReferencesOffset =
+                    recordOffset + sizeof(recordHeader) + recordHeader.newChunksDataLength;
+
+        recordIsValid = YES;
+
+        for (referenceIndex=0; referenceIndex<recordHeader.numChunkReferences; referenceIndex++)
+        {
+            memcpy(&chunkReference,
+                    &journalBytes[chunkReferencesOffset
+                                    + referenceIndex * sizeof(chunkReference)],
+                    sizeof(chunkReference));
+
+            PPAutosaveJournalChunkReference_FixByteOrder(&chunkReference);
+
+            if ((chunkReference.chunkSource >= kNumPPAutosaveJournalChunkSources)
+                || ((chunkReference.chunkSource == kPPAutosaveJournalChunkSource_Journal)
+                    && ((chunkReference.chunkOffset > chunkReferencesOffset)
+                        || (chunkReference.chunkLength
+                                > chunkReferencesOffset - chunkReference.chunkOffset))))
+            {
+                recordIsValid = NO;
+                break;
+            }
+        }
+
+        if (!recordIsValid)
+            break;
+
+        latestRecordOffset = recordOffset;
+        latestRecordHeader = recordHeader;
+
+        recordOffset += recordLength;
+    }
+
+    if (!latestRecordOffset)
+        goto ERROR;
+
+    chunkReferencesOffset = latestRecordOffset + sizeof(latestRecordHeader)
+                                + latestRecordHeader.newChunksDataLength;
+
+    _journalData = [journalData retain];
+    _checkpointLayerChunks = [checkpointLayerChunks retain];
+
+    _recordChunkReferencesBytes = &journalBytes[chunkReferencesOffset];
+    _numRecordChunkReferences = latestRecordHeader.numChunkReferences;
+
+    _archivedDocumentData =
+        [[journalData ppSubdataWithRangeNoCopy:
+                        NSMakeRange(chunkReferencesOffset
+                                        + _numRecordChunkReferences
+                                            * sizeof(PPAutosaveJournalChunkReference),
+                                    latestRecordHeader.archivedDocumentDataLength)]
+                    retain];
+
+    if (!_archivedDocumentData)
+        goto ERROR;
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- (NSData *) archivedDocumentData
+{
+    return _archivedDocumentData;
+}
+
+#pragma mark PPDocumentLayerBitmapChunkCodingDelegateMethods
+
+- (int) ppIndexOfStoredBitmapChunkForLayer: (PPDocumentLayer *) layer
+{
+    NSData *chunkData = nil;
+    unsigned storedChunkIndex;
+    PPAutosaveJournalChunkReference chunkReference;
+    PPAutosaveJournalStoredChunkHash chunkHash;
+
+    if (!_isWritingRecord || !layer)
+    {
+        goto ERROR;
+    }
+
+    if ([layer hasCachedTileEncodedBitmapData])
+    {
+        // unchanged layers return the same (cached) chunk data object, so a chunk that's
+        // already stored in the checkpoint or journal is just referenced again
+
+        chunkData = [layer tileEncodedBitmapData];
+
+        storedChunkIndex = [_storedChunks indexOfObjectIdenticalTo: chunkData];
+
+        chunkHash.contentHash = 0;
+        chunkHash.hasContentHash = NO;
+    }
+    else
+    {
+        // the layer changed since it was last encoded, but its content may match a stored
+        // chunk's (e.g. after undoing the change), in which case the layer doesn't need to be
+        // re-encoded; the layer's bitmap is decoded, so getting its content hash is cheap
+
+        chunkHash.contentHash = [layer bitmapContentHash];
+        chunkHash.hasContentHash = YES;
+
+        storedChunkIndex = [self indexOfStoredChunkWithContentHash: chunkHash.contentHash];
+    }
+
+    if (storedChunkIndex != NSNotFound)
+    {
+        memcpy(&chunkReference,
+                &((const unsigned char *) [_storedChunkReferences bytes])
+                                            [storedChunkIndex * sizeof(chunkReference)],
+                sizeof(chunkReference));
+    }
+    else
+    {
+        if (!chunkData)
+        {
+            chunkData = [layer tileEncodedBitmapData];
+        }
+
+        if (![chunkData length])
+            goto ERROR;
+
+        chunkReference.chunkSource = kPPAutosaveJournalChunkSource_Journal;
+        chunkReference.chunkOffset = _journalLength + sizeof(PPAutosaveJournalRecordHeader)
+                                        + [_recordChunksData length];
+        chunkReference.chunkLength = [chunkData length];
+
+        [_recordChunksData appendData: chunkData];
+
+        [_storedChunks addObject: chunkData];
+        [_storedChunkReferences appendBytes: &chunkReference length: sizeof(chunkReference)];
+        [_storedChunkContentHashes appendBytes: &chunkHash length: sizeof(chunkHash)];
+    }
+
+    PPAutosaveJournalChunkReference_FixByteOrder(&chunkReference);
+
+    [_recordChunkReferences appendBytes: &chunkReference length: sizeof(chunkReference)];
+
+    return _numRecordChunkReferences++;
+
+ERROR:
+    return -1;
+}
+
+- (NSData *) ppLayerBitmapChunkAtIndex: (int) chunkIndex
+{
+    PPAutosaveJournalChunkReference chunkReference;
+
+    if (!_recordChunkReferencesBytes || (chunkIndex < 0)
+        || ((unsigned) chunkIndex >= _numRecordChunkReferences))
+    {
+        goto ERROR;
+    }
+
+    memcpy(&chunkReference, &_recordChunkReferencesBytes[chunkIndex * sizeof(chunkReference)],
+            sizeof(chunkReference));
+
+    PPAutosaveJournalChunkReference_FixByteOrder(&chunkReference);
+
+    if (chunkReference.chunkSource == kPPAutosaveJournalChunkSource_Checkpoint)
+    {
+        return [_checkpointLayerChunks ppLayerBitmapChunkAtIndex: chunkReference.chunkOffset];
+    }
+
+    // journal chunk ranges were validated when the record was found; journal chunks are
+    // copied (unlike the archive & checkpoint chunks), so the layers using them don't keep
+    // the whole journal (including its stale records) in memory
+    return [_journalData subdataWithRange: NSMakeRange(chunkReference.chunkOffset,
+                                                        chunkReference.chunkLength)];
+
+ERROR:
+    return nil;
+}
+
+#pragma mark Private methods
+
+- (void) discardPreparedRecord
+{
+    unsigned numStoredChunks, numOldChunks;
+
+    // forget the chunks stored by the discarded record, since they were never written
+
+    numStoredChunks = [_storedChunks count];
+    numOldChunks = _numStoredChunksBeforePreparedRecord;
+
+    if (_hasPreparedRecord && (numStoredChunks > numOldChunks))
+    {
+        [_storedChunks removeObjectsInRange:
+                                NSMakeRange(numOldChunks, numStoredChunks - numOldChunks)];
+
+        [_storedChunkReferences setLength:
+                                    numOldChunks * sizeof(PPAutosaveJournalChunkReference)];
+
+        [_storedChunkContentHashes setLength:
+                                    numOldChunks * sizeof(PPAutosaveJournalStoredChunkHash)];
+    }
+
+    _hasPreparedRecord = NO;
+
+    [_preparedRecordData release];
+    _preparedRecordData = nil;
+
+    [_recordChunksData setLength: 0];
+    [_recordChunkReferences setLength: 0];
+}
+
+- (void) resetStoredChunks
+{
+    [_storedChunks removeAllObjects];
+    [_storedChunkReferences setLength: 0];
+    [_storedChunkContentHashes setLength: 0];
+
+    _journalLength = 0;
+    _checkpointLength = 0;
+    _numRecords = 0;
+}
+
+- (unsigned) indexOfStoredChunkWithContentHash: (uint64_t) contentHash
+{
+    const PPAutosaveJournalStoredChunkHash *chunkHashes;
+    unsigned numChunkHashes, chunkIndex;
+
+    chunkHashes = (const PPAutosaveJournalStoredChunkHash *) [_storedChunkContentHashes bytes];
+    numChunkHashes = [_storedChunkContentHashes length] / sizeof(*chunkHashes);
+
+    for (chunkIndex=0; chunkIndex<numChunkHashes; chunkIndex++)
+    {
+        if (chunkHashes[chunkIndex].hasContentHash
+            && (chunkHashes[chunkIndex].contentHash == contentHash))
+        {
+            return chunkIndex;
+        }
+    }
+
+    return NSNotFound;
+}
+
+@end
+
+#pragma mark Private functions
+
+static bool JournalDataIsValidForCheckpointData(NSData *journalData, NSData *checkpointData)
+{
+    PPAutosaveJournalHeader journalHeader;
+    uint64_t checkpointHash;
+
+    if (!checkpointData || ([journalData length] < sizeof(journalHeader)))
+    {
+        return NO;
+    }
+
+    memcpy(&journalHeader, [journalData bytes], sizeof(journalHeader));
+
+    if ((NSSwapLittleIntToHost(journalHeader.signature) != kAutosaveJournalHeaderSignature)
+        || (NSSwapLittleIntToHost(journalHeader.checkpointLength) != [checkpointData length]))
+    {
+        return NO;
+    }
+
+    checkpointHash = HashOfData(checkpointData);
+
+    return ((NSSwapLittleIntToHost(journalHeader.checkpointHashLow)
+                    == (uint32_t) (checkpointHash & 0xFFFFFFFF))
+                && (NSSwapLittleIntToHost(journalHeader.checkpointHashHigh)
+                    == (uint32_t) (checkpointHash >> 32))) ? YES : NO;
+}
+
+static uint64_t HashOfData(NSData *data)
+{
+    unsigned long numBytes;
+    uint64_t hash;
+
+    numBytes = [data length];
+
+    hash = PPContentHash_MixWord(kPPContentHashSeed, (uint64_t) numBytes);
+
+    if (numBytes)
+    {
+        hash = PPContentHash_MixBytes(hash, [data bytes], numBytes);
+    }
+
+    return PPContentHash_Finalize(hash);
+}
+
+static void PPAutosaveJournalChunkReference_FixByteOrder(
+                                            PPAutosaveJournalChunkReference *chunkReference)
+{
+    chunkReference->chunkSource = NSSwapHostIntToLittle(chunkReference->chunkSource);
+    chunkReference->chunkOffset = NSSwapHostIntToLittle(chunkReference->chunkOffset);
+    chunkReference->chunkLength = NSSwapHostIntToLittle(chunkReference->chunkLength);
+}
+
+// WriteDataToFileAtOffset() truncates the file at offset (discarding any incomplete record
+// left by an earlier failed append), then writes the data & flushes it to disk
+
+static bool WriteDataToFileAtOffset(NSData *data, NSString *filepath, unsigned long offset,
+                                    bool shouldCreateFile)
+{
+    const char *path;
+    int fileDescriptor, openFlags;
+    const unsigned char *bytes;
+    size_t numBytesRemaining;
+    ssize_t numBytesWritten;
+
+    path = [filepath fileSystemRepresentation];
+    bytes = [data bytes];
+    numBytesRemaining = [data length];
+
+    if (!path || !bytes)
+    {
+        goto ERROR;
+    }
+
+    openFlags = O_WRONLY;
+
+    if (shouldCreateFile)
+    {
+        openFlags |= O_CREAT | O_TRUNC;
+    }
+
+    fileDescriptor = open(path, openFlags, 0644);
+
+    if (fileDescriptor < 0)
+        goto ERROR;
+
+    if ((ftruncate(fileDescriptor, offset) != 0)
+        || (lseek(fileDescriptor, offset, SEEK_SET) != (off_t) offset))
+    {
+        goto CLOSE_AND_ERROR;
+    }
+
+    while (numBytesRemaining > 0)
+    {
+        numBytesWritten = write(fileDescriptor, bytes, numBytesRemaining);
+
+        if (numBytesWritten <= 0)
+            goto CLOSE_AND_ERROR;
+
+        bytes += numBytesWritten;
+        numBytesRemaining -= numBytesWritten;
+    }
+
+    if (fsync(fileDescriptor) != 0)
+    {
+        goto CLOSE_AND_ERROR;
+    }
+
+    close(fileDescriptor);
+
+    return YES;
+
+CLOSE_AND_ERROR:
+    close(fileDescriptor);
+
+ERROR:
+    return NO;
+}
@@ -0,0 +1,59 @@
+/*
+    PPBatchConverter.h
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import <Foundation/Foundation.h>
+
+
+// PPBatchConverter: Converts native-format (.piko) documents to PNG files from the command
+// line, without starting the application (no NSApplication, windows, or window server
+// connection), for build machines & asset pipelines. It runs when the executable's first
+// argument is kPPBatchConverterCommandLineFlag (see main.m):
+//
+//  PikoPixel -ppBatchConvert [-o <outputDirectory>] [-scale <scalingFactor>]
+//                  [-blending standard|linear] [-grid] [-background] <file.piko> ...
+//
+// Each document's loaded & merged with the regular document code (serially, since documents
+// aren't thread-safe), then the export images are generated, PNG-encoded, & written in
+// parallel. Inputs whose output files would have the same name get a numeric suffix
+// (name-2.png, ...). Per-file timings are printed to stdout, errors to stderr.
+
+#define kPPBatchConverterCommandLineFlag    "-ppBatchConvert"
+
+
+@interface PPBatchConverter : NSObject
+{
+    NSArray *_inputPaths;
+    NSString *_outputDirectory;
+
+    unsigned _scalingFactor;
+    int _layerBlendingMode;     // -1: use each document's blending mode
+
+    bool _shouldExportGrid;
+    bool _shouldExportBackground;
+}
+
+// returns the process exit status
++ (int) runWithCommandLineArgumentCount: (int) argc values: (char **) argv;
+
+@end
@@ -0,0 +1,634 @@
+/*
+    PPBatchConverter.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPBatchConverter.h"
+
+#import <Cocoa/Cocoa.h>
+#import "PPAppBootUtilities.h"
+#import "PPDocument_NativeFileFormat.h"
+#import "PPUserDefaults.h"
+#import "NSBitmapImageRep_PPUtilities.h"
+
+
+#define kOutputFileExtension                        @"png"
+
+#define kOption_OutputDirectory                     @"-o"
+#define kOption_ScalingFactor                       @"-scale"
+#define kOption_LayerBlendingMode                   @"-blending"
+#define kOption_Grid                                @"-grid"
+#define kOption_Background                          @"-background"
+
+#define kLayerBlendingModeName_Standard             @"standard"
+#define kLayerBlendingModeName_Linear               @"linear"
+
+#define kMaxScalingFactor                           50
+
+// documents are loaded & converted in batches (rather than all at once) to limit the number
+// of merged bitmaps in memory; each batch is exported in parallel
+#define kNumBatchFilesPerProcessor                  2
+#define kMinNumBatchFiles                           4
+
+#define kExitStatus_Success                         0
+#define kExitStatus_ConversionFailed                1
+#define kExitStatus_InvalidArguments                2
+
+
+// PPBatchConversionJob: state for converting a single file; the load stage runs on the main
+// thread, the export stage runs concurrently with other jobs' export stages, and only
+// accesses its own job's objects
+
+@interface PPBatchConversionJob : NSObject
+{
+@public
+    NSString *_inputPath;
+    NSString *_outputPath;
+
+    NSBitmapImageRep *_mergedBitmap;
+    PPGridPattern *_gridPattern;
+    PPBackgroundPattern *_backgroundPattern;
+    NSImage *_backgroundImage;
+    NSImageInterpolation _backgroundImageInterpolation;
+
+    NSString *_errorDescription;
+
+    NSTimeInterval _loadTime;
+    NSTimeInterval _exportTime;
+    unsigned long _outputFileSize;
+}
+
+- initWithInputPath: (NSString *) inputPath outputPath: (NSString *) outputPath;
+
+- (void) loadDocumentWithLayerBlendingMode: (int) layerBlendingMode
+            shouldExportGrid: (bool) shouldExportGrid
+            shouldExportBackground: (bool) shouldExportBackground;
+- (void) exportPNGWithScalingFactor: (unsigned) scalingFactor;
+
+- (bool) didSucceed;
+
+@end
+
+@interface PPBatchConverter (PrivateMethods)
+
+- initWithCommandLineArguments: (NSArray *) arguments;
+
+- (int) run;
+
+- (NSArray *) outputPathsForInputPaths: (NSArray *) inputPaths;
+- (NSString *) outputPathForInputPath: (NSString *) inputPath;
+
+- (void) printResultOfJob: (PPBatchConversionJob *) job;
+
+@end
+
+static void PrintUsage(void);
+static void PrintToFile(FILE *file, NSString *format, ...);
+
+@implementation PPBatchConverter
+
++ (int) runWithCommandLineArgumentCount: (int) argc values: (char **) argv
+{
+    NSAutoreleasePool *autoreleasePool;
+    NSMutableArray *arguments;
+    PPBatchConverter *converter;
+    int argIndex, exitStatus = kExitStatus_InvalidArguments;
+
+    autoreleasePool = [[NSAutoreleasePool alloc] init];
+
+    // the app's delayed setup selectors (normally performed when NSApplication finishes
+    // launching) set up globals that documents depend on; the linear working format must be
+    // set before any documents are loaded (same as -[PPApplication finishLaunching])
+
+    PPAppBootUtils_HandleAppDidFinishLoading();
+
+    [NSBitmapImageRep ppSetLinearBitmapsUseCompactFormat:
+                                            [PPUserDefaults linearBlendingUsesCompactFormat]];
+
+    arguments = [NSMutableArray array];
+
+    // skip argv[0] (executable path) & argv[1] (kPPBatchConverterCommandLineFlag)
+
+    for (argIndex=2; argIndex<argc; argIndex++)
+    {
+        NSString *argument = [NSString stringWithUTF8String: argv[argIndex]];
+
+        if (argument)
+        {
+            [arguments addObject: argument];
+        }
+    }
+
+    converter = [[[self alloc] initWithCommandLineArguments: arguments] autorelease];
+
+    if (converter)
+    {
+        exitStatus = [converter run];
+    }
+    else
+    {
+        PrintUsage();
+    }
+
+    [autoreleasePool release];
+
+    return exitStatus;
+}
+
+- (void) dealloc
+{
+    [_inputPaths release];
+    [_outputDirectory release];
+
+    [super dealloc];
+}
+
+#pragma mark Private methods
+
+- initWithCommandLineArguments: (NSArray *) arguments
+{
+    NSMutableArray *inputPaths;
+    NSEnumerator *argumentEnumerator;
+    NSString *argument, *value;
+
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    inputPaths = [NSMutableArray array];
+
+    if (!inputPaths)
+        goto ERROR;
+
+    _scalingFactor = 1;
+    _layerBlendingMode = -1;
+
+    argumentEnumerator = [arguments objectEnumerator];
+
+    while (argument = [argumentEnumerator nextObject])
+    {
+        if ([argument isEqualToString: kOption_Grid])
+        {
+            _shouldExportGrid = YES;
+        }
+        else if ([argument isEqualToString: kOption_Background])
+        {
+            _shouldExportBackground = YES;
+        }
+        else if ([argument isEqualToString: kOption_OutputDirectory]
+                || [argument isEqualToString: kOption_ScalingFactor]
+                || [argument isEqualToString: kOption_LayerBlendingMode])
+        {
+            value = [argumentEnumerator nextObject];
+
+            if (!value)
+                goto ERROR;
+
+            if ([argument isEqualToString: kOption_OutputDirectory])
+            {
+                [_outputDirectory release];
+                _outputDirectory = [[value stringByStandardizingPath] retain];
+            }
+            else if ([argument isEqualToString: kOption_ScalingFactor])
+            {
+                int scalingFactor = [value intValue];
+
+                if ((scalingFactor < 1) || (scalingFactor > kMaxScalingFactor))
+                {
+                    goto ERROR;
+                }
+
+                _scalingFactor = scalingFactor;
+            }
+            else if ([value isEqualToString: kLayerBlendingModeName_Standard])
+            {
+                _layerBlendingMode = kPPLayerBlendingMode_Standard;
+            }
+            else if ([value isEqualToString: kLayerBlendingModeName_Linear])
+            {
+                _layerBlendingMode = kPPLayerBlendingMode_Linear;
+            }
+            else
+            {
+                goto ERROR;
+            }
+        }
+        else if ([argument hasPrefix: @"-"])
+        {
+            goto ERROR;
+        }
+        else
+        {
+            [inputPaths addObject: [argument stringByStandardizingPath]];
+        }
+    }
+
+    if (![inputPaths count])
+        goto ERROR;
+
+    _inputPaths = [inputPaths retain];
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- (int) run
+{
+    NSArray *outputPaths;
+    NSMutableArray *jobs;
+    unsigned numFiles, numBatchFiles, batchStartIndex, numFailedFiles = 0;
+    NSTimeInterval startTime;
+    int exitStatus = kExitStatus_Success;
+
+    if (_outputDirectory
+        && ![[NSFileManager defaultManager] createDirectoryAtPath: _outputDirectory
+                                            withIntermediateDirectories: YES
+                                            attributes: nil
+                                            error: NULL])
+    {
+        PrintToFile(stderr, @"Unable to create output directory: %@\n", _outputDirectory);
+
+        return kExitStatus_ConversionFailed;
+    }
+
+    // all output paths are determined up front (before any files are written), so inputs that
+    // would export to the same file can be given distinct outputs
+
+    outputPaths = [self outputPathsForInputPaths: _inputPaths];
+
+    if (!outputPaths)
+        return kExitStatus_ConversionFailed;
+
+    startTime = [NSDate timeIntervalSinceReferenceDate];
+
+    numFiles = [_inputPaths count];
+    numBatchFiles = MAX([[NSProcessInfo processInfo] activeProcessorCount]
+                            * kNumBatchFilesPerProcessor,
+                        kMinNumBatchFiles);
+
+    for (batchStartIndex=0; batchStartIndex<numFiles; batchStartIndex+=numBatchFiles)
+    {
+        NSAutoreleasePool *autoreleasePool = [[NSAutoreleasePool alloc] init];
+        unsigned numJobs = MIN(numBatchFiles, numFiles - batchStartIndex), jobIndex;
+        unsigned scalingFactor = _scalingFactor;
+        PPBatchConversionJob *job;
+
+        jobs = [NSMutableArray array];
+
+        // load stage: serial, on the main thread
+
+        for (jobIndex=0; jobIndex<numJobs; jobIndex++)
+        {
+            unsigned fileIndex = batchStartIndex + jobIndex;
+
+            job = [[[PPBatchConversionJob alloc]
+                                initWithInputPath: [_inputPaths objectAtIndex: fileIndex]
+                                outputPath: [outputPaths objectAtIndex: fileIndex]]
+                        autorelease];
+
+            if (!job)
+                continue;
+
+            [job loadDocumentWithLayerBlendingMode: _layerBlendingMode
+                    shouldExportGrid: _shouldExportGrid
+                    shouldExportBackground: _shouldExportBackground];
+
+            [jobs addObject: job];
+        }
+
+        // export stage: parallel (the jobs array isn't modified while the blocks run)
+
+        dispatch_apply([jobs count],
+                        dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
+            ^(size_t index)
+            {
+                NSAutoreleasePool *jobAutoreleasePool = [[NSAutoreleasePool alloc] init];
+
+                [(PPBatchConversionJob *) [jobs objectAtIndex: index]
+                                                exportPNGWithScalingFactor: scalingFactor];
+
+                [jobAutoreleasePool release];
+            });
+
+        for (jobIndex=0; jobIndex<[jobs count]; jobIndex++)
+        {
+            job = [jobs objectAtIndex: jobIndex];
+
+            [self printResultOfJob: job];
+
+            if (![job didSucceed])
+            {
+                numFailedFiles++;
+            }
+        }
+
+        numFailedFiles += numJobs - [jobs count];
+
+        [autoreleasePool release];
+    }
+
+    PrintToFile(stdout, @"Converted %u of %u file(s) in %.1f ms\n",
+                numFiles - numFailedFiles, numFiles,
+                ([NSDate timeIntervalSinceReferenceDate] - startTime) * 1000.0);
+
+    if (numFailedFiles)
+    {
+        exitStatus = kExitStatus_ConversionFailed;
+    }
+
+    return exitStatus;
+}
+
+- (NSArray *) outputPathsForInputPaths: (NSArray *) inputPaths
+{
+    NSMutableArray *outputPaths;
+    NSMutableSet *usedOutputPathKeys;
+    NSEnumerator *inputPathEnumerator;
+    NSString *inputPath, *outputPath, *outputPathBase;
+    unsigned suffixNumber;
+
+    outputPaths = [NSMutableArray arrayWithCapacity: [inputPaths count]];
+    usedOutputPathKeys = [NSMutableSet set];
+
+    if (!outputPaths || !usedOutputPathKeys)
+        goto ERROR;
+
+    // inputs with the same basename (from different directories when using an output
+    // directory, or with different extensions) would overwrite each other's output (or, since
+    // the exports run in parallel, race to write it), so later ones get a numeric suffix; paths
+    // are compared case-insensitively, since the output volume may be case-insensitive
+
+    inputPathEnumerator = [inputPaths objectEnumerator];
+
+    while (inputPath = [inputPathEnumerator nextObject])
+    {
+        outputPath = [self outputPathForInputPath: inputPath];
+
+        if ([usedOutputPathKeys containsObject: [outputPath lowercaseString]])
+        {
+            outputPathBase = [outputPath stringByDeletingPathExtension];
+            suffixNumber = 2;
+
+            do
+            {
+                outputPath = [[NSString stringWithFormat: @"%@-%u", outputPathBase,
+                                                            suffixNumber++]
+                                    stringByAppendingPathExtension: kOutputFileExtension];
+            }
+            while ([usedOutputPathKeys containsObject: [outputPath lowercaseString]]);
+
+            PrintToFile(stderr, @"%@: output name's used by another input; writing to %@\n",
+                        inputPath, outputPath);
+        }
+
+        [usedOutputPathKeys addObject: [outputPath lowercaseString]];
+        [outputPaths addObject: outputPath];
+    }
+
+    return outputPaths;
+
+ERROR:
+    return nil;
+}
+
+- (NSString *) outputPathForInputPath: (NSString *) inputPath
+{
+    NSString *outputFilename =
+                [[[inputPath lastPathComponent] stringByDeletingPathExtension]
+                                        stringByAppendingPathExtension: kOutputFileExtension];
+
+    if (_outputDirectory)
+    {
+        return [_outputDirectory stringByAppendingPathComponent: outputFilename];
+    }
+
+    return [[inputPath stringByDeletingLastPathComponent]
+                                        stringByAppendingPathComponent: outputFilename];
+}
+
+- (void) printResultOfJob: (PPBatchConversionJob *) job
+{
+    if (![job didSucceed])
+    {
+        PrintToFile(stderr, @"%@: %@\n", job->_inputPath,
+                    (job->_errorDescription) ? job->_errorDescription : @"Conversion failed");
+
+        return;
+    }
+
+    PrintToFile(stdout, @"%@ -> %@ (%lu bytes): load %.1f ms, export %.1f ms\n",
+                job->_inputPath, job->_outputPath, job->_outputFileSize,
+                job->_loadTime * 1000.0, job->_exportTime * 1000.0);
+}
+
+@end
+
+@implementation PPBatchConversionJob
+
+- initWithInputPath: (NSString *) inputPath outputPath: (NSString *) outputPath
+{
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    if (!inputPath || !outputPath)
+        goto ERROR;
+
+    _inputPath = [inputPath retain];
+    _outputPath = [outputPath retain];
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- init
+{
+    return [self initWithInputPath: nil outputPath: nil];
+}
+
+- (void) dealloc
+{
+    [_inputPath release];
+    [_outputPath release];
+
+    [_mergedBitmap release];
+    [_gridPattern release];
+    [_backgroundPattern release];
+    [_backgroundImage release];
+
+    [_errorDescription release];
+
+    [super dealloc];
+}
+
+- (void) loadDocumentWithLayerBlendingMode: (int) layerBlendingMode
+            shouldExportGrid: (bool) shouldExportGrid
+            shouldExportBackground: (bool) shouldExportBackground
+{
+    NSAutoreleasePool *autoreleasePool;
+    NSTimeInterval startTime;
+    NSData *fileData;
+    NSError *error = nil;
+    PPDocument *document;
+
+    autoreleasePool = [[NSAutoreleasePool alloc] init];
+
+    startTime = [NSDate timeIntervalSinceReferenceDate];
+
+    fileData = [NSData dataWithContentsOfFile: _inputPath
+                        options: NSDataReadingMappedIfSafe
+                        error: &error];
+
+    if (!fileData)
+        goto ERROR;
+
+    document = [PPDocument ppDocumentFromNativeFileFormatData: fileData returnedError: &error];
+
+    if (!document)
+        goto ERROR;
+
+    if (layerBlendingMode >= 0)
+    {
+        [document setLayerBlendingMode: layerBlendingMode];
+    }
+
+    // the export stage runs on another thread, so it gets its own copies of the document's
+    // (mutable) export objects
+
+    _mergedBitmap = [[document mergedVisibleLayersBitmap] copy];
+
+    if (!_mergedBitmap)
+        goto ERROR;
+
+    if (shouldExportGrid)
+    {
+        _gridPattern = [[document gridPattern] retain];
+    }
+
+    if (shouldExportBackground)
+    {
+        _backgroundPattern = [[document backgroundPattern] retain];
+
+        if ([document shouldDisplayBackgroundImage])
+        {
+            _backgroundImage = [[document backgroundImage] copy];
+        }
+
+        _backgroundImageInterpolation = ([document shouldSmoothenBackgroundImage]) ?
+                                            NSImageInterpolationLow : NSImageInterpolationNone;
+    }
+
+    _loadTime = [NSDate timeIntervalSinceReferenceDate] - startTime;
+
+    [autoreleasePool release];
+
+    return;
+
+ERROR:
+    _errorDescription = [((error) ? [error localizedDescription] : @"Unable to load document")
+                            retain];
+
+    [autoreleasePool release];
+}
+
+- (void) exportPNGWithScalingFactor: (unsigned) scalingFactor
+{
+    NSTimeInterval startTime;
+    NSData *pngData;
+
+    if (!_mergedBitmap)
+        return;
+
+    startTime = [NSDate timeIntervalSinceReferenceDate];
+
+    pngData = [PPDocument exportPNGDataFromBitmap: _mergedBitmap
+                            scalingFactor: scalingFactor
+                            gridPattern: _gridPattern
+                            backgroundPattern: _backgroundPattern
+                            backgroundImage: _backgroundImage
+                            backgroundImageInterpolation: _backgroundImageInterpolation];
+
+    if (!pngData)
+    {
+        _errorDescription = [@"Unable to generate PNG data" retain];
+        goto ERROR;
+    }
+
+    if (![pngData writeToFile: _outputPath atomically: YES])
+    {
+        _errorDescription = [[NSString stringWithFormat: @"Unable to write file: %@",
+                                                            _outputPath]
+                                    retain];
+        goto ERROR;
+    }
+
+    _outputFileSize = [pngData length];
+    _exportTime = [NSDate timeIntervalSinceReferenceDate] - startTime;
+
+ERROR:
+    // the merged bitmap's no longer needed after exporting
+    [_mergedBitmap release];
+    _mergedBitmap = nil;
+}
+
+- (bool) didSucceed
+{
+    return (_errorDescription) ? NO : YES;
+}
+
+@end
+
+#pragma mark Private functions
+
+static void PrintUsage(void)
+{
+    PrintToFile(stderr,
+        @"Usage: %@ %s [%@ <outputDirectory>] [%@ <1-%d>] [%@ %@|%@] [%@] [%@] <file> ...\n",
+        [[NSProcessInfo processInfo] processName], kPPBatchConverterCommandLineFlag,
+        kOption_OutputDirectory, kOption_ScalingFactor, (int) kMaxScalingFactor,
+        kOption_LayerBlendingMode, kLayerBlendingModeName_Standard,
+        kLayerBlendingModeName_Linear, kOption_Grid, kOption_Background);
+}
+
+static void PrintToFile(FILE *file, NSString *format, ...)
+{
+    va_list arguments;
+    NSString *string;
+
+    va_start(arguments, format);
+
+    string = [[[NSString alloc] initWithFormat: format arguments: arguments] autorelease];
+
+    va_end(arguments);
+
+    fputs([string UTF8String], file);
+}
@@ -107,3 +107,31 @@ typedef enum
 
 #define macroLinearRGB16PixelComponent_Alpha(linearPixel)                   \
             macroLinearRGB16PixelComponent(linearPixel, kPPLinearRGB16PixelComponent_Alpha)
+
+
+// Linear Compact32 bitmap pixels
+#pragma mark Linear Compact32 bitmap pixels
+
+// Compact32 pixels store sRGB-encoded (nonlinear) 8-bit color components, unpremultiplied, &
+// an 8-bit alpha component; the color components are decoded to Linear16 values before blending
+// & re-encoded afterwards, so blending is still done in linear space, but with half the memory
+// footprint of LinearRGB16 pixels. Component order matches image bitmap pixels.
+
+typedef uint32_t PPLinearCompact32BitmapPixel;
+
+typedef uint8_t PPLinearCompact32PixelComponent;
+
+#define kMaxLinearCompact32PixelComponentValue      UINT8_MAX
+
+
+#define macroLinearCompact32PixelComponent_Red(linearPixel)                 \
+            macroImagePixelComponent_Red(linearPixel)
+
+#define macroLinearCompact32PixelComponent_Green(linearPixel)               \
+            macroImagePixelComponent_Green(linearPixel)
+
+#define macroLinearCompact32PixelComponent_Blue(linearPixel)                \
+            macroImagePixelComponent_Blue(linearPixel)
+
+#define macroLinearCompact32PixelComponent_Alpha(linearPixel)               \
+            macroImagePixelComponent_Alpha(linearPixel)
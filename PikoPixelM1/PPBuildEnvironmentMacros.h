@@ -111,6 +111,9 @@
 
 #   define PP_DEPLOYMENT_TARGET_SUPPORTS_RETINA_DISPLAY                     (true)//!defined(__ppc__)
 
+#   define PP_DEPLOYMENT_TARGET_SUPPORTS_MEMORY_PRESSURE_DISPATCH_SOURCE    \
+                                            (_PP_MAC_OS_X_DEPLOYMENT_TARGET_IS_AT_LEAST_10_(9))
+
 #elif defined(GNUSTEP) // !defined(__APPLE__)
 
 #   define PP_DEPLOYMENT_TARGET_DEPRECATED_CREATEDIRECTORYATPATHATTRIBUTES  (false)
@@ -133,4 +136,6 @@
 
 #   define PP_DEPLOYMENT_TARGET_SUPPORTS_RETINA_DISPLAY                     (false)
 
+#   define PP_DEPLOYMENT_TARGET_SUPPORTS_MEMORY_PRESSURE_DISPATCH_SOURCE    (false)
+
 #endif // defined(GNUSTEP)
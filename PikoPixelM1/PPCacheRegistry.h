@@ -0,0 +1,105 @@
+/*
+    PPCacheRegistry.h
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// PPCacheRegistry: Central registry of the app's rebuildable caches (documents' layer image
+// caches & thumbnail images, layers' linear blending bitmaps, canvas views' zoomed buffers).
+//
+// Each cache owner adds an entry (with the cache's rebuild cost) & notes the entry's use
+// whenever the cache is accessed. When caches grow, the registry checks (coalesced, after
+// the current event) whether the caches' total size exceeds the memory budget
+// (PPUserDefaults cacheMemoryBudgetInMegabytes), and if so, evicts caches - least-recently
+// used first, with more-costly caches kept longer - until the total's back under budget.
+// System memory-pressure warnings (OS X 10.9+) shrink the caches to half the budget;
+// critical memory pressure evicts everything evictable.
+//
+// Evicted caches are rebuilt lazily by their owners the next time they're needed.
+
+#import <Foundation/Foundation.h>
+
+
+typedef enum
+{
+    kPPCacheRebuildCost_Low,
+    kPPCacheRebuildCost_Medium,
+    kPPCacheRebuildCost_High
+
+} PPCacheRebuildCost;
+
+
+@class PPCacheRegistryEntry;
+
+@protocol PPCacheRegistryClient
+
+- (size_t) memorySizeOfCacheForCacheRegistryEntry: (PPCacheRegistryEntry *) entry;
+
+// returns NO if the cache can't be evicted at this time (e.g. it's currently on-screen)
+- (bool) evictCacheForCacheRegistryEntry: (PPCacheRegistryEntry *) entry;
+
+@end
+
+
+@interface PPCacheRegistryEntry : NSObject
+{
+    id <PPCacheRegistryClient> _client;    // not retained
+    PPCacheRebuildCost _rebuildCost;
+    uint64_t _lastUseCount;
+}
+
+- (id <PPCacheRegistryClient>) client;
+- (PPCacheRebuildCost) rebuildCost;
+
+// noteUse is called on every cache access, so it only updates a counter; noteGrowth also
+// schedules a budget check
+- (void) noteUse;
+- (void) noteGrowth;
+
+@end
+
+@interface PPCacheRegistry : NSObject
+{
+    NSMutableArray *_entries;
+
+    size_t _memoryBudget;
+
+    bool _isEvicting;
+    bool _budgetCheckIsPending;
+}
+
++ sharedRegistry;
+
+// entries are retained by the registry until they're removed; the client should retain its
+// entries as well, & remove them (removeEntry:) before it deallocates
+- (PPCacheRegistryEntry *) addEntryForClient: (id <PPCacheRegistryClient>) client
+                            rebuildCost: (PPCacheRebuildCost) rebuildCost;
+
+- (void) removeEntry: (PPCacheRegistryEntry *) entry;
+
+- (size_t) memoryBudget;
+- (size_t) totalCachesMemorySize;
+
+- (void) setNeedsBudgetCheck;
+
+- (void) evictCachesOverMemorySize: (size_t) maxMemorySize;
+
+@end
@@ -0,0 +1,426 @@
+/*
+    PPCacheRegistry.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPCacheRegistry.h"
+
+#import "PPUserDefaults.h"
+#import "NSObject_PPUtilities.h"
+
+
+#define kBytesPerMegabyte                       (1024 * 1024)
+
+// default budget (when the user default is zero) is a fraction of physical memory, clamped
+#define kDefaultMemoryBudgetPhysicalMemoryDivisor   8
+#define kMinDefaultMemoryBudget                 ((size_t) 128 * kBytesPerMegabyte)
+#define kMaxDefaultMemoryBudget                 ((size_t) 2048 * kBytesPerMegabyte)
+
+// a cache's eviction priority is its age (uses of other caches since its last use) divided
+// by its rebuild-cost weight, so a costly cache is kept longer than a cheap one of equal age
+#define kRebuildCostWeight_Low                  1
+#define kRebuildCostWeight_Medium               4
+#define kRebuildCostWeight_High                 16
+
+
+static uint64_t gCacheUseCount = 0;
+
+#if PP_DEPLOYMENT_TARGET_SUPPORTS_MEMORY_PRESSURE_DISPATCH_SOURCE
+
+static dispatch_source_t gMemoryPressureDispatchSource = NULL;
+
+#endif  // PP_DEPLOYMENT_TARGET_SUPPORTS_MEMORY_PRESSURE_DISPATCH_SOURCE
+
+
+static size_t DefaultMemoryBudget(void);
+static double EvictionPriorityOfEntry(PPCacheRegistryEntry *entry);
+static NSInteger CompareEntriesByEvictionPriority(id entry1, id entry2, void *context);
+
+
+@interface PPCacheRegistryEntry (PrivateMethods)
+
+- initWithClient: (id <PPCacheRegistryClient>) client
+    rebuildCost: (PPCacheRebuildCost) rebuildCost;
+
+- (uint64_t) lastUseCount;
+
+@end
+
+@interface PPCacheRegistry (PrivateMethods)
+
+- (void) performBudgetCheck;
+
+- (void) setupMemoryPressureDispatchSource;
+- (void) handleMemoryPressureWithFlags: (unsigned long) memoryPressureFlags;
+
+@end
+
+@implementation PPCacheRegistry
+
++ sharedRegistry
+{
+    static PPCacheRegistry *sharedRegistry = nil;
+
+    if (!sharedRegistry)
+    {
+        sharedRegistry = [[self alloc] init];
+    }
+
+    return sharedRegistry;
+}
+
+- init
+{
+    int budgetInMegabytes;
+
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    _entries = [[NSMutableArray array] retain];
+
+    if (!_entries)
+        goto ERROR;
+
+    budgetInMegabytes = [PPUserDefaults cacheMemoryBudgetInMegabytes];
+
+    _memoryBudget = (budgetInMegabytes > 0) ?
+                        (size_t) budgetInMegabytes * kBytesPerMegabyte : DefaultMemoryBudget();
+
+    [self setupMemoryPressureDispatchSource];
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- (void) dealloc
+{
+    [_entries release];
+
+    [super dealloc];
+}
+
+- (PPCacheRegistryEntry *) addEntryForClient: (id <PPCacheRegistryClient>) client
+                            rebuildCost: (PPCacheRebuildCost) rebuildCost
+{
+    PPCacheRegistryEntry *entry;
+
+    if (!client)
+        goto ERROR;
+
+    entry = [[[PPCacheRegistryEntry alloc] initWithClient: client rebuildCost: rebuildCost]
+                                            autorelease];
+
+    if (!entry)
+        goto ERROR;
+
+    [_entries addObject: entry];
+
+    return entry;
+
+ERROR:
+    return nil;
+}
+
+- (void) removeEntry: (PPCacheRegistryEntry *) entry
+{
+    if (!entry)
+        return;
+
+    [_entries removeObjectIdenticalTo: entry];
+}
+
+- (size_t) memoryBudget
+{
+    return _memoryBudget;
+}
+
+- (size_t) totalCachesMemorySize
+{
+    NSEnumerator *enumerator;
+    PPCacheRegistryEntry *entry;
+    size_t totalSize = 0;
+
+    enumerator = [_entries objectEnumerator];
+
+    while (entry = [enumerator nextObject])
+    {
+        totalSize += [[entry client] memorySizeOfCacheForCacheRegistryEntry: entry];
+    }
+
+    return totalSize;
+}
+
+- (void) setNeedsBudgetCheck
+{
+    if (_budgetCheckIsPending || _isEvicting)
+    {
+        return;
+    }
+
+    _budgetCheckIsPending = YES;
+
+    [self ppPerformSelectorFromNewStackFrame: @selector(performBudgetCheck)];
+}
+
+- (void) evictCachesOverMemorySize: (size_t) maxMemorySize
+{
+    size_t totalSize, entrySize, remainingEntrySize;
+    NSArray *entriesInEvictionOrder;
+    NSEnumerator *enumerator;
+    PPCacheRegistryEntry *entry;
+    id <PPCacheRegistryClient> client;
+
+    if (_isEvicting)
+        return;
+
+    totalSize = [self totalCachesMemorySize];
+
+    if (totalSize <= maxMemorySize)
+    {
+        return;
+    }
+
+    _isEvicting = YES;
+
+    // sorted copy retains the entries, so clients can remove entries during eviction
+
+    entriesInEvictionOrder =
+        [_entries sortedArrayUsingFunction: CompareEntriesByEvictionPriority context: NULL];
+
+    enumerator = [entriesInEvictionOrder objectEnumerator];
+
+    while ((totalSize > maxMemorySize) && (entry = [enumerator nextObject]))
+    {
+        client = [entry client];
+
+        entrySize = [client memorySizeOfCacheForCacheRegistryEntry: entry];
+
+        if (!entrySize || ![client evictCacheForCacheRegistryEntry: entry])
+        {
+            continue;
+        }
+
+        // some caches keep part of their contents when evicted (e.g. the most-recently used
+        // linear blending bitmap)
+
+        remainingEntrySize = [client memorySizeOfCacheForCacheRegistryEntry: entry];
+
+        if (remainingEntrySize < entrySize)
+        {
+            totalSize -= entrySize - remainingEntrySize;
+        }
+    }
+
+    _isEvicting = NO;
+}
+
+#pragma mark Private methods
+
+- (void) performBudgetCheck
+{
+    _budgetCheckIsPending = NO;
+
+    [self evictCachesOverMemorySize: _memoryBudget];
+}
+
+- (void) setupMemoryPressureDispatchSource
+{
+#if PP_DEPLOYMENT_TARGET_SUPPORTS_MEMORY_PRESSURE_DISPATCH_SOURCE
+
+    if (gMemoryPressureDispatchSource)
+        return;
+
+    gMemoryPressureDispatchSource =
+        dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+                                DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+                                dispatch_get_main_queue());
+
+    if (!gMemoryPressureDispatchSource)
+        return;
+
+    // the shared registry is never deallocated, so the handler block can reference self
+
+    dispatch_source_set_event_handler(gMemoryPressureDispatchSource,
+        ^{
+            [self handleMemoryPressureWithFlags:
+                                    dispatch_source_get_data(gMemoryPressureDispatchSource)];
+        });
+
+    dispatch_resume(gMemoryPressureDispatchSource);
+
+#endif  // PP_DEPLOYMENT_TARGET_SUPPORTS_MEMORY_PRESSURE_DISPATCH_SOURCE
+}
+
+- (void) handleMemoryPressureWithFlags: (unsigned long) memoryPressureFlags
+{
+#if PP_DEPLOYMENT_TARGET_SUPPORTS_MEMORY_PRESSURE_DISPATCH_SOURCE
+
+    if (memoryPressureFlags & DISPATCH_MEMORYPRESSURE_CRITICAL)
+    {
+        [self evictCachesOverMemorySize: 0];
+    }
+    else if (memoryPressureFlags & DISPATCH_MEMORYPRESSURE_WARN)
+    {
+        [self evictCachesOverMemorySize: _memoryBudget / 2];
+    }
+
+#endif  // PP_DEPLOYMENT_TARGET_SUPPORTS_MEMORY_PRESSURE_DISPATCH_SOURCE
+}
+
+@end
+
+@implementation PPCacheRegistryEntry
+
+- initWithClient: (id <PPCacheRegistryClient>) client
+    rebuildCost: (PPCacheRebuildCost) rebuildCost
+{
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    if (!client)
+        goto ERROR;
+
+    _client = client;
+    _rebuildCost = rebuildCost;
+    _lastUseCount = ++gCacheUseCount;
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- init
+{
+    return [self initWithClient: nil rebuildCost: kPPCacheRebuildCost_Low];
+}
+
+- (id <PPCacheRegistryClient>) client
+{
+    return _client;
+}
+
+- (PPCacheRebuildCost) rebuildCost
+{
+    return _rebuildCost;
+}
+
+- (void) noteUse
+{
+    _lastUseCount = ++gCacheUseCount;
+}
+
+- (void) noteGrowth
+{
+    _lastUseCount = ++gCacheUseCount;
+
+    [[PPCacheRegistry sharedRegistry] setNeedsBudgetCheck];
+}
+
+#pragma mark Private methods
+
+- (uint64_t) lastUseCount
+{
+    return _lastUseCount;
+}
+
+@end
+
+#pragma mark Private functions
+
+static size_t DefaultMemoryBudget(void)
+{
+    unsigned long long physicalMemory;
+    size_t memoryBudget;
+
+    physicalMemory = [[NSProcessInfo processInfo] physicalMemory];
+
+    memoryBudget = (size_t) MIN(physicalMemory / kDefaultMemoryBudgetPhysicalMemoryDivisor,
+                                (unsigned long long) kMaxDefaultMemoryBudget);
+
+    if (memoryBudget < kMinDefaultMemoryBudget)
+    {
+        memoryBudget = kMinDefaultMemoryBudget;
+    }
+
+    return memoryBudget;
+}
+
+static double EvictionPriorityOfEntry(PPCacheRegistryEntry *entry)
+{
+    double rebuildCostWeight;
+
+    switch ([entry rebuildCost])
+    {
+        case kPPCacheRebuildCost_High:
+        {
+            rebuildCostWeight = kRebuildCostWeight_High;
+        }
+        break;
+
+        case kPPCacheRebuildCost_Medium:
+        {
+            rebuildCostWeight = kRebuildCostWeight_Medium;
+        }
+        break;
+
+        case kPPCacheRebuildCost_Low:
+        default:
+        {
+            rebuildCostWeight = kRebuildCostWeight_Low;
+        }
+        break;
+    }
+
+    return (double) (gCacheUseCount - [entry lastUseCount]) / rebuildCostWeight;
+}
+
+static NSInteger CompareEntriesByEvictionPriority(id entry1, id entry2, void *context)
+{
+    double priority1, priority2;
+
+    // descending order: highest priority is evicted first
+
+    priority1 = EvictionPriorityOfEntry(entry1);
+    priority2 = EvictionPriorityOfEntry(entry2);
+
+    if (priority1 > priority2)
+    {
+        return NSOrderedAscending;
+    }
+    else if (priority1 < priority2)
+    {
+        return NSOrderedDescending;
+    }
+
+    return NSOrderedSame;
+}
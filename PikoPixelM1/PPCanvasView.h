@@ -28,7 +28,7 @@
 #import "PPBitmapPixelTypes.h"
 
 
-@class PPGridPattern;
+@class PPGridPattern, PPCacheRegistryEntry;
 
 @interface PPCanvasView : NSView
 {
@@ -57,6 +57,8 @@
     NSBitmapImageRep *_zoomedVisibleBackgroundBitmap;
     NSImage *_zoomedVisibleBackgroundImage;
 
+    PPCacheRegistryEntry *_zoomedBuffersCacheRegistryEntry;
+
     NSImage *_backgroundImage;
     NSColor *_backgroundColor;
 
@@ -131,6 +133,8 @@
 
     int _zoomedImagesDrawMode;
 
+    bool _zoomedVisibleImagesWereEvicted;
+
     bool _shouldDisplayDocumentLayers;
     bool _shouldDisplayGrid;
     bool _shouldDisplayGridGuidelines;
@@ -219,6 +223,11 @@
 
 - (void) enableSkippingOfMouseDraggedEvents: (bool) allowSkippingOfMouseDraggedEvents;
 
+// zoomedBuffersMemorySize returns the bytes used by the view's own bitmaps (zoomed canvas &
+// background, retina display buffer, selection-tool overlay masks); the canvas bitmap belongs
+// to the document, so it's not included
+- (size_t) zoomedBuffersMemorySize;
+
 @end
 
 @interface PPCanvasView (SelectionOutline)
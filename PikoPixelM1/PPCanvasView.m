@@ -39,6 +39,9 @@
 #import "NSWindow_PPUtilities.h"
 #import "NSEvent_PPUtilities.h"
 #import "PPSRGBUtilities.h"
+#import "PPCacheRegistry.h"
+#import "PPTrace.h"
+#import "PPStartupTimeline.h"
 
 
 typedef enum
@@ -81,6 +84,9 @@ static bool gRuntimeRoundsOffSubpixelMouseCoordinates = NO,
 - (void) repositionVisibleImages;
 - (void) repositionVisibleBoundingRects;
 - (void) resizeVisibleImages;
+- (void) restoreEvictedVisibleImages;
+
+- (size_t) zoomedVisibleImagesMemorySize;
 
 - (void) setupGridGuidelinesPhaseForVisibleCanvas;
 
@@ -99,10 +105,18 @@ static bool gRuntimeRoundsOffSubpixelMouseCoordinates = NO,
 
 @end
 
+// zoomed visible images are evictable by the cache registry while the view's window isn't
+// on-screen; they're restored the next time the view draws (or repositions its images)
+
+@interface PPCanvasView (CacheRegistryClient) <PPCacheRegistryClient>
+@end
+
 @implementation PPCanvasView
 
 + (void) load
 {
+    macroStartupTimelineMethodScope();
+
     gRuntimeRoundsOffSubpixelMouseCoordinates =
         (PP_RUNTIME_CHECK__RUNTIME_ROUNDS_OFF_SUBPIXEL_MOUSE_COORDINATES) ? YES : NO;
 
@@ -112,6 +126,8 @@ static bool gRuntimeRoundsOffSubpixelMouseCoordinates = NO,
 
 + (void) initialize
 {
+    macroStartupTimelineMethodScope();
+
     if ([self class] != [PPCanvasView class])
     {
         return;
@@ -144,6 +160,14 @@ static bool gRuntimeRoundsOffSubpixelMouseCoordinates = NO,
         goto ERROR;
     }
 
+    _zoomedBuffersCacheRegistryEntry =
+                [[[PPCacheRegistry sharedRegistry] addEntryForClient: self
+                                                    rebuildCost: kPPCacheRebuildCost_High]
+                        retain];
+
+    if (!_zoomedBuffersCacheRegistryEntry)
+        goto ERROR;
+
     [self setZoomFactor: kMinCanvasZoomFactor];
 
     _shouldDisplayDocumentLayers = YES;
@@ -156,6 +180,9 @@ ERROR:
 
 - (void) dealloc
 {
+    [[PPCacheRegistry sharedRegistry] removeEntry: _zoomedBuffersCacheRegistryEntry];
+    [_zoomedBuffersCacheRegistryEntry release];
+
     [self removeAsObserverForNSWindowNotifications];
     [self removeAsObserverForNotificationsFromNSClipView: nil];
 
@@ -609,6 +636,13 @@ ERROR:
     _allowSkippingOfMouseDraggedEvents = (allowSkippingOfMouseDraggedEvents) ? YES : NO;
 }
 
+- (size_t) zoomedBuffersMemorySize
+{
+    return [self zoomedVisibleImagesMemorySize]
+            + [_selectionToolOverlayWorkingMask ppMemorySize]
+            + [_selectionToolOverlayWorkingPathMask ppMemorySize];
+}
+
 #pragma mark NSView overrides
 
 - (void) viewDidMoveToWindow
@@ -649,6 +683,8 @@ ERROR:
 
 - (void) drawRect: (NSRect) rect
 {
+    macroTraceMethodScope();
+
     NSRect sourceRect;
 
     if (_zoomedImagesDrawMode == kPPZoomedImagesDrawMode_DisallowDrawing)
@@ -663,6 +699,13 @@ ERROR:
         return;
     }
 
+    if (_zoomedVisibleImagesWereEvicted)
+    {
+        [self restoreEvictedVisibleImages];
+    }
+
+    [_zoomedBuffersCacheRegistryEntry noteUse];
+
 #if PP_DEPLOYMENT_TARGET_SUPPORTS_RETINA_DISPLAY
 
     if (_retinaDisplayBuffer)
@@ -931,6 +974,54 @@ ERROR:
     [self postNotification_UpdatedNormalizedVisibleBounds];
 }
 
+#pragma mark PPCacheRegistryClient protocol
+
+- (size_t) memorySizeOfCacheForCacheRegistryEntry: (PPCacheRegistryEntry *) entry
+{
+    return [self zoomedVisibleImagesMemorySize];
+}
+
+- (bool) evictCacheForCacheRegistryEntry: (PPCacheRegistryEntry *) entry
+{
+    NSWindow *window = [self window];
+
+    if (_zoomedVisibleImagesWereEvicted)
+    {
+        return YES;
+    }
+
+    if (window && [window isVisible] && ![window isMiniaturized])
+    {
+        return NO;
+    }
+
+    [_zoomedVisibleCanvasBitmap release];
+    _zoomedVisibleCanvasBitmap = nil;
+
+    [_zoomedVisibleCanvasImage release];
+    _zoomedVisibleCanvasImage = nil;
+
+    [_zoomedVisibleBackgroundBitmap release];
+    _zoomedVisibleBackgroundBitmap = nil;
+
+    [_zoomedVisibleBackgroundImage release];
+    _zoomedVisibleBackgroundImage = nil;
+
+#if PP_DEPLOYMENT_TARGET_SUPPORTS_RETINA_DISPLAY
+
+    [self destroyRetinaDrawingMembers];
+
+#endif  // PP_DEPLOYMENT_TARGET_SUPPORTS_RETINA_DISPLAY
+
+    _zoomedVisibleImagesSize = NSZeroSize;
+
+    _zoomedVisibleImagesWereEvicted = YES;
+
+    [self setNeedsDisplay: YES];
+
+    return YES;
+}
+
 #pragma mark Private methods
 
 - (NSClipView *) enclosingClipView
@@ -1185,6 +1276,8 @@ ERROR:
 
 - (void) resizeVisibleImages
 {
+    _zoomedVisibleImagesWereEvicted = NO;
+
     _zoomedVisibleImagesSize = _zoomedVisibleCanvasBounds.size;
 
     [_zoomedVisibleCanvasBitmap release];
@@ -1220,6 +1313,35 @@ ERROR:
     }
 
 #endif  // PP_DEPLOYMENT_TARGET_SUPPORTS_RETINA_DISPLAY
+
+    [_zoomedBuffersCacheRegistryEntry noteGrowth];
+}
+
+- (void) restoreEvictedVisibleImages
+{
+    [self resizeVisibleImages];
+
+    [self setupGridGuidelinesPhaseForVisibleCanvas];
+
+    [self updateVisibleBackground];
+
+    [self updateVisibleCanvasInRect: _visibleCanvasBounds];
+}
+
+- (size_t) zoomedVisibleImagesMemorySize
+{
+    size_t memorySize;
+
+    memorySize = [_zoomedVisibleCanvasBitmap ppMemorySize]
+                    + [_zoomedVisibleBackgroundBitmap ppMemorySize];
+
+#if PP_DEPLOYMENT_TARGET_SUPPORTS_RETINA_DISPLAY
+
+    memorySize += [_retinaDisplayBuffer ppMemorySize];
+
+#endif  // PP_DEPLOYMENT_TARGET_SUPPORTS_RETINA_DISPLAY
+
+    return memorySize;
 }
 
 - (void) setupGridGuidelinesPhaseForVisibleCanvas
@@ -1234,8 +1356,13 @@ ERROR:
 
 - (void) updateVisibleCanvasInRect: (NSRect) canvasUpdateRect
 {
+    macroTraceMethodScope();
+
     NSRect zoomedUpdateRect;
 
+    if (_zoomedVisibleImagesWereEvicted)
+        return;
+
     canvasUpdateRect = NSIntersectionRect(canvasUpdateRect, _visibleCanvasBounds);
 
     if (NSIsEmptyRect(canvasUpdateRect))
@@ -1289,6 +1416,8 @@ ERROR:
 
 - (void) recacheZoomedVisibleCanvasImageInBounds: (NSRect) bounds
 {
+    macroTraceMethodScope();
+
     [_zoomedVisibleCanvasImage recache];
 }
 
@@ -1296,6 +1425,9 @@ ERROR:
 {
     NSImageInterpolation imageInterpolation;
 
+    if (_zoomedVisibleImagesWereEvicted)
+        return;
+
     if (gShouldDrawDirectlyToZoomedVisibleBackgroundImage)
     {
         [_zoomedVisibleBackgroundImage lockFocus];
@@ -0,0 +1,100 @@
+/*
+    PPContentHash.h
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// PPContentHash: Fast (noncryptographic) 64-bit hashing of raw data, for detecting whether
+// contents changed (layer bitmaps, autosave checkpoint files). Data is mixed in 8-byte words
+// (MurmurHash3-style), so every input bit can affect every bit of the finalized hash.
+
+#ifndef _PPCONTENTHASH_H_
+#define _PPCONTENTHASH_H_
+
+#include <stdint.h>
+#include <string.h>
+
+
+#define kPPContentHashSeed                          0x9E3779B97F4A7C15ULL
+
+#define kPPContentHashWordMultiplier1               0x87C37B91114253D5ULL
+#define kPPContentHashWordMultiplier2               0x4CF5AD432745937FULL
+#define kPPContentHashFinalizeMultiplier1           0xFF51AFD7ED558CCDULL
+#define kPPContentHashFinalizeMultiplier2           0xC4CEB9FE1A85EC53ULL
+
+#define macroPPContentHash_Rotate(value, numBits)                                       \
+            (((value) << (numBits)) | ((value) >> (64 - (numBits))))
+
+
+static inline uint64_t PPContentHash_MixWord(uint64_t hash, uint64_t word)
+{
+    word *= kPPContentHashWordMultiplier1;
+    word = macroPPContentHash_Rotate(word, 31);
+    word *= kPPContentHashWordMultiplier2;
+
+    hash ^= word;
+    hash = macroPPContentHash_Rotate(hash, 27);
+
+    return hash * 5 + 0x52DCE729;
+}
+
+// PPContentHash_MixBytes() reads the bytes with memcpy(), so they don't need to be aligned;
+// a partial final word is zero-padded (callers hashing variable-length data should also mix
+// in its length)
+
+static inline uint64_t PPContentHash_MixBytes(uint64_t hash, const unsigned char *bytes,
+                                                size_t numBytes)
+{
+    size_t numWords = numBytes / sizeof(uint64_t);
+    uint64_t word;
+
+    while (numWords--)
+    {
+        memcpy(&word, bytes, sizeof(uint64_t));
+        hash = PPContentHash_MixWord(hash, word);
+
+        bytes += sizeof(uint64_t);
+    }
+
+    numBytes %= sizeof(uint64_t);
+
+    if (numBytes)
+    {
+        word = 0;
+        memcpy(&word, bytes, numBytes);
+        hash = PPContentHash_MixWord(hash, word);
+    }
+
+    return hash;
+}
+
+static inline uint64_t PPContentHash_Finalize(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= kPPContentHashFinalizeMultiplier1;
+    hash ^= hash >> 33;
+    hash *= kPPContentHashFinalizeMultiplier2;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+#endif  // _PPCONTENTHASH_H_
@@ -26,6 +26,7 @@
 
 #import "NSObject_PPUtilities.h"
 #import "PPGeometry.h"
+#import "PPStartupTimeline.h"
 
 
 #define kDefaultCursor              [NSCursor arrowCursor]
@@ -49,6 +50,8 @@ static bool gRuntimeOverridesCursorWhenDraggingOverResizableWindowEdges = NO;
 
 + (void) load
 {
+    macroStartupTimelineMethodScope();
+
     gRuntimeOverridesCursorWhenDraggingOverResizableWindowEdges =
         (PP_RUNTIME_CHECK__RUNTIME_OVERRIDES_CURSOR_WHEN_DRAGGING_OVER_RESIZABLE_WINDOW_EDGES) ?
             YES : NO;
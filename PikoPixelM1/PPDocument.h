@@ -35,7 +35,8 @@
 
 
 @class PPDocumentLayer, PPTool, PPBackgroundPattern, PPGridPattern, PPDocumentSamplerImage,
-        PPExportPanelAccessoryViewController, PPDocumentWindowController;
+        PPExportPanelAccessoryViewController, PPDocumentWindowController, PPAutosaveJournal,
+        PPUndoDataMemoryCounter, PPCacheRegistryEntry, PPDocumentUpdateBus;
 
 @interface PPDocument : NSDocument <NSCoding>
 {
@@ -64,6 +65,7 @@
 
     NSBitmapImageRep *_drawingUndoBitmap;
     NSRect _drawingUndoBounds;
+    uint64_t _drawingLayerContentHashBeforeDrawing;
 
     NSBitmapImageRep *_selectionMask;
     NSRect _selectionBounds;
@@ -116,6 +118,18 @@
 
     PPDocumentSaveFormat _saveFormat;
 
+    PPAutosaveJournal *_autosaveJournal;
+
+    PPUndoDataMemoryCounter *_undoDataMemoryCounter;
+
+    PPCacheRegistryEntry *_layerImagesCacheRegistryEntry;
+    PPCacheRegistryEntry *_thumbnailImagesCacheRegistryEntry;
+    PPCacheRegistryEntry *_nondrawingLayerBitmapsCacheRegistryEntry;
+
+    PPDocumentUpdateBus *_updateBus;
+
+    NSImage *_savedFileIconImage;
+
     bool _hasSelection;
     bool _isDrawing;
     bool _shouldUndoCurrentDrawing;
@@ -127,10 +141,13 @@
     bool _mergedVisibleBitmapHasEnabledLayer;
     bool _disallowUpdatesToMergedBitmap;
     bool _disallowThumbnailImageUpdateNotifications;
+    bool _thumbnailImagesMayHaveCachedRepresentations;
     bool _disallowAutosaving;
     bool _shouldAutosaveWhenAllowed;
     bool _savePanelShouldAttachExportAccessoryView;
     bool _saveToOperationShouldUseExportSettings;
+    bool _asynchronousAutosaveIsCancellable;
+    volatile bool _shouldCancelAsynchronousAutosave;
     bool _sourceBitmapHasAnimationFrames;
 }
 
@@ -155,8 +172,33 @@
 - (NSBitmapImageRep *) dissolvedDrawingLayerBitmap;
 - (NSImage *) dissolvedDrawingLayerThumbnailImage;
 
+// frequent bitmap & thumbnail updates are delivered to observers through the update bus
+// rather than NSNotificationCenter (see PPDocumentUpdateBus.h)
+- (PPDocumentUpdateBus *) updateBus;
+
 - (NSBitmapImageRep *) mergedVisibleLayersBitmapUsingExportPanelSettings;
 
+// exportBitmapFromBitmap:... doesn't access any document state, so exported images can be
+// generated on a background thread from a copy of the merged bitmap
++ (NSBitmapImageRep *) exportBitmapFromBitmap: (NSBitmapImageRep *) bitmap
+                        scalingFactor: (unsigned) scalingFactor
+                        gridPattern: (PPGridPattern *) gridPattern
+                        backgroundPattern: (PPBackgroundPattern *) backgroundPattern
+                        backgroundImage: (NSImage *) backgroundImage
+                        backgroundImageInterpolation:
+                                        (NSImageInterpolation) backgroundImageInterpolation;
+
+// exportPNGDataFromBitmap:... generates the same image as exportBitmapFromBitmap:... as PNG
+// data, without creating the full-size export bitmap (the image is generated & encoded in
+// bands of rows)
++ (NSData *) exportPNGDataFromBitmap: (NSBitmapImageRep *) bitmap
+                scalingFactor: (unsigned) scalingFactor
+                gridPattern: (PPGridPattern *) gridPattern
+                backgroundPattern: (PPBackgroundPattern *) backgroundPattern
+                backgroundImage: (NSImage *) backgroundImage
+                backgroundImageInterpolation:
+                                        (NSImageInterpolation) backgroundImageInterpolation;
+
 - (PPDocumentWindowController *) ppDocumentWindowController;
 
 - (void) setupCompressedBackgroundImageData;
@@ -172,6 +214,11 @@
 
 - (void) exportImage;
 
+// unblockUserInteractionAfterSaveSnapshot is called by the writing methods once the
+// document's state needed for saving has been copied, so the remaining (slow) encoding can
+// run on the background thread while the user continues editing
+- (void) unblockUserInteractionAfterSaveSnapshot;
+
 @end
 
 @interface PPDocument (LayerOperationTarget)
@@ -228,6 +275,18 @@
 
 - (void) setEnabledFlagForAllLayers: (bool) isEnabled;
 
+// compactNondrawingLayersStorage reduces idle layers to their tile-encoded (palette-indexed)
+// storage; their bitmaps are decoded again when next needed. The drawing layer's never
+// compacted, & nothing's compacted while drawing or moving (returns NO). It's called after
+// the document's been in the background for a while (scheduleNondrawingLayers...; becoming
+// active again cancels it) & by the cache registry under memory pressure.
+- (bool) compactNondrawingLayersStorage;
+
+- (void) scheduleNondrawingLayersStorageCompaction;
+- (void) cancelNondrawingLayersStorageCompaction;
+
+- (size_t) nondrawingLayerBitmapsMemorySize;
+
 - (PPLayerBlendingMode) layerBlendingMode;
 - (void) setLayerBlendingMode: (PPLayerBlendingMode) layerBlendingMode;
 - (void) toggleLayerBlendingMode;
@@ -472,6 +531,37 @@
 
 @end
 
+@interface PPDocument (MemoryReport)
+
+// memoryReport returns the bytes used by the document's bitmaps & caches, as NSNumbers keyed
+// by the PPDocumentMemoryReportKey_ strings (memoryReportKeys returns them in display order);
+// the sizes are of pixel buffers & data objects only (object overhead isn't counted), objects
+// referenced from several places are counted once, & mapped file data isn't in the total
++ (NSArray *) memoryReportKeys;
+
+- (NSDictionary *) memoryReport;
+
+- (size_t) layerImageCachesMemorySize;
+
+// undo data (NSData objects passed to undo invocations) isn't visible through the undo
+// manager, so undo registrations with large data objects report them to the document, which
+// counts their size until they're deallocated
+- (void) trackMemoryForUndoData: (NSData *) undoData;
+
+@end
+
+@interface PPDocument (CacheRegistry)
+
+// the document's under/overlayers image caches, its thumbnail images' cached representations,
+// & its nondrawing layers' decoded bitmaps (which can be compacted to their tile-encoded data)
+// are registered with the shared cache registry (PPCacheRegistry), which evicts them when the
+// app's caches are over budget or the system is low on memory; evicted caches are rebuilt the
+// next time they're used
+- (bool) setupCacheRegistryEntries;
+- (void) removeCacheRegistryEntries;
+
+@end
+
 @interface PPDocument (NotificationOverrides)
 
 // for better performance, operations that perform multiple quick updates to the document
@@ -485,10 +575,20 @@
 
 @end
 
-extern NSString *PPDocumentNotification_UpdatedMergedVisibleArea;
-extern NSString *PPDocumentNotification_UpdatedDrawingLayerArea;
-extern NSString *PPDocumentNotification_UpdatedMergedVisibleThumbnailImage;
-extern NSString *PPDocumentNotification_UpdatedDrawingLayerThumbnailImage;
+extern NSString *PPDocumentMemoryReportKey_LayerBitmaps;
+extern NSString *PPDocumentMemoryReportKey_LayerTileEncodedData;
+extern NSString *PPDocumentMemoryReportKey_MappedLayerTileEncodedData;
+extern NSString *PPDocumentMemoryReportKey_LinearBlendingBitmaps;
+extern NSString *PPDocumentMemoryReportKey_MergedVisibleLayersBitmaps;
+extern NSString *PPDocumentMemoryReportKey_LayerImageCaches;
+extern NSString *PPDocumentMemoryReportKey_DrawingBitmaps;
+extern NSString *PPDocumentMemoryReportKey_InteractiveMoveBitmaps;
+extern NSString *PPDocumentMemoryReportKey_SamplerImages;
+extern NSString *PPDocumentMemoryReportKey_BackgroundImage;
+extern NSString *PPDocumentMemoryReportKey_UndoData;
+extern NSString *PPDocumentMemoryReportKey_CanvasViewBuffers;
+extern NSString *PPDocumentMemoryReportKey_Total;
+
 extern NSString *PPDocumentNotification_UpdatedSelection;
 extern NSString *PPDocumentNotification_SwitchedDrawingLayer;
 extern NSString *PPDocumentNotification_ReorderedLayers;
@@ -505,6 +605,5 @@ extern NSString *PPDocumentNotification_ReloadedDocument;
 extern NSString *PPDocumentNotification_UpdatedSamplerImages;
 extern NSString *PPDocumentNotification_SwitchedActiveSamplerImage;
 
-extern NSString *PPDocumentNotification_UserInfoKey_UpdateAreaRect;
 extern NSString *PPDocumentNotification_UserInfoKey_IndexOfChangedLayer;
 extern NSString *PPDocumentNotification_UserInfoKey_SamplerImagePanelType;
@@ -35,6 +35,9 @@
 #import "PPDocumentWindowController.h"
 #import "PPGeometry.h"
 #import "NSColor_PPUtilities.h"
+#import "PPAutosaveJournal.h"
+#import "PPPNGEncoder.h"
+#import "PPDocumentUpdateBus.h"
 
 
 #define kDocumentCodingVersion_Current                  kDocumentCodingVersion_1
@@ -73,6 +76,10 @@
 #define kDefaultBackgroundImageVisibility               YES
 #define kDefaultBackgroundImageSmoothing                NO
 
+// streaming PNG export: minimum height of each band of the export image that's generated &
+// encoded at once (bands always contain whole scaled source rows)
+#define kMinExportBandHeight                            64
+
 
 @interface PPDocument (PrivateMethods)
 
@@ -115,6 +122,14 @@
 
     [self setupSamplerImageIndexes];
 
+    _updateBus = [[PPDocumentUpdateBus alloc] initWithPPDocument: self];
+
+    if (!_updateBus)
+        goto ERROR;
+
+    if (![self setupCacheRegistryEntries])
+        goto ERROR;
+
     [[self undoManager] removeAllActions];
 
     return self;
@@ -132,6 +147,13 @@ ERROR:
         [self finishInteractiveMove];
     }
 
+    // remove the cache registry entries first, so the registry can't evict caches during
+    // deallocation
+    [self removeCacheRegistryEntries];
+
+    [_updateBus invalidate];
+    [_updateBus release];
+
     [self removeAllLayers]; // also removes all objects in _cached(Over|Under)layersImageObjects
 
     [_layers release];
@@ -171,6 +193,12 @@ ERROR:
 
     [_exportPanelViewController release];
 
+    [_autosaveJournal release];
+
+    [_undoDataMemoryCounter release];
+
+    [_savedFileIconImage release];
+
     [super dealloc];
 }
 
@@ -381,12 +409,17 @@ ERROR:
     return _dissolvedDrawingLayerThumbnailImage;
 }
 
+- (PPDocumentUpdateBus *) updateBus
+{
+    return _updateBus;
+}
+
 - (NSBitmapImageRep *) mergedVisibleLayersBitmapUsingExportPanelSettings
 {
     unsigned scalingFactor;
     PPGridPattern *gridPattern = nil;
     PPBackgroundPattern *backgroundPattern = nil;
-    bool shouldDrawGrid, shouldDrawBackgroundPattern, shouldDrawBackgroundImage;
+    bool shouldDrawBackgroundImage;
     NSBitmapImageRep *exportBitmap;
 
     if (![_exportPanelViewController getScalingFactor: &scalingFactor
@@ -397,19 +430,52 @@ ERROR:
         goto ERROR;
     }
 
+    exportBitmap =
+        [PPDocument exportBitmapFromBitmap: _mergedVisibleLayersBitmap
+                        scalingFactor: scalingFactor
+                        gridPattern: gridPattern
+                        backgroundPattern: backgroundPattern
+                        backgroundImage: (shouldDrawBackgroundImage) ? _backgroundImage : nil
+                        backgroundImageInterpolation: (_shouldSmoothenBackgroundImage) ?
+                                            NSImageInterpolationLow : NSImageInterpolationNone];
+
+    if (!exportBitmap)
+        goto ERROR;
+
+    return exportBitmap;
+
+ERROR:
+    return _mergedVisibleLayersBitmap;
+}
+
++ (NSBitmapImageRep *) exportBitmapFromBitmap: (NSBitmapImageRep *) bitmap
+                        scalingFactor: (unsigned) scalingFactor
+                        gridPattern: (PPGridPattern *) gridPattern
+                        backgroundPattern: (PPBackgroundPattern *) backgroundPattern
+                        backgroundImage: (NSImage *) backgroundImage
+                        backgroundImageInterpolation:
+                                        (NSImageInterpolation) backgroundImageInterpolation
+{
+    bool shouldDrawGrid;
+    NSBitmapImageRep *exportBitmap;
+
+    if (!bitmap || !scalingFactor)
+    {
+        goto ERROR;
+    }
+
     shouldDrawGrid = (gridPattern != nil) ? YES : NO;
-    shouldDrawBackgroundPattern = (backgroundPattern != nil) ? YES : NO;
 
     if ((scalingFactor == 1) && (!shouldDrawGrid))
     {
-        exportBitmap = _mergedVisibleLayersBitmap;
+        exportBitmap = bitmap;
     }
     else
     {
-        exportBitmap = [_mergedVisibleLayersBitmap ppImageBitmapScaledByFactor: scalingFactor
-                                                    shouldDrawGrid: shouldDrawGrid
-                                                    gridType: [gridPattern pixelGridType]
-                                                    gridColor: [gridPattern pixelGridColor]];
+        exportBitmap = [bitmap ppImageBitmapScaledByFactor: scalingFactor
+                                shouldDrawGrid: shouldDrawGrid
+                                gridType: [gridPattern pixelGridType]
+                                gridColor: [gridPattern pixelGridColor]];
 
         if (!exportBitmap)
             goto ERROR;
@@ -425,19 +491,13 @@ ERROR:
         }
     }
 
-    if (shouldDrawBackgroundPattern || (shouldDrawBackgroundImage && _backgroundImage))
+    if (backgroundPattern || backgroundImage)
     {
-        NSColor *backgroundColor =
-                    (shouldDrawBackgroundPattern) ? [backgroundPattern patternFillColor] : nil;
-        NSImage *backgroundImage = (shouldDrawBackgroundImage) ? _backgroundImage : nil;
-        NSImageInterpolation backgroundImageInterpolation =
-                                    (_shouldSmoothenBackgroundImage) ?
-                                            NSImageInterpolationLow : NSImageInterpolationNone;
-
         exportBitmap =
-                [exportBitmap ppImageBitmapCompositedWithBackgroundColor: backgroundColor
-                                andBackgroundImage: backgroundImage
-                                backgroundImageInterpolation: backgroundImageInterpolation];
+            [exportBitmap ppImageBitmapCompositedWithBackgroundColor:
+                                                        [backgroundPattern patternFillColor]
+                            andBackgroundImage: backgroundImage
+                            backgroundImageInterpolation: backgroundImageInterpolation];
 
         if (!exportBitmap)
             goto ERROR;
@@ -446,7 +506,220 @@ ERROR:
     return exportBitmap;
 
 ERROR:
-    return _mergedVisibleLayersBitmap;
+    return nil;
+}
+
++ (NSData *) exportPNGDataFromBitmap: (NSBitmapImageRep *) bitmap
+                scalingFactor: (unsigned) scalingFactor
+                gridPattern: (PPGridPattern *) gridPattern
+                backgroundPattern: (PPBackgroundPattern *) backgroundPattern
+                backgroundImage: (NSImage *) backgroundImage
+                backgroundImageInterpolation:
+                                        (NSImageInterpolation) backgroundImageInterpolation
+{
+    NSSize sourceSize, exportSize, bandSize;
+    unsigned numSourceRowsPerBand, sourceRow, numBandSourceRows, numBandRows, bandTopRow;
+    bool shouldDrawGrid, shouldDrawGuidelines, shouldDrawBackground;
+    PPGridType gridType = kPPGridType_Lines;
+    PPImageBitmapPixel gridPixelValue = 0, guidelinePixelValue = 0;
+    NSColor *backgroundColor;
+    NSRect bandFrame, bandContentBounds, sourceRect, backgroundImageFrame = NSZeroRect,
+            backgroundImageBounds = NSZeroRect;
+    NSPoint exportOriginInBand;
+    NSBitmapImageRep *bandBitmap, *compositedBandBitmap = nil, *encodedBandBitmap;
+    NSImage *bandImage;
+    PPPNGEncoder *pngEncoder;
+
+    if (![bitmap ppIsImageBitmap] || !scalingFactor)
+    {
+        goto ERROR;
+    }
+
+    sourceSize = [bitmap ppSizeInPixels];
+    exportSize = NSMakeSize(sourceSize.width * scalingFactor,
+                            sourceSize.height * scalingFactor);
+
+    shouldDrawGrid = (gridPattern != nil) ? YES : NO;
+    shouldDrawGuidelines = (shouldDrawGrid && [gridPattern shouldDisplayGuidelines]) ? YES : NO;
+
+    backgroundColor = [backgroundPattern patternFillColor];
+    shouldDrawBackground = (backgroundColor || backgroundImage) ? YES : NO;
+
+    pngEncoder = [[[PPPNGEncoder alloc] initWithImageSize: exportSize] autorelease];
+
+    if (!pngEncoder)
+        goto ERROR;
+
+    if ((scalingFactor == 1) && !shouldDrawGrid && !shouldDrawBackground)
+    {
+        if (![pngEncoder encodeRowsOfImageBitmap: bitmap
+                            fromRow: 0
+                            numRows: sourceSize.height])
+        {
+            goto ERROR;
+        }
+
+        return [pngEncoder finishEncoding];
+    }
+
+    // The export image is generated & encoded in horizontal bands (top to bottom) of whole
+    // scaled source rows, so only a band's worth of the export image is ever in memory (rather
+    // than the full export bitmap, plus a full composited copy if there's a background).
+    // Each band is drawn the same way as the full image by exportBitmapFromBitmap:..., using
+    // the band's offset within the export image to phase the guidelines & background.
+
+    numSourceRowsPerBand = (kMinExportBandHeight + scalingFactor - 1) / scalingFactor;
+    numSourceRowsPerBand = MIN(numSourceRowsPerBand, sourceSize.height);
+
+    bandSize = NSMakeSize(exportSize.width, numSourceRowsPerBand * scalingFactor);
+    bandFrame = PPGeometry_OriginRectOfSize(bandSize);
+
+    bandBitmap = [NSBitmapImageRep ppImageBitmapOfSize: bandSize];
+
+    if (!bandBitmap)
+        goto ERROR;
+
+    if (shouldDrawGrid)
+    {
+        gridType = [gridPattern pixelGridType];
+        gridPixelValue = [[gridPattern pixelGridColor] ppImageBitmapPixelValue];
+        guidelinePixelValue = [[gridPattern guidelineColor] ppImageBitmapPixelValue];
+    }
+
+    if (shouldDrawBackground)
+    {
+        compositedBandBitmap = [NSBitmapImageRep ppImageBitmapOfSize: bandSize];
+
+        if (!compositedBandBitmap)
+            goto ERROR;
+
+        if (backgroundImage)
+        {
+            backgroundImageFrame = PPGeometry_OriginRectOfSize([backgroundImage size]);
+
+            backgroundImageBounds =
+                PPGeometry_ScaledBoundsForFrameOfSizeToFitFrameOfSize(
+                                                                backgroundImageFrame.size,
+                                                                exportSize);
+        }
+    }
+
+    sourceRow = 0;
+
+    while (sourceRow < sourceSize.height)
+    {
+        NSAutoreleasePool *autoreleasePool = [[NSAutoreleasePool alloc] init];
+
+        numBandSourceRows = MIN(numSourceRowsPerBand, sourceSize.height - sourceRow);
+        numBandRows = numBandSourceRows * scalingFactor;
+        bandTopRow = sourceRow * scalingFactor;
+
+        // source rect uses bottom-left origin; band content is drawn at the top of the band
+        // bitmap (the last band may be shorter than the others)
+
+        sourceRect = NSMakeRect(0, sourceSize.height - sourceRow - numBandSourceRows,
+                                sourceSize.width, numBandSourceRows);
+
+        bandContentBounds = NSMakeRect(0, bandSize.height - numBandRows,
+                                        bandSize.width, numBandRows);
+
+        if (shouldDrawGrid)
+        {
+            [bandBitmap ppScaledCopyFromImageBitmap: bitmap
+                            inRect: sourceRect
+                            toPoint: bandContentBounds.origin
+                            scalingFactor: scalingFactor
+                            gridType: gridType
+                            gridPixelValue: gridPixelValue];
+        }
+        else
+        {
+            [bandBitmap ppScaledCopyFromImageBitmap: bitmap
+                            inRect: sourceRect
+                            toPoint: bandContentBounds.origin
+                            scalingFactor: scalingFactor];
+        }
+
+        if (shouldDrawGuidelines)
+        {
+            [bandBitmap ppDrawImageGuidelinesInBounds: bandContentBounds
+                            topLeftPhase: NSMakePoint(0, bandTopRow)
+                            unscaledSpacingSize: [gridPattern guidelineSpacingSize]
+                            scalingFactor: scalingFactor
+                            guidelinePixelValue: guidelinePixelValue];
+        }
+
+        encodedBandBitmap = bandBitmap;
+
+        if (shouldDrawBackground)
+        {
+            bandImage = [NSImage ppImageWithBitmap: bandBitmap];
+
+            if (!bandImage)
+            {
+                [autoreleasePool release];
+                goto ERROR;
+            }
+
+            // export image's origin (bottom-left) in the band bitmap's coordinates
+            exportOriginInBand =
+                        NSMakePoint(0, -(exportSize.height - bandTopRow - bandSize.height));
+
+            [compositedBandBitmap ppClearBitmap];
+
+            [compositedBandBitmap ppSetAsCurrentGraphicsContext];
+
+            if (backgroundColor)
+            {
+                [[NSGraphicsContext currentContext] setPatternPhase: exportOriginInBand];
+
+                [backgroundColor set];
+                NSRectFill(bandFrame);
+            }
+
+            if (backgroundImage)
+            {
+                [[NSGraphicsContext currentContext]
+                                        setImageInterpolation: backgroundImageInterpolation];
+
+                [backgroundImage drawInRect: NSOffsetRect(backgroundImageBounds,
+                                                            exportOriginInBand.x,
+                                                            exportOriginInBand.y)
+                                    fromRect: backgroundImageFrame
+                                    operation: NSCompositeSourceOver
+                                    fraction: 1.0f];
+            }
+
+            [[NSGraphicsContext currentContext]
+                                        setImageInterpolation: NSImageInterpolationNone];
+
+            [bandImage drawInRect: bandFrame
+                        fromRect: bandFrame
+                        operation: NSCompositeSourceOver
+                        fraction: 1.0f];
+
+            [compositedBandBitmap ppRestoreGraphicsContext];
+
+            encodedBandBitmap = compositedBandBitmap;
+        }
+
+        if (![pngEncoder encodeRowsOfImageBitmap: encodedBandBitmap
+                            fromRow: 0
+                            numRows: numBandRows])
+        {
+            [autoreleasePool release];
+            goto ERROR;
+        }
+
+        [autoreleasePool release];
+
+        sourceRow += numBandSourceRows;
+    }
+
+    return [pngEncoder finishEncoding];
+
+ERROR:
+    return nil;
 }
 
 - (PPDocumentWindowController *) ppDocumentWindowController
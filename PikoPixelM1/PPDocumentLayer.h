@@ -33,14 +33,31 @@
     NSBitmapImageRep *_bitmap;
     NSImage *_image;
 
+    NSData *_tileEncodedBitmapData;
+
     NSSize _size;
 
     float _opacity;
     float _lastOpacity;
 
     NSBitmapImageRep *_linearBlendingBitmap;
+    unsigned char *_linearBlendingTileValidityFlags;
+    PPDocumentLayer *_moreRecentLinearCacheLayer;
+    PPDocumentLayer *_lessRecentLinearCacheLayer;
+
+    unsigned char *_contentTileFlags;
+    unsigned char *_staleContentTileFlags;
+    uint64_t *_contentTileHashes;
+    unsigned char *_staleContentTileHashFlags;
+    uint64_t _bitmapContentHash;
+    int _numContentTileColumns;
+    int _numContentTileRows;
 
     bool _isEnabled;
+    bool _contentTilesHaveStaleTiles;
+    bool _bitmapContentHashHasStaleTiles;
+    bool _bitmapIsShared;
+    bool _linearBlendingIsEnabled;
 }
 
 + layerWithSize: (NSSize) size
@@ -56,11 +73,66 @@
     opacity: (float) opacity
     isEnabled: (bool) isEnabled;
 
+// Layers initialized from tile-encoded data (native file format) decode their bitmap lazily,
+// the first time it's needed. tileEncodedBitmapData is cached until the next call to
+// handleUpdateToBitmapInRect:, so unchanged layers aren't re-encoded, & callers can check
+// whether a layer's changed by comparing the returned object's identity.
+- initWithSize: (NSSize) size
+    name: (NSString *) name
+    tileEncodedBitmapData: (NSData *) tileEncodedBitmapData
+    opacity: (float) opacity
+    isEnabled: (bool) isEnabled;
+
+- (NSData *) tileEncodedBitmapData;
+- (bool) hasCachedTileEncodedBitmapData;
+
+// adoptTileEncodedBitmapDataFromLayerCopy: keeps the encoded data of a copy of this layer
+// (encoded on a background thread while saving), if the layers' bitmaps are still identical;
+// should be called on the main thread
+- (void) adoptTileEncodedBitmapDataFromLayerCopy: (PPDocumentLayer *) layerCopy;
+
 - (NSBitmapImageRep *) bitmap;
 - (NSImage *) image;
 
 - (void) handleUpdateToBitmapInRect: (NSRect) updateRect;
 
+// Copies of a layer share its bitmap & image (copy-on-write) until either layer is written to.
+// unshareBitmap must be called before writing to a layer's bitmap: if the bitmap's shared, the
+// layer switches to a private copy (so previously-returned bitmap & image pointers become
+// stale) & the delegate is notified via layerReplacedSharedBitmap:
+- (bool) unshareBitmap;
+- (bool) bitmapIsShared;
+
+// compactBitmapStorage releases the layer's bitmap & image, keeping only its tile-encoded data
+// (typically a fraction of the bitmap's size) until the bitmap's next needed; previously-
+// returned bitmap & image pointers become stale
+- (bool) compactBitmapStorage;
+
+// memory-report sizes, in bytes, of the layer's objects that aren't already in countedObjects
+// (they're then added to it), so objects shared by copy-on-write copies are only counted once;
+// the bitmap's size is zero while it's compacted (or not yet decoded)
+- (size_t) bitmapMemorySizeIfUncountedInTable: (NSHashTable *) countedObjects;
+- (size_t) linearBlendingBitmapMemorySizeIfUncountedInTable: (NSHashTable *) countedObjects;
+
+// cachedTileEncodedBitmapData returns nil if the layer has no cached encoded data (unlike
+// tileEncodedBitmapData, it doesn't encode the bitmap)
+- (NSData *) cachedTileEncodedBitmapData;
+
+// bitmapContentHash is maintained per content tile: handleUpdateToBitmapInRect: only marks the
+// updated tiles' hashes as stale, & those tiles are rehashed the next time the hash is
+// requested, so checking whether an unchanged layer's changed is O(1), & a changed layer costs
+// only its updated tiles. Layers with equal hashes have equal bitmaps (barring a 64-bit
+// collision).
+- (uint64_t) bitmapContentHash;
+
+// Layers track which 64px tiles of their bitmap have content (nonclear pixels), so compositing
+// can skip the empty areas of sparse layers (the bitmap itself is still stored in full).
+// handleUpdateToBitmapInRect: only marks the updated tiles as stale, & stale tiles are
+// rescanned when they're next queried. contentBoundsInRect: returns the union of rect's
+// content tiles, clipped to rect.
+- (bool) hasContentInRect: (NSRect) rect;
+- (NSRect) contentBoundsInRect: (NSRect) rect;
+
 - (bool) isEnabled;
 - (void) setEnabled: (bool) enabled;
 
@@ -83,8 +155,18 @@
 
 - (PPDocumentLayer *) layerCroppedToBounds: (NSRect) croppingBounds;
 
+// Linear blending bitmaps are generated lazily: enabling only sets a flag, and the bitmap's
+// tiles are converted from the layer's bitmap the first time they're requested (& again after
+// they're drawn to). Linear bitmaps are kept in a size-limited, least-recently-used cache
+// shared by all layers, so they can be released & regenerated later.
 - (bool) enableLinearBlendingBitmap: (bool) enableLinearBlendingBitmap;
-- (NSBitmapImageRep *) linearBlendingBitmap;
+- (NSBitmapImageRep *) linearBlendingBitmapValidInBounds: (NSRect) bounds;
+
+// Linear blending passes (merges that collect several layers' linear bitmaps before blending
+// them) defer the cache's size-limit evictions until the outermost pass ends, so bitmaps
+// collected early in a pass aren't released or regenerated by the rest of the pass
++ (void) beginLinearBlendingPass;
++ (void) endLinearBlendingPass;
 
 - (id) delegate;
 - (void) setDelegate: (id) delegate;
@@ -103,4 +185,18 @@
             changedOpacityFromOldValue: (float) oldOpacity
             shouldRegisterUndo: (bool) shouldRegisterUndo;
 
+- (void) layerReplacedSharedBitmap: (PPDocumentLayer *) layer;
+
+@end
+
+// Keyed archiver/unarchiver delegates can implement these to store layers' bitmaps as separate
+// chunks of tile-encoded data (native file format v3), instead of as TIFF data in the archive.
+// ppIndexOfStoredBitmapChunkForLayer: returns the index the layer's chunk will be stored at
+// (the delegate may encode the chunk later, from a copy of the layer), or -1 if the chunk
+// won't be stored.
+@interface NSObject (PPDocumentLayerBitmapChunkCodingDelegateMethods)
+
+- (int) ppIndexOfStoredBitmapChunkForLayer: (PPDocumentLayer *) layer;
+- (NSData *) ppLayerBitmapChunkAtIndex: (int) chunkIndex;
+
 @end
@@ -28,24 +28,73 @@
 #import "NSBitmapImageRep_PPUtilities.h"
 #import "PPGeometry.h"
 #import "PPDefines.h"
+#import "PPCacheRegistry.h"
+#import "PPContentHash.h"
 
 
-#define kDrawingLayerCodingKey_Size         @"Size"
-#define kDrawingLayerCodingKey_Name         @"Name"
-#define kDrawingLayerCodingKey_TIFFData     @"TIFFData"
-#define kDrawingLayerCodingKey_Opacity      @"Opacity"
-#define kDrawingLayerCodingKey_IsEnabled    @"IsEnabled"
+#define kDrawingLayerCodingKey_Size                 @"Size"
+#define kDrawingLayerCodingKey_Name                 @"Name"
+#define kDrawingLayerCodingKey_TIFFData             @"TIFFData"
+#define kDrawingLayerCodingKey_Opacity              @"Opacity"
+#define kDrawingLayerCodingKey_IsEnabled            @"IsEnabled"
+#define kDrawingLayerCodingKey_BitmapChunkIndex     @"BitmapChunkIndex"
 
 #define kOpacityStepSize                    0.1f
 
+#define kContentTileDimension               64
+
+#define kMaxLinearBlendingCacheBytes        (256 * 1024 * 1024)
+
+
+static PPDocumentLayer *gMostRecentLinearCacheLayer = nil,
+                        *gLeastRecentLinearCacheLayer = nil;
+static size_t gLinearBlendingCacheBytes = 0;
+static PPCacheRegistryEntry *gLinearBlendingCacheRegistryEntry = nil;
+static int gLinearBlendingPassDepth = 0;
+
+
+static bool GetContentTileRangeForRect(NSRect rect, NSSize layerSize,
+                                        int *returnedFirstColumn, int *returnedLastColumn,
+                                        int *returnedFirstRow, int *returnedLastRow);
+static uint64_t ContentTileHashContribution(int tileIndex, uint64_t tileHash);
+
 
 @interface PPDocumentLayer (PrivateMethods)
 
+- initWithSharedBitmapFromLayer: (PPDocumentLayer *) layer;
+
+- (bool) decodeBitmapIfNeeded;
+
+- (bool) setupContentTilesAndMarkStale: (bool) shouldMarkContentTilesStale;
+- (void) copyContentTilesFromLayer: (PPDocumentLayer *) layer;
+- (void) invalidateContentTilesInRect: (NSRect) rect;
+- (void) updateStaleContentTilesInRect: (NSRect) rect;
+- (void) updateContentTilesFromTileEncodedData;
+
+- (void) invalidateContentTileHashesInRect: (NSRect) rect;
+- (void) updateStaleContentTileHashes;
+
+- (bool) setupLinearBlendingBitmap;
+- (void) destroyLinearBlendingBitmap;
+- (void) invalidateLinearBlendingTilesInRect: (NSRect) rect;
+- (void) validateLinearBlendingTilesInRect: (NSRect) rect;
+
+- (void) addToLinearBlendingCache;
+- (void) removeFromLinearBlendingCache;
+- (void) moveToFrontOfLinearBlendingCache;
+- (size_t) linearBlendingBitmapByteCount;
++ (void) evictLinearBlendingBitmapsOverByteCount: (size_t) maxByteCount;
+
++ (PPCacheRegistryEntry *) linearBlendingCacheRegistryEntry;
++ (size_t) memorySizeOfCacheForCacheRegistryEntry: (PPCacheRegistryEntry *) entry;
++ (bool) evictCacheForCacheRegistryEntry: (PPCacheRegistryEntry *) entry;
+
 - (void) setOpacity: (float) opacity andRegisterUndo: (bool) shouldRegisterUndo;
 
 - (void) notifyDelegateDidChangeNameFromOldValue: (NSString *) oldName;
 - (void) notifyDelegateDidChangeEnabledFlagFromOldValue: (bool) oldEnabledFlag;
 - (void) notifyDelegateDidChangeOpacityAndShouldRegisterUndo: (bool) shouldRegisterUndo;
+- (void) notifyDelegateDidReplaceSharedBitmap;
 
 @end
 
@@ -117,6 +166,84 @@
                                 [NSBitmapImageRep ppImageBitmapWithImportedData: tiffData]];
     }
 
+    if (![self setupContentTilesAndMarkStale: (tiffData) ? YES : NO])
+    {
+        goto ERROR;
+    }
+
+    if (opacity > 1.0f)
+    {
+        opacity = 1.0f;
+    }
+    else if (opacity < 0.0f)
+    {
+        opacity = 0.0f;
+    }
+
+    _opacity = _lastOpacity = opacity;
+    _isEnabled = (isEnabled) ? YES : NO;
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- initWithSize: (NSSize) size
+    name: (NSString *) name
+    tileEncodedBitmapData: (NSData *) tileEncodedBitmapData
+    opacity: (float) opacity
+    isEnabled: (bool) isEnabled
+{
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    if (![name length])
+    {
+        goto ERROR;
+    }
+
+    size = PPGeometry_SizeClippedToIntegerValues(size);
+
+    if ((size.width < kMinCanvasDimension)
+        || (size.width > kMaxCanvasDimension)
+        || (size.height < kMinCanvasDimension)
+        || (size.height > kMaxCanvasDimension))
+    {
+        goto ERROR;
+    }
+
+    // validate the data up front, so decoding it later can't fail on bad data
+
+    if (![NSBitmapImageRep ppTileEncodedData: tileEncodedBitmapData isValidForSize: size])
+    {
+        goto ERROR;
+    }
+
+    _size = size;
+
+    _name = [name copy];
+    _tileEncodedBitmapData = [tileEncodedBitmapData retain];
+
+    if (!_name || !_tileEncodedBitmapData)
+    {
+        goto ERROR;
+    }
+
+    if (![self setupContentTilesAndMarkStale: NO])
+    {
+        goto ERROR;
+    }
+
+    // the content tiles come from the encoded data's tile table, so the bitmap can stay
+    // undecoded until its pixels are needed
+
+    [self updateContentTilesFromTileEncodedData];
+
     if (opacity > 1.0f)
     {
         opacity = 1.0f;
@@ -147,19 +274,73 @@ ERROR:
     [_name release];
     [_bitmap release];
     [_image release];
+    [_tileEncodedBitmapData release];
+
+    [self destroyLinearBlendingBitmap];
+
+    if (_contentTileFlags)
+    {
+        free(_contentTileFlags);
+    }
+
+    if (_staleContentTileFlags)
+    {
+        free(_staleContentTileFlags);
+    }
 
-    [_linearBlendingBitmap release];
+    if (_contentTileHashes)
+    {
+        free(_contentTileHashes);
+    }
+
+    if (_staleContentTileHashFlags)
+    {
+        free(_staleContentTileHashFlags);
+    }
 
     [super dealloc];
 }
 
+- (NSData *) tileEncodedBitmapData
+{
+    if (!_tileEncodedBitmapData)
+    {
+        _tileEncodedBitmapData = [[_bitmap ppTileEncodedData] retain];
+    }
+
+    return [[_tileEncodedBitmapData retain] autorelease];
+}
+
+- (bool) hasCachedTileEncodedBitmapData
+{
+    return (_tileEncodedBitmapData) ? YES : NO;
+}
+
+- (void) adoptTileEncodedBitmapDataFromLayerCopy: (PPDocumentLayer *) layerCopy
+{
+    // the copy's encoded data is only valid for this layer if they still share the same
+    // bitmap (writing to either layer unshares it)
+
+    if (_tileEncodedBitmapData || !layerCopy || !layerCopy->_tileEncodedBitmapData
+        || !_bitmap || (_bitmap != layerCopy->_bitmap))
+    {
+        return;
+    }
+
+    _tileEncodedBitmapData = [layerCopy->_tileEncodedBitmapData retain];
+}
+
 - (NSBitmapImageRep *) bitmap
 {
+    [self decodeBitmapIfNeeded];
+
     return _bitmap;
 }
 
 - (NSImage *) image
 {
+    [self decodeBitmapIfNeeded];
+
     return _image;
 }
 
@@ -168,12 +349,212 @@ ERROR:
 
 - (void) handleUpdateToBitmapInRect: (NSRect) updateRect
 {
+    [self decodeBitmapIfNeeded];
+
+    if (_tileEncodedBitmapData)
+    {
+        [_tileEncodedBitmapData release];
+        _tileEncodedBitmapData = nil;
+    }
+
+    [self invalidateContentTilesInRect: updateRect];
+    [self invalidateContentTileHashesInRect: updateRect];
+
     [_image recache];
 
     if (_linearBlendingBitmap)
     {
-        [_linearBlendingBitmap ppLinearCopyFromImageBitmap: _bitmap inBounds: updateRect];
+        [self invalidateLinearBlendingTilesInRect: updateRect];
+    }
+}
+
+- (bool) unshareBitmap
+{
+    NSBitmapImageRep *unsharedBitmap;
+    NSImage *unsharedImage;
+
+    if (!_bitmapIsShared)
+    {
+        return YES;
+    }
+
+    unsharedBitmap = [_bitmap ppBitmapCroppedToBounds: PPGeometry_OriginRectOfSize(_size)];
+
+    if (!unsharedBitmap)
+        goto ERROR;
+
+    unsharedImage = [NSImage ppImageWithBitmap: unsharedBitmap];
+
+    if (!unsharedImage)
+        goto ERROR;
+
+    [_bitmap release];
+    _bitmap = [unsharedBitmap retain];
+
+    [_image release];
+    _image = [unsharedImage retain];
+
+    _bitmapIsShared = NO;
+
+    [self notifyDelegateDidReplaceSharedBitmap];
+
+    return YES;
+
+ERROR:
+    return NO;
+}
+
+- (bool) bitmapIsShared
+{
+    return _bitmapIsShared;
+}
+
+- (bool) compactBitmapStorage
+{
+    if (!_bitmap)
+    {
+        return YES;
+    }
+
+    // tile-encoded data stores pixel-art layers compactly (mostly as palette-indexed tiles);
+    // it's kept (or generated) in place of the bitmap, which is decoded again when next needed
+
+    if (![self tileEncodedBitmapData])
+    {
+        return NO;
+    }
+
+    [self destroyLinearBlendingBitmap];
+
+    // rescan any stale content tiles while the bitmap's still available; the content tiles
+    // then stay valid (the encoded data matches the bitmap they were scanned from), so
+    // hasContentInRect: & contentBoundsInRect: won't need to decode the bitmap
+
+    [self updateStaleContentTilesInRect: PPGeometry_OriginRectOfSize(_size)];
+
+    [_bitmap release];
+    _bitmap = nil;
+
+    [_image release];
+    _image = nil;
+
+    _bitmapIsShared = NO;
+
+    return YES;
+}
+
+- (size_t) bitmapMemorySizeIfUncountedInTable: (NSHashTable *) countedObjects
+{
+    return [_bitmap ppMemorySizeIfUncountedInTable: countedObjects];
+}
+
+- (size_t) linearBlendingBitmapMemorySizeIfUncountedInTable: (NSHashTable *) countedObjects
+{
+    size_t memorySize = [_linearBlendingBitmap ppMemorySizeIfUncountedInTable: countedObjects];
+
+    // the tile validity flags belong to this layer (they're not shared)
+
+    if (_linearBlendingTileValidityFlags)
+    {
+        memorySize += _numContentTileColumns * _numContentTileRows * sizeof(unsigned char);
+    }
+
+    return memorySize;
+}
+
+- (NSData *) cachedTileEncodedBitmapData
+{
+    return [[_tileEncodedBitmapData retain] autorelease];
+}
+
+- (uint64_t) bitmapContentHash
+{
+    if (_bitmapContentHashHasStaleTiles && [self decodeBitmapIfNeeded])
+    {
+        [self updateStaleContentTileHashes];
+    }
+
+    // mix in the size, so cleared layers of different sizes have different hashes
+
+    return PPContentHash_Finalize(PPContentHash_MixWord(_bitmapContentHash,
+                                                        ((uint64_t) _size.width << 32)
+                                                            | (uint64_t) _size.height));
+}
+
+- (bool) hasContentInRect: (NSRect) rect
+{
+    int firstColumn, lastColumn, firstRow, lastRow, column, row;
+    unsigned char *tileFlag;
+
+    if (!GetContentTileRangeForRect(rect, _size, &firstColumn, &lastColumn, &firstRow,
+                                    &lastRow))
+    {
+        return NO;
+    }
+
+    if (!_contentTileFlags)
+    {
+        return YES;
+    }
+
+    [self updateStaleContentTilesInRect: rect];
+
+    for (row=firstRow; row<=lastRow; row++)
+    {
+        tileFlag = &_contentTileFlags[row * _numContentTileColumns + firstColumn];
+
+        for (column=firstColumn; column<=lastColumn; column++)
+        {
+            if (*tileFlag++)
+            {
+                return YES;
+            }
+        }
+    }
+
+    return NO;
+}
+
+- (NSRect) contentBoundsInRect: (NSRect) rect
+{
+    NSRect contentBounds = NSZeroRect, tileRect;
+    int firstColumn, lastColumn, firstRow, lastRow, column, row;
+    unsigned char *tileFlag;
+
+    rect = NSIntersectionRect(PPGeometry_PixelBoundsCoveredByRect(rect),
+                                PPGeometry_OriginRectOfSize(_size));
+
+    if (!GetContentTileRangeForRect(rect, _size, &firstColumn, &lastColumn, &firstRow,
+                                    &lastRow))
+    {
+        return NSZeroRect;
+    }
+
+    if (!_contentTileFlags)
+    {
+        return rect;
+    }
+
+    [self updateStaleContentTilesInRect: rect];
+
+    tileRect.size = NSMakeSize(kContentTileDimension, kContentTileDimension);
+
+    for (row=firstRow; row<=lastRow; row++)
+    {
+        tileRect.origin.y = row * kContentTileDimension;
+        tileFlag = &_contentTileFlags[row * _numContentTileColumns + firstColumn];
+
+        for (column=firstColumn; column<=lastColumn; column++)
+        {
+            if (*tileFlag++)
+            {
+                tileRect.origin.x = column * kContentTileDimension;
+                contentBounds = NSUnionRect(contentBounds, tileRect);
+            }
+        }
     }
+
+    return NSIntersectionRect(contentBounds, rect);
 }
 
 - (bool) isEnabled
@@ -278,6 +659,11 @@ ERROR:
     NSData *resizedBitmapData;
     PPDocumentLayer *resizedLayer;
 
+    if (![self decodeBitmapIfNeeded])
+    {
+        goto ERROR;
+    }
+
     newSize = PPGeometry_SizeClippedToIntegerValues(newSize);
 
     resizedBitmap = [_bitmap ppBitmapResizedToSize: newSize shouldScale: shouldScale];
@@ -308,6 +694,11 @@ ERROR:
     NSData *croppedBitmapTIFFData;
     PPDocumentLayer *croppedLayer;
 
+    if (![self decodeBitmapIfNeeded])
+    {
+        goto ERROR;
+    }
+
     croppingBounds = NSIntersectionRect(PPGeometry_PixelBoundsCoveredByRect(croppingBounds),
                                         [_bitmap ppFrameInPixels]);
 
@@ -336,30 +727,60 @@ ERROR:
 
 - (bool) enableLinearBlendingBitmap: (bool) enableLinearBlendingBitmap
 {
-    if (enableLinearBlendingBitmap)
+    _linearBlendingIsEnabled = (enableLinearBlendingBitmap) ? YES : NO;
+
+    if (!_linearBlendingIsEnabled)
     {
-        if (!_linearBlendingBitmap)
-        {
-            _linearBlendingBitmap = [[_bitmap ppLinearRGB16BitmapFromImageBitmap] retain];
-        }
+        [self destroyLinearBlendingBitmap];
+    }
+
+    return YES;
+}
 
-        return (_linearBlendingBitmap) ? YES : NO;
+- (NSBitmapImageRep *) linearBlendingBitmapValidInBounds: (NSRect) bounds
+{
+    if (!_linearBlendingIsEnabled || ![self decodeBitmapIfNeeded])
+    {
+        return nil;
     }
-    else    // (!enableLinearBlendingBitmap)
+
+    if (!_linearBlendingBitmap)
     {
-        if (_linearBlendingBitmap)
+        if (![self setupLinearBlendingBitmap])
         {
-            [_linearBlendingBitmap release];
-            _linearBlendingBitmap = nil;
+            return nil;
         }
-
-        return YES;
     }
+    else
+    {
+        [self moveToFrontOfLinearBlendingCache];
+    }
+
+    [self validateLinearBlendingTilesInRect: bounds];
+
+    // the cache may release the bitmap while the caller's still using it (memory-pressure
+    // evictions aren't deferred by linear blending passes)
+    return [[_linearBlendingBitmap retain] autorelease];
+}
+
++ (void) beginLinearBlendingPass
+{
+    gLinearBlendingPassDepth++;
 }
 
-- (NSBitmapImageRep *) linearBlendingBitmap
++ (void) endLinearBlendingPass
 {
-    return _linearBlendingBitmap;
+    if (gLinearBlendingPassDepth <= 0)
+    {
+        return;
+    }
+
+    gLinearBlendingPassDepth--;
+
+    if (!gLinearBlendingPassDepth)
+    {
+        [self evictLinearBlendingBitmapsOverByteCount: kMaxLinearBlendingCacheBytes];
+    }
 }
 
 - (id) delegate
@@ -376,6 +797,32 @@ ERROR:
 
 - (id) initWithCoder: (NSCoder *) aDecoder
 {
+    if ([aDecoder containsValueForKey: kDrawingLayerCodingKey_BitmapChunkIndex])
+    {
+        id decoderDelegate = nil;
+        NSData *chunkData = nil;
+
+        if ([aDecoder respondsToSelector: @selector(delegate)])
+        {
+            decoderDelegate = [(NSKeyedUnarchiver *) aDecoder delegate];
+        }
+
+        if ([decoderDelegate respondsToSelector: @selector(ppLayerBitmapChunkAtIndex:)])
+        {
+            int chunkIndex =
+                        [aDecoder decodeIntForKey: kDrawingLayerCodingKey_BitmapChunkIndex];
+
+            chunkData = [decoderDelegate ppLayerBitmapChunkAtIndex: chunkIndex];
+        }
+
+        return [self initWithSize: [aDecoder decodeSizeForKey: kDrawingLayerCodingKey_Size]
+                        name: [aDecoder decodeObjectForKey: kDrawingLayerCodingKey_Name]
+                        tileEncodedBitmapData: chunkData
+                        opacity: [aDecoder decodeFloatForKey: kDrawingLayerCodingKey_Opacity]
+                        isEnabled:
+                                [aDecoder decodeBoolForKey: kDrawingLayerCodingKey_IsEnabled]];
+    }
+
     return [self initWithSize: [aDecoder decodeSizeForKey: kDrawingLayerCodingKey_Size]
                     name: [aDecoder decodeObjectForKey: kDrawingLayerCodingKey_Name]
                     tiffData: [aDecoder decodeObjectForKey: kDrawingLayerCodingKey_TIFFData]
@@ -385,11 +832,33 @@ ERROR:
 
 - (void) encodeWithCoder: (NSCoder *) coder
 {
+    id coderDelegate = nil;
+    int bitmapChunkIndex = -1;
+
     [coder encodeSize: _size forKey: kDrawingLayerCodingKey_Size];
     [coder encodeObject: _name forKey: kDrawingLayerCodingKey_Name];
 
-    [coder encodeObject: [_bitmap ppCompressedTIFFData]
-            forKey: kDrawingLayerCodingKey_TIFFData];
+    if ([coder respondsToSelector: @selector(delegate)])
+    {
+        coderDelegate = [(NSKeyedArchiver *) coder delegate];
+    }
+
+    if ([coderDelegate respondsToSelector: @selector(ppIndexOfStoredBitmapChunkForLayer:)])
+    {
+        bitmapChunkIndex = [coderDelegate ppIndexOfStoredBitmapChunkForLayer: self];
+    }
+
+    if (bitmapChunkIndex >= 0)
+    {
+        [coder encodeInt: bitmapChunkIndex forKey: kDrawingLayerCodingKey_BitmapChunkIndex];
+    }
+    else
+    {
+        [self decodeBitmapIfNeeded];
+
+        [coder encodeObject: [_bitmap ppCompressedTIFFData]
+                forKey: kDrawingLayerCodingKey_TIFFData];
+    }
 
     [coder encodeFloat: _opacity forKey: kDrawingLayerCodingKey_Opacity];
     [coder encodeBool: _isEnabled forKey: kDrawingLayerCodingKey_IsEnabled];
@@ -402,6 +871,27 @@ ERROR:
     PPDocumentLayer *layerCopy;
     bool needToCopyLayerBitmapData = YES;
 
+    if (!zone || (zone == NSDefaultMallocZone()))
+    {
+        // copy-on-write: the copy shares this layer's bitmap until one of them calls
+        // unshareBitmap, so copying (duplicating layers, multilayer undo snapshots,
+        // document-from-selection, etc.) doesn't allocate or copy any pixel data
+
+        layerCopy = [[[self class] allocWithZone: zone] initWithSharedBitmapFromLayer: self];
+
+        if (!layerCopy)
+            goto ERROR;
+
+        layerCopy->_delegate = _delegate;
+
+        return layerCopy;
+    }
+
+    if (![self decodeBitmapIfNeeded])
+    {
+        goto ERROR;
+    }
+
     layerCopy = [[[self class] allocWithZone: zone] initWithSize: _size
                                                     name: _name
                                                     tiffData: nil
@@ -454,6 +944,8 @@ ERROR:
         [layerCopy handleUpdateToBitmapInRect: PPGeometry_OriginRectOfSize(_size)];
     }
 
+    [layerCopy copyContentTilesFromLayer: self];
+
     // Don't need to enable _linearBlendingBitmap in the copy - the linear bitmap will be
     // enabled automatically if the copy's added to a PPDocument that's in linear blending mode,
     // otherwise, the linear bitmap's currently unused in unattached layers.
@@ -466,6 +958,665 @@ ERROR:
 
 #pragma mark Private methods
 
+- initWithSharedBitmapFromLayer: (PPDocumentLayer *) layer
+{
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    if (!layer)
+        goto ERROR;
+
+    _size = layer->_size;
+
+    _name = [layer->_name copy];
+
+    if (!_name)
+        goto ERROR;
+
+    // share the layer's encoded data (if any) along with its bitmap; if the layer's bitmap
+    // isn't decoded yet, neither layer decodes until it's used
+
+    _tileEncodedBitmapData = [layer->_tileEncodedBitmapData retain];
+
+    if (layer->_bitmap)
+    {
+        _bitmap = [layer->_bitmap retain];
+        _image = [layer->_image retain];
+
+        if (!_bitmap || !_image)
+        {
+            goto ERROR;
+        }
+    }
+
+    _opacity = _lastOpacity = layer->_opacity;
+    _isEnabled = layer->_isEnabled;
+
+    if (![self setupContentTilesAndMarkStale: NO])
+    {
+        goto ERROR;
+    }
+
+    [self copyContentTilesFromLayer: layer];
+
+    if (_bitmap)
+    {
+        _bitmapIsShared = layer->_bitmapIsShared = YES;
+    }
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- (bool) decodeBitmapIfNeeded
+{
+    NSBitmapImageRep *bitmap;
+    NSImage *image;
+
+    if (_bitmap)
+    {
+        return YES;
+    }
+
+    bitmap = [NSBitmapImageRep ppImageBitmapOfSize: _size];
+
+    if (!bitmap)
+        goto ERROR;
+
+    if (![bitmap ppDecodeTileEncodedData: _tileEncodedBitmapData])
+    {
+        goto ERROR;
+    }
+
+    image = [NSImage ppImageWithBitmap: bitmap];
+
+    if (!image)
+        goto ERROR;
+
+    _bitmap = [bitmap retain];
+    _image = [image retain];
+
+    // keep the encoded data: it stays valid until the bitmap's updated
+
+    // when the height isn't a multiple of the tile size, content tiles flagged from the
+    // encoded data's tile table may not have content (encoded tiles straddle content tile
+    // rows), so the flagged tiles are marked stale, to be rescanned when they're next queried
+
+    if (_contentTileFlags && ((int) _size.height % kContentTileDimension))
+    {
+        int numContentTiles, tileIndex;
+
+        numContentTiles = _numContentTileColumns * _numContentTileRows;
+
+        for (tileIndex=0; tileIndex<numContentTiles; tileIndex++)
+        {
+            if (_contentTileFlags[tileIndex])
+            {
+                _staleContentTileFlags[tileIndex] = YES;
+                _contentTilesHaveStaleTiles = YES;
+            }
+        }
+    }
+
+    return YES;
+
+ERROR:
+    return NO;
+}
+
+- (bool) setupContentTilesAndMarkStale: (bool) shouldMarkContentTilesStale
+{
+    int numContentTiles, tileIndex;
+
+    _numContentTileColumns =
+                    (_size.width + kContentTileDimension - 1) / kContentTileDimension;
+
+    _numContentTileRows =
+                    (_size.height + kContentTileDimension - 1) / kContentTileDimension;
+
+    numContentTiles = _numContentTileColumns * _numContentTileRows;
+
+    _contentTileFlags = (unsigned char *) calloc(numContentTiles, sizeof(unsigned char));
+
+    _staleContentTileFlags = (unsigned char *) calloc(numContentTiles, sizeof(unsigned char));
+
+    _contentTileHashes = (uint64_t *) calloc(numContentTiles, sizeof(uint64_t));
+
+    _staleContentTileHashFlags =
+                        (unsigned char *) malloc(numContentTiles * sizeof(unsigned char));
+
+    if (!_contentTileFlags || !_staleContentTileFlags || !_contentTileHashes
+        || !_staleContentTileHashFlags)
+    {
+        goto ERROR;
+    }
+
+    // all tile hashes start out stale (zero), & are hashed the first time the layer's content
+    // hash is requested
+
+    memset(_staleContentTileHashFlags, YES, numContentTiles * sizeof(unsigned char));
+
+    _bitmapContentHash = 0;
+
+    for (tileIndex=0; tileIndex<numContentTiles; tileIndex++)
+    {
+        _bitmapContentHash += ContentTileHashContribution(tileIndex, 0);
+    }
+
+    _bitmapContentHashHasStaleTiles = YES;
+
+    if (shouldMarkContentTilesStale)
+    {
+        [self invalidateContentTilesInRect: PPGeometry_OriginRectOfSize(_size)];
+    }
+
+    return YES;
+
+ERROR:
+    return NO;
+}
+
+- (void) copyContentTilesFromLayer: (PPDocumentLayer *) layer
+{
+    if (!_contentTileFlags || !layer || !layer->_contentTileFlags
+        || !NSEqualSizes(_size, layer->_size))
+    {
+        return;
+    }
+
+    memcpy(_contentTileFlags, layer->_contentTileFlags,
+            _numContentTileColumns * _numContentTileRows * sizeof(unsigned char));
+
+    if (_staleContentTileFlags && layer->_staleContentTileFlags)
+    {
+        memcpy(_staleContentTileFlags, layer->_staleContentTileFlags,
+                _numContentTileColumns * _numContentTileRows * sizeof(unsigned char));
+
+        _contentTilesHaveStaleTiles = layer->_contentTilesHaveStaleTiles;
+    }
+
+    if (_contentTileHashes && layer->_contentTileHashes
+        && _staleContentTileHashFlags && layer->_staleContentTileHashFlags)
+    {
+        memcpy(_contentTileHashes, layer->_contentTileHashes,
+                _numContentTileColumns * _numContentTileRows * sizeof(uint64_t));
+
+        memcpy(_staleContentTileHashFlags, layer->_staleContentTileHashFlags,
+                _numContentTileColumns * _numContentTileRows * sizeof(unsigned char));
+
+        _bitmapContentHash = layer->_bitmapContentHash;
+        _bitmapContentHashHasStaleTiles = layer->_bitmapContentHashHasStaleTiles;
+    }
+}
+
+- (void) invalidateContentTilesInRect: (NSRect) rect
+{
+    int firstColumn, lastColumn, firstRow, lastRow, row;
+
+    if (!_staleContentTileFlags)
+        return;
+
+    if (!GetContentTileRangeForRect(rect, _size, &firstColumn, &lastColumn, &firstRow,
+                                    &lastRow))
+    {
+        return;
+    }
+
+    for (row=firstRow; row<=lastRow; row++)
+    {
+        memset(&_staleContentTileFlags[row * _numContentTileColumns + firstColumn], YES,
+                (lastColumn - firstColumn + 1) * sizeof(unsigned char));
+    }
+
+    _contentTilesHaveStaleTiles = YES;
+}
+
+- (void) updateStaleContentTilesInRect: (NSRect) rect
+{
+    NSRect tileRect;
+    int firstColumn, lastColumn, firstRow, lastRow, column, row, tileIndex;
+    bool rectCoversAllTiles;
+
+    if (!_contentTilesHaveStaleTiles || !_contentTileFlags || !_staleContentTileFlags)
+    {
+        return;
+    }
+
+    // stale tiles only exist while the bitmap's decoded (they're marked by bitmap updates &
+    // decoding, & rescanned before compacting)
+
+    if (!_bitmap)
+        return;
+
+    if (!GetContentTileRangeForRect(rect, _size, &firstColumn, &lastColumn, &firstRow,
+                                    &lastRow))
+    {
+        return;
+    }
+
+    tileRect.size = NSMakeSize(kContentTileDimension, kContentTileDimension);
+
+    for (row=firstRow; row<=lastRow; row++)
+    {
+        tileRect.origin.y = row * kContentTileDimension;
+        tileIndex = row * _numContentTileColumns + firstColumn;
+
+        for (column=firstColumn; column<=lastColumn; column++)
+        {
+            if (_staleContentTileFlags[tileIndex])
+            {
+                tileRect.origin.x = column * kContentTileDimension;
+
+                _contentTileFlags[tileIndex] =
+                            ([_bitmap ppImageBitmapIsClearInBounds: tileRect]) ? NO : YES;
+
+                _staleContentTileFlags[tileIndex] = NO;
+            }
+
+            tileIndex++;
+        }
+    }
+
+    rectCoversAllTiles = ((firstColumn == 0) && (lastColumn == _numContentTileColumns - 1)
+                            && (firstRow == 0) && (lastRow == _numContentTileRows - 1))
+                                ? YES : NO;
+
+    if (rectCoversAllTiles)
+    {
+        _contentTilesHaveStaleTiles = NO;
+    }
+}
+
+// updateContentTilesFromTileEncodedData flags each content tile that overlaps a stored
+// (nonclear) encoded tile; encoded tiles are aligned to the bitmap's top edge while content
+// tiles are aligned to its bottom edge, so unless the height's a multiple of the tile size, a
+// few clear content tiles may be flagged - the flags are rescanned exactly once the bitmap's
+// decoded
+
+- (void) updateContentTilesFromTileEncodedData
+{
+    NSArray *storedTileBoundsArray;
+    NSEnumerator *boundsEnumerator;
+    NSValue *boundsValue;
+    int numContentTiles, firstColumn, lastColumn, firstRow, lastRow, row;
+
+    if (!_contentTileFlags || !_staleContentTileFlags || !_tileEncodedBitmapData)
+    {
+        return;
+    }
+
+    numContentTiles = _numContentTileColumns * _numContentTileRows;
+
+    memset(_staleContentTileFlags, NO, numContentTiles * sizeof(unsigned char));
+    _contentTilesHaveStaleTiles = NO;
+
+    storedTileBoundsArray =
+        [NSBitmapImageRep ppStoredTileBoundsInTileEncodedData: _tileEncodedBitmapData
+                            forSize: _size];
+
+    if (!storedTileBoundsArray)
+    {
+        // unreadable tile table: treat every tile as having content
+        memset(_contentTileFlags, YES, numContentTiles * sizeof(unsigned char));
+
+        return;
+    }
+
+    memset(_contentTileFlags, NO, numContentTiles * sizeof(unsigned char));
+
+    boundsEnumerator = [storedTileBoundsArray objectEnumerator];
+
+    while (boundsValue = [boundsEnumerator nextObject])
+    {
+        if (!GetContentTileRangeForRect([boundsValue rectValue], _size, &firstColumn,
+                                        &lastColumn, &firstRow, &lastRow))
+        {
+            continue;
+        }
+
+        for (row=firstRow; row<=lastRow; row++)
+        {
+            memset(&_contentTileFlags[row * _numContentTileColumns + firstColumn], YES,
+                    (lastColumn - firstColumn + 1) * sizeof(unsigned char));
+        }
+    }
+}
+
+- (void) invalidateContentTileHashesInRect: (NSRect) rect
+{
+    int firstColumn, lastColumn, firstRow, lastRow, row;
+
+    if (!_staleContentTileHashFlags)
+        return;
+
+    if (!GetContentTileRangeForRect(rect, _size, &firstColumn, &lastColumn, &firstRow,
+                                    &lastRow))
+    {
+        return;
+    }
+
+    for (row=firstRow; row<=lastRow; row++)
+    {
+        memset(&_staleContentTileHashFlags[row * _numContentTileColumns + firstColumn], YES,
+                (lastColumn - firstColumn + 1) * sizeof(unsigned char));
+    }
+
+    _bitmapContentHashHasStaleTiles = YES;
+}
+
+- (void) updateStaleContentTileHashes
+{
+    unsigned char *bitmapData, *tileRow;
+    int bytesPerRow, width, height, numContentTiles, tileIndex, tileX, tileY, tileWidth,
+        tileHeight, row;
+    uint64_t tileHash;
+
+    if (!_contentTileHashes || !_staleContentTileHashFlags)
+    {
+        return;
+    }
+
+    bitmapData = [_bitmap bitmapData];
+
+    if (!bitmapData)
+        return;
+
+    bytesPerRow = [_bitmap bytesPerRow];
+    width = _size.width;
+    height = _size.height;
+
+    numContentTiles = _numContentTileColumns * _numContentTileRows;
+
+    for (tileIndex=0; tileIndex<numContentTiles; tileIndex++)
+    {
+        if (!_staleContentTileHashFlags[tileIndex])
+        {
+            continue;
+        }
+
+        // content tile rows are bottom-up (like the tile rects), bitmap data rows are top-down
+
+        tileX = (tileIndex % _numContentTileColumns) * kContentTileDimension;
+        tileY = (tileIndex / _numContentTileColumns) * kContentTileDimension;
+
+        tileWidth = MIN(kContentTileDimension, width - tileX);
+        tileHeight = MIN(kContentTileDimension, height - tileY);
+
+        tileRow = &bitmapData[(height - (tileY + tileHeight)) * bytesPerRow
+                                + tileX * sizeof(PPImageBitmapPixel)];
+
+        tileHash = kPPContentHashSeed;
+
+        for (row=0; row<tileHeight; row++)
+        {
+            tileHash = PPContentHash_MixBytes(tileHash, tileRow,
+                                                tileWidth * sizeof(PPImageBitmapPixel));
+
+            tileRow += bytesPerRow;
+        }
+
+        _bitmapContentHash -=
+                ContentTileHashContribution(tileIndex, _contentTileHashes[tileIndex]);
+
+        _bitmapContentHash += ContentTileHashContribution(tileIndex, tileHash);
+
+        _contentTileHashes[tileIndex] = tileHash;
+        _staleContentTileHashFlags[tileIndex] = NO;
+    }
+
+    _bitmapContentHashHasStaleTiles = NO;
+}
+
+- (bool) setupLinearBlendingBitmap
+{
+    int numTiles, tileIndex;
+
+    [self destroyLinearBlendingBitmap];
+
+    numTiles = _numContentTileColumns * _numContentTileRows;
+
+    _linearBlendingTileValidityFlags =
+                        (unsigned char *) malloc(numTiles * sizeof(unsigned char));
+
+    if (!_linearBlendingTileValidityFlags)
+        goto ERROR;
+
+    _linearBlendingBitmap = [[NSBitmapImageRep ppLinearBitmapOfSize: _size] retain];
+
+    if (!_linearBlendingBitmap)
+        goto ERROR;
+
+    // new linear bitmaps are cleared (clear image pixels convert to clear linear pixels), so
+    // tiles without content are already valid (stale content tiles aren't rescanned here, just
+    // treated as invalid)
+
+    for (tileIndex=0; tileIndex<numTiles; tileIndex++)
+    {
+        _linearBlendingTileValidityFlags[tileIndex] =
+            (_contentTileFlags && !_contentTileFlags[tileIndex]
+                && !(_staleContentTileFlags && _staleContentTileFlags[tileIndex]))
+                    ? YES : NO;
+    }
+
+    [self addToLinearBlendingCache];
+
+    if (!gLinearBlendingPassDepth)
+    {
+        [PPDocumentLayer evictLinearBlendingBitmapsOverByteCount: kMaxLinearBlendingCacheBytes];
+    }
+
+    return YES;
+
+ERROR:
+    [self destroyLinearBlendingBitmap];
+
+    return NO;
+}
+
+- (void) destroyLinearBlendingBitmap
+{
+    if (_linearBlendingBitmap)
+    {
+        [self removeFromLinearBlendingCache];
+
+        [_linearBlendingBitmap release];
+        _linearBlendingBitmap = nil;
+    }
+
+    if (_linearBlendingTileValidityFlags)
+    {
+        free(_linearBlendingTileValidityFlags);
+        _linearBlendingTileValidityFlags = NULL;
+    }
+}
+
+- (void) invalidateLinearBlendingTilesInRect: (NSRect) rect
+{
+    int firstColumn, lastColumn, firstRow, lastRow, row;
+
+    if (!_linearBlendingTileValidityFlags)
+        return;
+
+    if (!GetContentTileRangeForRect(rect, _size, &firstColumn, &lastColumn, &firstRow,
+                                    &lastRow))
+    {
+        return;
+    }
+
+    for (row=firstRow; row<=lastRow; row++)
+    {
+        memset(&_linearBlendingTileValidityFlags[row * _numContentTileColumns + firstColumn],
+                NO, (lastColumn - firstColumn + 1) * sizeof(unsigned char));
+    }
+}
+
+- (void) validateLinearBlendingTilesInRect: (NSRect) rect
+{
+    NSRect layerFrame, tileRect;
+    int firstColumn, lastColumn, firstRow, lastRow, column, row;
+    unsigned char *tileValidityFlag;
+
+    if (!_linearBlendingBitmap || !_linearBlendingTileValidityFlags)
+    {
+        return;
+    }
+
+    if (!GetContentTileRangeForRect(rect, _size, &firstColumn, &lastColumn, &firstRow,
+                                    &lastRow))
+    {
+        return;
+    }
+
+    layerFrame = PPGeometry_OriginRectOfSize(_size);
+    tileRect.size = NSMakeSize(kContentTileDimension, kContentTileDimension);
+
+    for (row=firstRow; row<=lastRow; row++)
+    {
+        tileRect.origin.y = row * kContentTileDimension;
+        tileValidityFlag =
+                &_linearBlendingTileValidityFlags[row * _numContentTileColumns + firstColumn];
+
+        for (column=firstColumn; column<=lastColumn; column++)
+        {
+            if (!*tileValidityFlag)
+            {
+                tileRect.origin.x = column * kContentTileDimension;
+
+                [_linearBlendingBitmap ppLinearCopyFromImageBitmap: _bitmap
+                                        inBounds: NSIntersectionRect(tileRect, layerFrame)];
+
+                *tileValidityFlag = YES;
+            }
+
+            tileValidityFlag++;
+        }
+    }
+}
+
+// Linear blending cache: layers with linear bitmaps form a doubly-linked list (nonretaining)
+// ordered from most- to least-recently used; linear bitmaps are released from the end of the
+// list when the total size of all linear bitmaps exceeds kMaxLinearBlendingCacheBytes, or
+// when the cache registry evicts the linear blending cache (the PPDocumentLayer class is the
+// registry client for the whole list)
+
+- (void) addToLinearBlendingCache
+{
+    _lessRecentLinearCacheLayer = gMostRecentLinearCacheLayer;
+    _moreRecentLinearCacheLayer = nil;
+
+    if (gMostRecentLinearCacheLayer)
+    {
+        gMostRecentLinearCacheLayer->_moreRecentLinearCacheLayer = self;
+    }
+    else
+    {
+        gLeastRecentLinearCacheLayer = self;
+    }
+
+    gMostRecentLinearCacheLayer = self;
+
+    gLinearBlendingCacheBytes += [self linearBlendingBitmapByteCount];
+
+    [[PPDocumentLayer linearBlendingCacheRegistryEntry] noteGrowth];
+}
+
+- (void) removeFromLinearBlendingCache
+{
+    if (_moreRecentLinearCacheLayer)
+    {
+        _moreRecentLinearCacheLayer->_lessRecentLinearCacheLayer = _lessRecentLinearCacheLayer;
+    }
+    else if (gMostRecentLinearCacheLayer == self)
+    {
+        gMostRecentLinearCacheLayer = _lessRecentLinearCacheLayer;
+    }
+    else
+    {
+        return;
+    }
+
+    if (_lessRecentLinearCacheLayer)
+    {
+        _lessRecentLinearCacheLayer->_moreRecentLinearCacheLayer = _moreRecentLinearCacheLayer;
+    }
+    else
+    {
+        gLeastRecentLinearCacheLayer = _moreRecentLinearCacheLayer;
+    }
+
+    _moreRecentLinearCacheLayer = _lessRecentLinearCacheLayer = nil;
+
+    gLinearBlendingCacheBytes -= [self linearBlendingBitmapByteCount];
+}
+
+- (void) moveToFrontOfLinearBlendingCache
+{
+    [gLinearBlendingCacheRegistryEntry noteUse];
+
+    if (gMostRecentLinearCacheLayer == self)
+    {
+        return;
+    }
+
+    [self removeFromLinearBlendingCache];
+    [self addToLinearBlendingCache];
+}
+
+- (size_t) linearBlendingBitmapByteCount
+{
+    if (!_linearBlendingBitmap)
+    {
+        return 0;
+    }
+
+    return (size_t) [_linearBlendingBitmap bytesPerRow]
+                * (size_t) [_linearBlendingBitmap pixelsHigh];
+}
+
++ (void) evictLinearBlendingBitmapsOverByteCount: (size_t) maxByteCount
+{
+    // the most-recently used layer's bitmap is never evicted, since it's about to be used
+
+    while ((gLinearBlendingCacheBytes > maxByteCount)
+            && gLeastRecentLinearCacheLayer
+            && (gLeastRecentLinearCacheLayer != gMostRecentLinearCacheLayer))
+    {
+        [gLeastRecentLinearCacheLayer destroyLinearBlendingBitmap];
+    }
+}
+
++ (PPCacheRegistryEntry *) linearBlendingCacheRegistryEntry
+{
+    if (!gLinearBlendingCacheRegistryEntry)
+    {
+        gLinearBlendingCacheRegistryEntry =
+            [[[PPCacheRegistry sharedRegistry]
+                                addEntryForClient: (id) [PPDocumentLayer class]
+                                rebuildCost: kPPCacheRebuildCost_Medium]
+                        retain];
+    }
+
+    return gLinearBlendingCacheRegistryEntry;
+}
+
++ (size_t) memorySizeOfCacheForCacheRegistryEntry: (PPCacheRegistryEntry *) entry
+{
+    return gLinearBlendingCacheBytes;
+}
+
++ (bool) evictCacheForCacheRegistryEntry: (PPCacheRegistryEntry *) entry
+{
+    [self evictLinearBlendingBitmapsOverByteCount: 0];
+
+    return YES;
+}
+
 - (void) setOpacity: (float) opacity andRegisterUndo: (bool) shouldRegisterUndo
 {
     if (opacity > 1.0f)
@@ -521,4 +1672,42 @@ ERROR:
     }
 }
 
+- (void) notifyDelegateDidReplaceSharedBitmap
+{
+    if ([_delegate respondsToSelector: @selector(layerReplacedSharedBitmap:)])
+    {
+        [_delegate layerReplacedSharedBitmap: self];
+    }
+}
+
 @end
+
+#pragma mark Private functions
+
+static bool GetContentTileRangeForRect(NSRect rect, NSSize layerSize,
+                                        int *returnedFirstColumn, int *returnedLastColumn,
+                                        int *returnedFirstRow, int *returnedLastRow)
+{
+    rect = NSIntersectionRect(PPGeometry_PixelBoundsCoveredByRect(rect),
+                                PPGeometry_OriginRectOfSize(layerSize));
+
+    if (NSIsEmptyRect(rect))
+    {
+        return NO;
+    }
+
+    *returnedFirstColumn = rect.origin.x / kContentTileDimension;
+    *returnedLastColumn = (NSMaxX(rect) - 1) / kContentTileDimension;
+    *returnedFirstRow = rect.origin.y / kContentTileDimension;
+    *returnedLastRow = (NSMaxY(rect) - 1) / kContentTileDimension;
+
+    return YES;
+}
+
+// the layer's content hash is the sum of its tiles' contributions, so a rehashed tile's
+// contribution can be swapped out without touching the other tiles
+
+static uint64_t ContentTileHashContribution(int tileIndex, uint64_t tileHash)
+{
+    return PPContentHash_Finalize(PPContentHash_MixWord(tileHash, (uint64_t) tileIndex));
+}
@@ -0,0 +1,100 @@
+/*
+    PPDocumentUpdateBus.h
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// PPDocumentUpdateBus: Delivers a document's frequent bitmap & thumbnail updates (updated
+// merged-visible/drawing-layer areas, updated thumbnail images) directly to typed observer
+// methods, instead of through NSNotificationCenter.
+//
+// Immediate observers (the canvas) are called synchronously, as each update's posted.
+// Coalesced observers (preview, navigator, layer panels & thumbnails) have their updates
+// batched until the end of the current run-loop pass: update-area rects are merged (unioned)
+// in place, & each observer's then called once per update type, so slow observers don't run
+// on the drawing path & don't see every intermediate update.
+//
+// Observers aren't retained, & must remove themselves before they deallocate.
+
+#import <Cocoa/Cocoa.h>
+
+
+@class PPDocument;
+
+typedef enum
+{
+    kPPDocumentUpdateDeliveryMode_Immediate,
+    kPPDocumentUpdateDeliveryMode_Coalesced
+
+} PPDocumentUpdateDeliveryMode;
+
+
+@interface PPDocumentUpdateBus : NSObject
+{
+    PPDocument *_ppDocument;   // not retained
+
+    struct PPDocumentUpdateObserverEntry *_observerEntries;
+    int _numObserverEntries;
+    int _observerEntriesCapacity;
+
+    unsigned _pendingUpdateTypesMask;
+    NSRect _pendingMergedVisibleUpdateRect;
+    NSRect _pendingDrawingLayerUpdateRect;
+
+    int _deliveryDepth;
+
+    bool _deliveryOfCoalescedUpdatesIsScheduled;
+    bool _observerEntriesNeedCompaction;
+}
+
+- initWithPPDocument: (PPDocument *) ppDocument;
+
+// invalidate is called by the document before it deallocates: cancels undelivered coalesced
+// updates & removes all observers
+- (void) invalidate;
+
+// observers only receive the update types whose observer methods they implement (checked
+// when the observer's added)
+- (void) addUpdateObserver: (id) observer
+            deliveryMode: (PPDocumentUpdateDeliveryMode) deliveryMode;
+
+- (void) removeUpdateObserver: (id) observer;
+
+- (void) postUpdatedMergedVisibleAreaInRect: (NSRect) updateRect;
+- (void) postUpdatedDrawingLayerAreaInRect: (NSRect) updateRect;
+- (void) postUpdatedMergedVisibleThumbnailImage;
+- (void) postUpdatedDrawingLayerThumbnailImage;
+
+@end
+
+@interface NSObject (PPDocumentUpdateObserverMethods)
+
+- (void) ppDocument: (PPDocument *) ppDocument
+            updatedMergedVisibleAreaInRect: (NSRect) updateRect;
+
+- (void) ppDocument: (PPDocument *) ppDocument
+            updatedDrawingLayerAreaInRect: (NSRect) updateRect;
+
+- (void) ppDocumentUpdatedMergedVisibleThumbnailImage: (PPDocument *) ppDocument;
+
+- (void) ppDocumentUpdatedDrawingLayerThumbnailImage: (PPDocument *) ppDocument;
+
+@end
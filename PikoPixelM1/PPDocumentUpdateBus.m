@@ -0,0 +1,463 @@
+/*
+    PPDocumentUpdateBus.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPDocumentUpdateBus.h"
+
+
+#define kUpdateTypeMask_MergedVisibleArea               (1 << 0)
+#define kUpdateTypeMask_DrawingLayerArea                (1 << 1)
+#define kUpdateTypeMask_MergedVisibleThumbnailImage     (1 << 2)
+#define kUpdateTypeMask_DrawingLayerThumbnailImage      (1 << 3)
+
+#define kMinObserverEntriesCapacity                     8
+
+
+struct PPDocumentUpdateObserverEntry
+{
+    id observer;    // not retained; nil if the observer was removed during a delivery
+    unsigned updateTypesMask;
+    PPDocumentUpdateDeliveryMode deliveryMode;
+};
+
+typedef struct PPDocumentUpdateObserverEntry PPDocumentUpdateObserverEntry;
+
+
+static unsigned UpdateTypesMaskForObserver(id observer);
+
+
+@interface PPDocumentUpdateBus (PrivateMethods)
+
+- (void) postUpdateOfType: (unsigned) updateType inRect: (NSRect) updateRect;
+
+- (void) scheduleDeliveryOfCoalescedUpdates;
+- (void) deliverCoalescedUpdates;
+
+- (void) sendUpdatesOfTypes: (unsigned) updateTypesMask
+            mergedVisibleUpdateRect: (NSRect) mergedVisibleUpdateRect
+            drawingLayerUpdateRect: (NSRect) drawingLayerUpdateRect
+            toObserverAtIndex: (int) observerIndex;
+
+- (void) beginDelivery;
+- (void) finishDelivery;
+
+- (void) compactObserverEntries;
+
+@end
+
+@implementation PPDocumentUpdateBus
+
+- initWithPPDocument: (PPDocument *) ppDocument
+{
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    if (!ppDocument)
+        goto ERROR;
+
+    _ppDocument = ppDocument;
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- init
+{
+    return [self initWithPPDocument: nil];
+}
+
+- (void) dealloc
+{
+    if (_observerEntries)
+    {
+        free(_observerEntries);
+    }
+
+    [super dealloc];
+}
+
+- (void) invalidate
+{
+    // a scheduled delivery retains the bus, so it's canceled here rather than in dealloc
+
+    if (_deliveryOfCoalescedUpdatesIsScheduled)
+    {
+        [[self class] cancelPreviousPerformRequestsWithTarget: self
+                        selector: @selector(deliverCoalescedUpdates)
+                        object: nil];
+
+        _deliveryOfCoalescedUpdatesIsScheduled = NO;
+    }
+
+    _pendingUpdateTypesMask = 0;
+
+    // in-progress deliveries stop at the next observer, since the entry count's now zero
+    _numObserverEntries = 0;
+    _observerEntriesNeedCompaction = NO;
+
+    _ppDocument = nil;
+}
+
+- (void) addUpdateObserver: (id) observer
+            deliveryMode: (PPDocumentUpdateDeliveryMode) deliveryMode
+{
+    unsigned updateTypesMask;
+    PPDocumentUpdateObserverEntry *observerEntry;
+    int entryIndex;
+
+    if (!observer || !_ppDocument)
+        goto ERROR;
+
+    updateTypesMask = UpdateTypesMaskForObserver(observer);
+
+    if (!updateTypesMask)
+        goto ERROR;
+
+    // already added? just update the delivery mode
+
+    for (entryIndex=0; entryIndex<_numObserverEntries; entryIndex++)
+    {
+        observerEntry = &_observerEntries[entryIndex];
+
+        if (observerEntry->observer == observer)
+        {
+            observerEntry->deliveryMode = deliveryMode;
+
+            return;
+        }
+    }
+
+    if (_numObserverEntries >= _observerEntriesCapacity)
+    {
+        int newCapacity;
+        PPDocumentUpdateObserverEntry *newObserverEntries;
+
+        newCapacity = MAX(2 * _observerEntriesCapacity, kMinObserverEntriesCapacity);
+
+        newObserverEntries =
+            (PPDocumentUpdateObserverEntry *)
+                realloc(_observerEntries, newCapacity * sizeof(PPDocumentUpdateObserverEntry));
+
+        if (!newObserverEntries)
+            goto ERROR;
+
+        _observerEntries = newObserverEntries;
+        _observerEntriesCapacity = newCapacity;
+    }
+
+    observerEntry = &_observerEntries[_numObserverEntries++];
+
+    observerEntry->observer = observer;
+    observerEntry->updateTypesMask = updateTypesMask;
+    observerEntry->deliveryMode = deliveryMode;
+
+    return;
+
+ERROR:
+    return;
+}
+
+- (void) removeUpdateObserver: (id) observer
+{
+    int entryIndex;
+
+    if (!observer)
+        return;
+
+    for (entryIndex=0; entryIndex<_numObserverEntries; entryIndex++)
+    {
+        if (_observerEntries[entryIndex].observer == observer)
+        {
+            // entries can't move during a delivery (the delivery loops index the entries
+            // array), so they're just cleared, & compacted when the delivery finishes
+
+            _observerEntries[entryIndex].observer = nil;
+            _observerEntriesNeedCompaction = YES;
+        }
+    }
+
+    if (_observerEntriesNeedCompaction && !_deliveryDepth)
+    {
+        [self compactObserverEntries];
+    }
+}
+
+- (void) postUpdatedMergedVisibleAreaInRect: (NSRect) updateRect
+{
+    [self postUpdateOfType: kUpdateTypeMask_MergedVisibleArea inRect: updateRect];
+}
+
+- (void) postUpdatedDrawingLayerAreaInRect: (NSRect) updateRect
+{
+    [self postUpdateOfType: kUpdateTypeMask_DrawingLayerArea inRect: updateRect];
+}
+
+- (void) postUpdatedMergedVisibleThumbnailImage
+{
+    [self postUpdateOfType: kUpdateTypeMask_MergedVisibleThumbnailImage inRect: NSZeroRect];
+}
+
+- (void) postUpdatedDrawingLayerThumbnailImage
+{
+    [self postUpdateOfType: kUpdateTypeMask_DrawingLayerThumbnailImage inRect: NSZeroRect];
+}
+
+#pragma mark Private methods
+
+- (void) postUpdateOfType: (unsigned) updateType inRect: (NSRect) updateRect
+{
+    int entryIndex;
+    PPDocumentUpdateObserverEntry *observerEntry;
+    bool hasCoalescedObserver = NO;
+
+    if (!_numObserverEntries)
+        return;
+
+    [self beginDelivery];
+
+    for (entryIndex=0; entryIndex<_numObserverEntries; entryIndex++)
+    {
+        observerEntry = &_observerEntries[entryIndex];
+
+        if (!observerEntry->observer || !(observerEntry->updateTypesMask & updateType))
+        {
+            continue;
+        }
+
+        if (observerEntry->deliveryMode == kPPDocumentUpdateDeliveryMode_Coalesced)
+        {
+            hasCoalescedObserver = YES;
+            continue;
+        }
+
+        [self sendUpdatesOfTypes: updateType
+                mergedVisibleUpdateRect: updateRect
+                drawingLayerUpdateRect: updateRect
+                toObserverAtIndex: entryIndex];
+    }
+
+    [self finishDelivery];
+
+    if (!hasCoalescedObserver)
+        return;
+
+    // merge the update into the pending updates (no allocation)
+
+    if (updateType == kUpdateTypeMask_MergedVisibleArea)
+    {
+        _pendingMergedVisibleUpdateRect =
+            (_pendingUpdateTypesMask & kUpdateTypeMask_MergedVisibleArea) ?
+                NSUnionRect(_pendingMergedVisibleUpdateRect, updateRect) : updateRect;
+    }
+    else if (updateType == kUpdateTypeMask_DrawingLayerArea)
+    {
+        _pendingDrawingLayerUpdateRect =
+            (_pendingUpdateTypesMask & kUpdateTypeMask_DrawingLayerArea) ?
+                NSUnionRect(_pendingDrawingLayerUpdateRect, updateRect) : updateRect;
+    }
+
+    _pendingUpdateTypesMask |= updateType;
+
+    [self scheduleDeliveryOfCoalescedUpdates];
+}
+
+- (void) scheduleDeliveryOfCoalescedUpdates
+{
+    if (_deliveryOfCoalescedUpdatesIsScheduled)
+        return;
+
+    _deliveryOfCoalescedUpdatesIsScheduled = YES;
+
+    // common modes, so coalesced updates are also delivered during event-tracking loops
+    // (live resizing, menu tracking)
+
+    [self performSelector: @selector(deliverCoalescedUpdates)
+            withObject: nil
+            afterDelay: 0.0f
+            inModes: [NSArray arrayWithObject: NSRunLoopCommonModes]];
+}
+
+- (void) deliverCoalescedUpdates
+{
+    unsigned pendingUpdateTypesMask, observerUpdateTypesMask;
+    NSRect mergedVisibleUpdateRect, drawingLayerUpdateRect;
+    int entryIndex;
+    PPDocumentUpdateObserverEntry *observerEntry;
+
+    _deliveryOfCoalescedUpdatesIsScheduled = NO;
+
+    // updates posted by observers during the delivery are pending for the next delivery
+
+    pendingUpdateTypesMask = _pendingUpdateTypesMask;
+    mergedVisibleUpdateRect = _pendingMergedVisibleUpdateRect;
+    drawingLayerUpdateRect = _pendingDrawingLayerUpdateRect;
+
+    _pendingUpdateTypesMask = 0;
+
+    if (!pendingUpdateTypesMask)
+        return;
+
+    [self beginDelivery];
+
+    for (entryIndex=0; entryIndex<_numObserverEntries; entryIndex++)
+    {
+        observerEntry = &_observerEntries[entryIndex];
+
+        if (!observerEntry->observer
+            || (observerEntry->deliveryMode != kPPDocumentUpdateDeliveryMode_Coalesced))
+        {
+            continue;
+        }
+
+        observerUpdateTypesMask = observerEntry->updateTypesMask & pendingUpdateTypesMask;
+
+        if (!observerUpdateTypesMask)
+            continue;
+
+        [self sendUpdatesOfTypes: observerUpdateTypesMask
+                mergedVisibleUpdateRect: mergedVisibleUpdateRect
+                drawingLayerUpdateRect: drawingLayerUpdateRect
+                toObserverAtIndex: entryIndex];
+    }
+
+    [self finishDelivery];
+}
+
+- (void) sendUpdatesOfTypes: (unsigned) updateTypesMask
+            mergedVisibleUpdateRect: (NSRect) mergedVisibleUpdateRect
+            drawingLayerUpdateRect: (NSRect) drawingLayerUpdateRect
+            toObserverAtIndex: (int) observerIndex
+{
+    id observer = _observerEntries[observerIndex].observer;
+    PPDocument *ppDocument = _ppDocument;
+
+    // before each call after the first, make sure the observer wasn't removed (or the bus
+    // invalidated) by the previous call
+
+#define macroObserverIsStillValid                                                       \
+            ((observerIndex < _numObserverEntries)                                      \
+                && (_observerEntries[observerIndex].observer == observer))
+
+    if (updateTypesMask & kUpdateTypeMask_MergedVisibleArea)
+    {
+        [observer ppDocument: ppDocument
+                    updatedMergedVisibleAreaInRect: mergedVisibleUpdateRect];
+    }
+
+    if ((updateTypesMask & kUpdateTypeMask_DrawingLayerArea) && macroObserverIsStillValid)
+    {
+        [observer ppDocument: ppDocument
+                    updatedDrawingLayerAreaInRect: drawingLayerUpdateRect];
+    }
+
+    if ((updateTypesMask & kUpdateTypeMask_MergedVisibleThumbnailImage)
+        && macroObserverIsStillValid)
+    {
+        [observer ppDocumentUpdatedMergedVisibleThumbnailImage: ppDocument];
+    }
+
+    if ((updateTypesMask & kUpdateTypeMask_DrawingLayerThumbnailImage)
+        && macroObserverIsStillValid)
+    {
+        [observer ppDocumentUpdatedDrawingLayerThumbnailImage: ppDocument];
+    }
+
+#undef macroObserverIsStillValid
+}
+
+- (void) beginDelivery
+{
+    // an observer may release the document (& its bus) during the delivery
+
+    [[self retain] autorelease];
+
+    _deliveryDepth++;
+}
+
+- (void) finishDelivery
+{
+    _deliveryDepth--;
+
+    if (!_deliveryDepth && _observerEntriesNeedCompaction)
+    {
+        [self compactObserverEntries];
+    }
+}
+
+- (void) compactObserverEntries
+{
+    int entryIndex, numValidEntries = 0;
+
+    for (entryIndex=0; entryIndex<_numObserverEntries; entryIndex++)
+    {
+        if (_observerEntries[entryIndex].observer)
+        {
+            if (entryIndex != numValidEntries)
+            {
+                _observerEntries[numValidEntries] = _observerEntries[entryIndex];
+            }
+
+            numValidEntries++;
+        }
+    }
+
+    _numObserverEntries = numValidEntries;
+    _observerEntriesNeedCompaction = NO;
+}
+
+@end
+
+#pragma mark Private functions
+
+static unsigned UpdateTypesMaskForObserver(id observer)
+{
+    unsigned updateTypesMask = 0;
+
+    if ([observer respondsToSelector: @selector(ppDocument:updatedMergedVisibleAreaInRect:)])
+    {
+        updateTypesMask |= kUpdateTypeMask_MergedVisibleArea;
+    }
+
+    if ([observer respondsToSelector: @selector(ppDocument:updatedDrawingLayerAreaInRect:)])
+    {
+        updateTypesMask |= kUpdateTypeMask_DrawingLayerArea;
+    }
+
+    if ([observer respondsToSelector: @selector(ppDocumentUpdatedMergedVisibleThumbnailImage:)])
+    {
+        updateTypesMask |= kUpdateTypeMask_MergedVisibleThumbnailImage;
+    }
+
+    if ([observer respondsToSelector: @selector(ppDocumentUpdatedDrawingLayerThumbnailImage:)])
+    {
+        updateTypesMask |= kUpdateTypeMask_DrawingLayerThumbnailImage;
+    }
+
+    return updateTypesMask;
+}
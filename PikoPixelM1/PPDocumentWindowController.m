@@ -41,6 +41,8 @@
 #import "NSObject_PPUtilities.h"
 #import "PPCursorManager.h"
 #import "PPLayerControlButtonImagesManager.h"
+#import "PPDocumentUpdateBus.h"
+#import "PPStartupTimeline.h"
 
 
 #define kWindowNibName  @"DocumentWindow"
@@ -61,8 +63,6 @@ static NSDictionary *gHotkeyToActionSelectorNameDict = nil;
 
 - (void) addAsObserverForPPDocumentNotifications;
 - (void) removeAsObserverForPPDocumentNotifications;
-- (void) handlePPDocumentNotification_UpdatedMergedVisibleArea: (NSNotification *) notification;
-- (void) handlePPDocumentNotification_UpdatedDrawingLayerArea: (NSNotification *) notification;
 - (void) handlePPDocumentNotification_UpdatedSelection: (NSNotification *) notification;
 - (void) handlePPDocumentNotification_SwitchedSelectedTool: (NSNotification *) notification;
 - (void) handlePPDocumentNotification_UpdatedBackgroundSettings:
@@ -127,6 +127,8 @@ static NSDictionary *gHotkeyToActionSelectorNameDict = nil;
 
 + (void) initialize
 {
+    macroStartupTimelineMethodScope();
+
     if ([self class] != [PPDocumentWindowController class])
     {
         return;
@@ -517,6 +519,8 @@ ERROR:
     {
         [self setupPanelsWithPPDocument: _ppDocument];
     }
+
+    [_ppDocument cancelNondrawingLayersStorageCompaction];
 }
 
 - (void) windowDidResignMain: (NSNotification *) notification
@@ -526,6 +530,10 @@ ERROR:
     [self removeAsObserverForNSMenuDidEndTrackingNotifications];
 
     [self setupPanelsWithPPDocument: nil];
+
+    // background documents' nondrawing layers are compacted (tile-encoded) if the document
+    // stays in the background for a while
+    [_ppDocument scheduleNondrawingLayersStorageCompaction];
 }
 
 - (void) windowDidBecomeKey: (NSNotification *) notification
@@ -582,17 +590,10 @@ ERROR:
     if (!_ppDocument)
         return;
 
-    [notificationCenter addObserver: self
-                        selector:
-                            @selector(handlePPDocumentNotification_UpdatedMergedVisibleArea:)
-                        name: PPDocumentNotification_UpdatedMergedVisibleArea
-                        object: _ppDocument];
+    // canvas updates are on the drawing path, so they're delivered immediately
 
-    [notificationCenter addObserver: self
-                        selector:
-                            @selector(handlePPDocumentNotification_UpdatedDrawingLayerArea:)
-                        name: PPDocumentNotification_UpdatedDrawingLayerArea
-                        object: _ppDocument];
+    [[_ppDocument updateBus] addUpdateObserver: self
+                                deliveryMode: kPPDocumentUpdateDeliveryMode_Immediate];
 
     [notificationCenter addObserver: self
                         selector: @selector(handlePPDocumentNotification_UpdatedSelection:)
@@ -629,53 +630,13 @@ ERROR:
 
 - (void) removeAsObserverForPPDocumentNotifications
 {
+    [[_ppDocument updateBus] removeUpdateObserver: self];
+
     [[NSNotificationCenter defaultCenter] removeObserver: self
                                             name: nil
                                             object: _ppDocument];
 }
 
-- (void) handlePPDocumentNotification_UpdatedMergedVisibleArea: (NSNotification *) notification
-{
-    NSDictionary *userInfo;
-    NSValue *updateRectValue;
-
-    if (_canvasDisplayMode == kPPLayerDisplayMode_DrawingLayerOnly)
-    {
-        return;
-    }
-
-    userInfo = [notification userInfo];
-
-    updateRectValue =
-                [userInfo objectForKey: PPDocumentNotification_UserInfoKey_UpdateAreaRect];
-
-    if (!updateRectValue)
-        return;
-
-    [_canvasView handleUpdateToCanvasBitmapInRect: [updateRectValue rectValue]];
-}
-
-- (void) handlePPDocumentNotification_UpdatedDrawingLayerArea: (NSNotification *) notification
-{
-    NSDictionary *userInfo;
-    NSValue *updateRectValue;
-
-    if (_canvasDisplayMode != kPPLayerDisplayMode_DrawingLayerOnly)
-    {
-        return;
-    }
-
-    userInfo = [notification userInfo];
-
-    updateRectValue =
-                [userInfo objectForKey: PPDocumentNotification_UserInfoKey_UpdateAreaRect];
-
-    if (!updateRectValue)
-        return;
-
-    [_canvasView handleUpdateToCanvasBitmapInRect: [updateRectValue rectValue]];
-}
-
 - (void) handlePPDocumentNotification_UpdatedSelection: (NSNotification *) notification
 {
     [_canvasView setSelectionOutlineToMask: [_ppDocument selectionMask]
@@ -739,6 +700,30 @@ ERROR:
             withPressedHotkey: _pressedHotkeyForActivePopupPanel];
 }
 
+#pragma mark PPDocumentUpdateObserver methods
+
+- (void) ppDocument: (PPDocument *) ppDocument
+            updatedMergedVisibleAreaInRect: (NSRect) updateRect
+{
+    if (_canvasDisplayMode == kPPLayerDisplayMode_DrawingLayerOnly)
+    {
+        return;
+    }
+
+    [_canvasView handleUpdateToCanvasBitmapInRect: updateRect];
+}
+
+- (void) ppDocument: (PPDocument *) ppDocument
+            updatedDrawingLayerAreaInRect: (NSRect) updateRect
+{
+    if (_canvasDisplayMode != kPPLayerDisplayMode_DrawingLayerOnly)
+    {
+        return;
+    }
+
+    [_canvasView handleUpdateToCanvasBitmapInRect: updateRect];
+}
+
 #pragma mark PPCanvasView notifications
 
 - (void) addAsObserverForPPCanvasViewNotifications
@@ -0,0 +1,178 @@
+/*
+    PPDocument_CacheRegistry.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPDocument.h"
+
+#import "PPCacheRegistry.h"
+#import "NSBitmapImageRep_PPUtilities.h"
+
+
+@interface PPDocument (CacheRegistryClient) <PPCacheRegistryClient>
+@end
+
+@interface PPDocument (CacheRegistryPrivateMethods)
+
+- (void) removeAllCachedLayersImages;
+
+@end
+
+@implementation PPDocument (CacheRegistry)
+
+- (bool) setupCacheRegistryEntries
+{
+    PPCacheRegistry *cacheRegistry = [PPCacheRegistry sharedRegistry];
+
+    [self removeCacheRegistryEntries];
+
+    // layer image caches are rebuilt by merging the layers above or below a layer (each cache
+    // is a merge of up to all the document's layers)
+
+    _layerImagesCacheRegistryEntry =
+                    [[cacheRegistry addEntryForClient: self
+                                    rebuildCost: kPPCacheRebuildCost_Medium]
+                            retain];
+
+    // thumbnail images' cached representations are resampled from the merged bitmaps
+    // whenever a thumbnail view redraws
+
+    _thumbnailImagesCacheRegistryEntry =
+                    [[cacheRegistry addEntryForClient: self
+                                    rebuildCost: kPPCacheRebuildCost_Low]
+                            retain];
+
+    // nondrawing layers' bitmaps are rebuilt by decoding their tile-encoded data (& may first
+    // need encoding when they're compacted)
+
+    _nondrawingLayerBitmapsCacheRegistryEntry =
+                    [[cacheRegistry addEntryForClient: self
+                                    rebuildCost: kPPCacheRebuildCost_High]
+                            retain];
+
+    if (!_layerImagesCacheRegistryEntry || !_thumbnailImagesCacheRegistryEntry
+        || !_nondrawingLayerBitmapsCacheRegistryEntry)
+    {
+        goto ERROR;
+    }
+
+    return YES;
+
+ERROR:
+    [self removeCacheRegistryEntries];
+
+    return NO;
+}
+
+- (void) removeCacheRegistryEntries
+{
+    PPCacheRegistry *cacheRegistry = [PPCacheRegistry sharedRegistry];
+
+    if (_layerImagesCacheRegistryEntry)
+    {
+        [cacheRegistry removeEntry: _layerImagesCacheRegistryEntry];
+
+        [_layerImagesCacheRegistryEntry release];
+        _layerImagesCacheRegistryEntry = nil;
+    }
+
+    if (_thumbnailImagesCacheRegistryEntry)
+    {
+        [cacheRegistry removeEntry: _thumbnailImagesCacheRegistryEntry];
+
+        [_thumbnailImagesCacheRegistryEntry release];
+        _thumbnailImagesCacheRegistryEntry = nil;
+    }
+
+    if (_nondrawingLayerBitmapsCacheRegistryEntry)
+    {
+        [cacheRegistry removeEntry: _nondrawingLayerBitmapsCacheRegistryEntry];
+
+        [_nondrawingLayerBitmapsCacheRegistryEntry release];
+        _nondrawingLayerBitmapsCacheRegistryEntry = nil;
+    }
+}
+
+@end
+
+@implementation PPDocument (CacheRegistryClient)
+
+#pragma mark PPCacheRegistryClient protocol
+
+- (size_t) memorySizeOfCacheForCacheRegistryEntry: (PPCacheRegistryEntry *) entry
+{
+    if (entry == _layerImagesCacheRegistryEntry)
+    {
+        return [self layerImageCachesMemorySize];
+    }
+    else if (entry == _thumbnailImagesCacheRegistryEntry)
+    {
+        // NSImage doesn't expose the sizes of its cached representations; the thumbnails'
+        // source bitmaps' sizes are used as an estimate
+
+        if (!_thumbnailImagesMayHaveCachedRepresentations)
+        {
+            return 0;
+        }
+
+        return [_mergedVisibleLayersBitmap ppMemorySize]
+                + [_dissolvedDrawingLayerBitmap ppMemorySize];
+    }
+    else if (entry == _nondrawingLayerBitmapsCacheRegistryEntry)
+    {
+        return [self nondrawingLayerBitmapsMemorySize];
+    }
+
+    return 0;
+}
+
+- (bool) evictCacheForCacheRegistryEntry: (PPCacheRegistryEntry *) entry
+{
+    if (entry == _layerImagesCacheRegistryEntry)
+    {
+        // cached layers images are rebuilt on demand (cachedOverlayersImageObjectForIndex:,
+        // cachedUnderlayersImageObjectForIndex:)
+
+        [self removeAllCachedLayersImages];
+
+        return YES;
+    }
+    else if (entry == _thumbnailImagesCacheRegistryEntry)
+    {
+        [_mergedVisibleLayersThumbnailImage recache];
+        [_dissolvedDrawingLayerThumbnailImage recache];
+
+        _thumbnailImagesMayHaveCachedRepresentations = NO;
+
+        return YES;
+    }
+    else if (entry == _nondrawingLayerBitmapsCacheRegistryEntry)
+    {
+        // compacted layers' bitmaps are decoded on demand (the drawing layer's left expanded)
+
+        return [self compactNondrawingLayersStorage];
+    }
+
+    return NO;
+}
+
+@end
@@ -30,6 +30,7 @@
 #import "NSBezierPath_PPUtilities.h"
 #import "PPGeometry.h"
 #import "PPDocumentLayer.h"
+#import "PPTrace.h"
 
 
 @interface PPDocument (DrawingPrivateMethods)
@@ -126,7 +127,7 @@ ERROR:
 
 - (void) beginDrawingWithPenMode: (PPPenMode) penMode
 {
-    if (![_drawingLayer isEnabled] || _isDrawing)
+    if (![_drawingLayer isEnabled] || _isDrawing || ![_drawingLayer unshareBitmap])
     {
         return;
     }
@@ -136,6 +137,8 @@ ERROR:
     _drawingUndoBounds = NSZeroRect;
     _shouldUndoCurrentDrawing = NO;
 
+    _drawingLayerContentHashBeforeDrawing = [_drawingLayer bitmapContentHash];
+
     // improve drawing performance by disabling thumbnail updates until the draw's done
     [self disableThumbnailImageUpdateNotifications: YES];
 
@@ -158,13 +161,20 @@ ERROR:
 
     if (!NSIsEmptyRect(_drawingUndoBounds))
     {
-        [self prepareUndoDrawingInBounds: _drawingUndoBounds];
+        // draws that left the layer unchanged (redrawing pixels with their existing colors,
+        // erasing clear areas) don't need an undo action or thumbnail updates; checking the
+        // layer's content hash only rehashes the tiles the draw touched
 
-        [[self undoManager] setActionName: (_penMode != kPPPenMode_Erase) ? NSLocalizedString(@"Draw", nil) : NSLocalizedString(@"Erase", nil)];
+        if ([_drawingLayer bitmapContentHash] != _drawingLayerContentHashBeforeDrawing)
+        {
+            [self prepareUndoDrawingInBounds: _drawingUndoBounds];
 
-        _drawingUndoBounds = NSZeroRect;
+            [[self undoManager] setActionName: (_penMode != kPPPenMode_Erase) ? NSLocalizedString(@"Draw", nil) : NSLocalizedString(@"Erase", nil)];
 
-        [self sendThumbnailImageUpdateNotifications];
+            [self sendThumbnailImageUpdateNotifications];
+        }
+
+        _drawingUndoBounds = NSZeroRect;
 
         if (_penMode == kPPPenMode_Erase)
         {
@@ -468,7 +478,8 @@ ERROR:
 
 - (void) noninteractiveFillSelectedDrawingArea
 {
-    if (_isDrawing || !_hasSelection || ![_drawingLayer isEnabled])
+    if (_isDrawing || !_hasSelection || ![_drawingLayer isEnabled]
+        || ![_drawingLayer unshareBitmap])
     {
         return;
     }
@@ -619,7 +630,7 @@ ERROR:
 
     updateBounds = NSIntersectionRect(updateBounds, _canvasFrame);
 
-    if (NSIsEmptyRect(updateBounds))
+    if (NSIsEmptyRect(updateBounds) || ![_drawingLayer unshareBitmap])
     {
         goto ERROR;
     }
@@ -811,11 +822,15 @@ ERROR:
 
 - (void) prepareUndoDrawingInBounds: (NSRect) undoBounds
 {
+    macroTraceMethodScope();
+
     NSData *undoBitmapTIFFData = [_drawingUndoBitmap ppCompressedTIFFDataFromBounds: undoBounds];
 
     if (!undoBitmapTIFFData)
         goto ERROR;
 
+    [self trackMemoryForUndoData: undoBitmapTIFFData];
+
     [[[self undoManager] prepareWithInvocationTarget: self]
                                                 undoDrawingWithTIFFData: undoBitmapTIFFData
                                                                 atPoint: undoBounds.origin];
@@ -834,6 +849,8 @@ ERROR:
 
 - (void) undoDrawingWithTIFFData: (NSData *) undoBitmapTIFFData atPoint: (NSPoint) origin
 {
+    macroTraceMethodScope();
+
     NSBitmapImageRep *undoBitmap;
     NSRect undoBounds;
     NSData *redoBitmapTIFFData;
@@ -843,8 +860,10 @@ ERROR:
 
     undoBitmap = [NSBitmapImageRep imageRepWithData: undoBitmapTIFFData];
 
-    if (!undoBitmap)
+    if (!undoBitmap || ![_drawingLayer unshareBitmap])
+    {
         goto ERROR;
+    }
 
     undoBounds =
             NSMakeRect(origin.x, origin.y, [undoBitmap pixelsWide], [undoBitmap pixelsHigh]);
@@ -859,6 +878,8 @@ ERROR:
     if (!redoBitmapTIFFData)
         goto ERROR;
 
+    [self trackMemoryForUndoData: redoBitmapTIFFData];
+
     [[[self undoManager] prepareWithInvocationTarget: self]
                                                 undoDrawingWithTIFFData: redoBitmapTIFFData
                                                                 atPoint: origin];
@@ -25,9 +25,15 @@
 #import "PPDocument.h"
 
 #import "PPDocument_NativeFileFormat.h"
+#import "PPDocument_NativeFileIcon.h"
 #import "PPGeometry.h"
 #import "NSBitmapImageRep_PPUtilities.h"
 #import "NSError_PPUtilities.h"
+#import "PPAutosaveJournal.h"
+#import "PPExportPanelAccessoryViewController.h"
+#import "PPGridPattern.h"
+#import "PPBackgroundPattern.h"
+#import "PPTrace.h"
 
 
 #define kTypeName_GIF               @"GIF Graphic"
@@ -37,39 +43,150 @@
 #define kTypeName_BMP               @"BMP Graphic"
 
 
+@interface PPDocument (FileFormatsPrivateMethods)
+
+- (BOOL) readFromNativeFileFormatData: (NSData *) data
+            autosaveJournalData: (NSData *) autosaveJournalData
+            error: (NSError **) outError;
+
+@end
+
 @implementation PPDocument (FileFormats)
 
 #pragma mark NSDocument overrides
 
 - (NSData *) dataOfType: (NSString *) typeName error: (NSError **) outError
 {
+    macroTraceMethodScope();
+
+    PPDocumentSaveFormat saveFormat;
     NSData *returnedData;
+    NSError *error = nil;
     NSBitmapImageRep *bitmap;
     NSBitmapImageFileType bitmapImageFileType = NSPNGFileType;
     NSDictionary *propertiesDict = nil;
+    unsigned exportScalingFactor = 1;
+    PPGridPattern *exportGridPattern = nil;
+    PPBackgroundPattern *exportBackgroundPattern = nil;
+    NSImage *exportBackgroundImage = nil;
+    NSImageInterpolation exportBackgroundImageInterpolation = NSImageInterpolationNone;
+    bool shouldExportBackgroundImage, hasExportSettings = NO;
 
     if (outError)
     {
         *outError = nil;
     }
 
+    // When saving asynchronously, user interaction is blocked only until the document state
+    // that's needed for saving is copied (unblockUserInteractionAfterSaveSnapshot); the copies
+    // are then encoded while the document may be edited, so the encoding must not access the
+    // document's (mutable) state
+
+    saveFormat = _saveFormat;
+
     if ([typeName isEqualToString: kNativeFileFormatTypeName])
     {
-        returnedData = [self nativeFileFormatData];
+        id snapshot;
+        NSArray *storedLayerChunks = nil;
+
+        snapshot = [self nativeFileFormatSnapshot];
+
+        if (!snapshot)
+            goto ERROR;
+
+        if (saveFormat != kPPDocumentSaveFormat_Autosave)
+        {
+            // the saved file's Finder icon is set after writing (writeToURL:...)
+            [_savedFileIconImage release];
+            _savedFileIconImage = [[self nativeFileIconImage] retain];
+        }
+
+        [self unblockUserInteractionAfterSaveSnapshot];
+
+        returnedData = [self nativeFileFormatDataFromSnapshot: snapshot
+                                returnedStoredLayerChunks: &storedLayerChunks];
 
         if (!returnedData)
+        {
+            if (_shouldCancelAsynchronousAutosave)
+            {
+                error = [NSError ppError_SaveWasCancelled];
+            }
+
             goto ERROR;
+        }
+
+        if ((saveFormat == kPPDocumentSaveFormat_Autosave) && _autosaveJournal)
+        {
+            // full autosave: the written data becomes the journal's new checkpoint
+            [_autosaveJournal setupPendingCheckpointWithData: returnedData
+                                storedLayerChunks: storedLayerChunks];
+        }
 
         return returnedData;
     }
 
-    if (_saveFormat == kPPDocumentSaveFormat_Export)
+    bitmap = [[_mergedVisibleLayersBitmap copy] autorelease];
+
+    if (!bitmap)
+        goto ERROR;
+
+    if ((saveFormat == kPPDocumentSaveFormat_Export)
+        && [_exportPanelViewController getScalingFactor: &exportScalingFactor
+                                        gridPattern: &exportGridPattern
+                                        backgroundPattern: &exportBackgroundPattern
+                                        backgroundImageFlag: &shouldExportBackgroundImage])
+    {
+        [[exportGridPattern retain] autorelease];
+        [[exportBackgroundPattern retain] autorelease];
+
+        if (shouldExportBackgroundImage)
+        {
+            exportBackgroundImage = [[_backgroundImage retain] autorelease];
+        }
+
+        exportBackgroundImageInterpolation =
+                                    (_shouldSmoothenBackgroundImage) ?
+                                            NSImageInterpolationLow : NSImageInterpolationNone;
+
+        hasExportSettings = YES;
+    }
+
+    [self unblockUserInteractionAfterSaveSnapshot];
+
+    if (hasExportSettings && [typeName isEqualToString: kTypeName_PNG])
     {
-        bitmap = [self mergedVisibleLayersBitmapUsingExportPanelSettings];
+        // PNG exports are generated & encoded in bands of rows, so large scaled exports don't
+        // need the full-size export bitmap in memory
+
+        returnedData =
+            [PPDocument exportPNGDataFromBitmap: bitmap
+                            scalingFactor: exportScalingFactor
+                            gridPattern: exportGridPattern
+                            backgroundPattern: exportBackgroundPattern
+                            backgroundImage: exportBackgroundImage
+                            backgroundImageInterpolation: exportBackgroundImageInterpolation];
+
+        if (returnedData)
+        {
+            return returnedData;
+        }
     }
-    else
+
+    if (hasExportSettings)
     {
-        bitmap = _mergedVisibleLayersBitmap;
+        NSBitmapImageRep *exportBitmap =
+            [PPDocument exportBitmapFromBitmap: bitmap
+                            scalingFactor: exportScalingFactor
+                            gridPattern: exportGridPattern
+                            backgroundPattern: exportBackgroundPattern
+                            backgroundImage: exportBackgroundImage
+                            backgroundImageInterpolation: exportBackgroundImageInterpolation];
+
+        if (exportBitmap)
+        {
+            bitmap = exportBitmap;
+        }
     }
 
     if ([typeName isEqualToString: kTypeName_PNG])
@@ -101,8 +218,15 @@
         bitmapImageFileType = NSBMPFileType;
     }
 
-    returnedData =
+    if (bitmapImageFileType == NSPNGFileType)
+    {
+        returnedData = [bitmap ppCompressedPNGData];
+    }
+    else
+    {
+        returnedData =
             [bitmap representationUsingType: bitmapImageFileType properties: propertiesDict];
+    }
 
     if (!returnedData)
         goto ERROR;
@@ -112,7 +236,12 @@
 ERROR:
     if (outError)
     {
-        *outError = [NSError ppError_UnableToCreateDataOfType: typeName];
+        if (!error)
+        {
+            error = [NSError ppError_UnableToCreateDataOfType: typeName];
+        }
+
+        *outError = error;
     }
 
     return nil;
@@ -127,17 +256,9 @@ ERROR:
 
     if ([typeName isEqualToString: kNativeFileFormatTypeName])
     {
-        PPDocument *ppDocument = [PPDocument ppDocumentFromNativeFileFormatData: data
-                                                returnedError: &error];
-
-        if (ppDocument && [self loadFromPPDocument: ppDocument])
-        {
-            return YES;
-        }
-        else
-        {
-            goto ERROR;
-        }
+        return [self readFromNativeFileFormatData: data
+                        autosaveJournalData: nil
+                        error: outError];
     }
 
     importedBitmap = [NSBitmapImageRep imageRepWithData: data];
@@ -184,4 +305,90 @@ ERROR:
     return NO;
 }
 
+- (BOOL) readFromURL: (NSURL *) absoluteURL
+            ofType: (NSString *) typeName
+            error: (NSError **) outError
+{
+    // native files are memory-mapped rather than read into memory: the archive is unarchived
+    // directly from the file's bytes, and only the (compressed) layer chunks are copied out;
+    // the mapping isn't referenced once loading finishes, so the file being truncated or
+    // rewritten in place later (by another process) can't fault a layer's lazy decode
+
+    if ([typeName isEqualToString: kNativeFileFormatTypeName] && [absoluteURL isFileURL])
+    {
+        NSString *journalPath;
+        NSData *data, *journalData = nil;
+
+        data = [NSData dataWithContentsOfURL: absoluteURL
+                        options: NSDataReadingMappedIfSafe
+                        error: NULL];
+
+        if (!data)
+            goto ERROR;
+
+        // autosaved native files may have an autosave journal with more recent changes
+        // (the journal's appended to in place, so it's read, not mapped)
+
+        journalPath = [PPAutosaveJournal journalPathForCheckpointPath: [absoluteURL path]];
+
+        if (journalPath && [[NSFileManager defaultManager] fileExistsAtPath: journalPath])
+        {
+            journalData = [NSData dataWithContentsOfFile: journalPath];
+        }
+
+        return [self readFromNativeFileFormatData: data
+                        autosaveJournalData: journalData
+                        error: outError];
+    }
+
+    return [super readFromURL: absoluteURL ofType: typeName error: outError];
+
+ERROR:
+    if (outError)
+    {
+        *outError = [NSError ppError_ImageFileIsCorrupt];
+    }
+
+    return NO;
+}
+
+#pragma mark Private methods
+
+- (BOOL) readFromNativeFileFormatData: (NSData *) data
+            autosaveJournalData: (NSData *) autosaveJournalData
+            error: (NSError **) outError
+{
+    NSError *error = nil;
+    PPDocument *ppDocument;
+
+    ppDocument = [PPDocument ppDocumentFromNativeFileFormatData: data
+                                autosaveJournalData: autosaveJournalData
+                                returnedError: &error];
+
+    if (!ppDocument || ![self loadFromPPDocument: ppDocument])
+    {
+        goto ERROR;
+    }
+
+    if (outError)
+    {
+        *outError = nil;
+    }
+
+    return YES;
+
+ERROR:
+    if (outError)
+    {
+        if (!error)
+        {
+            error = [NSError ppError_ImageFileIsCorrupt];
+        }
+
+        *outError = error;
+    }
+
+    return NO;
+}
+
 @end
@@ -30,8 +30,17 @@
 #import "NSImage_PPUtilities.h"
 #import "NSBitmapImageRep_PPUtilities.h"
 #import "PPAppBootUtilities.h"
+#import "PPCacheRegistry.h"
+#import "NSObject_PPUtilities.h"
+#import "PPTrace.h"
+#import "PPStartupTimeline.h"
 
 
+// background documents' nondrawing layers are compacted once the document's been in the
+// background for a while, so switching back & forth between document windows doesn't
+// re-encode & re-decode their layers each time
+#define kNondrawingLayersCompactionDelay        60.0f
+
 static NSObject *gEmptyImageObject = nil;
 static NSBitmapImageRep *gEmptyBitmap = nil;
 
@@ -111,6 +120,8 @@ static NSBitmapImageRep *gEmptyBitmap = nil;
 
 + (void) load
 {
+    macroStartupTimelineMethodScope();
+
     macroPerformNSObjectSelectorAfterAppLoads(ppDocument_Layers_SetupGlobals);
 }
 
@@ -264,6 +275,8 @@ ERROR:
     // removeLayerAtIndex: (which might cause layer ordering & draw layer index issues on
     // undo if the old removed layer is inserted before the newly-created layer is removed)
 
+    [self trackMemoryForUndoData: archivedLayer];
+
     [[undoManager prepareWithInvocationTarget: self]
                                                 insertArchivedLayer: archivedLayer
                                                 atIndex: index
@@ -502,6 +515,8 @@ ERROR:
     [[undoManager prepareWithInvocationTarget: self]
                                     setupDrawingLayerWithLayerAtIndex: oldIndexOfDrawingLayer];
 
+    [self trackMemoryForUndoData: archivedOldLayers];
+
     [[undoManager prepareWithInvocationTarget: self]
                                     setLayersWithArchivedLayersData: archivedOldLayers];
 
@@ -608,8 +623,10 @@ ERROR:
 
     mergedLayer = [[_drawingLayer copy] autorelease];
 
-    if (!mergedLayer)
+    if (!mergedLayer || ![mergedLayer unshareBitmap])
+    {
         goto ERROR;
+    }
 
     [[mergedLayer bitmap] ppCopyFromBitmap: _mergedVisibleLayersBitmap
                             toPoint: NSZeroPoint];
@@ -658,6 +675,76 @@ ERROR:
                 setActionName: (isEnabled) ? NSLocalizedString(@"Enable All Layers", nil) : NSLocalizedString(@"Disable All Layers", nil)];
 }
 
+- (bool) compactNondrawingLayersStorage
+{
+    int i;
+    PPDocumentLayer *layer;
+
+    if (_isDrawing || _isPerformingInteractiveMove)
+    {
+        return NO;
+    }
+
+    // the drawing layer's bitmap is retained by the document (_drawingLayerBitmap), so it's
+    // left expanded
+
+    for (i=0; i<_numLayers; i++)
+    {
+        layer = (PPDocumentLayer *) [_layers objectAtIndex: i];
+
+        if (layer != _drawingLayer)
+        {
+            [layer compactBitmapStorage];
+        }
+    }
+
+    return YES;
+}
+
+- (void) scheduleNondrawingLayersStorageCompaction
+{
+    [self ppPerformSelectorAtomically: @selector(compactNondrawingLayersStorage)
+            afterDelay: kNondrawingLayersCompactionDelay];
+}
+
+- (void) cancelNondrawingLayersStorageCompaction
+{
+    [[self class] cancelPreviousPerformRequestsWithTarget: self
+                    selector: @selector(compactNondrawingLayersStorage)
+                    object: nil];
+
+    [_nondrawingLayerBitmapsCacheRegistryEntry noteUse];
+}
+
+- (size_t) nondrawingLayerBitmapsMemorySize
+{
+    NSHashTable *countedObjects;
+    int i;
+    size_t memorySize = 0;
+
+    countedObjects = NSCreateHashTable(NSNonOwnedPointerHashCallBacks, 0);
+
+    if (!countedObjects)
+        goto ERROR;
+
+    // bitmaps shared with the drawing layer aren't freed by compaction, so they're not counted
+
+    [_drawingLayer bitmapMemorySizeIfUncountedInTable: countedObjects];
+
+    for (i=0; i<_numLayers; i++)
+    {
+        memorySize += [(PPDocumentLayer *) [_layers objectAtIndex: i]
+                                            bitmapMemorySizeIfUncountedInTable: countedObjects];
+    }
+
+    NSFreeHashTable(countedObjects);
+
+    return memorySize;
+
+ERROR:
+    return 0;
+}
+
 - (PPLayerBlendingMode) layerBlendingMode
 {
     return _layerBlendingMode;
@@ -737,7 +824,7 @@ ERROR:
             || !NSEqualSizes([_mergedVisibleLayersLinearBitmap ppSizeInPixels], bitmapSize))
         {
             NSBitmapImageRep *mergedVisibleLayersLinearBitmap =
-                                    [NSBitmapImageRep ppLinearRGB16BitmapOfSize: bitmapSize];
+                                    [NSBitmapImageRep ppLinearBitmapOfSize: bitmapSize];
 
             if (!mergedVisibleLayersLinearBitmap)
                 goto ERROR;
@@ -819,6 +906,9 @@ ERROR:
             goto ERROR;
     }
 
+    if (![layer unshareBitmap])
+        goto ERROR;
+
     layerBitmap = [layer bitmap];
 
     undoBitmapTIFFData = [layerBitmap ppCompressedTIFFDataFromBounds: updateRect];
@@ -831,6 +921,8 @@ ERROR:
 
     [self handleUpdateToLayerAtIndex: index inRect: updateRect];
 
+    [self trackMemoryForUndoData: undoBitmapTIFFData];
+
     [[[self undoManager] prepareWithInvocationTarget: self] copyTIFFData: undoBitmapTIFFData
                                                                 toLayerAtIndex: index
                                                                 atPoint: updateRect.origin];
@@ -843,6 +935,8 @@ ERROR:
 
 - (void) handleUpdateToLayerAtIndex: (int) index inRect: (NSRect) updateRect
 {
+    macroTraceMethodScope();
+
     if (![self hasLayerAtIndex: index] || _disallowUpdatesToMergedBitmap)
     {
         return;
@@ -964,6 +1058,23 @@ ERROR:
     [self postNotification_ChangedAttributeOfLayerAtIndex: layerIndex];
 }
 
+- (void) layerReplacedSharedBitmap: (PPDocumentLayer *) layer
+{
+    if (layer != _drawingLayer)
+    {
+        return;
+    }
+
+    // drawing layer switched from a shared (copy-on-write) bitmap to its own copy, so the
+    // cached bitmap & image pointers need updating
+
+    [_drawingLayerBitmap release];
+    _drawingLayerBitmap = [[_drawingLayer bitmap] retain];
+
+    [_drawingLayerImage release];
+    _drawingLayerImage = [[_drawingLayer image] retain];
+}
+
 #pragma mark Private methods
 
 - (bool) hasLayerAtIndex: (int) index
@@ -1126,6 +1237,12 @@ ERROR:
     {
         _cachedOverlayersImageObjects[index] =
             [[self mergedLayersImageObjectFromIndex: index + 1 toIndex: _numLayers - 1] retain];
+
+        [_layerImagesCacheRegistryEntry noteGrowth];
+    }
+    else
+    {
+        [_layerImagesCacheRegistryEntry noteUse];
     }
 
     return _cachedOverlayersImageObjects[index];
@@ -1142,6 +1259,12 @@ ERROR:
     {
         _cachedUnderlayersImageObjects[index] =
             [[self mergedLayersImageObjectFromIndex: 0 toIndex: index - 1] retain];
+
+        [_layerImagesCacheRegistryEntry noteGrowth];
+    }
+    else
+    {
+        [_layerImagesCacheRegistryEntry noteUse];
     }
 
     return _cachedUnderlayersImageObjects[index];
@@ -1165,7 +1288,7 @@ ERROR:
     }
     else if (_layerBlendingMode == kPPLayerBlendingMode_Linear)
     {
-        // Linear blending: image-objects are NSBitmapImageReps (LinearRGB16)
+        // Linear blending: image-objects are NSBitmapImageReps (LinearRGB16 or Compact32)
         imageObject = mergedLayersBitmap;
     }
     else
@@ -1190,6 +1313,8 @@ ERROR:
     int index;
     PPDocumentLayer *layer;
     float layerOpacity;
+    NSRect layerContentBounds;
+    bool didBeginLinearBlendingPass = NO;
 
     if (firstIndex < 0)
     {
@@ -1208,8 +1333,12 @@ ERROR:
 
     if (_layerBlendingMode == kPPLayerBlendingMode_Linear)
     {
-        // Linear blending - generate LinearRGB16 bitmap, merge using PikoPixel's LinearRGB16
-        // methods
+        // Linear blending - generate linear bitmap, merge using PikoPixel's linear bitmap
+        // methods; the merged bitmap starts out clear & clear source pixels don't change it,
+        // so each layer only needs merging within its content bounds
+
+        [PPDocumentLayer beginLinearBlendingPass];
+        didBeginLinearBlendingPass = YES;
 
         for (index=lastIndex; index>=firstIndex; index--)
         {
@@ -1221,32 +1350,49 @@ ERROR:
                 if (!mergedLayersBitmap)
                 {
                      mergedLayersBitmap =
-                                [NSBitmapImageRep ppLinearRGB16BitmapOfSize: _canvasFrame.size];
+                                [NSBitmapImageRep ppLinearBitmapOfSize: _canvasFrame.size];
 
                     if (!mergedLayersBitmap)
                         goto ERROR;
 
+                    layerContentBounds = [layer contentBoundsInRect: _canvasFrame];
+
+                    if (NSIsEmptyRect(layerContentBounds))
+                    {
+                        continue;
+                    }
+
                     // merge the first layer using linear-copy (faster than linear-blend)
 
                     [mergedLayersBitmap ppLinearCopyFromLinearBitmap:
-                                                                [layer linearBlendingBitmap]
+                                [layer linearBlendingBitmapValidInBounds: layerContentBounds]
                                             opacity: layerOpacity
-                                            inBounds: _canvasFrame];
+                                            inBounds: layerContentBounds];
                 }
                 else
                 {
+                    layerContentBounds = [layer contentBoundsInRect: _canvasFrame];
+
+                    if (NSIsEmptyRect(layerContentBounds))
+                    {
+                        continue;
+                    }
+
                     [mergedLayersBitmap ppLinearBlendFromLinearBitmapUnderneath:
-                                                                [layer linearBlendingBitmap]
+                                [layer linearBlendingBitmapValidInBounds: layerContentBounds]
                                             sourceOpacity: layerOpacity
-                                            inBounds: _canvasFrame];
+                                            inBounds: layerContentBounds];
                 }
             }
         }
+
+        [PPDocumentLayer endLinearBlendingPass];
+        didBeginLinearBlendingPass = NO;
     }
     else
     {
         // Standard blending - generate standard Image bitmap (sRGB), merge using native Cocoa
-        // methods
+        // methods; as with linear blending, layers are only drawn within their content bounds
 
         NSCompositingOperation compositingOperation;
 
@@ -1277,10 +1423,15 @@ ERROR:
                     compositingOperation = NSCompositeSourceOver;
                 }
 
-                [[layer image] drawInRect: _canvasFrame
-                                fromRect: _canvasFrame
-                                operation: compositingOperation
-                                fraction: layerOpacity];
+                layerContentBounds = [layer contentBoundsInRect: _canvasFrame];
+
+                if (!NSIsEmptyRect(layerContentBounds))
+                {
+                    [[layer image] drawInRect: layerContentBounds
+                                    fromRect: layerContentBounds
+                                    operation: compositingOperation
+                                    fraction: layerOpacity];
+                }
             }
         }
 
@@ -1300,12 +1451,19 @@ ERROR:
     return mergedLayersBitmap;
 
 ERROR:
+    if (didBeginLinearBlendingPass)
+    {
+        [PPDocumentLayer endLinearBlendingPass];
+    }
+
     return nil;
 }
 
 - (void) updateMergedVisibleLayersBitmapInRect: (NSRect) rect
             indexOfUpdatedLayer: (int) indexOfUpdatedLayer
 {
+    macroTraceMethodScope();
+
     NSObject *imageObject, *imageObjectsToMerge[3];
     int numImageObjectsToMerge = 0, imageIndexOfUpdatedLayer = -1, imageIndex;
     PPDocumentLayer *updatedLayer;
@@ -1318,6 +1476,11 @@ ERROR:
         return;
     }
 
+    // the updated layer's linear bitmap is collected before the under/overlayer images are
+    // generated, so cache evictions are deferred until the merge is done
+
+    [PPDocumentLayer beginLinearBlendingPass];
+
     // Collect image-objects for merge:
 
     // 1) Underlayers image (merged layers below updated layer)
@@ -1336,12 +1499,12 @@ ERROR:
 
     if ([updatedLayer isEnabled] && (opacityOfUpdatedLayer > 0.0f))
     {
-        // Linear blending: image-objects are NSBitmapImageReps (LinearRGB16)
+        // Linear blending: image-objects are NSBitmapImageReps (LinearRGB16 or Compact32)
         // Standard blending: image-objects are NSImages
 
         imageObject =
             (_layerBlendingMode == kPPLayerBlendingMode_Linear) ?
-                (NSObject *) [updatedLayer linearBlendingBitmap] :
+                (NSObject *) [updatedLayer linearBlendingBitmapValidInBounds: rect] :
                 (NSObject *) [updatedLayer image];
 
         // Don't need to check that (imageObject != gEmptyImageObject), since gEmptyImageObject
@@ -1368,8 +1531,8 @@ ERROR:
 
     if (_layerBlendingMode == kPPLayerBlendingMode_Linear)
     {
-        // Linear blending - image-objects are NSBitmapImageReps (LinearRGB16); merge using
-        // PikoPixel's LinearRGB16 bitmap methods
+        // Linear blending - image-objects are NSBitmapImageReps (LinearRGB16 or Compact32);
+        // merge using PikoPixel's linear bitmap methods
 
         NSBitmapImageRep *mergingBitmap;
 
@@ -1454,6 +1617,8 @@ ERROR:
         }
     }
 
+    [PPDocumentLayer endLinearBlendingPass];
+
     _mergedVisibleBitmapHasEnabledLayer = (numImageObjectsToMerge > 0) ? YES : NO;
 
     [self recacheMergedVisibleLayersThumbnailImageInBounds: rect];
@@ -1618,9 +1783,9 @@ ERROR:
         mergedLayersBitmap = [NSBitmapImageRep ppImageBitmapOfSize: _canvasFrame.size];
         shouldEnableMergedDrawLayer = NO;
     }
-    else if ([mergedLayersBitmap ppIsLinearRGB16Bitmap])
+    else if ([mergedLayersBitmap ppIsLinearBitmap])
     {
-        mergedLayersBitmap = [mergedLayersBitmap ppImageBitmapFromLinearRGB16Bitmap];
+        mergedLayersBitmap = [mergedLayersBitmap ppImageBitmapFromLinearBitmap];
     }
 
     if (!mergedLayersBitmap)
@@ -1644,6 +1809,7 @@ ERROR:
 - (bool) handleUpdateToLayer: (PPDocumentLayer *) layer
 {
     int indexOfChangedLayer;
+    NSRect updateRect;
 
     indexOfChangedLayer = [_layers indexOfObject: layer];
 
@@ -1652,7 +1818,18 @@ ERROR:
         return NO;
     }
 
-    [self handleUpdateToLayerAtIndex: indexOfChangedLayer inRect: _canvasFrame];
+    // layer attribute changes (opacity, enabled flag) only affect the merged image where the
+    // layer has content; fall back to the full canvas for empty layers so the merged-image
+    // caches & enabled-layer state still get refreshed
+
+    updateRect = [layer contentBoundsInRect: _canvasFrame];
+
+    if (NSIsEmptyRect(updateRect))
+    {
+        updateRect = _canvasFrame;
+    }
+
+    [self handleUpdateToLayerAtIndex: indexOfChangedLayer inRect: updateRect];
 
     return YES;
 }
@@ -1766,11 +1943,15 @@ ERROR:
 
 - (void) recacheMergedVisibleLayersThumbnailImageInBounds: (NSRect) bounds
 {
+    macroTraceMethodScope();
+
     [_mergedVisibleLayersThumbnailImage recache];
 }
 
 - (void) recacheDissolvedDrawingLayerThumbnailImageInBounds: (NSRect) bounds
 {
+    macroTraceMethodScope();
+
     [_dissolvedDrawingLayerThumbnailImage recache];
 }
 
@@ -0,0 +1,455 @@
+/*
+    PPDocument_MemoryReport.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPDocument.h"
+
+#import <objc/runtime.h>
+#import "PPDocumentLayer.h"
+#import "PPDocumentSamplerImage.h"
+#import "PPDocumentWindowController.h"
+#import "PPCanvasView.h"
+#import "NSBitmapImageRep_PPUtilities.h"
+#import "NSData_PPUtilities.h"
+
+
+// memory report keys are also the debug panel's display labels
+
+NSString *PPDocumentMemoryReportKey_LayerBitmaps = @"Layer bitmaps";
+
+NSString *PPDocumentMemoryReportKey_LayerTileEncodedData = @"Layer tile-encoded data";
+
+NSString *PPDocumentMemoryReportKey_MappedLayerTileEncodedData =
+                                                    @"Mapped tile-encoded data (not in total)";
+
+NSString *PPDocumentMemoryReportKey_LinearBlendingBitmaps = @"Linear blending bitmaps";
+
+NSString *PPDocumentMemoryReportKey_MergedVisibleLayersBitmaps = @"Merged visible bitmaps";
+
+NSString *PPDocumentMemoryReportKey_LayerImageCaches = @"Under/overlayer image caches";
+
+NSString *PPDocumentMemoryReportKey_DrawingBitmaps = @"Drawing & selection bitmaps";
+
+NSString *PPDocumentMemoryReportKey_InteractiveMoveBitmaps = @"Interactive move bitmaps";
+
+NSString *PPDocumentMemoryReportKey_SamplerImages = @"Sampler images";
+
+NSString *PPDocumentMemoryReportKey_BackgroundImage = @"Background image";
+
+NSString *PPDocumentMemoryReportKey_UndoData = @"Undo data";
+
+NSString *PPDocumentMemoryReportKey_CanvasViewBuffers = @"Canvas view buffers";
+
+NSString *PPDocumentMemoryReportKey_Total = @"Total";
+
+
+// PPUndoDataMemoryCounter: running total of a document's tracked undo data; it's retained by
+// each tracked data object's tracker, since undo data can outlive its document
+
+@interface PPUndoDataMemoryCounter : NSObject
+{
+    int64_t _numBytes;
+}
+
+- (void) addNumBytes: (int64_t) numBytes;
+- (int64_t) numBytes;
+
+@end
+
+// PPUndoDataMemoryTracker: associated object of a tracked undo data object; removes the
+// data's size from the counter when the data (& the tracker) is deallocated
+
+@interface PPUndoDataMemoryTracker : NSObject
+{
+    PPUndoDataMemoryCounter *_counter;
+    int64_t _numBytes;
+}
+
+- initWithCounter: (PPUndoDataMemoryCounter *) counter numBytes: (int64_t) numBytes;
+
+@end
+
+
+static char gUndoDataMemoryTrackerAssociationKey;
+
+
+@interface PPDocument (MemoryReportPrivateMethods)
+
+- (size_t) layerImageCachesMemorySizeIfUncountedInTable: (NSHashTable *) countedObjects;
+
+@end
+
+
+static size_t MemorySizeOfUncountedData(NSData *data, NSHashTable *countedObjects);
+static size_t MemorySizeOfImage(NSImage *image, NSHashTable *countedObjects);
+static size_t MemorySizeOfImageObject(NSObject *imageObject, NSHashTable *countedObjects);
+
+
+@implementation PPDocument (MemoryReport)
+
++ (NSArray *) memoryReportKeys
+{
+    static NSArray *memoryReportKeys = nil;
+
+    if (!memoryReportKeys)
+    {
+        memoryReportKeys =
+            [[NSArray arrayWithObjects: PPDocumentMemoryReportKey_LayerBitmaps,
+                                        PPDocumentMemoryReportKey_LayerTileEncodedData,
+                                        PPDocumentMemoryReportKey_MappedLayerTileEncodedData,
+                                        PPDocumentMemoryReportKey_LinearBlendingBitmaps,
+                                        PPDocumentMemoryReportKey_MergedVisibleLayersBitmaps,
+                                        PPDocumentMemoryReportKey_LayerImageCaches,
+                                        PPDocumentMemoryReportKey_DrawingBitmaps,
+                                        PPDocumentMemoryReportKey_InteractiveMoveBitmaps,
+                                        PPDocumentMemoryReportKey_SamplerImages,
+                                        PPDocumentMemoryReportKey_BackgroundImage,
+                                        PPDocumentMemoryReportKey_UndoData,
+                                        PPDocumentMemoryReportKey_CanvasViewBuffers,
+                                        PPDocumentMemoryReportKey_Total,
+                                        nil]
+                retain];
+    }
+
+    return memoryReportKeys;
+}
+
+- (NSDictionary *) memoryReport
+{
+    size_t layerBitmapsSize = 0, layerTileEncodedDataSize = 0,
+            mappedLayerTileEncodedDataSize = 0, linearBlendingBitmapsSize = 0,
+            mergedVisibleLayersBitmapsSize, layerImageCachesSize, drawingBitmapsSize,
+            interactiveMoveBitmapsSize, samplerImagesSize = 0, backgroundImageSize,
+            undoDataSize, canvasViewBuffersSize = 0, totalSize;
+    NSHashTable *countedObjects;
+    NSEnumerator *enumerator;
+    PPDocumentLayer *layer;
+    NSData *tileEncodedData;
+    PPDocumentSamplerImage *samplerImage;
+    NSWindowController *windowController;
+
+    // bitmaps & data objects can be referenced from several places (copy-on-write layer
+    // copies share their bitmap & encoded data, cached images can be shared), so each object's
+    // only counted the first time it's seen; layers are counted first, so objects they share
+    // with caches are reported as layer memory
+
+    countedObjects = NSCreateHashTable(NSNonOwnedPointerHashCallBacks, 0);
+
+    if (!countedObjects)
+        goto ERROR;
+
+    enumerator = [_layers objectEnumerator];
+
+    while (layer = [enumerator nextObject])
+    {
+        layerBitmapsSize += [layer bitmapMemorySizeIfUncountedInTable: countedObjects];
+
+        // encoded data that references (usually memory-mapped) file data isn't heap memory, so
+        // it's reported separately & isn't included in the total
+
+        tileEncodedData = [layer cachedTileEncodedBitmapData];
+
+        if ([tileEncodedData ppIsNoCopySubdata])
+        {
+            mappedLayerTileEncodedDataSize +=
+                                    MemorySizeOfUncountedData(tileEncodedData, countedObjects);
+        }
+        else
+        {
+            layerTileEncodedDataSize +=
+                                    MemorySizeOfUncountedData(tileEncodedData, countedObjects);
+        }
+
+        linearBlendingBitmapsSize +=
+                    [layer linearBlendingBitmapMemorySizeIfUncountedInTable: countedObjects];
+    }
+
+    mergedVisibleLayersBitmapsSize =
+            [_mergedVisibleLayersBitmap ppMemorySizeIfUncountedInTable: countedObjects]
+            + [_mergedVisibleLayersLinearBitmap ppMemorySizeIfUncountedInTable: countedObjects];
+
+    layerImageCachesSize = [self layerImageCachesMemorySizeIfUncountedInTable: countedObjects];
+
+    drawingBitmapsSize =
+                [_dissolvedDrawingLayerBitmap ppMemorySizeIfUncountedInTable: countedObjects]
+                + [_drawingMask ppMemorySizeIfUncountedInTable: countedObjects]
+                + [_drawingUndoBitmap ppMemorySizeIfUncountedInTable: countedObjects]
+                + [_selectionMask ppMemorySizeIfUncountedInTable: countedObjects]
+                + [_interactiveEraseMask ppMemorySizeIfUncountedInTable: countedObjects];
+
+    // _interactiveMoveTargetBitmap is the drawing layer's bitmap or the merged visible bitmap,
+    // so it's already counted
+
+    interactiveMoveBitmapsSize =
+        [_interactiveMoveUnderlyingBitmap ppMemorySizeIfUncountedInTable: countedObjects]
+        + [_interactiveMoveFloatingBitmap ppMemorySizeIfUncountedInTable: countedObjects]
+        + [_interactiveMoveFloatingMask ppMemorySizeIfUncountedInTable: countedObjects]
+        + [_interactiveMoveInitialSelectionMask ppMemorySizeIfUncountedInTable: countedObjects];
+
+    enumerator = [_samplerImages objectEnumerator];
+
+    while (samplerImage = [enumerator nextObject])
+    {
+        samplerImagesSize +=
+                    [[samplerImage bitmap] ppMemorySizeIfUncountedInTable: countedObjects]
+                    + MemorySizeOfUncountedData([samplerImage compressedBitmapData],
+                                                countedObjects);
+    }
+
+    backgroundImageSize = MemorySizeOfImage(_backgroundImage, countedObjects)
+                            + MemorySizeOfUncountedData(_compressedBackgroundImageData,
+                                                        countedObjects);
+
+    NSFreeHashTable(countedObjects);
+
+    undoDataSize = (size_t) MAX([_undoDataMemoryCounter numBytes], 0);
+
+    enumerator = [[self windowControllers] objectEnumerator];
+
+    while (windowController = [enumerator nextObject])
+    {
+        if ([windowController isKindOfClass: [PPDocumentWindowController class]])
+        {
+            canvasViewBuffersSize +=
+                [[(PPDocumentWindowController *) windowController canvasView]
+                                                                    zoomedBuffersMemorySize];
+        }
+    }
+
+    totalSize = layerBitmapsSize + layerTileEncodedDataSize + linearBlendingBitmapsSize
+                + mergedVisibleLayersBitmapsSize + layerImageCachesSize + drawingBitmapsSize
+                + interactiveMoveBitmapsSize + samplerImagesSize + backgroundImageSize
+                + undoDataSize + canvasViewBuffersSize;
+
+    return [NSDictionary dictionaryWithObjectsAndKeys:
+                    [NSNumber numberWithUnsignedLongLong: layerBitmapsSize],
+                        PPDocumentMemoryReportKey_LayerBitmaps,
+                    [NSNumber numberWithUnsignedLongLong: layerTileEncodedDataSize],
+                        PPDocumentMemoryReportKey_LayerTileEncodedData,
+                    [NSNumber numberWithUnsignedLongLong: mappedLayerTileEncodedDataSize],
+                        PPDocumentMemoryReportKey_MappedLayerTileEncodedData,
+                    [NSNumber numberWithUnsignedLongLong: linearBlendingBitmapsSize],
+                        PPDocumentMemoryReportKey_LinearBlendingBitmaps,
+                    [NSNumber numberWithUnsignedLongLong: mergedVisibleLayersBitmapsSize],
+                        PPDocumentMemoryReportKey_MergedVisibleLayersBitmaps,
+                    [NSNumber numberWithUnsignedLongLong: layerImageCachesSize],
+                        PPDocumentMemoryReportKey_LayerImageCaches,
+                    [NSNumber numberWithUnsignedLongLong: drawingBitmapsSize],
+                        PPDocumentMemoryReportKey_DrawingBitmaps,
+                    [NSNumber numberWithUnsignedLongLong: interactiveMoveBitmapsSize],
+                        PPDocumentMemoryReportKey_InteractiveMoveBitmaps,
+                    [NSNumber numberWithUnsignedLongLong: samplerImagesSize],
+                        PPDocumentMemoryReportKey_SamplerImages,
+                    [NSNumber numberWithUnsignedLongLong: backgroundImageSize],
+                        PPDocumentMemoryReportKey_BackgroundImage,
+                    [NSNumber numberWithUnsignedLongLong: undoDataSize],
+                        PPDocumentMemoryReportKey_UndoData,
+                    [NSNumber numberWithUnsignedLongLong: canvasViewBuffersSize],
+                        PPDocumentMemoryReportKey_CanvasViewBuffers,
+                    [NSNumber numberWithUnsignedLongLong: totalSize],
+                        PPDocumentMemoryReportKey_Total,
+                    nil];
+
+ERROR:
+    return nil;
+}
+
+- (size_t) layerImageCachesMemorySize
+{
+    NSHashTable *countedObjects;
+    size_t memorySize;
+
+    countedObjects = NSCreateHashTable(NSNonOwnedPointerHashCallBacks, 0);
+
+    if (!countedObjects)
+        goto ERROR;
+
+    memorySize = [self layerImageCachesMemorySizeIfUncountedInTable: countedObjects];
+
+    NSFreeHashTable(countedObjects);
+
+    return memorySize;
+
+ERROR:
+    return 0;
+}
+
+- (void) trackMemoryForUndoData: (NSData *) undoData
+{
+    PPUndoDataMemoryTracker *tracker;
+
+    if (!undoData
+        || objc_getAssociatedObject(undoData, &gUndoDataMemoryTrackerAssociationKey))
+    {
+        return;
+    }
+
+    if (!_undoDataMemoryCounter)
+    {
+        _undoDataMemoryCounter = [[PPUndoDataMemoryCounter alloc] init];
+
+        if (!_undoDataMemoryCounter)
+            goto ERROR;
+    }
+
+    tracker = [[[PPUndoDataMemoryTracker alloc] initWithCounter: _undoDataMemoryCounter
+                                                    numBytes: [undoData length]]
+                                            autorelease];
+
+    if (!tracker)
+        goto ERROR;
+
+    objc_setAssociatedObject(undoData, &gUndoDataMemoryTrackerAssociationKey, tracker,
+                                OBJC_ASSOCIATION_RETAIN);
+
+    return;
+
+ERROR:
+    return;
+}
+
+#pragma mark Private methods
+
+- (size_t) layerImageCachesMemorySizeIfUncountedInTable: (NSHashTable *) countedObjects
+{
+    size_t memorySize = 0;
+    int index;
+
+    // the cached image objects may be shared (empty merged images all use the same object)
+
+    for (index=0; index<_numLayers; index++)
+    {
+        memorySize +=
+            MemorySizeOfImageObject(_cachedOverlayersImageObjects[index], countedObjects)
+            + MemorySizeOfImageObject(_cachedUnderlayersImageObjects[index], countedObjects);
+    }
+
+    return memorySize;
+}
+
+@end
+
+@implementation PPUndoDataMemoryCounter
+
+- (void) addNumBytes: (int64_t) numBytes
+{
+    // undo data isn't guaranteed to be deallocated on the main thread
+    __atomic_add_fetch(&_numBytes, numBytes, __ATOMIC_RELAXED);
+}
+
+- (int64_t) numBytes
+{
+    return __atomic_load_n(&_numBytes, __ATOMIC_RELAXED);
+}
+
+@end
+
+@implementation PPUndoDataMemoryTracker
+
+- initWithCounter: (PPUndoDataMemoryCounter *) counter numBytes: (int64_t) numBytes
+{
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    if (!counter)
+        goto ERROR;
+
+    _counter = [counter retain];
+    _numBytes = numBytes;
+
+    [_counter addNumBytes: _numBytes];
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- init
+{
+    return [self initWithCounter: nil numBytes: 0];
+}
+
+- (void) dealloc
+{
+    [_counter addNumBytes: -_numBytes];
+    [_counter release];
+
+    [super dealloc];
+}
+
+@end
+
+#pragma mark Private functions
+
+static size_t MemorySizeOfUncountedData(NSData *data, NSHashTable *countedObjects)
+{
+    if (!data || NSHashInsertIfAbsent(countedObjects, data))
+    {
+        return 0;
+    }
+
+    return [data length];
+}
+
+static size_t MemorySizeOfImage(NSImage *image, NSHashTable *countedObjects)
+{
+    NSEnumerator *representationEnumerator;
+    NSImageRep *representation;
+    size_t memorySize = 0;
+
+    representationEnumerator = [[image representations] objectEnumerator];
+
+    while (representation = [representationEnumerator nextObject])
+    {
+        if ([representation isKindOfClass: [NSBitmapImageRep class]])
+        {
+            memorySize += [(NSBitmapImageRep *) representation
+                                                ppMemorySizeIfUncountedInTable: countedObjects];
+        }
+    }
+
+    return memorySize;
+}
+
+// image objects (cached under/overlayers) are NSImages when using standard blending &
+// NSBitmapImageReps when using linear blending
+
+static size_t MemorySizeOfImageObject(NSObject *imageObject, NSHashTable *countedObjects)
+{
+    if ([imageObject isKindOfClass: [NSBitmapImageRep class]])
+    {
+        return [(NSBitmapImageRep *) imageObject
+                                                ppMemorySizeIfUncountedInTable: countedObjects];
+    }
+    else if ([imageObject isKindOfClass: [NSImage class]])
+    {
+        return MemorySizeOfImage((NSImage *) imageObject, countedObjects);
+    }
+
+    return 0;
+}
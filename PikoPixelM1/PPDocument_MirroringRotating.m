@@ -397,13 +397,20 @@ ERROR:
         goto ERROR;
 
     layer = [self layerAtIndex: index];
-    layerBitmap = [layer bitmap];
 
-    if (!layer || !layerBitmap)
+    // copyImageBitmap:toLayerAtIndex: unshares the layer's bitmap (replacing it) if it's
+    // shared, so unshare it up front to keep layerBitmap valid through the copies below
+
+    if (!layer || ![layer unshareBitmap])
     {
         goto ERROR;
     }
 
+    layerBitmap = [layer bitmap];
+
+    if (!layerBitmap)
+        goto ERROR;
+
     if (preOperationCroppedMask)
     {
         NSBitmapImageRep *updatedAreaBitmap, *operatedBitmap;
@@ -619,20 +619,26 @@ ERROR:
 
 - (bool) setupInteractiveMoveBitmaps
 {
+    if ((_interactiveMoveDisplayMode == kPPLayerDisplayMode_DrawingLayerOnly)
+        && ![_drawingLayer unshareBitmap])
+    {
+        goto ERROR;
+    }
+
     _interactiveMoveTargetBitmap =
         (_interactiveMoveDisplayMode == kPPLayerDisplayMode_DrawingLayerOnly) ?
             _drawingLayerBitmap : _mergedVisibleLayersBitmap;
 
     [_interactiveMoveTargetBitmap retain];
 
-    _interactiveMoveUnderlyingBitmap = [_interactiveMoveTargetBitmap copy];
+    _interactiveMoveUnderlyingBitmap = [[_interactiveMoveTargetBitmap ppPooledCopy] retain];
 
     if (!_interactiveMoveUnderlyingBitmap)
         goto ERROR;
 
     if (_hasSelection)
     {
-        _interactiveMoveInitialSelectionMask = [_selectionMask copy];
+        _interactiveMoveInitialSelectionMask = [[_selectionMask ppPooledCopy] retain];
 
         _interactiveMoveFloatingBitmap =
             [[_interactiveMoveTargetBitmap ppBitmapCroppedToBounds: _selectionBounds] retain];
@@ -28,7 +28,42 @@
 @interface PPDocument (NativeFileFormat)
 
 - (NSData *) nativeFileFormatData;
+
+// Saving is split into two steps: nativeFileFormatSnapshot archives the document & takes
+// copy-on-write references to its layers, so it's fast, but needs to be called on the main
+// thread (or while the document's user interaction is blocked);
+// nativeFileFormatDataFromSnapshot: does the slow work (encoding the layers & merged image)
+// and can be called on a background thread while the document's being edited.
+// Returns nil if the document's autosave is cancelled (_shouldCancelAsynchronousAutosave);
+// returnedStoredLayerChunks: the layers' bitmap chunk data objects, in chunk-index order
+- (id) nativeFileFormatSnapshot;
+- (NSData *) nativeFileFormatDataFromSnapshot: (id) snapshot
+                returnedStoredLayerChunks: (NSArray **) returnedStoredLayerChunks;
+
+// nativeArchivedDocumentDataUsingLayerChunksDelegate: returns the document's keyed archive,
+// with layer bitmaps stored through layerChunksDelegate
+// (PPDocumentLayerBitmapChunkCodingDelegateMethods)
+- (NSData *) nativeArchivedDocumentDataUsingLayerChunksDelegate: (id) layerChunksDelegate;
+
++ (PPDocument *) ppDocumentFromNativeFileFormatData: (NSData *) data
+                    returnedError: (NSError **) returnedError;
+
+// autosaveJournalData (optional) is the contents of the journal file for an autosaved
+// document (PPAutosaveJournal); if it's valid for data, the document's loaded from the
+// journal's most recent record instead
 + (PPDocument *) ppDocumentFromNativeFileFormatData: (NSData *) data
+                    autosaveJournalData: (NSData *) autosaveJournalData
                     returnedError: (NSError **) returnedError;
 
+// nativeFileFormatThumbnail...: returns the smallest of the data's embedded thumbnails (256,
+// 128, 64 pixels max dimension) whose larger dimension is at least minDimension (or the
+// largest one, if none are) without unarchiving the document or decoding its layers; returns
+// nil if the data has no thumbnails (autosaved data, images no larger than 64 pixels, or data
+// written in a format version before v4)
++ (NSBitmapImageRep *) nativeFileFormatThumbnailFromData: (NSData *) data
+                        minDimension: (unsigned) minDimension;
+
++ (NSBitmapImageRep *) nativeFileFormatThumbnailFromFileAtURL: (NSURL *) fileURL
+                        minDimension: (unsigned) minDimension;
+
 @end
@@ -26,6 +26,9 @@
 
 #import "NSError_PPUtilities.h"
 #import "NSBitmapImageRep_PPUtilities.h"
+#import "NSData_PPUtilities.h"
+#import "PPDocumentLayer.h"
+#import "PPAutosaveJournal.h"
 
 
 /*
@@ -58,118 +61,1068 @@ is the same as v1
 #define kPPNativeFileFormatVersion_2            2
 
 
+/*
+PikoPixel Native File Format v3
+
+Layer bitmaps are stored outside the NSKeyedArchive, as separate chunks of tile-encoded data
+(NSBitmapImageRep_PPUtilities_TileEncoding), so each layer's bitmap can be written & read
+independently: unchanged layers loaded from a v3 file are saved without re-encoding, and
+layers loaded from a v3 file aren't decoded until their bitmap is first needed. (The archived
+PPDocumentLayers contain chunk indexes instead of TIFF data).
+
+6 parts packed together:
+-----------
+1. Binary data (PNG of the merged visible image - allows for viewing/editing by other apps)
+-----------
+2. Binary data (Layer chunks - each layer's tile-encoded bitmap data, concatenated)
+-----------
+3. Chunk index (PPNativeFileFormatChunkIndexHeader, followed by a
+    PPNativeFileFormatChunkIndexEntry for each layer chunk - offset & length of the chunk,
+    relative to the start of the layer chunks data)
+-----------
+4. Binary data (NSKeyedArchive of PPDocument)
+-----------
+5. Descriptor (PPNativeFileFormatDataDescriptor - contains lengths of PNG, layer chunks, chunk
+    index & NSKeyedArchive data)
+-----------
+6. Trailer (PPNativeFileFormatDataTrailer - contains version info & length of descriptor)
+
+The v3 descriptor appends its two additional lengths to the v1 descriptor's members, so its
+layout is backwards-compatible; the trailer's descriptor length differentiates them.
+Layer Blending Mode is stored in the archived PPDocument data (as in v2), so v3 is used for
+both blending modes.
+*/
+
+#define kPPNativeFileFormatVersion_3            3
+
+
+/*
+PikoPixel Native File Format v4
+
+Same as v3, with an additional thumbnails section after the PNG data, so previews & icons can
+be read without decoding the PNG or unarchiving the document.
+
+7 parts packed together:
+-----------
+1. Binary data (PNG of the merged visible image)
+-----------
+2. Thumbnails (PPNativeFileFormatThumbnailsHeader, followed by a
+    PPNativeFileFormatThumbnailEntry for each thumbnail - its size, and the offset & length of
+    its tile-encoded bitmap data, relative to the start of the thumbnails section - followed
+    by the thumbnails' data); the thumbnails are successively halved downsamples of the merged
+    visible image (256, 128, 64 pixels max dimension, but never larger than the image), largest
+    first; autosaved data (which has a blank PNG) has no thumbnails
+-----------
+3. Binary data (Layer chunks)
+-----------
+4. Chunk index
+-----------
+5. Binary data (NSKeyedArchive of PPDocument)
+-----------
+6. Descriptor (PPNativeFileFormatDataDescriptor - contains lengths of PNG, layer chunks, chunk
+    index, NSKeyedArchive & thumbnails data)
+-----------
+7. Trailer (PPNativeFileFormatDataTrailer)
+
+The v4 descriptor appends the thumbnails length to the v3 descriptor's members.
+
+v4 is also the first version whose tile-encoded data (layer chunks & thumbnails) may contain
+indexed tiles, so data with indexed tiles is written as v4 even if it has no thumbnails (its
+thumbnails section is then empty).
+*/
+
+#define kPPNativeFileFormatVersion_4            4
+
+
 #define kPPNativeFormatDataTrailerSignature     'ppDT'
 
-#define kPPNativeFormatDataDescriptorSignature  'ppDD'
+#define kPPNativeFormatDataDescriptorSignature  'ppDD'
+
+#define kPPNativeFormatChunkIndexSignature      'ppCI'
+
+#define kPPNativeFormatThumbnailsSignature      'ppTN'
+
+#define kMaxSupportedPPNativeFileFormatVersion  kPPNativeFileFormatVersion_4
+
+
+// Format versions used when writing data are the oldest that support the features the written
+// data uses (see nativeFileFormatSnapshot & nativeFileFormatDataFromSnapshot:...)
+
+// smaller documents don't gain much from layer chunks (lazy decoding, reusing unchanged
+// layers' encoded data), so they're saved as v1/v2 (with TIFF layer data), which older
+// versions can read
+#define kMaxLayerPixelsForUnchunkedFormat       (512 * 512)
+
+#define kMaxThumbnailDimension                  256
+#define kMinThumbnailDimension                  64
+
+// Root object key used by +[NSKeyedArchiver archivedDataWithRootObject:] &
+// +[NSKeyedUnarchiver unarchiveObjectWithData:]
+#define kKeyedArchiveRootObjectKey              @"root"
+
+
+typedef struct
+{
+    uint32_t signature;
+    uint32_t formatVersion;
+    uint32_t minSupportedFormatVersion;
+    uint32_t descriptorLength;
+
+} PPNativeFileFormatDataTrailer;
+
+typedef struct
+{
+    uint32_t signature;
+    uint32_t pngDataLength;
+    uint32_t archivedDocumentDataLength;
+
+    // v3 members
+    uint32_t layerChunksDataLength;
+    uint32_t chunkIndexLength;
+
+    // v4 members
+    uint32_t thumbnailsDataLength;
+
+} PPNativeFileFormatDataDescriptor;
+
+#define kPPNativeFileFormatDataDescriptorLength_v1      (3 * sizeof(uint32_t))
+#define kPPNativeFileFormatDataDescriptorLength_v3      (5 * sizeof(uint32_t))
+
+typedef struct
+{
+    uint32_t signature;
+    uint32_t numChunks;
+
+} PPNativeFileFormatChunkIndexHeader;
+
+typedef struct
+{
+    uint32_t chunkOffset;
+    uint32_t chunkLength;
+
+} PPNativeFileFormatChunkIndexEntry;
+
+typedef struct
+{
+    uint32_t signature;
+    uint32_t numThumbnails;
+
+} PPNativeFileFormatThumbnailsHeader;
+
+typedef struct
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t dataOffset;
+    uint32_t dataLength;
+
+} PPNativeFileFormatThumbnailEntry;
+
+typedef struct
+{
+    NSRange pngDataRange;
+    NSRange thumbnailsDataRange;
+    NSRange layerChunksRange;
+    NSRange chunkIndexRange;
+    NSRange archivedDocumentDataRange;
+
+} PPNativeFileFormatSectionRanges;
+
+
+// PPNativeFileFormatLayerChunks is the delegate of the keyed (un)archiver used for native
+// file format data, and stores or retrieves the archived layers' bitmap chunks
+// (PPDocumentLayerBitmapChunkCodingDelegateMethods); when writing, the archived layers are
+// stored as copy-on-write copies, and aren't encoded until encodeStoredLayers... is called
+
+@interface PPNativeFileFormatLayerChunks : NSObject
+{
+    NSMutableArray *_layersToEncode;
+    NSMutableData *_layerChunksData;
+    NSMutableData *_chunkIndexEntriesData;
+    NSMutableArray *_storedChunks;
+    bool _storedChunksUseIndexedTiles;
+
+    NSData *_fileData;
+    NSRange _layerChunksRange;
+    const unsigned char *_chunkIndexEntries;
+    unsigned _numChunks;
+}
+
+- initForWriting;
+
+- initForReadingFromFileData: (NSData *) fileData
+    layerChunksRange: (NSRange) layerChunksRange
+    chunkIndexRange: (NSRange) chunkIndexRange;
+
+- (bool) encodeStoredLayersWithCancellationFlag: (volatile bool *) cancellationFlag;
+
+- (NSData *) layerChunksData;
+- (NSData *) chunkIndexData;
+- (NSArray *) storedChunks;
+- (bool) storedChunksUseIndexedTiles;
+
+- (int) ppIndexOfStoredBitmapChunkForLayer: (PPDocumentLayer *) layer;
+- (NSData *) ppLayerBitmapChunkAtIndex: (int) chunkIndex;
+
+@end
+
+// PPNativeFileFormatSnapshot holds the document state copied by nativeFileFormatSnapshot
+
+@interface PPNativeFileFormatSnapshot : NSObject
+{
+    NSData *_archivedDocumentData;
+    PPNativeFileFormatLayerChunks *_layerChunks;
+    NSBitmapImageRep *_mergedBitmap;
+    unsigned _minFormatVersion;
+}
+
+- initWithArchivedDocumentData: (NSData *) archivedDocumentData
+    layerChunks: (PPNativeFileFormatLayerChunks *) layerChunks
+    mergedBitmap: (NSBitmapImageRep *) mergedBitmap
+    minFormatVersion: (unsigned) minFormatVersion;
+
+- (NSData *) archivedDocumentData;
+- (PPNativeFileFormatLayerChunks *) layerChunks;
+- (NSBitmapImageRep *) mergedBitmap;
+- (unsigned) minFormatVersion;
+
+@end
+
+
+static void SwapUInt32sWithByteCount(uint32_t *uint32sToSwap, unsigned byteCount);
+static void PPNativeFileFormatDataTrailer_FixByteOrder(
+                                                PPNativeFileFormatDataTrailer *dataTrailer);
+static void PPNativeFileFormatDataDescriptor_FixByteOrder(
+                                            PPNativeFileFormatDataDescriptor *dataDescriptor);
+static void PPNativeFileFormatChunkIndexHeader_FixByteOrder(
+                                            PPNativeFileFormatChunkIndexHeader *indexHeader);
+static void PPNativeFileFormatChunkIndexEntry_FixByteOrder(
+                                            PPNativeFileFormatChunkIndexEntry *indexEntry);
+static void PPNativeFileFormatThumbnailsHeader_FixByteOrder(
+                                        PPNativeFileFormatThumbnailsHeader *thumbnailsHeader);
+static void PPNativeFileFormatThumbnailEntry_FixByteOrder(
+                                            PPNativeFileFormatThumbnailEntry *thumbnailEntry);
+static bool GetSectionRangesOfNativeFileFormatData(NSData *data,
+                                            PPNativeFileFormatSectionRanges *returnedRanges,
+                                            NSError **returnedError);
+static NSData *ThumbnailsDataForMergedBitmap(NSBitmapImageRep *mergedBitmap);
+
+@implementation PPDocument (NativeFileFormat)
+
+- (NSData *) nativeFileFormatData
+{
+    return [self nativeFileFormatDataFromSnapshot: [self nativeFileFormatSnapshot]
+                    returnedStoredLayerChunks: NULL];
+}
+
+- (id) nativeFileFormatSnapshot
+{
+    PPNativeFileFormatLayerChunks *layerChunks;
+    bool shouldUseLayerChunks;
+    unsigned minFormatVersion;
+    NSData *archivedDocumentData;
+    NSBitmapImageRep *mergedBitmap = nil;
+
+    layerChunks = [[[PPNativeFileFormatLayerChunks alloc] initForWriting] autorelease];
+
+    if (!layerChunks)
+        goto ERROR;
+
+    // autosaves always use layer chunks, because the autosave journal's records reference the
+    // checkpoint's chunks; the journal's records may also store indexed tiles (which a v3
+    // reader can't decode), so autosaves are at least v4
+
+    shouldUseLayerChunks =
+        ((_saveFormat == kPPDocumentSaveFormat_Autosave)
+            || (_canvasFrame.size.width * _canvasFrame.size.height * _numLayers
+                    > kMaxLayerPixelsForUnchunkedFormat)) ? YES : NO;
+
+    if (_saveFormat == kPPDocumentSaveFormat_Autosave)
+    {
+        minFormatVersion = kPPNativeFileFormatVersion_4;
+    }
+    else if (shouldUseLayerChunks)
+    {
+        minFormatVersion = kPPNativeFileFormatVersion_3;
+    }
+    else if (_layerBlendingMode == kPPLayerBlendingMode_Linear)
+    {
+        minFormatVersion = kPPNativeFileFormatVersion_2;
+    }
+    else
+    {
+        minFormatVersion = kPPNativeFileFormatVersion_1;
+    }
+
+    // without the layer chunks delegate, the layers archive their bitmaps as TIFF data
+
+    archivedDocumentData =
+        [self nativeArchivedDocumentDataUsingLayerChunksDelegate:
+                                                    (shouldUseLayerChunks) ? layerChunks : nil];
+
+    if (![archivedDocumentData length])
+        goto ERROR;
+
+    // in order to speed up autosaving, the PNG representation is left blank, so the merged
+    // bitmap's only needed for other saves
+
+    if (_saveFormat != kPPDocumentSaveFormat_Autosave)
+    {
+        mergedBitmap = [[_mergedVisibleLayersBitmap copy] autorelease];
+
+        if (!mergedBitmap)
+            goto ERROR;
+    }
+
+    return [[[PPNativeFileFormatSnapshot alloc]
+                                    initWithArchivedDocumentData: archivedDocumentData
+                                    layerChunks: layerChunks
+                                    mergedBitmap: mergedBitmap
+                                    minFormatVersion: minFormatVersion]
+                            autorelease];
+
+ERROR:
+    return nil;
+}
+
+- (NSData *) nativeFileFormatDataFromSnapshot: (id) snapshot
+                returnedStoredLayerChunks: (NSArray **) returnedStoredLayerChunks
+{
+    PPNativeFileFormatLayerChunks *layerChunks;
+    NSBitmapImageRep *mergedBitmap;
+    NSData *pngData, *thumbnailsData, *archivedDocumentData, *layerChunksData,
+            *chunkIndexData;
+    NSMutableData *nativeFileFormatData;
+    unsigned formatVersion, descriptorLength;
+    PPNativeFileFormatDataDescriptor dataDescriptor;
+    PPNativeFileFormatDataTrailer dataTrailer;
+
+    if (![snapshot isKindOfClass: [PPNativeFileFormatSnapshot class]])
+    {
+        goto ERROR;
+    }
+
+    layerChunks = [snapshot layerChunks];
+
+    if (![layerChunks encodeStoredLayersWithCancellationFlag:
+                                        (_asynchronousAutosaveIsCancellable) ?
+                                                &_shouldCancelAsynchronousAutosave : NULL])
+    {
+        goto ERROR;
+    }
+
+    formatVersion = [snapshot minFormatVersion];
+
+    mergedBitmap = [snapshot mergedBitmap];
+
+    pngData = (mergedBitmap) ? [mergedBitmap ppCompressedPNGData] : [NSData data];
+
+    // thumbnails are only stored in chunked data (v3+ layout), & only for images larger than
+    // the smallest thumbnail (smaller images' PNG data is as quick to read)
+
+    if (mergedBitmap && (formatVersion >= kPPNativeFileFormatVersion_3)
+        && (([mergedBitmap pixelsWide] > kMinThumbnailDimension)
+            || ([mergedBitmap pixelsHigh] > kMinThumbnailDimension)))
+    {
+        thumbnailsData = ThumbnailsDataForMergedBitmap(mergedBitmap);
+    }
+    else
+    {
+        thumbnailsData = [NSData data];
+    }
+
+    archivedDocumentData = [snapshot archivedDocumentData];
+    layerChunksData = [layerChunks layerChunksData];
+    chunkIndexData = [layerChunks chunkIndexData];
+
+    nativeFileFormatData = [NSMutableData data];
+
+    if (!pngData || !thumbnailsData || ![archivedDocumentData length] || !layerChunksData
+        || !chunkIndexData || !nativeFileFormatData)
+    {
+        goto ERROR;
+    }
+
+    dataDescriptor.signature = kPPNativeFormatDataDescriptorSignature;
+    dataDescriptor.pngDataLength = [pngData length];
+    dataDescriptor.archivedDocumentDataLength = [archivedDocumentData length];
+    dataDescriptor.layerChunksDataLength = [layerChunksData length];
+    dataDescriptor.chunkIndexLength = [chunkIndexData length];
+    dataDescriptor.thumbnailsDataLength = [thumbnailsData length];
+
+    if ([thumbnailsData length] || [layerChunks storedChunksUseIndexedTiles])
+    {
+        formatVersion = MAX(formatVersion, kPPNativeFileFormatVersion_4);
+    }
+
+    // the descriptor's written without the members of versions later than the format version
+    // (their lengths are all zero)
+
+    if (formatVersion >= kPPNativeFileFormatVersion_4)
+    {
+        descriptorLength = sizeof(PPNativeFileFormatDataDescriptor);
+    }
+    else if (formatVersion == kPPNativeFileFormatVersion_3)
+    {
+        descriptorLength = kPPNativeFileFormatDataDescriptorLength_v3;
+    }
+    else
+    {
+        descriptorLength = kPPNativeFileFormatDataDescriptorLength_v1;
+    }
+
+    dataTrailer.signature = kPPNativeFormatDataTrailerSignature;
+    dataTrailer.formatVersion = formatVersion;
+    dataTrailer.minSupportedFormatVersion = formatVersion;
+    dataTrailer.descriptorLength = descriptorLength;
+
+    PPNativeFileFormatDataDescriptor_FixByteOrder(&dataDescriptor);
+    PPNativeFileFormatDataTrailer_FixByteOrder(&dataTrailer);
+
+    [nativeFileFormatData appendData: pngData];
+    [nativeFileFormatData appendData: thumbnailsData];
+    [nativeFileFormatData appendData: layerChunksData];
+    [nativeFileFormatData appendData: chunkIndexData];
+    [nativeFileFormatData appendData: archivedDocumentData];
+    [nativeFileFormatData appendBytes: &dataDescriptor length: descriptorLength];
+    [nativeFileFormatData appendBytes: &dataTrailer length: sizeof(dataTrailer)];
+
+    if (returnedStoredLayerChunks)
+    {
+        *returnedStoredLayerChunks = [layerChunks storedChunks];
+    }
+
+    return nativeFileFormatData;
+
+ERROR:
+    return nil;
+}
+
+- (NSData *) nativeArchivedDocumentDataUsingLayerChunksDelegate: (id) layerChunksDelegate
+{
+    NSMutableData *archivedDocumentData;
+    NSKeyedArchiver *archiver;
+
+    archivedDocumentData = [NSMutableData data];
+
+    if (!archivedDocumentData)
+        goto ERROR;
+
+    archiver = [[[NSKeyedArchiver alloc] initForWritingWithMutableData: archivedDocumentData]
+                                    autorelease];
+
+    if (!archiver)
+        goto ERROR;
+
+    // the archiver's delegate stores the layers' bitmaps as separate chunks as they're
+    // encoded (-[PPDocumentLayer encodeWithCoder:])
+
+    [archiver setDelegate: layerChunksDelegate];
+    [archiver encodeObject: self forKey: kKeyedArchiveRootObjectKey];
+    [archiver finishEncoding];
+    [archiver setDelegate: nil];
+
+    return archivedDocumentData;
+
+ERROR:
+    return nil;
+}
+
++ (PPDocument *) ppDocumentFromNativeFileFormatData: (NSData *) data
+                    returnedError: (NSError **) returnedError
+{
+    return [self ppDocumentFromNativeFileFormatData: data
+                    autosaveJournalData: nil
+                    returnedError: returnedError];
+}
+
++ (PPDocument *) ppDocumentFromNativeFileFormatData: (NSData *) data
+                    autosaveJournalData: (NSData *) autosaveJournalData
+                    returnedError: (NSError **) returnedError
+{
+    NSError *error = nil;
+    PPNativeFileFormatSectionRanges sectionRanges;
+    NSData *archivedDocumentData;
+    PPNativeFileFormatLayerChunks *layerChunks = nil;
+    id unarchiverDelegate;
+    NSKeyedUnarchiver *unarchiver;
+    PPDocument *document;
+
+    if (!GetSectionRangesOfNativeFileFormatData(data, &sectionRanges, &error))
+    {
+        goto ERROR;
+    }
+
+    // the archive references the file data's bytes rather than copying them (the file data's
+    // usually memory-mapped - see -[PPDocument readFromURL:ofType:error:]); it's only used
+    // while unarchiving, whereas layer chunks (kept for lazy decoding) are copied out
+
+    archivedDocumentData =
+                [data ppSubdataWithRangeNoCopy: sectionRanges.archivedDocumentDataRange];
+
+    if (!archivedDocumentData)
+        goto ERROR;
+
+    if (sectionRanges.chunkIndexRange.length)
+    {
+        layerChunks =
+            [[[PPNativeFileFormatLayerChunks alloc]
+                                initForReadingFromFileData: data
+                                layerChunksRange: sectionRanges.layerChunksRange
+                                chunkIndexRange: sectionRanges.chunkIndexRange]
+                        autorelease];
+
+        if (!layerChunks)
+            goto ERROR;
+    }
+
+    unarchiverDelegate = layerChunks;
+
+    if (autosaveJournalData && layerChunks)
+    {
+        PPAutosaveJournal *journal =
+            [[[PPAutosaveJournal alloc] initForReadingLatestRecordInJournalData:
+                                                                        autosaveJournalData
+                                            checkpointData: data
+                                            checkpointLayerChunks: layerChunks]
+                                    autorelease];
+
+        // a missing or invalid journal isn't an error - the checkpoint data's still usable
+
+        if (journal)
+        {
+            archivedDocumentData = [journal archivedDocumentData];
+            unarchiverDelegate = journal;
+        }
+    }
+
+    unarchiver = [[[NSKeyedUnarchiver alloc] initForReadingWithData: archivedDocumentData]
+                                        autorelease];
+
+    if (!unarchiver)
+        goto ERROR;
+
+    // the unarchiver's delegate supplies the layers' bitmap chunks as they're decoded
+    // (-[PPDocumentLayer initWithCoder:]); the layers retain their chunks & decode them later
+
+    [unarchiver setDelegate: unarchiverDelegate];
+    document = [unarchiver decodeObjectForKey: kKeyedArchiveRootObjectKey];
+    [unarchiver finishDecoding];
+    [unarchiver setDelegate: nil];
+
+    if (![document isKindOfClass: [PPDocument class]])
+    {
+        goto ERROR;
+    }
+
+    if (returnedError)
+    {
+        *returnedError = nil;
+    }
+
+    return document;
+
+ERROR:
+    if (returnedError)
+    {
+        if (!error)
+        {
+            error = [NSError ppError_ImageFileIsCorrupt];
+        }
+
+        *returnedError = error;
+    }
+
+    return nil;
+}
+
++ (NSBitmapImageRep *) nativeFileFormatThumbnailFromData: (NSData *) data
+                        minDimension: (unsigned) minDimension
+{
+    PPNativeFileFormatSectionRanges sectionRanges;
+    const unsigned char *thumbnailsBytes;
+    PPNativeFileFormatThumbnailsHeader thumbnailsHeader;
+    PPNativeFileFormatThumbnailEntry thumbnailEntry, selectedEntry;
+    unsigned thumbnailIndex, thumbnailDimension, selectedDimension = 0;
+    NSRange thumbnailDataRange;
+    NSBitmapImageRep *thumbnailBitmap;
+
+    if (!GetSectionRangesOfNativeFileFormatData(data, &sectionRanges, NULL)
+        || (sectionRanges.thumbnailsDataRange.length < sizeof(thumbnailsHeader)))
+    {
+        goto ERROR;
+    }
+
+    thumbnailsBytes = &((const unsigned char *) [data bytes])
+                                                [sectionRanges.thumbnailsDataRange.location];
+
+    memcpy(&thumbnailsHeader, thumbnailsBytes, sizeof(thumbnailsHeader));
+    PPNativeFileFormatThumbnailsHeader_FixByteOrder(&thumbnailsHeader);
+
+    if ((thumbnailsHeader.signature != kPPNativeFormatThumbnailsSignature)
+        || !thumbnailsHeader.numThumbnails
+        || (thumbnailsHeader.numThumbnails
+                > (sectionRanges.thumbnailsDataRange.length - sizeof(thumbnailsHeader))
+                    / sizeof(thumbnailEntry)))
+    {
+        goto ERROR;
+    }
+
+    // thumbnails are stored largest first, so the last one that's at least minDimension is
+    // the smallest suitable one (if none are, the first - largest - one's used)
+
+    for (thumbnailIndex=0; thumbnailIndex<thumbnailsHeader.numThumbnails; thumbnailIndex++)
+    {
+        memcpy(&thumbnailEntry,
+                &thumbnailsBytes[sizeof(thumbnailsHeader)
+                                    + thumbnailIndex * sizeof(thumbnailEntry)],
+                sizeof(thumbnailEntry));
+        PPNativeFileFormatThumbnailEntry_FixByteOrder(&thumbnailEntry);
+
+        thumbnailDimension = MAX(thumbnailEntry.width, thumbnailEntry.height);
+
+        if (!thumbnailIndex || (thumbnailDimension >= minDimension))
+        {
+            selectedEntry = thumbnailEntry;
+            selectedDimension = thumbnailDimension;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (!selectedDimension
+        || (selectedDimension > kMaxThumbnailDimension)
+        || !MIN(selectedEntry.width, selectedEntry.height)
+        || (selectedEntry.dataOffset > sectionRanges.thumbnailsDataRange.length)
+        || (selectedEntry.dataLength
+                > sectionRanges.thumbnailsDataRange.length - selectedEntry.dataOffset))
+    {
+        goto ERROR;
+    }
+
+    thumbnailDataRange =
+        NSMakeRange(sectionRanges.thumbnailsDataRange.location + selectedEntry.dataOffset,
+                    selectedEntry.dataLength);
+
+    thumbnailBitmap =
+        [NSBitmapImageRep ppImageBitmapOfSize: NSMakeSize(selectedEntry.width,
+                                                            selectedEntry.height)];
+
+    if (!thumbnailBitmap
+        || ![thumbnailBitmap ppDecodeTileEncodedData:
+                                        [data ppSubdataWithRangeNoCopy: thumbnailDataRange]])
+    {
+        goto ERROR;
+    }
+
+    return thumbnailBitmap;
+
+ERROR:
+    return nil;
+}
+
++ (NSBitmapImageRep *) nativeFileFormatThumbnailFromFileAtURL: (NSURL *) fileURL
+                        minDimension: (unsigned) minDimension
+{
+    NSData *data;
+
+    if (![fileURL isFileURL])
+    {
+        goto ERROR;
+    }
+
+    // mapped, so only the pages with the trailer, descriptor & thumbnail are read from disk
+
+    data = [NSData dataWithContentsOfURL: fileURL
+                    options: NSDataReadingMappedIfSafe
+                    error: NULL];
+
+    if (!data)
+        goto ERROR;
+
+    return [self nativeFileFormatThumbnailFromData: data minDimension: minDimension];
+
+ERROR:
+    return nil;
+}
+
+@end
+
+@implementation PPNativeFileFormatLayerChunks
+
+- initForWriting
+{
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    _layersToEncode = [[NSMutableArray alloc] init];
+    _layerChunksData = [[NSMutableData alloc] init];
+    _chunkIndexEntriesData = [[NSMutableData alloc] init];
+    _storedChunks = [[NSMutableArray alloc] init];
+
+    if (!_layersToEncode || !_layerChunksData || !_chunkIndexEntriesData || !_storedChunks)
+    {
+        goto ERROR;
+    }
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- initForReadingFromFileData: (NSData *) fileData
+    layerChunksRange: (NSRange) layerChunksRange
+    chunkIndexRange: (NSRange) chunkIndexRange
+{
+    const unsigned char *fileBytes;
+    PPNativeFileFormatChunkIndexHeader indexHeader;
+    PPNativeFileFormatChunkIndexEntry indexEntry;
+    unsigned chunkIndex;
+
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    fileBytes = [fileData bytes];
 
-#define kMaxSupportedPPNativeFileFormatVersion  kPPNativeFileFormatVersion_2
+    if (!fileBytes
+        || (NSMaxRange(layerChunksRange) > [fileData length])
+        || (NSMaxRange(chunkIndexRange) > [fileData length])
+        || (chunkIndexRange.length < sizeof(indexHeader)))
+    {
+        goto ERROR;
+    }
 
+    memcpy(&indexHeader, &fileBytes[chunkIndexRange.location], sizeof(indexHeader));
+    PPNativeFileFormatChunkIndexHeader_FixByteOrder(&indexHeader);
 
-// Format versions used when writing data, based on whether linear blending is enabled
-#define kPPNativeFormatVersion_UsesLinearBlending       kPPNativeFileFormatVersion_2
-#define kPPNativeFormatVersion_UsesStandardBlending     kPPNativeFileFormatVersion_1
+    if ((indexHeader.signature != kPPNativeFormatChunkIndexSignature)
+        || (chunkIndexRange.length
+                != sizeof(indexHeader) + indexHeader.numChunks * sizeof(indexEntry)))
+    {
+        goto ERROR;
+    }
 
+    _fileData = [fileData retain];
+    _layerChunksRange = layerChunksRange;
+    _chunkIndexEntries = &fileBytes[chunkIndexRange.location + sizeof(indexHeader)];
+    _numChunks = indexHeader.numChunks;
 
-typedef struct
-{
-    uint32_t signature;
-    uint32_t formatVersion;
-    uint32_t minSupportedFormatVersion;
-    uint32_t descriptorLength;
+    // validate all chunk ranges up front
 
-} PPNativeFileFormatDataTrailer;
+    for (chunkIndex=0; chunkIndex<_numChunks; chunkIndex++)
+    {
+        memcpy(&indexEntry, &_chunkIndexEntries[chunkIndex * sizeof(indexEntry)],
+                sizeof(indexEntry));
+        PPNativeFileFormatChunkIndexEntry_FixByteOrder(&indexEntry);
 
-typedef struct
-{
-    uint32_t signature;
-    uint32_t pngDataLength;
-    uint32_t archivedDocumentDataLength;
+        if ((indexEntry.chunkOffset > _layerChunksRange.length)
+            || (indexEntry.chunkLength > _layerChunksRange.length - indexEntry.chunkOffset))
+        {
+            goto ERROR;
+        }
+    }
 
-} PPNativeFileFormatDataDescriptor;
+    return self;
 
+ERROR:
+    [self release];
 
-static void SwapUInt32sWithByteCount(uint32_t *uint32sToSwap, unsigned byteCount);
-static void PPNativeFileFormatDataTrailer_FixByteOrder(
-                                                PPNativeFileFormatDataTrailer *dataTrailer);
-static void PPNativeFileFormatDataDescriptor_FixByteOrder(
-                                            PPNativeFileFormatDataDescriptor *dataDescriptor);
+    return nil;
+}
 
-@implementation PPDocument (NativeFileFormat)
+- init
+{
+    return [self initForWriting];
+}
 
-- (NSData *) nativeFileFormatData
+- (void) dealloc
 {
-    NSData *pngData, *archivedDocumentData;
-    NSMutableData *nativeFileFormatData;
-    PPNativeFileFormatDataDescriptor dataDescriptor;
-    PPNativeFileFormatDataTrailer dataTrailer;
+    [_layersToEncode release];
+    [_layerChunksData release];
+    [_chunkIndexEntriesData release];
+    [_storedChunks release];
 
-    if (_saveFormat != kPPDocumentSaveFormat_Autosave)
+    [_fileData release];
+
+    [super dealloc];
+}
+
+- (bool) encodeStoredLayersWithCancellationFlag: (volatile bool *) cancellationFlag
+{
+    unsigned numLayers, layerIndex;
+    PPDocumentLayer *layer, *layerCopy;
+    NSData *chunkData;
+    PPNativeFileFormatChunkIndexEntry indexEntry;
+    bool isMainThread;
+
+    if (!_layersToEncode || !_layerChunksData || !_chunkIndexEntriesData || !_storedChunks)
     {
-        pngData = [_mergedVisibleLayersBitmap ppCompressedPNGData];
+        goto ERROR;
     }
-    else
+
+    numLayers = [_layersToEncode count] / 2;
+    isMainThread = [NSThread isMainThread] ? YES : NO;
+
+    for (layerIndex=0; layerIndex<numLayers; layerIndex++)
     {
-        // in order to speed up autosaving, leave the PNG representation blank
-        pngData = [NSData data];
+        if (cancellationFlag && *cancellationFlag)
+        {
+            goto ERROR;
+        }
+
+        layer = [_layersToEncode objectAtIndex: 2 * layerIndex];
+        layerCopy = [_layersToEncode objectAtIndex: 2 * layerIndex + 1];
+
+        // the copy shares the layer's bitmap (or its cached encoded data), and the layer
+        // unshares before modifying it, so the copy's safe to encode on a background thread
+
+        chunkData = [layerCopy tileEncodedBitmapData];
+
+        if (![chunkData length])
+            goto ERROR;
+
+        indexEntry.chunkOffset = [_layerChunksData length];
+        indexEntry.chunkLength = [chunkData length];
+
+        PPNativeFileFormatChunkIndexEntry_FixByteOrder(&indexEntry);
+
+        [_layerChunksData appendData: chunkData];
+        [_chunkIndexEntriesData appendBytes: &indexEntry length: sizeof(indexEntry)];
+        [_storedChunks addObject: chunkData];
+
+        if (!_storedChunksUseIndexedTiles
+            && [NSBitmapImageRep ppTileEncodedDataUsesIndexedTiles: chunkData])
+        {
+            _storedChunksUseIndexedTiles = YES;
+        }
+
+        // the original layer can keep the encoded data as its cache (so it isn't re-encoded by
+        // the next save) if it's unchanged since the snapshot
+
+        if (isMainThread)
+        {
+            [layer adoptTileEncodedBitmapDataFromLayerCopy: layerCopy];
+        }
+        else
+        {
+            [layer performSelectorOnMainThread:
+                                        @selector(adoptTileEncodedBitmapDataFromLayerCopy:)
+                    withObject: layerCopy
+                    waitUntilDone: NO];
+        }
     }
 
-    archivedDocumentData = [NSKeyedArchiver archivedDataWithRootObject: self];
+    [_layersToEncode removeAllObjects];
 
-    nativeFileFormatData = [NSMutableData data];
+    return YES;
 
-    if (!pngData || !archivedDocumentData || !nativeFileFormatData)
-    {
+ERROR:
+    return NO;
+}
+
+- (NSData *) layerChunksData
+{
+    return _layerChunksData;
+}
+
+- (NSArray *) storedChunks
+{
+    return _storedChunks;
+}
+
+- (bool) storedChunksUseIndexedTiles
+{
+    return _storedChunksUseIndexedTiles;
+}
+
+- (NSData *) chunkIndexData
+{
+    NSMutableData *chunkIndexData;
+    PPNativeFileFormatChunkIndexHeader indexHeader;
+
+    if (!_chunkIndexEntriesData)
         goto ERROR;
+
+    // data without layer chunks (v1/v2) has no chunk index
+
+    if (!_numChunks)
+    {
+        return [NSData data];
     }
 
-    dataDescriptor.signature = kPPNativeFormatDataDescriptorSignature;
-    dataDescriptor.pngDataLength = [pngData length];
-    dataDescriptor.archivedDocumentDataLength = [archivedDocumentData length];
+    chunkIndexData = [NSMutableData dataWithCapacity:
+                                        sizeof(indexHeader) + [_chunkIndexEntriesData length]];
 
-    dataTrailer.signature = kPPNativeFormatDataTrailerSignature;
+    if (!chunkIndexData)
+        goto ERROR;
+
+    indexHeader.signature = kPPNativeFormatChunkIndexSignature;
+    indexHeader.numChunks = _numChunks;
+
+    PPNativeFileFormatChunkIndexHeader_FixByteOrder(&indexHeader);
+
+    [chunkIndexData appendBytes: &indexHeader length: sizeof(indexHeader)];
+    [chunkIndexData appendData: _chunkIndexEntriesData];
+
+    return chunkIndexData;
+
+ERROR:
+    return nil;
+}
+
+#pragma mark PPDocumentLayerBitmapChunkCodingDelegateMethods
 
-    if (_layerBlendingMode == kPPLayerBlendingMode_Linear)
+- (int) ppIndexOfStoredBitmapChunkForLayer: (PPDocumentLayer *) layer
+{
+    PPDocumentLayer *layerCopy;
+
+    if (!_layersToEncode || !layer)
     {
-        dataTrailer.formatVersion = kPPNativeFormatVersion_UsesLinearBlending;
-        dataTrailer.minSupportedFormatVersion = kPPNativeFormatVersion_UsesLinearBlending;
+        goto ERROR;
     }
-    else
+
+    layerCopy = [[layer copy] autorelease];
+
+    if (!layerCopy)
+        goto ERROR;
+
+    [layerCopy setDelegate: nil];
+
+    [_layersToEncode addObject: layer];
+    [_layersToEncode addObject: layerCopy];
+
+    return _numChunks++;
+
+ERROR:
+    return -1;
+}
+
+- (NSData *) ppLayerBitmapChunkAtIndex: (int) chunkIndex
+{
+    PPNativeFileFormatChunkIndexEntry indexEntry;
+
+    if (!_fileData || (chunkIndex < 0) || ((unsigned) chunkIndex >= _numChunks))
     {
-        dataTrailer.formatVersion = kPPNativeFormatVersion_UsesStandardBlending;
-        dataTrailer.minSupportedFormatVersion = kPPNativeFormatVersion_UsesStandardBlending;
+        goto ERROR;
     }
 
-    dataTrailer.descriptorLength = sizeof(PPNativeFileFormatDataDescriptor);
+    memcpy(&indexEntry, &_chunkIndexEntries[chunkIndex * sizeof(indexEntry)],
+            sizeof(indexEntry));
+    PPNativeFileFormatChunkIndexEntry_FixByteOrder(&indexEntry);
 
-    PPNativeFileFormatDataDescriptor_FixByteOrder(&dataDescriptor);
-    PPNativeFileFormatDataTrailer_FixByteOrder(&dataTrailer);
+    // return a copy rather than a no-copy subrange: the returned chunk is kept by its layer
+    // (decoded lazily) for the document's lifetime, and _fileData may be a memory-mapped
+    // file, so referencing it directly would fault (SIGBUS) if the file were later truncated
+    // or rewritten in place by another process
 
-    [nativeFileFormatData appendData: pngData];
-    [nativeFileFormatData appendData: archivedDocumentData];
-    [nativeFileFormatData appendBytes: &dataDescriptor length: sizeof(dataDescriptor)];
-    [nativeFileFormatData appendBytes: &dataTrailer length: sizeof(dataTrailer)];
+    return [_fileData subdataWithRange:
+                            NSMakeRange(_layerChunksRange.location + indexEntry.chunkOffset,
+                                        indexEntry.chunkLength)];
 
-    return nativeFileFormatData;
+ERROR:
+    return nil;
+}
+
+@end
+
+@implementation PPNativeFileFormatSnapshot
+
+- initWithArchivedDocumentData: (NSData *) archivedDocumentData
+    layerChunks: (PPNativeFileFormatLayerChunks *) layerChunks
+    mergedBitmap: (NSBitmapImageRep *) mergedBitmap
+    minFormatVersion: (unsigned) minFormatVersion
+{
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    if (!archivedDocumentData || !layerChunks)
+    {
+        goto ERROR;
+    }
+
+    _archivedDocumentData = [archivedDocumentData retain];
+    _layerChunks = [layerChunks retain];
+    _mergedBitmap = [mergedBitmap retain];
+    _minFormatVersion = minFormatVersion;
+
+    return self;
 
 ERROR:
-    return archivedDocumentData;
+    [self release];
+
+    return nil;
 }
 
-+ (PPDocument *) ppDocumentFromNativeFileFormatData: (NSData *) data
-                    returnedError: (NSError **) returnedError
+- init
+{
+    return [self initWithArchivedDocumentData: nil
+                    layerChunks: nil
+                    mergedBitmap: nil
+                    minFormatVersion: 0];
+}
+
+- (void) dealloc
+{
+    [_archivedDocumentData release];
+    [_layerChunks release];
+    [_mergedBitmap release];
+
+    [super dealloc];
+}
+
+- (NSData *) archivedDocumentData
+{
+    return _archivedDocumentData;
+}
+
+- (PPNativeFileFormatLayerChunks *) layerChunks
+{
+    return _layerChunks;
+}
+
+- (NSBitmapImageRep *) mergedBitmap
+{
+    return _mergedBitmap;
+}
+
+- (unsigned) minFormatVersion
+{
+    return _minFormatVersion;
+}
+
+@end
+
+#pragma mark Private functions
+
+static bool GetSectionRangesOfNativeFileFormatData(NSData *data,
+                                            PPNativeFileFormatSectionRanges *returnedRanges,
+                                            NSError **returnedError)
 {
     const unsigned char *dataBytes;
     unsigned dataLength, numBytesFromEndOfData;
-    NSError *error = nil;
     PPNativeFileFormatDataTrailer dataTrailer;
     PPNativeFileFormatDataDescriptor dataDescriptor;
-    NSData *archivedDocumentData;
-    PPDocument *document;
+
+    if (returnedError)
+    {
+        *returnedError = nil;
+    }
 
     dataBytes = [data bytes];
     dataLength = [data length];
 
-    if (!data || (dataLength < sizeof(dataTrailer)))
+    if (!data || !returnedRanges || (dataLength < sizeof(dataTrailer)))
     {
         goto ERROR;
     }
@@ -185,7 +1138,17 @@ ERROR:
 
     if (dataTrailer.minSupportedFormatVersion > kMaxSupportedPPNativeFileFormatVersion)
     {
-        error = [NSError ppError_ImageFileVersionIsTooNew];
+        if (returnedError)
+        {
+            *returnedError = [NSError ppError_ImageFileVersionIsTooNew];
+        }
+
+        goto ERROR;
+    }
+
+    if ((dataTrailer.descriptorLength < kPPNativeFileFormatDataDescriptorLength_v1)
+        || (dataTrailer.descriptorLength >= dataLength))
+    {
         goto ERROR;
     }
 
@@ -196,8 +1159,11 @@ ERROR:
         goto ERROR;
     }
 
+    // older descriptors don't have the later versions' members, so they're left zeroed
+
+    memset(&dataDescriptor, 0, sizeof(dataDescriptor));
     memcpy(&dataDescriptor, &dataBytes[dataLength - numBytesFromEndOfData],
-            sizeof(dataDescriptor));
+            MIN(sizeof(dataDescriptor), dataTrailer.descriptorLength));
     PPNativeFileFormatDataDescriptor_FixByteOrder(&dataDescriptor);
 
     if (dataDescriptor.signature != kPPNativeFormatDataDescriptorSignature)
@@ -205,8 +1171,13 @@ ERROR:
         goto ERROR;
     }
 
-    if ((dataDescriptor.pngDataLength + dataDescriptor.archivedDocumentDataLength
-            + numBytesFromEndOfData) != dataLength)
+    if (((unsigned long long) dataDescriptor.pngDataLength
+            + (unsigned long long) dataDescriptor.thumbnailsDataLength
+            + (unsigned long long) dataDescriptor.archivedDocumentDataLength
+            + (unsigned long long) dataDescriptor.layerChunksDataLength
+            + (unsigned long long) dataDescriptor.chunkIndexLength
+            + numBytesFromEndOfData)
+        != dataLength)
     {
         goto ERROR;
     }
@@ -218,42 +1189,129 @@ ERROR:
 
     numBytesFromEndOfData += dataDescriptor.archivedDocumentDataLength;
 
-    archivedDocumentData = [NSData dataWithBytes: &dataBytes[dataLength - numBytesFromEndOfData]
-                                        length: dataDescriptor.archivedDocumentDataLength];
+    returnedRanges->archivedDocumentDataRange =
+                                NSMakeRange(dataLength - numBytesFromEndOfData,
+                                            dataDescriptor.archivedDocumentDataLength);
 
-    if (!archivedDocumentData)
-        goto ERROR;
+    numBytesFromEndOfData += dataDescriptor.chunkIndexLength;
 
-    document = [NSKeyedUnarchiver unarchiveObjectWithData: archivedDocumentData];
+    returnedRanges->chunkIndexRange = NSMakeRange(dataLength - numBytesFromEndOfData,
+                                                    dataDescriptor.chunkIndexLength);
 
-    if (![document isKindOfClass: [PPDocument class]])
+    numBytesFromEndOfData += dataDescriptor.layerChunksDataLength;
+
+    returnedRanges->layerChunksRange = NSMakeRange(dataLength - numBytesFromEndOfData,
+                                                    dataDescriptor.layerChunksDataLength);
+
+    numBytesFromEndOfData += dataDescriptor.thumbnailsDataLength;
+
+    returnedRanges->thumbnailsDataRange = NSMakeRange(dataLength - numBytesFromEndOfData,
+                                                        dataDescriptor.thumbnailsDataLength);
+
+    returnedRanges->pngDataRange = NSMakeRange(0, dataDescriptor.pngDataLength);
+
+    return YES;
+
+ERROR:
+    return NO;
+}
+
+static NSData *ThumbnailsDataForMergedBitmap(NSBitmapImageRep *mergedBitmap)
+{
+    NSMutableArray *thumbnailBitmaps, *thumbnailsEncodedData;
+    NSBitmapImageRep *thumbnailBitmap, *previousThumbnailBitmap = nil;
+    unsigned thumbnailDimension, numThumbnails, thumbnailIndex, dataOffset;
+    NSSize thumbnailSize;
+    NSData *encodedData;
+    NSMutableData *thumbnailsData;
+    PPNativeFileFormatThumbnailsHeader thumbnailsHeader;
+    PPNativeFileFormatThumbnailEntry thumbnailEntry;
+
+    thumbnailBitmaps = [NSMutableArray array];
+    thumbnailsEncodedData = [NSMutableArray array];
+
+    if (!mergedBitmap || !thumbnailBitmaps || !thumbnailsEncodedData)
     {
         goto ERROR;
     }
 
-    if (returnedError)
-    {
-        *returnedError = nil;
-    }
+    // each thumbnail's downsampled from the previous (larger) one, so only the first reads the
+    // full-size bitmap; thumbnails are never larger than the merged bitmap, so small images
+    // have fewer thumbnails (the largest may be the image itself)
 
-    return document;
+    previousThumbnailBitmap = mergedBitmap;
 
-ERROR:
-    if (returnedError)
+    for (thumbnailDimension=kMaxThumbnailDimension;
+            thumbnailDimension>=kMinThumbnailDimension;
+            thumbnailDimension/=2)
     {
-        if (!error)
+        thumbnailBitmap =
+            [previousThumbnailBitmap ppImageBitmapAveragedDownToMaxDimension:
+                                                                        thumbnailDimension];
+
+        if (!thumbnailBitmap)
+            goto ERROR;
+
+        if ([thumbnailBitmaps count] && (thumbnailBitmap == previousThumbnailBitmap))
         {
-            error = [NSError ppError_ImageFileIsCorrupt];
+            continue;
         }
 
-        *returnedError = error;
+        encodedData = [thumbnailBitmap ppTileEncodedData];
+
+        if (!encodedData)
+            goto ERROR;
+
+        [thumbnailBitmaps addObject: thumbnailBitmap];
+        [thumbnailsEncodedData addObject: encodedData];
+
+        previousThumbnailBitmap = thumbnailBitmap;
+    }
+
+    numThumbnails = [thumbnailBitmaps count];
+
+    thumbnailsData = [NSMutableData data];
+
+    if (!thumbnailsData)
+        goto ERROR;
+
+    thumbnailsHeader.signature = kPPNativeFormatThumbnailsSignature;
+    thumbnailsHeader.numThumbnails = numThumbnails;
+
+    PPNativeFileFormatThumbnailsHeader_FixByteOrder(&thumbnailsHeader);
+
+    [thumbnailsData appendBytes: &thumbnailsHeader length: sizeof(thumbnailsHeader)];
+
+    dataOffset = sizeof(thumbnailsHeader) + numThumbnails * sizeof(thumbnailEntry);
+
+    for (thumbnailIndex=0; thumbnailIndex<numThumbnails; thumbnailIndex++)
+    {
+        thumbnailSize = [[thumbnailBitmaps objectAtIndex: thumbnailIndex] ppSizeInPixels];
+        encodedData = [thumbnailsEncodedData objectAtIndex: thumbnailIndex];
+
+        thumbnailEntry.width = thumbnailSize.width;
+        thumbnailEntry.height = thumbnailSize.height;
+        thumbnailEntry.dataOffset = dataOffset;
+        thumbnailEntry.dataLength = [encodedData length];
+
+        dataOffset += thumbnailEntry.dataLength;
+
+        PPNativeFileFormatThumbnailEntry_FixByteOrder(&thumbnailEntry);
+
+        [thumbnailsData appendBytes: &thumbnailEntry length: sizeof(thumbnailEntry)];
+    }
+
+    for (thumbnailIndex=0; thumbnailIndex<numThumbnails; thumbnailIndex++)
+    {
+        [thumbnailsData appendData: [thumbnailsEncodedData objectAtIndex: thumbnailIndex]];
     }
 
+    return thumbnailsData;
+
+ERROR:
     return nil;
 }
 
-@end
-
 #define macroSwapUInt32(uint32ToSwap)               \
             (((uint32ToSwap & 0xFF000000) >> 24)    \
             | ((uint32ToSwap & 0x00FF0000) >> 8)    \
@@ -294,3 +1352,39 @@ static void PPNativeFileFormatDataDescriptor_FixByteOrder(
     }
 }
 
+
+static void PPNativeFileFormatChunkIndexHeader_FixByteOrder(
+                                            PPNativeFileFormatChunkIndexHeader *indexHeader)
+{
+    if (NSHostByteOrder() == NS_BigEndian)
+    {
+        SwapUInt32sWithByteCount((uint32_t *) indexHeader, sizeof(*indexHeader));
+    }
+}
+
+static void PPNativeFileFormatChunkIndexEntry_FixByteOrder(
+                                            PPNativeFileFormatChunkIndexEntry *indexEntry)
+{
+    if (NSHostByteOrder() == NS_BigEndian)
+    {
+        SwapUInt32sWithByteCount((uint32_t *) indexEntry, sizeof(*indexEntry));
+    }
+}
+
+static void PPNativeFileFormatThumbnailsHeader_FixByteOrder(
+                                        PPNativeFileFormatThumbnailsHeader *thumbnailsHeader)
+{
+    if (NSHostByteOrder() == NS_BigEndian)
+    {
+        SwapUInt32sWithByteCount((uint32_t *) thumbnailsHeader, sizeof(*thumbnailsHeader));
+    }
+}
+
+static void PPNativeFileFormatThumbnailEntry_FixByteOrder(
+                                            PPNativeFileFormatThumbnailEntry *thumbnailEntry)
+{
+    if (NSHostByteOrder() == NS_BigEndian)
+    {
+        SwapUInt32sWithByteCount((uint32_t *) thumbnailEntry, sizeof(*thumbnailEntry));
+    }
+}
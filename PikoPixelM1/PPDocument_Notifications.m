@@ -24,18 +24,9 @@
 
 #import "PPDocument_Notifications.h"
 
+#import "PPCacheRegistry.h"
+#import "PPDocumentUpdateBus.h"
 
-NSString *PPDocumentNotification_UpdatedMergedVisibleArea =
-                                            @"PPDocumentNotification_UpdatedMergedVisibleArea";
-
-NSString *PPDocumentNotification_UpdatedDrawingLayerArea =
-                                            @"PPDocumentNotification_UpdatedDrawingLayerArea";
-
-NSString *PPDocumentNotification_UpdatedMergedVisibleThumbnailImage =
-                                @"PPDocumentNotification_UpdatedMergedVisibleThumbnailImage";
-
-NSString *PPDocumentNotification_UpdatedDrawingLayerThumbnailImage =
-                                @"PPDocumentNotification_UpdatedDrawingLayerThumbnailImage";
 
 NSString *PPDocumentNotification_UpdatedSelection = @"PPDocumentNotification_UpdatedSelection";
 
@@ -79,9 +70,6 @@ NSString *PPDocumentNotification_SwitchedActiveSamplerImage =
                                         @"PPDocumentNotification_SwitchedActiveSamplerImage";
 
 
-NSString *PPDocumentNotification_UserInfoKey_UpdateAreaRect =
-                                        @"PPDocumentNotification_UserInfoKey_UpdateAreaRect";
-
 NSString *PPDocumentNotification_UserInfoKey_IndexOfChangedLayer =
                                     @"PPDocumentNotification_UserInfoKey_IndexOfChangedLayer";
 
@@ -91,32 +79,17 @@ NSString *PPDocumentNotification_UserInfoKey_SamplerImagePanelType =
 
 @implementation PPDocument (Notifications)
 
+// area & thumbnail updates are posted through the update bus (immediate delivery to the
+// canvas, coalesced delivery to other observers)
+
 - (void) postNotification_UpdatedMergedVisibleAreaInRect: (NSRect) updateRect
 {
-    NSDictionary *userInfo;
-
-    userInfo = [NSDictionary dictionaryWithObject: [NSValue valueWithRect: updateRect]
-                                forKey: PPDocumentNotification_UserInfoKey_UpdateAreaRect];
-
-    [[NSNotificationCenter defaultCenter]
-                                postNotificationName:
-                                                PPDocumentNotification_UpdatedMergedVisibleArea
-                                object: self
-                                userInfo: userInfo];
+    [_updateBus postUpdatedMergedVisibleAreaInRect: updateRect];
 }
 
 - (void) postNotification_UpdatedDrawingLayerAreaInRect: (NSRect) updateRect
 {
-    NSDictionary *userInfo;
-
-    userInfo = [NSDictionary dictionaryWithObject: [NSValue valueWithRect: updateRect]
-                                forKey: PPDocumentNotification_UserInfoKey_UpdateAreaRect];
-
-    [[NSNotificationCenter defaultCenter]
-                                postNotificationName:
-                                                PPDocumentNotification_UpdatedDrawingLayerArea
-                                object: self
-                                userInfo: userInfo];
+    [_updateBus postUpdatedDrawingLayerAreaInRect: updateRect];
 }
 
 - (void) postNotification_UpdatedMergedVisibleThumbnailImage
@@ -124,10 +97,12 @@ NSString *PPDocumentNotification_UserInfoKey_SamplerImagePanelType =
     if (_disallowThumbnailImageUpdateNotifications)
         return;
 
-    [[NSNotificationCenter defaultCenter]
-                                postNotificationName:
-                                    PPDocumentNotification_UpdatedMergedVisibleThumbnailImage
-                                object: self];
+    // observing thumbnail views redraw, resampling the image into new cached representations
+
+    _thumbnailImagesMayHaveCachedRepresentations = YES;
+    [_thumbnailImagesCacheRegistryEntry noteGrowth];
+
+    [_updateBus postUpdatedMergedVisibleThumbnailImage];
 }
 
 - (void) postNotification_UpdatedDrawingLayerThumbnailImage
@@ -135,10 +110,10 @@ NSString *PPDocumentNotification_UserInfoKey_SamplerImagePanelType =
     if (_disallowThumbnailImageUpdateNotifications)
         return;
 
-    [[NSNotificationCenter defaultCenter]
-                                postNotificationName:
-                                    PPDocumentNotification_UpdatedDrawingLayerThumbnailImage
-                                object: self];
+    _thumbnailImagesMayHaveCachedRepresentations = YES;
+    [_thumbnailImagesCacheRegistryEntry noteGrowth];
+
+    [_updateBus postUpdatedDrawingLayerThumbnailImage];
 }
 
 - (void) postNotification_UpdatedSelection
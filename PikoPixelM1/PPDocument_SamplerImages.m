@@ -442,6 +442,8 @@ ERROR:
         }
     }
 
+    [self trackMemoryForUndoData: oldSamplerImageData];
+
     [[[self undoManager] prepareWithInvocationTarget: self]
                                             insertArchivedSamplerImage: oldSamplerImageData
                                             atIndex: index];
@@ -485,6 +487,8 @@ ERROR:
 
     [self resetActiveSamplerImageIndexes];
 
+    [self trackMemoryForUndoData: oldSamplerImagesData];
+
     [[[self undoManager]
                     prepareWithInvocationTarget: self]
                         setSamplerImagesWithArchivedSamplerImagesData: oldSamplerImagesData];
@@ -30,6 +30,10 @@
 #import "PPDocumentWindowController.h"
 #import "NSObject_PPUtilities.h"
 #import "PPDocument_NativeFileIcon.h"
+#import "PPAutosaveJournal.h"
+#import "NSError_PPUtilities.h"
+#import "PPTrace.h"
+#import "PPStartupTimeline.h"
 
 
 #define kAutosaveCompoundExtensionFormatString          @"%@-%@"
@@ -43,9 +47,6 @@ static inline bool SaveOperationIsForDocumentFileOfCurrentWindow(
 
 static bool gRuntimeRequiresManualSetupOfAutosaveFileExtensions = NO;
 
-//check
-static bool saveOperationResult = false;
-
 
 @interface PPDocument (SavingPrivateMethods)
 
@@ -67,6 +68,8 @@ static bool saveOperationResult = false;
 
 + (void) load
 {
+    macroStartupTimelineMethodScope();
+
     gRuntimeRequiresManualSetupOfAutosaveFileExtensions =
         (PP_RUNTIME_CHECK__RUNTIME_REQUIRES_MANUAL_SETUP_OF_AUTOSAVE_FILE_EXTENSIONS) ?
             YES : NO;
@@ -92,6 +95,17 @@ static bool saveOperationResult = false;
     [super saveDocumentTo: self];
 }
 
+- (void) unblockUserInteractionAfterSaveSnapshot
+{
+    // unblockUserInteraction is only available on 10.7+ (asynchronous saving); it does nothing
+    // when saving synchronously
+
+    if ([self respondsToSelector: @selector(unblockUserInteraction)])
+    {
+        [self unblockUserInteraction];
+    }
+}
+
 #pragma mark NSDocument overrides
 
 - (IBAction) saveDocumentTo: (id) sender
@@ -149,28 +163,23 @@ ERROR:
     return NO;
 }
 
-- (void) setSaveOperationResultBool:(bool)result {
-    saveOperationResult = result;
-}
-
-//check
-- (BOOL) saveToURL: (NSURL *) absoluteURL
+- (void) saveToURL: (NSURL *) absoluteURL
             ofType: (NSString *) typeName
             forSaveOperation: (NSSaveOperationType) saveOperation
-            completitionHandler: (void (^)(NSError *errorOrNil))completionHandler
+            completionHandler: (void (^)(NSError *errorOrNil)) completionHandler
 {
-    bool didSaveSuccessfully = false;
+    PPDocumentSaveFormat saveFormat;
 
-    _saveFormat = [self saveFormatForSaveOperation: saveOperation];
+    saveFormat = _saveFormat = [self saveFormatForSaveOperation: saveOperation];
 
-    if (_saveFormat == kPPDocumentSaveFormat_Autosave)
+    if (saveFormat == kPPDocumentSaveFormat_Autosave)
     {
         if (gRuntimeRequiresManualSetupOfAutosaveFileExtensions)
         {
             absoluteURL = [self autosaveURLWithModifiedExtensionForSaveURL: absoluteURL];
         }
     }
-    else if (_saveFormat == kPPDocumentSaveFormat_Export)
+    else if (saveFormat == kPPDocumentSaveFormat_Export)
     {
         NSString *exportedTypeName = [_exportPanelViewController selectedFileTypeName];
 
@@ -179,44 +188,154 @@ ERROR:
             typeName = exportedTypeName;
         }
     }
-    
-    //check
-    [super saveToURL:absoluteURL ofType:typeName forSaveOperation:saveOperation completionHandler:^(NSError *errorOrNil) {
-        if (errorOrNil == nil) {
-            NSLog(@"success");
-            [self setSaveOperationResultBool:true];
-        } else {
-            NSLog(@"error");
-            [self setSaveOperationResultBool:false];
-        }
-    }];
-    
-    didSaveSuccessfully = saveOperationResult;
 
-    if (didSaveSuccessfully && SaveOperationIsForDocumentFileOfCurrentWindow(saveOperation))
+    // the save may finish asynchronously (writing on a background thread), so the post-save
+    // setup is done in the completion handler (called on the main thread)
+
+    [super saveToURL: absoluteURL
+            ofType: typeName
+            forSaveOperation: saveOperation
+            completionHandler:
+                ^(NSError *errorOrNil)
+                {
+                    if (!errorOrNil
+                        && SaveOperationIsForDocumentFileOfCurrentWindow(saveOperation))
+                    {
+                        if ([typeName isEqualToString: kNativeFileFormatTypeName])
+                        {
+                            // native filetype: set up window titlebar icon
+                            [[self ppWindow] ppSetDocumentWindowTitlebarIcon:
+                                                                [self nativeFileIconImage]];
+                        }
+                        else
+                        {
+                            // non-native filetypes: set up flattened-save notice if settings
+                            // were lost
+                            if ([self flattenedSaveWillLoseSettings])
+                            {
+                                [[self ppDocumentWindowController]
+                                        ppPerformSelectorFromNewStackFrame:
+                                                    @selector(beginFlattenedSaveNoticeSheet)];
+                            }
+                        }
+                    }
+
+                    if (saveFormat == kPPDocumentSaveFormat_Export)
+                    {
+                        [self cleanupAfterExportSave];
+                    }
+
+                    if (completionHandler)
+                    {
+                        completionHandler(errorOrNil);
+                    }
+                }];
+}
+
+- (BOOL) canAsynchronouslyWriteToURL: (NSURL *) absoluteURL
+            ofType: (NSString *) typeName
+            forSaveOperation: (NSSaveOperationType) saveOperation
+{
+    // the writing methods (dataOfType:error:, writeSafelyToURL:...) copy the document state
+    // they need before calling unblockUserInteractionAfterSaveSnapshot, and don't access the
+    // document's state afterwards
+
+    return YES;
+}
+
+- (BOOL) writeSafelyToURL: (NSURL *) absoluteURL
+            ofType: (NSString *) typeName
+            forSaveOperation: (NSSaveOperationType) saveOperation
+            error: (NSError **) outError
+{
+    macroTraceMethodScope();
+
+    bool isNativeAutosave, autosaveWasCancelled;
+    BOOL didWriteSuccessfully;
+
+    isNativeAutosave = ((_saveFormat == kPPDocumentSaveFormat_Autosave)
+                            && [typeName isEqualToString: kNativeFileFormatTypeName]
+                            && [absoluteURL isFileURL]) ? YES : NO;
+
+    if (isNativeAutosave)
     {
-        if ([typeName isEqualToString: kNativeFileFormatTypeName])
+        if (!_autosaveJournal)
         {
-            // native filetype: set up window titlebar icon
-            [[self ppWindow] ppSetDocumentWindowTitlebarIcon: [self nativeFileIconImage]];
+            _autosaveJournal = [[PPAutosaveJournal alloc] init];
         }
-        else
+
+        // an autosave that's implicitly cancellable is cancelled if the document's edited
+        // while it's being written (updateChangeCount:)
+
+        _asynchronousAutosaveIsCancellable =
+            ([self respondsToSelector: @selector(autosavingIsImplicitlyCancellable)]
+                && [self autosavingIsImplicitlyCancellable]) ? YES : NO;
+
+        _shouldCancelAsynchronousAutosave = NO;
+
+        // if the autosave file's the journal's checkpoint, append only the changes since the
+        // last autosave to the journal, instead of rewriting the whole file
+
+        if ([_autosaveJournal canAppendRecordForCheckpointAtPath: [absoluteURL path]]
+            && [_autosaveJournal prepareRecordForDocument: self])
         {
-            // non-native filetypes: set up flattened-save notice if settings were lost
-            if ([self flattenedSaveWillLoseSettings])
+            [self unblockUserInteractionAfterSaveSnapshot];
+
+            // once user interaction's unblocked, the document may have changed, so a failed
+            // append can't fall back to writing the whole file; removing the journal instead
+            // makes the next autosave write a new checkpoint
+
+            didWriteSuccessfully = [_autosaveJournal appendPreparedRecord];
+
+            if (!didWriteSuccessfully)
             {
-                [[self ppDocumentWindowController] ppPerformSelectorFromNewStackFrame:
-                                                    @selector(beginFlattenedSaveNoticeSheet)];
+                [_autosaveJournal removeJournal];
             }
+
+            _asynchronousAutosaveIsCancellable = NO;
+
+            if (outError)
+            {
+                *outError = (didWriteSuccessfully) ?
+                                nil : [NSError ppError_UnableToCreateDataOfType: typeName];
+            }
+
+            return didWriteSuccessfully;
         }
     }
 
-    if (_saveFormat == kPPDocumentSaveFormat_Export)
+    didWriteSuccessfully = [super writeSafelyToURL: absoluteURL
+                                    ofType: typeName
+                                    forSaveOperation: saveOperation
+                                    error: outError];
+
+    if (isNativeAutosave)
     {
-        [self cleanupAfterExportSave];
+        autosaveWasCancelled = (_shouldCancelAsynchronousAutosave) ? YES : NO;
+
+        _asynchronousAutosaveIsCancellable = NO;
+        _shouldCancelAsynchronousAutosave = NO;
+
+        // the full autosave file is the journal's new checkpoint (compacts the old journal);
+        // a cancelled autosave leaves the previous checkpoint & journal unchanged
+
+        if (didWriteSuccessfully)
+        {
+            [_autosaveJournal beginJournalForPendingCheckpointAtPath: [absoluteURL path]];
+        }
+        else if (!autosaveWasCancelled)
+        {
+            [_autosaveJournal removeJournal];
+        }
+    }
+    else if (didWriteSuccessfully
+                && SaveOperationIsForDocumentFileOfCurrentWindow(saveOperation))
+    {
+        // the autosave file's discarded after saving the document
+        [_autosaveJournal removeJournal];
     }
 
-    return didSaveSuccessfully;
+    return didWriteSuccessfully;
 }
 
 - (BOOL) writeToURL: (NSURL *) absoluteURL
@@ -231,8 +350,10 @@ ERROR:
                                         originalContentsURL: absoluteOriginalContentsURL
                                         error: outError];
 
-    if (didWriteSuccessfully
-        && (_saveFormat != kPPDocumentSaveFormat_Autosave)
+    // _savedFileIconImage is set by dataOfType:error: when saving non-autosave native data
+    // (before user interaction's unblocked, so the icon matches the saved document)
+
+    if (didWriteSuccessfully && _savedFileIconImage
         && [typeName isEqualToString: kNativeFileFormatTypeName])
     {
         // The custom finder icon for native-format files needs to be set here: The point where
@@ -246,9 +367,37 @@ ERROR:
         [self setupCustomFinderIconForSavedDocumentAtPath: [absoluteURL path]];
     }
 
+    [_savedFileIconImage release];
+    _savedFileIconImage = nil;
+
     return didWriteSuccessfully;
 }
 
+- (void) updateChangeCount: (NSDocumentChangeType) change
+{
+    // editing the document during an implicitly-cancellable autosave makes the autosave's
+    // data out of date, so stop encoding it - the document will be autosaved again later
+
+    if (_asynchronousAutosaveIsCancellable)
+    {
+        _shouldCancelAsynchronousAutosave = YES;
+    }
+
+    [super updateChangeCount: change];
+}
+
+- (void) close
+{
+    [super close];
+
+    // a compaction scheduled when the document's window resigned main would keep the closed
+    // document alive until it's performed
+    [self cancelNondrawingLayersStorageCompaction];
+
+    // closing discards the autosave file unless it's still needed for restoring the document
+    [_autosaveJournal removeJournalIfCheckpointIsMissing];
+}
+
 - (NSString *) autosavingFileType
 {
     if (_disallowAutosaving)
@@ -303,7 +452,7 @@ ERROR:
     if (![filepath length])
         goto ERROR;
 
-    [[NSWorkspace sharedWorkspace] setIcon: [self nativeFileIconImage]
+    [[NSWorkspace sharedWorkspace] setIcon: _savedFileIconImage
                                     forFile: filepath
                                     options: NSExcludeQuickDrawElementsIconCreationOption];
 
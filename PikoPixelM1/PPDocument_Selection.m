@@ -566,6 +566,7 @@ ERROR:
             undoBitmap: (NSBitmapImageRep *) undoBitmap
 {
     NSUndoManager *undoManager;
+    NSData *undoBitmapTIFFData;
 
     _hasSelection = [self selectionMaskIsNotEmpty];
 
@@ -583,9 +584,12 @@ ERROR:
 
     undoManager = [self undoManager];
 
+    undoBitmapTIFFData = [undoBitmap ppCompressedTIFFData];
+
+    [self trackMemoryForUndoData: undoBitmapTIFFData];
+
     [[undoManager prepareWithInvocationTarget: self]
-                                            updateSelectionMaskWithTIFFData:
-                                                            [undoBitmap ppCompressedTIFFData]
+                                            updateSelectionMaskWithTIFFData: undoBitmapTIFFData
                                             atPoint: bounds.origin];
 
     if (![undoManager isUndoing] && ![undoManager isRedoing])
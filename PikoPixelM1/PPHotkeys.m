@@ -28,6 +28,7 @@
 #import "PPDefines.h"
 #import "PPKeyConstants.h"
 #import "NSFileManager_PPUtilities.h"
+#import "PPStartupTimeline.h"
 
 
 #define kHotkeysDictResourceType            @"plist"
@@ -96,6 +97,8 @@ static NSString *ModifiedXMLKeyForHotkey(NSString *hotkey);
 
 + (void) initialize
 {
+    macroStartupTimelineMethodScope();
+
     NSDictionary *hotkeysDict;
 
     if ([self class] != [PPHotkeys class])
@@ -39,12 +39,20 @@
 // premultipliedImagePixel.blueComponent = premultiplyTable[imagePixel.blueComponent]
 //
 // (Same process for unpremultiplying)
+//
+// The tables are set up on first use rather than at launch:
+// PPImageAlphaPremultiplyTables_Setup() must be called (& return YES) before the tables are
+// accessed. It's thread-safe & only costs a pthread_once() check after the first call, so it
+// can be called once per bitmap operation, outside of the pixel loops.
 
 
 extern PPImagePixelComponent *gImageAlphaPremultiplyTables[],
                                 *gImageAlphaUnpremultiplyTables[];
 
 
+bool PPImageAlphaPremultiplyTables_Setup(void);
+
+
 #define macroAlphaPremultiplyTableForImagePixel(imagePixel)             \
             gImageAlphaPremultiplyTables[macroImagePixelComponent_Alpha(imagePixel)]
 
@@ -24,6 +24,8 @@
 
 #import "PPImagePixelAlphaPremultiplyTables.h"
 
+#import <pthread.h>
+
 
 #define kNumLookupTables    (kMaxImagePixelComponentValue+1)
 #define kSizeOfLookupTable  ((kMaxImagePixelComponentValue+1) * sizeof(PPImagePixelComponent))
@@ -33,20 +35,28 @@ PPImagePixelComponent *gImageAlphaPremultiplyTables[kNumLookupTables],
                         *gImageAlphaUnpremultiplyTables[kNumLookupTables];
 
 
-static bool SetupImageAlphaPremultiplyTables(void);
+static pthread_once_t gSetupTablesOnceControl = PTHREAD_ONCE_INIT;
+static bool gTablesAreSetUp = NO;
 
 
-@implementation NSObject (PPImagePixelAlphaPremultiplyTables)
+static void SetupImageAlphaPremultiplyTablesOnce(void);
+static bool SetupImageAlphaPremultiplyTables(void);
 
-+ (void) load
+
+bool PPImageAlphaPremultiplyTables_Setup(void)
 {
-    SetupImageAlphaPremultiplyTables();
-}
+    pthread_once(&gSetupTablesOnceControl, SetupImageAlphaPremultiplyTablesOnce);
 
-@end
+    return gTablesAreSetUp;
+}
 
 #pragma mark Private functions
 
+static void SetupImageAlphaPremultiplyTablesOnce(void)
+{
+    gTablesAreSetUp = SetupImageAlphaPremultiplyTables();
+}
+
 static bool SetupImageAlphaPremultiplyTables(void)
 {
     int tablesBufferSize, alphaValue, colorValue;
@@ -27,6 +27,7 @@
 #import "PPDefines.h"
 #import "PPGeometry.h"
 #import "NSFileManager_PPUtilities.h"
+#import "PPStartupTimeline.h"
 
 
 #define kCustomPresetsFilename                      @"ImageSizePresets.plist"
@@ -58,6 +59,8 @@ static NSArray *VerifiedPresetStringsForPresetStrings(NSArray *presetStrings);
 
 + (void) initialize
 {
+    macroStartupTimelineMethodScope();
+
     if ([self class] != [PPImageSizePresets class])
     {
         return;
@@ -23,6 +23,7 @@
 */
 
 #import "PPLayerBlendingModeButton.h"
+#import "PPStartupTimeline.h"
 
 
 #define kButtonIconName_Standard    @"blend_mode_icon_standard"
@@ -56,6 +57,8 @@ static NSString *gToolTip_StandardMode = nil, *gToolTip_LinearMode = nil;
 
 + (void) initialize
 {
+    macroStartupTimelineMethodScope();
+
     if ([self class] != [PPLayerBlendingModeButton class])
     {
         return;
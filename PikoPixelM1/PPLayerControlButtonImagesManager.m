@@ -31,6 +31,7 @@
 #import "PPGeometry.h"
 #import "PPBackgroundPattern.h"
 #import "PPThumbnailUtilities.h"
+#import "PPDocumentUpdateBus.h"
 
 
 #define kLayerControlButtonImageViewsNibName            @"LayerControlButtonImageViews"
@@ -40,10 +41,6 @@
 
 - (void) addAsObserverForPPDocumentNotifications;
 - (void) removeAsObserverForPPDocumentNotifications;
-- (void) handlePPDocumentNotification_UpdatedMergedVisibleThumbnailImage:
-                                                            (NSNotification *) notification;
-- (void) handlePPDocumentNotification_UpdatedDrawingLayerThumbnailImage:
-                                                                (NSNotification *) notification;
 - (void) handlePPDocumentNotification_UpdatedBackgroundSettings:
                                                             (NSNotification *) notification;
 - (void) handlePPDocumentNotification_ReloadedDocument: (NSNotification *) notification;
@@ -247,19 +244,8 @@ ERROR:
     if (!_ppDocument)
         return;
 
-    [notificationCenter addObserver: self
-                        selector:
-                            @selector(
-                            handlePPDocumentNotification_UpdatedMergedVisibleThumbnailImage:)
-                        name: PPDocumentNotification_UpdatedMergedVisibleThumbnailImage
-                        object: _ppDocument];
-
-    [notificationCenter addObserver: self
-                        selector:
-                            @selector(
-                                handlePPDocumentNotification_UpdatedDrawingLayerThumbnailImage:)
-                        name: PPDocumentNotification_UpdatedDrawingLayerThumbnailImage
-                        object: _ppDocument];
+    [[_ppDocument updateBus] addUpdateObserver: self
+                                deliveryMode: kPPDocumentUpdateDeliveryMode_Coalesced];
 
     [notificationCenter addObserver: self
                         selector:
@@ -279,13 +265,7 @@ ERROR:
 {
     NSNotificationCenter *notificationCenter = [NSNotificationCenter defaultCenter];
 
-    [notificationCenter removeObserver: self
-                        name: PPDocumentNotification_UpdatedMergedVisibleThumbnailImage
-                        object: _ppDocument];
-
-    [notificationCenter removeObserver: self
-                        name: PPDocumentNotification_UpdatedDrawingLayerThumbnailImage
-                        object: _ppDocument];
+    [[_ppDocument updateBus] removeUpdateObserver: self];
 
     [notificationCenter removeObserver: self
                         name: PPDocumentNotification_UpdatedBackgroundSettings
@@ -296,22 +276,24 @@ ERROR:
                         object: _ppDocument];
 }
 
-- (void) handlePPDocumentNotification_UpdatedMergedVisibleThumbnailImage:
-                                                            (NSNotification *) notification
+#pragma mark PPDocumentUpdateObserver methods
+
+- (void) ppDocumentUpdatedMergedVisibleThumbnailImage: (PPDocument *) ppDocument
 {
     _enabledLayersThumbnailsAreDirty = YES;
 
     [self postNotification_ChangedEnabledLayersImages];
 }
 
-- (void) handlePPDocumentNotification_UpdatedDrawingLayerThumbnailImage:
-                                                                (NSNotification *) notification
+- (void) ppDocumentUpdatedDrawingLayerThumbnailImage: (PPDocument *) ppDocument
 {
     _drawLayerThumbnailsAreDirty = YES;
 
     [self postNotification_ChangedDrawLayerImages];
 }
 
+#pragma mark PPDocument notifications
+
 - (void) handlePPDocumentNotification_UpdatedBackgroundSettings:
                                                             (NSNotification *) notification
 {
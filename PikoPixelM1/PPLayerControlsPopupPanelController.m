@@ -38,6 +38,7 @@
 #import "NSBitmapImageRep_PPUtilities.h"
 #import "NSImage_PPUtilities.h"
 #import "PPThumbnailUtilities.h"
+#import "PPDocumentUpdateBus.h"
 
 
 #define kLayerControlsPopupPanelNibName     @"LayerControlsPopupPanel"
@@ -49,8 +50,6 @@
 
 @interface PPLayerControlsPopupPanelController (PrivateMethods)
 
-- (void) handlePPDocumentNotification_UpdatedDrawingLayerThumbnailImage:
-                                                            (NSNotification *) notification;
 - (void) handlePPDocumentNotification_SwitchedDrawingLayer: (NSNotification *) notification;
 - (void) handlePPDocumentNotification_ReorderedLayers: (NSNotification *) notification;
 - (void) handlePPDocumentNotification_ChangedLayerAttribute: (NSNotification *) notification;
@@ -208,12 +207,8 @@
     if (!_ppDocument)
         return;
 
-    [notificationCenter addObserver: self
-                        selector:
-                            @selector(
-                            handlePPDocumentNotification_UpdatedDrawingLayerThumbnailImage:)
-                        name: PPDocumentNotification_UpdatedDrawingLayerThumbnailImage
-                        object: _ppDocument];
+    [[_ppDocument updateBus] addUpdateObserver: self
+                                deliveryMode: kPPDocumentUpdateDeliveryMode_Coalesced];
 
     [notificationCenter addObserver: self
                         selector: @selector(handlePPDocumentNotification_SwitchedDrawingLayer:)
@@ -252,9 +247,7 @@
 {
     NSNotificationCenter *notificationCenter = [NSNotificationCenter defaultCenter];
 
-    [notificationCenter removeObserver: self
-                        name: PPDocumentNotification_UpdatedDrawingLayerThumbnailImage
-                        object: _ppDocument];
+    [[_ppDocument updateBus] removeUpdateObserver: self];
 
     [notificationCenter removeObserver: self
                         name: PPDocumentNotification_SwitchedDrawingLayer
@@ -379,16 +372,17 @@
     }
 }
 
-#pragma mark PPDocument notifications
+#pragma mark PPDocumentUpdateObserver methods
 
-- (void) handlePPDocumentNotification_UpdatedDrawingLayerThumbnailImage:
-                                                                (NSNotification *) notification
+- (void) ppDocumentUpdatedDrawingLayerThumbnailImage: (PPDocument *) ppDocument
 {
     [_drawingLayerThumbnailView handleUpdateToImage];
 
     _needToUpdateDrawingLayerPopupButtonMenu = YES;
 }
 
+#pragma mark PPDocument notifications
+
 - (void) handlePPDocumentNotification_SwitchedDrawingLayer: (NSNotification *) notification
 {
     [self setupDrawingLayerThumbnailImage];
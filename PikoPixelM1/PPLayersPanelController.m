@@ -39,6 +39,7 @@
 #import "NSBitmapImageRep_PPUtilities.h"
 #import "NSImage_PPUtilities.h"
 #import "PPThumbnailUtilities.h"
+#import "PPDocumentUpdateBus.h"
 
 
 #define kLayersPanelNibName                     @"LayersPanel"
@@ -55,8 +56,6 @@
 
 @interface PPLayersPanelController (PrivateMethods)
 
-- (void) handlePPDocumentNotification_UpdatedDrawingLayerThumbnailImage:
-                                                            (NSNotification *) notification;
 - (void) handlePPDocumentNotification_SwitchedDrawingLayer: (NSNotification *) notification;
 - (void) handlePPDocumentNotification_ReorderedLayers: (NSNotification *) notification;
 - (void) handlePPDocumentNotification_PerformedMultilayerOperation:
@@ -322,12 +321,8 @@
     if (!_ppDocument)
         return;
 
-    [notificationCenter addObserver: self
-                        selector:
-                            @selector(
-                            handlePPDocumentNotification_UpdatedDrawingLayerThumbnailImage:)
-                        name: PPDocumentNotification_UpdatedDrawingLayerThumbnailImage
-                        object: _ppDocument];
+    [[_ppDocument updateBus] addUpdateObserver: self
+                                deliveryMode: kPPDocumentUpdateDeliveryMode_Coalesced];
 
     [notificationCenter addObserver: self
                         selector: @selector(handlePPDocumentNotification_SwitchedDrawingLayer:)
@@ -378,9 +373,7 @@
 {
     NSNotificationCenter *notificationCenter = [NSNotificationCenter defaultCenter];
 
-    [notificationCenter removeObserver: self
-                        name: PPDocumentNotification_UpdatedDrawingLayerThumbnailImage
-                        object: _ppDocument];
+    [[_ppDocument updateBus] removeUpdateObserver: self];
 
     [notificationCenter removeObserver: self
                         name: PPDocumentNotification_SwitchedDrawingLayer
@@ -482,10 +475,9 @@
     return [self undoManager];
 }
 
-#pragma mark PPDocument notifications
+#pragma mark PPDocumentUpdateObserver methods
 
-- (void) handlePPDocumentNotification_UpdatedDrawingLayerThumbnailImage:
-                                                                (NSNotification *) notification
+- (void) ppDocumentUpdatedDrawingLayerThumbnailImage: (PPDocument *) ppDocument
 {
     unsigned layerIndex = [_ppDocument indexOfDrawingLayer];
 
@@ -494,6 +486,8 @@
     [self reloadLayersTableThumbnailDataForLayerAtIndex: layerIndex];
 }
 
+#pragma mark PPDocument notifications
+
 - (void) handlePPDocumentNotification_SwitchedDrawingLayer: (NSNotification *) notification
 {
     [self updateLayersTableSelection];
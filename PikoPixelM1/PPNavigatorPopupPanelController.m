@@ -31,6 +31,7 @@
 #import "PPUIColors_Panels.h"
 #import "PPCursorManager.h"
 #import "NSObject_PPUtilities.h"
+#import "PPDocumentUpdateBus.h"
 
 
 #define kNavigatorPopupPanelNibName  @"NavigatorPopupPanel"
@@ -42,10 +43,6 @@
 - (void) removeAsObserverForPPCanvasViewNotifications;
 - (void) handlePPCanvasViewNotification_ChangedZoomFactor: (NSNotification *) notification;
 
-- (void) handlePPDocumentNotification_UpdatedMergedVisibleThumbnailImage:
-                                                            (NSNotification *) notification;
-- (void) handlePPDocumentNotification_UpdatedDrawingLayerThumbnailImage:
-                                                            (NSNotification *) notification;
 - (void) handlePPDocumentNotification_UpdatedBackgroundSettings:
                                                             (NSNotification *) notification;
 - (void) handlePPDocumentNotification_ReloadedDocument: (NSNotification *) notification;
@@ -153,19 +150,8 @@
     if (!_ppDocument)
         return;
 
-    [notificationCenter addObserver: self
-                        selector:
-                            @selector(
-                            handlePPDocumentNotification_UpdatedMergedVisibleThumbnailImage:)
-                        name: PPDocumentNotification_UpdatedMergedVisibleThumbnailImage
-                        object: _ppDocument];
-
-    [notificationCenter addObserver: self
-                        selector:
-                            @selector(
-                            handlePPDocumentNotification_UpdatedDrawingLayerThumbnailImage:)
-                        name: PPDocumentNotification_UpdatedDrawingLayerThumbnailImage
-                        object: _ppDocument];
+    [[_ppDocument updateBus] addUpdateObserver: self
+                                deliveryMode: kPPDocumentUpdateDeliveryMode_Coalesced];
 
     [notificationCenter addObserver: self
                         selector:
@@ -183,13 +169,7 @@
 {
     NSNotificationCenter *notificationCenter = [NSNotificationCenter defaultCenter];
 
-    [notificationCenter removeObserver: self
-                        name: PPDocumentNotification_UpdatedMergedVisibleThumbnailImage
-                        object: _ppDocument];
-
-    [notificationCenter removeObserver: self
-                        name: PPDocumentNotification_UpdatedDrawingLayerThumbnailImage
-                        object: _ppDocument];
+    [[_ppDocument updateBus] removeUpdateObserver: self];
 
     [notificationCenter removeObserver: self
                         name: PPDocumentNotification_UpdatedBackgroundSettings
@@ -289,10 +269,9 @@
     [self updateZoomSliderPosition];
 }
 
-#pragma mark PPDocument notifications
+#pragma mark PPDocumentUpdateObserver methods
 
-- (void) handlePPDocumentNotification_UpdatedMergedVisibleThumbnailImage:
-                                                            (NSNotification *) notification
+- (void) ppDocumentUpdatedMergedVisibleThumbnailImage: (PPDocument *) ppDocument
 {
     if (_navigatorViewImageDisplayMode == kPPLayerDisplayMode_VisibleLayers)
     {
@@ -300,8 +279,7 @@
     }
 }
 
-- (void) handlePPDocumentNotification_UpdatedDrawingLayerThumbnailImage:
-                                                                (NSNotification *) notification
+- (void) ppDocumentUpdatedDrawingLayerThumbnailImage: (PPDocument *) ppDocument
 {
     if (_navigatorViewImageDisplayMode == kPPLayerDisplayMode_DrawingLayerOnly)
     {
@@ -309,6 +287,8 @@
     }
 }
 
+#pragma mark PPDocument notifications
+
 - (void) handlePPDocumentNotification_UpdatedBackgroundSettings:
                                                             (NSNotification *) notification
 {
@@ -29,6 +29,7 @@
 #import "PPCursorManager.h"
 #import "PPGeometry.h"
 #import "NSEvent_PPUtilities.h"
+#import "PPStartupTimeline.h"
 
 
 #define kUIColor_VisibleCanvasFrame                     [NSColor redColor]
@@ -64,6 +65,8 @@ static NSColor *gVisibleCanvasFrameColor = nil;
 
 + (void) initialize
 {
+    macroStartupTimelineMethodScope();
+
     if ([self class] != [PPNavigatorPopupView class])
     {
         return;
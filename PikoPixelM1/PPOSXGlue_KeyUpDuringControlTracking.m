@@ -44,6 +44,7 @@
 #import "PPAppBootUtilities.h"
 #import "PPLayerEnabledButtonCell.h"
 #import "PPLayerOpacitySliderCell.h"
+#import "PPStartupTimeline.h"
 
 
 #define PP_RUNTIME_CHECK__RUNTIME_INTERCEPTS_KEYBOARD_EVENTS_WHEN_TRACKING_CONTROLS     \
@@ -89,6 +90,8 @@
 
 + (void) load
 {
+    macroStartupTimelineMethodScope();
+
     if (PP_RUNTIME_CHECK__RUNTIME_INTERCEPTS_KEYBOARD_EVENTS_WHEN_TRACKING_CONTROLS)
     {
         macroPerformNSObjectSelectorAfterAppLoads(
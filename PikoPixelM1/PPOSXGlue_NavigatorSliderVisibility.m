@@ -35,6 +35,7 @@
 #import "PPAppBootUtilities.h"
 #import "PPNavigatorPopupPanelController.h"
 #import "PPSRGBUtilities.h"
+#import "PPStartupTimeline.h"
 
 
 #define PP_SDK_HAS_NSSLIDERCELL_BARRECTFLIPPED_METHOD                           \
@@ -78,6 +79,8 @@
 
 + (void) load
 {
+    macroStartupTimelineMethodScope();
+
     if (PP_RUNTIME_CHECK__RUNTIME_HAS_TRANSPARENT_SLIDER_BARS)
     {
         macroPerformNSObjectSelectorAfterAppLoads(
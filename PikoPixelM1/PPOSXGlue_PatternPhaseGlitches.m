@@ -41,6 +41,7 @@
 #import "NSObject_PPUtilities.h"
 #import "PPAppBootUtilities.h"
 #import "PPPreviewView.h"
+#import "PPStartupTimeline.h"
 
 
 #define PP_RUNTIME_CHECK__RUNTIME_HAS_PATTERN_PHASE_GLITCH_ISSUE                \
@@ -57,6 +58,8 @@
 
 + (void) load
 {
+    macroStartupTimelineMethodScope();
+
     if (PP_RUNTIME_CHECK__RUNTIME_HAS_PATTERN_PHASE_GLITCH_ISSUE)
     {
         macroPerformNSObjectSelectorAfterAppLoads(ppOSXGlue_PatternPhaseGlitches_InstallPatches);
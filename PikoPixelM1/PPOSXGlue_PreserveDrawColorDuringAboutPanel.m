@@ -40,6 +40,7 @@
 #import <Cocoa/Cocoa.h>
 #import "NSObject_PPUtilities.h"
 #import "PPAppBootUtilities.h"
+#import "PPStartupTimeline.h"
 
 
 #define PP_RUNTIME_CHECK__ABOUT_PANEL_CAN_CAUSE_DRAW_COLOR_CHANGE       \
@@ -55,6 +56,8 @@
 
 + (void) load
 {
+    macroStartupTimelineMethodScope();
+
     if (PP_RUNTIME_CHECK__ABOUT_PANEL_CAN_CAUSE_DRAW_COLOR_CHANGE)
     {
         macroPerformNSObjectSelectorAfterAppLoads(
@@ -42,6 +42,7 @@
 #import "PPOSXGlueUtilities.h"
 #import "PPCanvasView.h"
 #import "PPPreviewView.h"
+#import "PPStartupTimeline.h"
 
 
 @implementation NSObject (PPOSXGlue_RetinaDrawingArtifacts)
@@ -64,6 +65,8 @@
 
 + (void) load
 {
+    macroStartupTimelineMethodScope();
+
     if (PP_RUNTIME_CHECK__RUNTIME_SUPPORTS_RETINA_DISPLAY)
     {
         macroPerformNSObjectSelectorAfterAppLoads(ppOSXGlue_RetinaDrawingArtifacts_Install);
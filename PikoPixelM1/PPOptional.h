@@ -28,6 +28,20 @@
 
 #define PP_OPTIONAL__ENABLE_CANVAS_SPEED_CHECK          (false)
 
+#define PP_OPTIONAL__ENABLE_LINEAR_BLENDING_FORMAT_CHECK    (false)
+
+#define PP_OPTIONAL__ENABLE_KERNEL_BENCHMARKS           (false)
+
+#define PP_OPTIONAL__ENABLE_INPUT_RECORDING             (false)
+
+#define PP_OPTIONAL__ENABLE_HOT_PATH_TRACING            (false)
+
+#define PP_OPTIONAL__ENABLE_MEMORY_REPORT_PANEL         (false)
+
+#define PP_OPTIONAL__ENABLE_STARTUP_TIMELINE            (false)
+
+#define PP_OPTIONAL__ENABLE_PNG_ENCODER_CHECK           (false)
+
 
 // __BUILD_WITH_ defines are derived from __ENABLE_ flags and build-environment requirements
 
@@ -37,6 +51,27 @@
 #define PP_OPTIONAL__BUILD_WITH_CANVAS_SPEED_CHECK      \
             (PP_OPTIONAL__ENABLE_CANVAS_SPEED_CHECK)
 
+#define PP_OPTIONAL__BUILD_WITH_LINEAR_BLENDING_FORMAT_CHECK    \
+            (PP_OPTIONAL__ENABLE_LINEAR_BLENDING_FORMAT_CHECK)
+
+#define PP_OPTIONAL__BUILD_WITH_KERNEL_BENCHMARKS       \
+            (PP_OPTIONAL__ENABLE_KERNEL_BENCHMARKS)
+
+#define PP_OPTIONAL__BUILD_WITH_INPUT_RECORDING         \
+            (PP_OPTIONAL__ENABLE_INPUT_RECORDING)
+
+#define PP_OPTIONAL__BUILD_WITH_HOT_PATH_TRACING        \
+            (PP_OPTIONAL__ENABLE_HOT_PATH_TRACING)
+
+#define PP_OPTIONAL__BUILD_WITH_MEMORY_REPORT_PANEL     \
+            (PP_OPTIONAL__ENABLE_MEMORY_REPORT_PANEL)
+
+#define PP_OPTIONAL__BUILD_WITH_STARTUP_TIMELINE        \
+            (PP_OPTIONAL__ENABLE_STARTUP_TIMELINE)
+
+#define PP_OPTIONAL__BUILD_WITH_PNG_ENCODER_CHECK       \
+            (PP_OPTIONAL__ENABLE_PNG_ENCODER_CHECK)
+
 
 // Screencasting functionality requires ObjC runtime API version 2
 
@@ -35,6 +35,8 @@
 #import "PPTool.h"
 #import "PPToolbox.h"
 #import "PPGeometry.h"
+#import "PPDocumentLayer.h"
+#import "PPStartupTimeline.h"
 
 
 #define kSpeedCheckMenuItem_Name                        @"Canvas Speed Check"
@@ -45,17 +47,67 @@
 
 #define kNumSpeedCheckDragMovements                     100
 
+// shape & tolerance drags repeatedly grow over this many movements
+#define kNumSpeedCheckMovementsPerDragCycle             50
 
-@interface PPApplication (PPOptional_CanvasSpeedCheck)
+#define kSpeedCheckReportFilenameFormat                 @"PikoPixel Canvas Speed Check %@.json"
+#define kSpeedCheckReportFormatVersion                  1
 
-- (void) ppMenuItemSelected_CanvasSpeedCheck: (id) sender;
 
-@end
+typedef enum
+{
+    kPPSpeedCheckScenario_PencilStroke,
+    kPPSpeedCheckScenario_LineCorners,
+    kPPSpeedCheckScenario_RectDrag,
+    kPPSpeedCheckScenario_OvalDrag,
+    kPPSpeedCheckScenario_FillToleranceDrag,
+    kPPSpeedCheckScenario_MagicWandToleranceDrag,
+    kPPSpeedCheckScenario_SelectionMove,
+    kPPSpeedCheckScenario_LayerOpacitySlide,
+    kPPSpeedCheckScenario_RedrawBackground,
+    kPPSpeedCheckScenario_ZoomChanges,
+
+    kNumPPSpeedCheckScenarios
+
+} PPSpeedCheckScenario;
+
+
+static NSString *gSpeedCheckScenarioNames[kNumPPSpeedCheckScenarios] =
+{
+    @"pencilStroke",
+    @"lineCorners",
+    @"rectDrag",
+    @"ovalDrag",
+    @"fillToleranceDrag",
+    @"magicWandToleranceDrag",
+    @"selectionMove",
+    @"layerOpacitySlide",
+    @"redrawBackground",
+    @"zoomChanges"
+};
+
+static const float kSpeedCheckZoomFactors[] = {1.0f, 4.0f, 16.0f};
+
+
+static void RunSpeedCheckScenario(PPSpeedCheckScenario scenario, PPDocument *ppDocument,
+                                    PPCanvasView *canvasView, NSMutableData *frameTimes);
+static NSPoint SpeedCheckDragPoint(PPSpeedCheckScenario scenario, int step, NSSize canvasSize);
+static float SpeedCheckCycleFraction(int step, bool shouldReverseAtMidpoint);
+static NSDictionary *FrameTimeStatisticsForScenario(PPSpeedCheckScenario scenario,
+                                                    NSMutableData *frameTimes,
+                                                    PPLayerBlendingMode layerBlendingMode,
+                                                    float zoomFactor);
+static NSTimeInterval PercentileOfSortedTimes(NSTimeInterval *sortedTimes, int numTimes,
+                                                double percentile);
+static int CompareFrameTimes(const void *time1, const void *time2);
+
 
 @implementation NSObject (PPOptional_CanvasSpeedCheck)
 
 + (void) load
 {
+    macroStartupTimelineMethodScope();
+
     macroPerformNSObjectSelectorAfterAppLoads(ppOptional_CanvasSpeedCheck_SetupMenuItem);
 }
 
@@ -98,20 +150,24 @@ ERROR:
 
 @implementation PPApplication (PPOptional_CanvasSpeedCheck)
 
+// Canvas Speed Check: runs each scenario at each zoom factor (zoom changes: once) in each
+// layer blending mode, timing every frame (a tool movement or setting change, plus the canvas
+// redraw); min/median/p95/p99 frame times are logged & written to a JSON report in the
+// temporary-items directory
+
 - (void) ppMenuItemSelected_CanvasSpeedCheck: (id) sender
 {
     NSAutoreleasePool *autoreleasePool;
     PPDocumentWindowController *documentWindowController;
     PPDocument *ppDocument;
     PPCanvasView *canvasView;
-    PPTool *lineTool;
-    NSPoint point1, point2;
-    NSTimeInterval totalTime;
-    NSDate *startDate;
-    int dragLoopCount = 0;
-    NSRect drawRect;
-
-    autoreleasePool = [[NSAutoreleasePool alloc] init];
+    NSMutableArray *scenarioResults;
+    PPLayerBlendingMode initialLayerBlendingMode, layerBlendingMode;
+    float initialZoomFactor, zoomFactor;
+    unsigned zoomFactorIndex;
+    PPSpeedCheckScenario scenario;
+    NSDictionary *report;
+    NSString *reportPath;
 
     documentWindowController = [[NSApp mainWindow] windowController];
 
@@ -123,186 +179,372 @@ ERROR:
     ppDocument = [documentWindowController document];
     canvasView = [documentWindowController canvasView];
 
-    lineTool = [[PPToolbox sharedToolbox] toolOfType: kPPToolType_Line];
+    scenarioResults = [NSMutableArray array];
 
-    // Line tool - corner to corner
+    initialLayerBlendingMode = [ppDocument layerBlendingMode];
+    initialZoomFactor = [canvasView zoomFactor];
 
-    point1 = NSZeroPoint;
-    point2 =
-        NSMakePoint([ppDocument canvasSize].width - 1.0, [ppDocument canvasSize].height - 1.0);
-
-    [canvasView setIsDraggingTool: YES];
-
-    [lineTool mouseDownForDocument: ppDocument
-                withCanvasView: canvasView
-                currentPoint: point1
-                modifierKeyFlags: 0];
-
-    startDate = [[NSDate date] retain];
-    totalTime = 0;
-
-    dragLoopCount = kNumSpeedCheckDragMovements;
-
-    while (dragLoopCount--)
+    for (layerBlendingMode=0; layerBlendingMode<kNumPPLayerBlendingModes; layerBlendingMode++)
     {
-        [autoreleasePool release];
-        autoreleasePool = [[NSAutoreleasePool alloc] init];
-
-        totalTime -= [NSDate timeIntervalSinceReferenceDate];
+        [ppDocument setLayerBlendingMode: layerBlendingMode];
+
+        for (zoomFactorIndex=0;
+            zoomFactorIndex<(sizeof(kSpeedCheckZoomFactors) / sizeof(*kSpeedCheckZoomFactors));
+            zoomFactorIndex++)
+        {
+            zoomFactor = MIN(kSpeedCheckZoomFactors[zoomFactorIndex], kMaxCanvasZoomFactor);
+
+            [canvasView setZoomFactor: zoomFactor];
+            [canvasView displayIfNeeded];
+
+            for (scenario=0; scenario<kNumPPSpeedCheckScenarios; scenario++)
+            {
+                NSMutableData *frameTimes;
+                NSDictionary *statistics;
+
+                // zoom changes don't depend on the initial zoom factor
+                if ((scenario == kPPSpeedCheckScenario_ZoomChanges) && (zoomFactorIndex > 0))
+                {
+                    continue;
+                }
+
+                autoreleasePool = [[NSAutoreleasePool alloc] init];
+
+                frameTimes = [NSMutableData data];
+
+                RunSpeedCheckScenario(scenario, ppDocument, canvasView, frameTimes);
+
+                [canvasView setZoomFactor: zoomFactor];
+
+                statistics = FrameTimeStatisticsForScenario(scenario, frameTimes,
+                                                            layerBlendingMode, zoomFactor);
+
+                if (statistics)
+                {
+                    [scenarioResults addObject: statistics];
+
+                    NSLog(@"Speed check: %@ (%@ blending, zoom %dx) - frame times (ms): "
+                            "min %.2f, median %.2f, p95 %.2f, p99 %.2f",
+                            [statistics objectForKey: @"scenario"],
+                            [statistics objectForKey: @"layerBlendingMode"], (int) zoomFactor,
+                            [[statistics objectForKey: @"minFrameTime"] doubleValue] * 1000.0,
+                            [[statistics objectForKey: @"medianFrameTime"] doubleValue]
+                                * 1000.0,
+                            [[statistics objectForKey: @"p95FrameTime"] doubleValue] * 1000.0,
+                            [[statistics objectForKey: @"p99FrameTime"] doubleValue]
+                                * 1000.0);
+                }
+
+                [autoreleasePool release];
+            }
+        }
+    }
 
-        [lineTool mouseDraggedOrModifierKeysChangedForDocument: ppDocument
-                    withCanvasView: canvasView
-                    currentPoint: point2
-                    lastPoint: point1
-                    mouseDownPoint: point1
-                    modifierKeyFlags: 0];
+    [ppDocument setLayerBlendingMode: initialLayerBlendingMode];
+    [canvasView setZoomFactor: initialZoomFactor];
 
-        [canvasView displayIfNeeded];
+    report = [NSDictionary dictionaryWithObjectsAndKeys:
+                            [NSNumber numberWithInt: kSpeedCheckReportFormatVersion],
+                                @"formatVersion",
+                            [[NSDate date] description], @"date",
+                            [NSNumber numberWithFloat: [ppDocument canvasSize].width],
+                                @"canvasWidth",
+                            [NSNumber numberWithFloat: [ppDocument canvasSize].height],
+                                @"canvasHeight",
+                            [NSNumber numberWithInt: [ppDocument numLayers]], @"layerCount",
+                            scenarioResults, @"scenarios",
+                            nil];
+
+    reportPath =
+        [NSTemporaryDirectory() stringByAppendingPathComponent:
+                [NSString stringWithFormat: kSpeedCheckReportFilenameFormat,
+                            [[NSDate date] descriptionWithCalendarFormat: @"%Y-%m-%d %H.%M.%S"
+                                            timeZone: nil
+                                            locale: nil]]];
+
+    if ([[NSJSONSerialization dataWithJSONObject: report
+                                options: NSJSONWritingPrettyPrinted
+                                error: NULL]
+            writeToFile: reportPath
+            atomically: YES])
+    {
+        NSLog(@"Speed check: report written to %@", reportPath);
+    }
+}
 
-        [lineTool mouseDraggedOrModifierKeysChangedForDocument: ppDocument
-                    withCanvasView: canvasView
-                    currentPoint: point1
-                    lastPoint: point2
-                    mouseDownPoint: point1
-                    modifierKeyFlags: 0];
+@end
 
-        [canvasView displayIfNeeded];
+#pragma mark Private functions
 
-        totalTime += [NSDate timeIntervalSinceReferenceDate];
-    }
+static void RunSpeedCheckScenario(PPSpeedCheckScenario scenario, PPDocument *ppDocument,
+                                    PPCanvasView *canvasView, NSMutableData *frameTimes)
+{
+    NSSize canvasSize = [ppDocument canvasSize];
+    NSPoint mouseDownPoint = NSZeroPoint, currentPoint, lastPoint;
+    PPToolType toolType = kPPToolType_Pencil;
+    PPTool *tool = nil;
+    PPDocumentLayer *drawingLayer;
+    float initialOpacity = 1.0f;
+    int step;
+    NSTimeInterval frameTime;
+
+    switch (scenario)
+    {
+        case kPPSpeedCheckScenario_PencilStroke:
+            toolType = kPPToolType_Pencil;
+        break;
 
-    [lineTool mouseUpForDocument: ppDocument
-                withCanvasView: canvasView
-                currentPoint: point1
-                mouseDownPoint: point1
-                modifierKeyFlags: 0];
+        case kPPSpeedCheckScenario_LineCorners:
+            toolType = kPPToolType_Line;
+        break;
 
+        case kPPSpeedCheckScenario_RectDrag:
+            toolType = kPPToolType_Rect;
+        break;
 
-    [canvasView setIsDraggingTool: NO];
+        case kPPSpeedCheckScenario_OvalDrag:
+            toolType = kPPToolType_Oval;
+        break;
 
-    NSLog(@"Speed check: LINE TOOL, CORNERS - time elapsed: %f (%f)", (float) totalTime,
-            (float) -[startDate timeIntervalSinceNow]);
+        case kPPSpeedCheckScenario_FillToleranceDrag:
+            toolType = kPPToolType_Fill;
+        break;
 
+        case kPPSpeedCheckScenario_MagicWandToleranceDrag:
+            toolType = kPPToolType_MagicWand;
+        break;
 
-    // Line tool - small draw
+        case kPPSpeedCheckScenario_SelectionMove:
+            toolType = kPPToolType_Move;
+            [ppDocument selectAll];
+        break;
 
-    drawRect = PPGeometry_CenterRectInRect(PPGeometry_OriginRectOfSize(NSMakeSize(8,8)),
-                                            PPGeometry_OriginRectOfSize([ppDocument canvasSize]));
+        default:
+        break;
+    }
 
-    point1 = drawRect.origin;
-    point2 =
-        NSMakePoint(point1.x + drawRect.size.width - 1, point1.y + drawRect.size.height - 1);
+    if (scenario <= kPPSpeedCheckScenario_SelectionMove)
+    {
+        tool = [[PPToolbox sharedToolbox] toolOfType: toolType];
+        mouseDownPoint = SpeedCheckDragPoint(scenario, -1, canvasSize);
 
-    [canvasView setIsDraggingTool: YES];
+        [canvasView setIsDraggingTool: YES];
 
-    [lineTool mouseDownForDocument: ppDocument
+        [tool mouseDownForDocument: ppDocument
                 withCanvasView: canvasView
-                currentPoint: point1
+                currentPoint: mouseDownPoint
                 modifierKeyFlags: 0];
 
-    [startDate release];
-    startDate = [[NSDate date] retain];
-    totalTime = 0;
+        [canvasView displayIfNeeded];
+    }
+
+    drawingLayer = [ppDocument drawingLayer];
+
+    if (scenario == kPPSpeedCheckScenario_LayerOpacitySlide)
+    {
+        initialOpacity = [drawingLayer opacity];
+    }
 
-    dragLoopCount = kNumSpeedCheckDragMovements;
+    lastPoint = mouseDownPoint;
 
-    while (dragLoopCount--)
+    for (step=0; step<kNumSpeedCheckDragMovements; step++)
     {
-        [autoreleasePool release];
-        autoreleasePool = [[NSAutoreleasePool alloc] init];
+        NSAutoreleasePool *autoreleasePool = [[NSAutoreleasePool alloc] init];
+
+        currentPoint = SpeedCheckDragPoint(scenario, step, canvasSize);
 
-        totalTime -= [NSDate timeIntervalSinceReferenceDate];
+        frameTime = [NSDate timeIntervalSinceReferenceDate];
 
-        [lineTool mouseDraggedOrModifierKeysChangedForDocument: ppDocument
+        if (tool)
+        {
+            [tool mouseDraggedOrModifierKeysChangedForDocument: ppDocument
                     withCanvasView: canvasView
-                    currentPoint: point2
-                    lastPoint: point1
-                    mouseDownPoint: point1
+                    currentPoint: currentPoint
+                    lastPoint: lastPoint
+                    mouseDownPoint: mouseDownPoint
                     modifierKeyFlags: 0];
+        }
+        else if (scenario == kPPSpeedCheckScenario_LayerOpacitySlide)
+        {
+            [drawingLayer setOpacityWithoutRegisteringUndo:
+                                                SpeedCheckCycleFraction(step, YES)];
+        }
+        else if (scenario == kPPSpeedCheckScenario_RedrawBackground)
+        {
+            [canvasView performSelector: @selector(updateVisibleBackground)];
+        }
+        else if (scenario == kPPSpeedCheckScenario_ZoomChanges)
+        {
+            [canvasView setZoomFactor: 1 + (step % (int) kMaxCanvasZoomFactor)];
+        }
 
         [canvasView displayIfNeeded];
 
-        [lineTool mouseDraggedOrModifierKeysChangedForDocument: ppDocument
-                    withCanvasView: canvasView
-                    currentPoint: point1
-                    lastPoint: point2
-                    mouseDownPoint: point1
-                    modifierKeyFlags: 0];
+        frameTime = [NSDate timeIntervalSinceReferenceDate] - frameTime;
 
-        [canvasView displayIfNeeded];
+        [frameTimes appendBytes: &frameTime length: sizeof(frameTime)];
 
-        totalTime += [NSDate timeIntervalSinceReferenceDate];
+        lastPoint = currentPoint;
+
+        [autoreleasePool release];
     }
 
-    [lineTool mouseUpForDocument: ppDocument
+    if (tool)
+    {
+        [tool mouseUpForDocument: ppDocument
                 withCanvasView: canvasView
-                currentPoint: point1
-                mouseDownPoint: point1
+                currentPoint: lastPoint
+                mouseDownPoint: mouseDownPoint
                 modifierKeyFlags: 0];
 
+        [canvasView setIsDraggingTool: NO];
+    }
 
-    [canvasView setIsDraggingTool: NO];
-
-    NSLog(@"Speed check: LINE TOOL, SMALL DRAW - time elapsed: %f (%f)", (float) totalTime,
-            (float) -[startDate timeIntervalSinceNow]);
+    if (scenario == kPPSpeedCheckScenario_SelectionMove)
+    {
+        [ppDocument deselectAll];
+    }
+    else if (scenario == kPPSpeedCheckScenario_LayerOpacitySlide)
+    {
+        [drawingLayer setOpacityWithoutRegisteringUndo: initialOpacity];
+    }
 
+    [canvasView displayIfNeeded];
+}
 
-    // Zooming
+// SpeedCheckDragPoint() returns the mouse-down point for step -1
 
-    [startDate release];
-    startDate = [[NSDate date] retain];
-    totalTime = 0;
+static NSPoint SpeedCheckDragPoint(PPSpeedCheckScenario scenario, int step, NSSize canvasSize)
+{
+    float maxX = canvasSize.width - 1.0f, maxY = canvasSize.height - 1.0f, cycleFraction,
+            radius;
 
-    int initialZoomFactor = [canvasView zoomFactor], zoomCounter;
+    cycleFraction = (step >= 0) ? SpeedCheckCycleFraction(step, NO) : 0.0f;
 
-    for (zoomCounter=1; zoomCounter<=kMaxCanvasZoomFactor; zoomCounter++)
+    switch (scenario)
     {
-        [autoreleasePool release];
-        autoreleasePool = [[NSAutoreleasePool alloc] init];
+        case kPPSpeedCheckScenario_PencilStroke:
+        {
+            // wavy stroke across the canvas
+            float strokeFraction = (step >= 0) ?
+                                        (float) step / (kNumSpeedCheckDragMovements - 1) : 0.0f;
+
+            return PPGeometry_PointClippedToIntegerValues(
+                        NSMakePoint(strokeFraction * maxX,
+                                    maxY * (0.5f + 0.4f * sinf(strokeFraction * 4.0f * M_PI))));
+        }
+
+        case kPPSpeedCheckScenario_LineCorners:
+            // alternate between opposite corners
+            return (step & 1) ? NSZeroPoint : NSMakePoint(maxX, maxY);
+
+        case kPPSpeedCheckScenario_RectDrag:
+        case kPPSpeedCheckScenario_OvalDrag:
+            // shape grows from the lower-left quarter point to the upper-right quarter point
+            return PPGeometry_PointClippedToIntegerValues(
+                        NSMakePoint(maxX * (0.25f + 0.5f * cycleFraction),
+                                    maxY * (0.25f + 0.5f * cycleFraction)));
+
+        case kPPSpeedCheckScenario_FillToleranceDrag:
+        case kPPSpeedCheckScenario_MagicWandToleranceDrag:
+            // drag distance from the mouse-down point (center) sets the tolerance
+            return PPGeometry_PointClippedToIntegerValues(
+                        NSMakePoint(maxX * (0.5f + 0.5f * cycleFraction), maxY * 0.5f));
+
+        case kPPSpeedCheckScenario_SelectionMove:
+            // circle around the center
+            radius = MIN(maxX, maxY) / 8.0f;
+
+            return PPGeometry_PointClippedToIntegerValues(
+                        NSMakePoint(maxX * 0.5f + radius * sinf(cycleFraction * 2.0f * M_PI),
+                                    maxY * 0.5f + radius * cosf(cycleFraction * 2.0f * M_PI)
+                                        - radius));
+
+        default:
+        break;
+    }
 
-        totalTime -= [NSDate timeIntervalSinceReferenceDate];
+    return NSZeroPoint;
+}
 
-        [canvasView setZoomFactor: zoomCounter];
-        [canvasView displayIfNeeded];
+// SpeedCheckCycleFraction() returns step's position (0-1) in its drag cycle; if
+// shouldReverseAtMidpoint, it ramps back down (1-0) in the cycle's second half
+
+static float SpeedCheckCycleFraction(int step, bool shouldReverseAtMidpoint)
+{
+    float fraction = (float) (step % kNumSpeedCheckMovementsPerDragCycle)
+                        / (kNumSpeedCheckMovementsPerDragCycle - 1);
 
-        totalTime += [NSDate timeIntervalSinceReferenceDate];
+    if (shouldReverseAtMidpoint)
+    {
+        fraction = 1.0f - fabsf(1.0f - 2.0f * fraction);
     }
 
-    [canvasView setZoomFactor: initialZoomFactor];
+    return fraction;
+}
 
-    NSLog(@"Speed check: ZOOMING - time elapsed: %f (%f)", (float) totalTime,
-            (float) -[startDate timeIntervalSinceNow]);
+static NSDictionary *FrameTimeStatisticsForScenario(PPSpeedCheckScenario scenario,
+                                                    NSMutableData *frameTimes,
+                                                    PPLayerBlendingMode layerBlendingMode,
+                                                    float zoomFactor)
+{
+    NSTimeInterval *times, totalTime = 0;
+    int numFrames, frameIndex;
 
+    numFrames = [frameTimes length] / sizeof(NSTimeInterval);
 
-    // Redrawing background
+    if (!numFrames)
+        return nil;
 
-    [startDate release];
-    startDate = [[NSDate date] retain];
-    totalTime = 0;
+    times = (NSTimeInterval *) [frameTimes mutableBytes];
 
-    dragLoopCount = kNumSpeedCheckDragMovements;
+    qsort(times, numFrames, sizeof(NSTimeInterval), CompareFrameTimes);
 
-    while (dragLoopCount--)
+    for (frameIndex=0; frameIndex<numFrames; frameIndex++)
     {
-        [autoreleasePool release];
-        autoreleasePool = [[NSAutoreleasePool alloc] init];
+        totalTime += times[frameIndex];
+    }
 
-        totalTime -= [NSDate timeIntervalSinceReferenceDate];
+    return [NSDictionary dictionaryWithObjectsAndKeys:
+                            gSpeedCheckScenarioNames[scenario], @"scenario",
+                            (layerBlendingMode == kPPLayerBlendingMode_Linear) ?
+                                @"linear" : @"standard",
+                                @"layerBlendingMode",
+                            [NSNumber numberWithFloat: zoomFactor], @"zoomFactor",
+                            [NSNumber numberWithInt: numFrames], @"frameCount",
+                            [NSNumber numberWithDouble: times[0]], @"minFrameTime",
+                            [NSNumber numberWithDouble:
+                                            PercentileOfSortedTimes(times, numFrames, 0.50)],
+                                @"medianFrameTime",
+                            [NSNumber numberWithDouble:
+                                            PercentileOfSortedTimes(times, numFrames, 0.95)],
+                                @"p95FrameTime",
+                            [NSNumber numberWithDouble:
+                                            PercentileOfSortedTimes(times, numFrames, 0.99)],
+                                @"p99FrameTime",
+                            [NSNumber numberWithDouble: times[numFrames - 1]],
+                                @"maxFrameTime",
+                            [NSNumber numberWithDouble: totalTime / numFrames],
+                                @"meanFrameTime",
+                            nil];
+}
 
-        [canvasView performSelector: @selector(updateVisibleBackground)];
-        [canvasView displayIfNeeded];
+// nearest-rank percentile
 
-        totalTime += [NSDate timeIntervalSinceReferenceDate];
-    }
+static NSTimeInterval PercentileOfSortedTimes(NSTimeInterval *sortedTimes, int numTimes,
+                                                double percentile)
+{
+    int index = ceil(percentile * numTimes) - 1;
 
-    [canvasView setZoomFactor: initialZoomFactor];
+    return sortedTimes[MAX(0, MIN(index, numTimes - 1))];
+}
 
-    NSLog(@"Speed check: REDRAW BACKGROUND - time elapsed: %f (%f)", (float) totalTime,
-            (float) -[startDate timeIntervalSinceNow]);
+static int CompareFrameTimes(const void *time1, const void *time2)
+{
+    NSTimeInterval difference = *(const NSTimeInterval *) time1
+                                    - *(const NSTimeInterval *) time2;
 
-    [startDate release];
+    return (difference < 0) ? -1 : (difference > 0) ? 1 : 0;
 }
 
-@end
-
 #endif  // PP_OPTIONAL__BUILD_WITH_CANVAS_SPEED_CHECK
@@ -0,0 +1,119 @@
+/*
+    PPOptional_HotPathTracing.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPOptional.h"
+#if PP_OPTIONAL__BUILD_WITH_HOT_PATH_TRACING
+
+#import <Cocoa/Cocoa.h>
+#import "PPAppBootUtilities.h"
+#import "PPApplication.h"
+#import "PPTrace.h"
+#import "PPStartupTimeline.h"
+
+
+#define kHotPathTraceMenuItem_Name          @"Save Hot-Path Trace"
+
+#define kHotPathTraceFilenameFormat         @"PikoPixel Hot-Path Trace %@.json"
+
+
+@interface PPApplication (PPOptional_HotPathTracing)
+
+- (void) ppMenuItemSelected_SaveHotPathTrace: (id) sender;
+
+@end
+
+@implementation NSObject (PPOptional_HotPathTracing)
+
++ (void) load
+{
+    macroStartupTimelineMethodScope();
+
+    macroPerformNSObjectSelectorAfterAppLoads(ppOptional_HotPathTracing_SetupMenuItem);
+}
+
++ (void) ppOptional_HotPathTracing_SetupMenuItem
+{
+    NSMenu *canvasMenu;
+    NSMenuItem *saveTraceItem;
+        // use PPSDKNativeType_NSMenuItemPtr for separatorItem, as -[NSMenu separatorItem]
+        // could return either (NSMenuItem *) or (id <NSMenuItem>), depending on the SDK
+    PPSDKNativeType_NSMenuItemPtr separatorItem;
+
+    canvasMenu = [[[NSApp mainMenu] itemWithTitle: @"Canvas"] submenu];
+
+    saveTraceItem =
+                [[[NSMenuItem alloc] initWithTitle: kHotPathTraceMenuItem_Name
+                                        action: @selector(ppMenuItemSelected_SaveHotPathTrace:)
+                                        keyEquivalent: @""]
+                                autorelease];
+
+    [saveTraceItem setTarget: NSApp];
+
+    separatorItem = [NSMenuItem separatorItem];
+
+    if (!canvasMenu || !saveTraceItem || !separatorItem)
+    {
+        goto ERROR;
+    }
+
+    [canvasMenu addItem: separatorItem];
+    [canvasMenu addItem: saveTraceItem];
+
+    return;
+
+ERROR:
+    return;
+}
+
+@end
+
+@implementation PPApplication (PPOptional_HotPathTracing)
+
+// trace events are recorded continuously while the app runs (see PPTrace.h); saving writes
+// each thread's most recent events to a Chrome trace-event JSON file in the temporary-items
+// directory
+
+- (void) ppMenuItemSelected_SaveHotPathTrace: (id) sender
+{
+    NSString *tracePath;
+
+    tracePath =
+        [NSTemporaryDirectory() stringByAppendingPathComponent:
+                [NSString stringWithFormat: kHotPathTraceFilenameFormat,
+                            [[NSDate date] descriptionWithCalendarFormat: @"%Y-%m-%d %H.%M.%S"
+                                            timeZone: nil
+                                            locale: nil]]];
+
+    if (!PPTrace_WriteChromeTraceFile([tracePath fileSystemRepresentation]))
+    {
+        NSLog(@"Hot-path trace: unable to write %@", tracePath);
+        return;
+    }
+
+    NSLog(@"Hot-path trace: written to %@", tracePath);
+}
+
+@end
+
+#endif  // PP_OPTIONAL__BUILD_WITH_HOT_PATH_TRACING
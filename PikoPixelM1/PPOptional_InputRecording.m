@@ -0,0 +1,660 @@
+/*
+    PPOptional_InputRecording.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPOptional.h"
+#if PP_OPTIONAL__BUILD_WITH_INPUT_RECORDING
+
+#import <Cocoa/Cocoa.h>
+#import "PPAppBootUtilities.h"
+#import "PPApplication.h"
+#import "NSObject_PPUtilities.h"
+#import "PPDocumentWindowController.h"
+#import "PPDocument.h"
+#import "PPCanvasView.h"
+#import "PPTool.h"
+#import "PPToolbox.h"
+#import "PPGeometry.h"
+#import "PPStartupTimeline.h"
+
+
+#define kInputRecordingMenuItemTitle_Start          @"Start Input Recording"
+#define kInputRecordingMenuItemTitle_Stop           @"Stop Input Recording..."
+#define kInputReplayMenuItemTitle_MaximumSpeed      @"Replay Input Recording..."
+#define kInputReplayMenuItemTitle_RealTime          @"Replay Input Recording in Real Time..."
+
+#define kInputRecordingFileType                     @"json"
+#define kInputRecordingFormatVersion                1
+
+#define kInputRecordingKey_FormatVersion            @"formatVersion"
+#define kInputRecordingKey_CanvasWidth              @"canvasWidth"
+#define kInputRecordingKey_CanvasHeight             @"canvasHeight"
+#define kInputRecordingKey_Events                   @"events"
+
+#define kInputEventKey_Type                         @"type"
+#define kInputEventKey_ToolType                     @"tool"
+#define kInputEventKey_PointX                       @"x"
+#define kInputEventKey_PointY                       @"y"
+#define kInputEventKey_ModifierKeyFlags             @"modifiers"
+#define kInputEventKey_Time                         @"time"
+
+
+typedef enum
+{
+    kPPInputEventType_MouseDown,
+    kPPInputEventType_MouseDragged,
+    kPPInputEventType_ModifierKeysChanged,
+    kPPInputEventType_MouseUp,
+
+    kNumPPInputEventTypes
+
+} PPInputEventType;
+
+
+static NSMutableArray *gRecordedInputEvents = nil;
+static NSTimeInterval gInputRecordingStartTime = 0;
+static NSSize gInputRecordingCanvasSize;
+
+
+@interface PPApplication (PPOptional_InputRecording)
+
+- (void) ppMenuItemSelected_ToggleInputRecording: (id) sender;
+- (void) ppMenuItemSelected_InputReplay: (id) sender;
+- (void) ppMenuItemSelected_RealTimeInputReplay: (id) sender;
+
+- (void) ppInputRecording_InstallPatches: (bool) installPatches;
+- (void) ppInputRecording_SaveRecordedEvents;
+- (void) ppInputRecording_ReplayInRealTime: (bool) shouldReplayInRealTime;
+
+@end
+
+// PPDocumentWindowController private methods used by the input-recording patches
+@interface PPDocumentWindowController (PPOptional_InputRecordingPrivateMethodDeclarations)
+
+- (NSPoint) mouseLocationFromEvent: (NSEvent *) event
+            clippedToCanvasBounds: (bool) shouldClipToCanvasBounds;
+- (void) updateModifierKeyFlags: (unsigned) modifierKeyFlags;
+
+@end
+
+@interface PPDocumentWindowController (PPOptional_InputRecording)
+
+- (void) ppInputRecording_RecordEventOfType: (PPInputEventType) eventType
+            toolType: (PPToolType) toolType
+            point: (NSPoint) point;
+
+@end
+
+static NSDictionary *InputRecordingFromData(NSData *data);
+static void ReplayInputEvents(NSArray *events, PPDocumentWindowController *windowController,
+                                bool shouldReplayInRealTime);
+
+
+@implementation NSObject (PPOptional_InputRecording)
+
++ (void) load
+{
+    macroStartupTimelineMethodScope();
+
+    macroPerformNSObjectSelectorAfterAppLoads(ppOptional_InputRecording_SetupMenuItems);
+}
+
++ (void) ppOptional_InputRecording_SetupMenuItems
+{
+    NSMenu *canvasMenu;
+    NSMenuItem *recordingItem, *replayItem, *realTimeReplayItem;
+        // use PPSDKNativeType_NSMenuItemPtr for separatorItem, as -[NSMenu separatorItem]
+        // could return either (NSMenuItem *) or (id <NSMenuItem>), depending on the SDK
+    PPSDKNativeType_NSMenuItemPtr separatorItem;
+
+    canvasMenu = [[[NSApp mainMenu] itemWithTitle: @"Canvas"] submenu];
+
+    recordingItem =
+            [[[NSMenuItem alloc] initWithTitle: kInputRecordingMenuItemTitle_Start
+                                    action: @selector(ppMenuItemSelected_ToggleInputRecording:)
+                                    keyEquivalent: @""]
+                            autorelease];
+
+    replayItem =
+            [[[NSMenuItem alloc] initWithTitle: kInputReplayMenuItemTitle_MaximumSpeed
+                                    action: @selector(ppMenuItemSelected_InputReplay:)
+                                    keyEquivalent: @""]
+                            autorelease];
+
+    realTimeReplayItem =
+            [[[NSMenuItem alloc] initWithTitle: kInputReplayMenuItemTitle_RealTime
+                                    action: @selector(ppMenuItemSelected_RealTimeInputReplay:)
+                                    keyEquivalent: @""]
+                            autorelease];
+
+    [recordingItem setTarget: NSApp];
+    [replayItem setTarget: NSApp];
+    [realTimeReplayItem setTarget: NSApp];
+
+    separatorItem = [NSMenuItem separatorItem];
+
+    if (!canvasMenu || !recordingItem || !replayItem || !realTimeReplayItem || !separatorItem)
+    {
+        goto ERROR;
+    }
+
+    [canvasMenu addItem: separatorItem];
+    [canvasMenu addItem: recordingItem];
+    [canvasMenu addItem: replayItem];
+    [canvasMenu addItem: realTimeReplayItem];
+
+    return;
+
+ERROR:
+    return;
+}
+
+@end
+
+@implementation PPApplication (PPOptional_InputRecording)
+
+// Input recording logs the tool-level calls a document window controller makes to its active
+// tool (tool type, document point, modifier keys, time since recording started); replaying a
+// recording makes the same calls on the main window's document, either as fast as possible or
+// at the recorded times, and logs the replay's timing
+
+- (void) ppMenuItemSelected_ToggleInputRecording: (id) sender
+{
+    bool isRecording = (gRecordedInputEvents) ? YES : NO;
+
+    if (!isRecording)
+    {
+        gRecordedInputEvents = [[NSMutableArray alloc] init];
+        gInputRecordingStartTime = [NSDate timeIntervalSinceReferenceDate];
+        gInputRecordingCanvasSize = NSZeroSize;
+    }
+    else
+    {
+        [self ppInputRecording_SaveRecordedEvents];
+
+        [gRecordedInputEvents release];
+        gRecordedInputEvents = nil;
+    }
+
+    isRecording = !isRecording;
+
+    [self ppInputRecording_InstallPatches: isRecording];
+
+    if ([sender isKindOfClass: [NSMenuItem class]])
+    {
+        [((NSMenuItem *) sender) setTitle: (isRecording) ?
+                                                kInputRecordingMenuItemTitle_Stop
+                                                : kInputRecordingMenuItemTitle_Start];
+    }
+}
+
+- (void) ppMenuItemSelected_InputReplay: (id) sender
+{
+    [self ppInputRecording_ReplayInRealTime: NO];
+}
+
+- (void) ppMenuItemSelected_RealTimeInputReplay: (id) sender
+{
+    [self ppInputRecording_ReplayInRealTime: YES];
+}
+
+#pragma mark Private methods
+
+- (void) ppInputRecording_InstallPatches: (bool) installPatches
+{
+    static bool inputRecordingPatchesAreInstalled = NO;
+
+    installPatches = (installPatches) ? YES : NO;
+
+    if (inputRecordingPatchesAreInstalled == installPatches)
+    {
+        return;
+    }
+
+    macroSwizzleInstanceMethod(PPDocumentWindowController, mouseDown:,
+                                ppPatch_InputRec_MouseDown:);
+
+    macroSwizzleInstanceMethod(PPDocumentWindowController, mouseDragged:,
+                                ppPatch_InputRec_MouseDragged:);
+
+    macroSwizzleInstanceMethod(PPDocumentWindowController, mouseUp:,
+                                ppPatch_InputRec_MouseUp:);
+
+    macroSwizzleInstanceMethod(PPDocumentWindowController, updateModifierKeyFlags:,
+                                ppPatch_InputRec_UpdateModifierKeyFlags:);
+
+    inputRecordingPatchesAreInstalled = installPatches;
+}
+
+- (void) ppInputRecording_SaveRecordedEvents
+{
+    NSDictionary *recording;
+    NSData *recordingData;
+    NSSavePanel *savePanel;
+
+    if (![gRecordedInputEvents count])
+    {
+        return;
+    }
+
+    recording = [NSDictionary dictionaryWithObjectsAndKeys:
+                                [NSNumber numberWithInt: kInputRecordingFormatVersion],
+                                    kInputRecordingKey_FormatVersion,
+                                [NSNumber numberWithFloat: gInputRecordingCanvasSize.width],
+                                    kInputRecordingKey_CanvasWidth,
+                                [NSNumber numberWithFloat: gInputRecordingCanvasSize.height],
+                                    kInputRecordingKey_CanvasHeight,
+                                gRecordedInputEvents, kInputRecordingKey_Events,
+                                nil];
+
+    recordingData = [NSJSONSerialization dataWithJSONObject: recording
+                                            options: 0
+                                            error: NULL];
+
+    if (!recordingData)
+        goto ERROR;
+
+    savePanel = [NSSavePanel savePanel];
+
+    [savePanel setAllowedFileTypes: [NSArray arrayWithObject: kInputRecordingFileType]];
+
+    if ([savePanel runModal] != NSFileHandlingPanelOKButton)
+    {
+        return;
+    }
+
+    if (![recordingData writeToURL: [savePanel URL] atomically: YES])
+    {
+        goto ERROR;
+    }
+
+    return;
+
+ERROR:
+    NSLog(@"Input recording: unable to save the recorded events");
+
+    return;
+}
+
+- (void) ppInputRecording_ReplayInRealTime: (bool) shouldReplayInRealTime
+{
+    PPDocumentWindowController *documentWindowController;
+    NSOpenPanel *openPanel;
+    NSDictionary *recording;
+    NSSize canvasSize, recordedCanvasSize;
+
+    if (gRecordedInputEvents)
+    {
+        NSLog(@"Input replay: stop the current input recording before replaying");
+        return;
+    }
+
+    documentWindowController = [[NSApp mainWindow] windowController];
+
+    if (![documentWindowController isKindOfClass: [PPDocumentWindowController class]])
+    {
+        return;
+    }
+
+    openPanel = [NSOpenPanel openPanel];
+
+    [openPanel setAllowedFileTypes: [NSArray arrayWithObject: kInputRecordingFileType]];
+
+    if ([openPanel runModal] != NSFileHandlingPanelOKButton)
+    {
+        return;
+    }
+
+    recording = InputRecordingFromData([NSData dataWithContentsOfURL: [openPanel URL]]);
+
+    if (!recording)
+        goto ERROR;
+
+    canvasSize = [[documentWindowController document] canvasSize];
+
+    recordedCanvasSize =
+        NSMakeSize([[recording objectForKey: kInputRecordingKey_CanvasWidth] floatValue],
+                    [[recording objectForKey: kInputRecordingKey_CanvasHeight] floatValue]);
+
+    if (!NSEqualSizes(canvasSize, recordedCanvasSize))
+    {
+        NSLog(@"Input replay: canvas size (%dx%d) doesn't match the recording's (%dx%d)",
+                (int) canvasSize.width, (int) canvasSize.height,
+                (int) recordedCanvasSize.width, (int) recordedCanvasSize.height);
+    }
+
+    ReplayInputEvents([recording objectForKey: kInputRecordingKey_Events],
+                        documentWindowController, shouldReplayInRealTime);
+
+    return;
+
+ERROR:
+    NSLog(@"Input replay: unable to read the input recording file");
+
+    return;
+}
+
+@end
+
+@implementation PPDocumentWindowController (PPOptional_InputRecording)
+
+- (void) ppPatch_InputRec_MouseDown: (NSEvent *) theEvent
+{
+    bool wasTrackingMouse = _isTrackingMouseInCanvasView;
+
+    [self ppPatch_InputRec_MouseDown: theEvent];
+
+    if (!wasTrackingMouse && _isTrackingMouseInCanvasView)
+    {
+        [self ppInputRecording_RecordEventOfType: kPPInputEventType_MouseDown
+                toolType: [_ppDocument activeToolType]
+                point: _mouseDownLocation];
+    }
+}
+
+- (void) ppPatch_InputRec_MouseDragged: (NSEvent *) theEvent
+{
+    NSPoint lastMouseLocation = _lastMouseLocation;
+
+    [self ppPatch_InputRec_MouseDragged: theEvent];
+
+    if (_isTrackingMouseInCanvasView && !NSEqualPoints(_lastMouseLocation, lastMouseLocation))
+    {
+        [self ppInputRecording_RecordEventOfType: kPPInputEventType_MouseDragged
+                toolType: [_ppDocument activeToolType]
+                point: _lastMouseLocation];
+    }
+}
+
+- (void) ppPatch_InputRec_MouseUp: (NSEvent *) theEvent
+{
+    bool wasTrackingMouse = _isTrackingMouseInCanvasView;
+    PPToolType toolType;
+    NSPoint mouseLocation = NSZeroPoint;
+
+    // read the active tool type & mouse-up location before the original method runs, as it
+    // may update the active tool
+
+    toolType = [_ppDocument activeToolType];
+
+    if (wasTrackingMouse)
+    {
+        mouseLocation = [self mouseLocationFromEvent: theEvent
+                                clippedToCanvasBounds:
+                                                _shouldClipMouseLocationPointsToCanvasBounds];
+    }
+
+    [self ppPatch_InputRec_MouseUp: theEvent];
+
+    if (wasTrackingMouse)
+    {
+        [self ppInputRecording_RecordEventOfType: kPPInputEventType_MouseUp
+                toolType: toolType
+                point: mouseLocation];
+    }
+}
+
+- (void) ppPatch_InputRec_UpdateModifierKeyFlags: (unsigned) modifierKeyFlags
+{
+    unsigned lastModifierKeyFlags = _modifierKeyFlags;
+
+    [self ppPatch_InputRec_UpdateModifierKeyFlags: modifierKeyFlags];
+
+    // modifier changes outside a mouse drag only affect the active tool type, which is
+    // recorded with each event
+
+    if (_isTrackingMouseInCanvasView && (_modifierKeyFlags != lastModifierKeyFlags))
+    {
+        [self ppInputRecording_RecordEventOfType: kPPInputEventType_ModifierKeysChanged
+                toolType: [_ppDocument activeToolType]
+                point: _lastMouseLocation];
+    }
+}
+
+- (void) ppInputRecording_RecordEventOfType: (PPInputEventType) eventType
+            toolType: (PPToolType) toolType
+            point: (NSPoint) point
+{
+    if (!gRecordedInputEvents)
+        return;
+
+    if (NSEqualSizes(gInputRecordingCanvasSize, NSZeroSize))
+    {
+        gInputRecordingCanvasSize = [_ppDocument canvasSize];
+    }
+
+    [gRecordedInputEvents addObject:
+                [NSDictionary dictionaryWithObjectsAndKeys:
+                                [NSNumber numberWithInt: eventType], kInputEventKey_Type,
+                                [NSNumber numberWithInt: toolType], kInputEventKey_ToolType,
+                                [NSNumber numberWithFloat: point.x], kInputEventKey_PointX,
+                                [NSNumber numberWithFloat: point.y], kInputEventKey_PointY,
+                                [NSNumber numberWithUnsignedInt: _modifierKeyFlags],
+                                    kInputEventKey_ModifierKeyFlags,
+                                [NSNumber numberWithDouble:
+                                            [NSDate timeIntervalSinceReferenceDate]
+                                                - gInputRecordingStartTime],
+                                    kInputEventKey_Time,
+                                nil]];
+}
+
+@end
+
+#pragma mark Private functions
+
+static NSDictionary *InputRecordingFromData(NSData *data)
+{
+    NSDictionary *recording;
+    NSArray *events;
+    NSEnumerator *eventEnumerator;
+    NSDictionary *event;
+
+    if (!data)
+        goto ERROR;
+
+    recording = [NSJSONSerialization JSONObjectWithData: data options: 0 error: NULL];
+
+    if (![recording isKindOfClass: [NSDictionary class]]
+        || ([[recording objectForKey: kInputRecordingKey_FormatVersion] intValue]
+                != kInputRecordingFormatVersion))
+    {
+        goto ERROR;
+    }
+
+    events = [recording objectForKey: kInputRecordingKey_Events];
+
+    if (![events isKindOfClass: [NSArray class]])
+        goto ERROR;
+
+    eventEnumerator = [events objectEnumerator];
+
+    while (event = [eventEnumerator nextObject])
+    {
+        if (![event isKindOfClass: [NSDictionary class]]
+            || (((unsigned) [[event objectForKey: kInputEventKey_Type] intValue])
+                    >= kNumPPInputEventTypes)
+            || !PPToolType_IsValid([[event objectForKey: kInputEventKey_ToolType] intValue]))
+        {
+            goto ERROR;
+        }
+    }
+
+    return recording;
+
+ERROR:
+    return nil;
+}
+
+// ReplayInputEvents() makes each event's tool call & redraws the canvas; recorded points are
+// clipped to the document's canvas, and mouse-drag sequences without a (valid) mouse-down are
+// skipped
+
+static void ReplayInputEvents(NSArray *events, PPDocumentWindowController *windowController,
+                                bool shouldReplayInRealTime)
+{
+    PPDocument *ppDocument = [windowController document];
+    PPCanvasView *canvasView = [windowController canvasView];
+    NSRect canvasFrame;
+    NSEnumerator *eventEnumerator;
+    NSDictionary *event;
+    PPTool *tool = nil;
+    NSPoint mouseDownPoint = NSZeroPoint, lastPoint = NSZeroPoint, point;
+    NSTimeInterval replayStartTime, eventStartTime, eventDuration,
+                    totalEventDuration = 0, maxEventDuration = 0;
+    int numReplayedEvents = 0;
+
+    canvasFrame = PPGeometry_OriginRectOfSize([ppDocument canvasSize]);
+
+    [ppDocument disableAutosaving: YES];
+
+    replayStartTime = [NSDate timeIntervalSinceReferenceDate];
+
+    eventEnumerator = [events objectEnumerator];
+
+    while (event = [eventEnumerator nextObject])
+    {
+        NSAutoreleasePool *autoreleasePool;
+        PPInputEventType eventType;
+        unsigned modifierKeyFlags;
+
+        eventType = [[event objectForKey: kInputEventKey_Type] intValue];
+
+        if (!tool && (eventType != kPPInputEventType_MouseDown))
+        {
+            continue;
+        }
+
+        if (shouldReplayInRealTime)
+        {
+            [NSThread sleepUntilDate:
+                        [NSDate dateWithTimeIntervalSinceReferenceDate:
+                                    replayStartTime
+                                        + [[event objectForKey: kInputEventKey_Time]
+                                                doubleValue]]];
+        }
+
+        autoreleasePool = [[NSAutoreleasePool alloc] init];
+
+        point = PPGeometry_PointClippedToRect(
+                    NSMakePoint([[event objectForKey: kInputEventKey_PointX] floatValue],
+                                [[event objectForKey: kInputEventKey_PointY] floatValue]),
+                    canvasFrame);
+
+        modifierKeyFlags =
+                    [[event objectForKey: kInputEventKey_ModifierKeyFlags] unsignedIntValue];
+
+        eventStartTime = [NSDate timeIntervalSinceReferenceDate];
+
+        switch (eventType)
+        {
+            case kPPInputEventType_MouseDown:
+            {
+                tool = [[PPToolbox sharedToolbox]
+                                toolOfType: [[event objectForKey: kInputEventKey_ToolType]
+                                                intValue]];
+
+                mouseDownPoint = lastPoint = point;
+
+                [canvasView setIsDraggingTool: YES];
+
+                [tool mouseDownForDocument: ppDocument
+                        withCanvasView: canvasView
+                        currentPoint: point
+                        modifierKeyFlags: modifierKeyFlags];
+            }
+            break;
+
+            case kPPInputEventType_MouseDragged:
+            case kPPInputEventType_ModifierKeysChanged:
+            {
+                [tool mouseDraggedOrModifierKeysChangedForDocument: ppDocument
+                        withCanvasView: canvasView
+                        currentPoint: point
+                        lastPoint: lastPoint
+                        mouseDownPoint: mouseDownPoint
+                        modifierKeyFlags: modifierKeyFlags];
+
+                lastPoint = point;
+            }
+            break;
+
+            case kPPInputEventType_MouseUp:
+            {
+                [canvasView setIsDraggingTool: NO];
+
+                [tool mouseUpForDocument: ppDocument
+                        withCanvasView: canvasView
+                        currentPoint: point
+                        mouseDownPoint: mouseDownPoint
+                        modifierKeyFlags: modifierKeyFlags];
+
+                tool = nil;
+            }
+            break;
+
+            default:
+            break;
+        }
+
+        [canvasView displayIfNeeded];
+
+        eventDuration = [NSDate timeIntervalSinceReferenceDate] - eventStartTime;
+
+        totalEventDuration += eventDuration;
+
+        if (eventDuration > maxEventDuration)
+        {
+            maxEventDuration = eventDuration;
+        }
+
+        numReplayedEvents++;
+
+        [autoreleasePool release];
+    }
+
+    if (tool)
+    {
+        // recording ended mid-drag
+
+        [canvasView setIsDraggingTool: NO];
+
+        [tool mouseUpForDocument: ppDocument
+                withCanvasView: canvasView
+                currentPoint: lastPoint
+                mouseDownPoint: mouseDownPoint
+                modifierKeyFlags: 0];
+
+        [canvasView displayIfNeeded];
+    }
+
+    [ppDocument disableAutosaving: NO];
+
+    NSLog(@"Input replay (%@): %d events in %.3f seconds (mean event time: %.2f ms, "
+            "max: %.2f ms)",
+            (shouldReplayInRealTime) ? @"real time" : @"maximum speed",
+            numReplayedEvents, [NSDate timeIntervalSinceReferenceDate] - replayStartTime,
+            (numReplayedEvents) ? totalEventDuration * 1000.0 / numReplayedEvents : 0.0,
+            maxEventDuration * 1000.0);
+}
+
+#endif  // PP_OPTIONAL__BUILD_WITH_INPUT_RECORDING
@@ -0,0 +1,44 @@
+/*
+    PPOptional_KernelBenchmarks.h
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPOptional.h"
+#if PP_OPTIONAL__BUILD_WITH_KERNEL_BENCHMARKS
+
+// Kernel benchmarks: Times the bitmap utility kernels (NSBitmapImageRep_PPUtilities_*) over
+// parameterized cases (canvas sizes, mask densities, layer counts, zoom factors), & writes the
+// results as JSON, so kernel performance can be tracked per commit. Runs headless (no
+// NSApplication) when the executable's first argument is kPPKernelBenchmarksCommandLineFlag
+// (see main.m):
+//
+//  PikoPixel -ppBenchmarkKernels [-o <results.json>] [-quick]
+//
+// (results are written to stdout if there's no -o option; -quick limits canvas sizes to 256)
+
+#define kPPKernelBenchmarksCommandLineFlag      "-ppBenchmarkKernels"
+
+
+// returns the process exit status
+int PPKernelBenchmarks_RunWithCommandLineArguments(int argc, char **argv);
+
+#endif  // PP_OPTIONAL__BUILD_WITH_KERNEL_BENCHMARKS
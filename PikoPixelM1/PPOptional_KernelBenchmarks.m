@@ -0,0 +1,781 @@
+/*
+    PPOptional_KernelBenchmarks.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPOptional_KernelBenchmarks.h"
+#if PP_OPTIONAL__BUILD_WITH_KERNEL_BENCHMARKS
+
+#import <Cocoa/Cocoa.h>
+#import "PPAppBootUtilities.h"
+#import "PPUserDefaults.h"
+#import "NSBitmapImageRep_PPUtilities.h"
+#import "PPGeometry.h"
+
+
+#define kOption_OutputPath                  @"-o"
+#define kOption_Quick                       @"-quick"
+
+#define kResultsFormatVersion               1
+
+// each case is timed for at least kMinCaseDuration seconds (& kMinCaseIterations), after an
+// untimed warm-up iteration; the fastest iteration's time is reported
+#define kMinCaseDuration                    0.25
+#define kMinCaseIterations                  3
+#define kMaxCaseIterations                  1000
+
+#define kRandomSeed                         1
+
+#define kMaxQuickCanvasDimension            256
+
+// hole closing floods from each border pixel, so large canvases take too long to time
+#define kMaxHoleClosingCanvasDimension      256
+
+// scaled copies are timed at the size of a typical visible canvas area
+#define kScaledCopyDestinationDimension     1024
+
+#define kBackgroundPixelValue               0xFF202020
+#define kForegroundPixelValue               0xFF40C0F0
+#define kGridPixelValue                     0xFF808080
+
+
+static const unsigned kCanvasDimensions[] = {64, 256, 1024, kMaxCanvasDimension};
+static const float kMaskDensities[] = {0.05f, 0.5f, 1.0f};
+static const unsigned kLayerCounts[] = {1, 4, 16};
+static const unsigned kZoomFactors[] = {1, 4, 16};
+
+
+@interface PPKernelBenchmarks : NSObject
+{
+    NSMutableArray *_results;
+    bool _isQuick;
+}
+
+- initWithQuickFlag: (bool) isQuick;
+
+- (void) runAllCases;
+
+- (void) runMaskedImageCasesWithCanvasDimension: (unsigned) dimension;
+- (void) runColorMatchingCasesWithCanvasDimension: (unsigned) dimension;
+- (void) runLinearBlendingCasesWithCanvasDimension: (unsigned) dimension;
+- (void) runScaledCopyCasesWithCanvasDimension: (unsigned) dimension;
+- (void) runTransformCasesWithCanvasDimension: (unsigned) dimension;
+- (void) runMaskCasesWithCanvasDimension: (unsigned) dimension;
+
+- (void) timeKernel: (NSString *) kernelName
+            canvasDimension: (unsigned) dimension
+            parameters: (NSDictionary *) parameters
+            numPixelsPerIteration: (double) numPixelsPerIteration
+            bytesPerPixel: (double) bytesPerPixel
+            kernelBlock: (void (^)(void)) kernelBlock;
+
+- (NSData *) resultsJSONData;
+
+@end
+
+static NSBitmapImageRep *BenchmarkImageBitmap(unsigned dimension, float foregroundDensity);
+static NSBitmapImageRep *BenchmarkMaskBitmap(unsigned dimension, float density);
+static bool RandomFlagWithProbability(float probability);
+
+
+int PPKernelBenchmarks_RunWithCommandLineArguments(int argc, char **argv)
+{
+    NSAutoreleasePool *autoreleasePool;
+    NSString *outputPath = nil;
+    bool isQuick = NO;
+    int argIndex, exitStatus = 1;
+    PPKernelBenchmarks *benchmarks;
+    NSData *resultsData;
+
+    autoreleasePool = [[NSAutoreleasePool alloc] init];
+
+    // same setup as the batch converter (PPBatchConverter.m): delayed setup selectors & the
+    // linear working format
+
+    PPAppBootUtils_HandleAppDidFinishLoading();
+
+    [NSBitmapImageRep ppSetLinearBitmapsUseCompactFormat:
+                                            [PPUserDefaults linearBlendingUsesCompactFormat]];
+
+    // skip argv[0] (executable path) & argv[1] (kPPKernelBenchmarksCommandLineFlag)
+
+    for (argIndex=2; argIndex<argc; argIndex++)
+    {
+        NSString *argument = [NSString stringWithUTF8String: argv[argIndex]];
+
+        if ([argument isEqualToString: kOption_Quick])
+        {
+            isQuick = YES;
+        }
+        else if ([argument isEqualToString: kOption_OutputPath] && (argIndex + 1 < argc))
+        {
+            outputPath = [[NSString stringWithUTF8String: argv[++argIndex]]
+                                                                stringByStandardizingPath];
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s %s [-o <results.json>] [-quick]\n", argv[0],
+                    kPPKernelBenchmarksCommandLineFlag);
+
+            goto ERROR;
+        }
+    }
+
+    benchmarks = [[[PPKernelBenchmarks alloc] initWithQuickFlag: isQuick] autorelease];
+
+    if (!benchmarks)
+        goto ERROR;
+
+    [benchmarks runAllCases];
+
+    resultsData = [benchmarks resultsJSONData];
+
+    if (!resultsData)
+        goto ERROR;
+
+    if (outputPath)
+    {
+        if (![resultsData writeToFile: outputPath atomically: YES])
+        {
+            fprintf(stderr, "Unable to write results file: %s\n", [outputPath UTF8String]);
+
+            goto ERROR;
+        }
+    }
+    else
+    {
+        fwrite([resultsData bytes], 1, [resultsData length], stdout);
+        fputc('\n', stdout);
+    }
+
+    exitStatus = 0;
+
+ERROR:
+    [autoreleasePool release];
+
+    return exitStatus;
+}
+
+@implementation PPKernelBenchmarks
+
+- initWithQuickFlag: (bool) isQuick
+{
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    _results = [[NSMutableArray array] retain];
+
+    if (!_results)
+        goto ERROR;
+
+    _isQuick = (isQuick) ? YES : NO;
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- init
+{
+    return [self initWithQuickFlag: NO];
+}
+
+- (void) dealloc
+{
+    [_results release];
+
+    [super dealloc];
+}
+
+- (void) runAllCases
+{
+    unsigned dimensionIndex;
+    unsigned dimension;
+
+    srandom(kRandomSeed);
+
+    for (dimensionIndex=0;
+        dimensionIndex<(sizeof(kCanvasDimensions) / sizeof(*kCanvasDimensions));
+        dimensionIndex++)
+    {
+        NSAutoreleasePool *autoreleasePool;
+
+        dimension = kCanvasDimensions[dimensionIndex];
+
+        if (_isQuick && (dimension > kMaxQuickCanvasDimension))
+        {
+            break;
+        }
+
+        autoreleasePool = [[NSAutoreleasePool alloc] init];
+
+        [self runMaskedImageCasesWithCanvasDimension: dimension];
+        [self runColorMatchingCasesWithCanvasDimension: dimension];
+        [self runLinearBlendingCasesWithCanvasDimension: dimension];
+        [self runScaledCopyCasesWithCanvasDimension: dimension];
+        [self runTransformCasesWithCanvasDimension: dimension];
+        [self runMaskCasesWithCanvasDimension: dimension];
+
+        [autoreleasePool release];
+    }
+}
+
+// Masked fill / erase / copy
+
+- (void) runMaskedImageCasesWithCanvasDimension: (unsigned) dimension
+{
+    NSBitmapImageRep *destinationBitmap, *sourceBitmap, *maskBitmap;
+    NSRect canvasFrame;
+    double numPixels = (double) dimension * dimension;
+    unsigned densityIndex;
+
+    canvasFrame = PPGeometry_OriginRectOfSize(NSMakeSize(dimension, dimension));
+
+    destinationBitmap = BenchmarkImageBitmap(dimension, 0.5f);
+    sourceBitmap = BenchmarkImageBitmap(dimension, 0.5f);
+
+    if (!destinationBitmap || !sourceBitmap)
+        return;
+
+    for (densityIndex=0;
+        densityIndex<(sizeof(kMaskDensities) / sizeof(*kMaskDensities));
+        densityIndex++)
+    {
+        NSDictionary *parameters;
+
+        maskBitmap = BenchmarkMaskBitmap(dimension, kMaskDensities[densityIndex]);
+
+        if (!maskBitmap)
+            continue;
+
+        parameters = [NSDictionary dictionaryWithObject:
+                                        [NSNumber numberWithFloat: kMaskDensities[densityIndex]]
+                                    forKey: @"maskDensity"];
+
+        // bytes per pixel: mask read + image write (+ source read, for copies)
+
+        [self timeKernel: @"maskedFill"
+                canvasDimension: dimension
+                parameters: parameters
+                numPixelsPerIteration: numPixels
+                bytesPerPixel: sizeof(PPMaskBitmapPixel) + sizeof(PPImageBitmapPixel)
+                kernelBlock: ^{
+                    [destinationBitmap ppMaskedFillUsingMask: maskBitmap
+                                        inBounds: canvasFrame
+                                        fillPixelValue: kForegroundPixelValue];
+                }];
+
+        [self timeKernel: @"maskedErase"
+                canvasDimension: dimension
+                parameters: parameters
+                numPixelsPerIteration: numPixels
+                bytesPerPixel: sizeof(PPMaskBitmapPixel) + sizeof(PPImageBitmapPixel)
+                kernelBlock: ^{
+                    [destinationBitmap ppMaskedEraseUsingMask: maskBitmap
+                                        inBounds: canvasFrame];
+                }];
+
+        [self timeKernel: @"maskedCopy"
+                canvasDimension: dimension
+                parameters: parameters
+                numPixelsPerIteration: numPixels
+                bytesPerPixel: sizeof(PPMaskBitmapPixel) + 2 * sizeof(PPImageBitmapPixel)
+                kernelBlock: ^{
+                    [destinationBitmap ppMaskedCopyFromImageBitmap: sourceBitmap
+                                        usingMask: maskBitmap
+                                        inBounds: canvasFrame];
+                }];
+    }
+}
+
+// Flood fill & global color matching
+
+- (void) runColorMatchingCasesWithCanvasDimension: (unsigned) dimension
+{
+    NSBitmapImageRep *maskBitmap;
+    double numPixels = (double) dimension * dimension;
+    unsigned densityIndex;
+
+    maskBitmap = [NSBitmapImageRep ppMaskBitmapOfSize: NSMakeSize(dimension, dimension)];
+
+    if (!maskBitmap)
+        return;
+
+    // mask density is the density of the image's foreground pixels (unmatched pixels)
+
+    for (densityIndex=0;
+        densityIndex<(sizeof(kMaskDensities) / sizeof(*kMaskDensities));
+        densityIndex++)
+    {
+        NSBitmapImageRep *imageBitmap;
+        NSDictionary *parameters;
+        float density = kMaskDensities[densityIndex];
+
+        // a fully-foreground image is one color, so it's the same as an empty one
+        if (density >= 1.0f)
+        {
+            density = 0.0f;
+        }
+
+        imageBitmap = BenchmarkImageBitmap(dimension, density);
+
+        if (!imageBitmap)
+            continue;
+
+        parameters = [NSDictionary dictionaryWithObject: [NSNumber numberWithFloat: density]
+                                    forKey: @"maskDensity"];
+
+        // bytes per pixel: image read + mask write
+
+        [self timeKernel: @"floodFill"
+                canvasDimension: dimension
+                parameters: parameters
+                numPixelsPerIteration: numPixels
+                bytesPerPixel: sizeof(PPImageBitmapPixel) + sizeof(PPMaskBitmapPixel)
+                kernelBlock: ^{
+                    [maskBitmap ppMaskNeighboringPixelsMatchingColorAtPoint: NSZeroPoint
+                                inImageBitmap: imageBitmap
+                                colorMatchTolerance: 0
+                                selectionMask: nil
+                                selectionMaskBounds: NSZeroRect
+                                matchDiagonally: NO];
+                }];
+
+        [self timeKernel: @"globalColorMatch"
+                canvasDimension: dimension
+                parameters: parameters
+                numPixelsPerIteration: numPixels
+                bytesPerPixel: sizeof(PPImageBitmapPixel) + sizeof(PPMaskBitmapPixel)
+                kernelBlock: ^{
+                    [maskBitmap ppMaskAllPixelsMatchingColorAtPoint: NSZeroPoint
+                                inImageBitmap: imageBitmap
+                                colorMatchTolerance: 0
+                                selectionMask: nil
+                                selectionMaskBounds: NSZeroRect];
+                }];
+    }
+}
+
+// Linear copy & blend (layer counts: number of layers merged per iteration)
+
+- (void) runLinearBlendingCasesWithCanvasDimension: (unsigned) dimension
+{
+    NSBitmapImageRep *imageBitmap, *sourceLinearBitmap, *mergedLinearBitmap;
+    NSRect canvasFrame;
+    double numPixels = (double) dimension * dimension, linearBytesPerPixel;
+    unsigned layerCountIndex;
+
+    canvasFrame = PPGeometry_OriginRectOfSize(NSMakeSize(dimension, dimension));
+
+    imageBitmap = BenchmarkImageBitmap(dimension, 0.5f);
+    sourceLinearBitmap = [NSBitmapImageRep ppLinearBitmapOfSize: canvasFrame.size];
+    mergedLinearBitmap = [NSBitmapImageRep ppLinearBitmapOfSize: canvasFrame.size];
+
+    if (!imageBitmap || !sourceLinearBitmap || !mergedLinearBitmap)
+    {
+        return;
+    }
+
+    linearBytesPerPixel = [sourceLinearBitmap bitsPerPixel] / 8;
+
+    [self timeKernel: @"linearCopyFromImage"
+            canvasDimension: dimension
+            parameters: nil
+            numPixelsPerIteration: numPixels
+            bytesPerPixel: sizeof(PPImageBitmapPixel) + linearBytesPerPixel
+            kernelBlock: ^{
+                [sourceLinearBitmap ppLinearCopyFromImageBitmap: imageBitmap
+                                    inBounds: canvasFrame];
+            }];
+
+    for (layerCountIndex=0;
+        layerCountIndex<(sizeof(kLayerCounts) / sizeof(*kLayerCounts));
+        layerCountIndex++)
+    {
+        unsigned numLayers = kLayerCounts[layerCountIndex];
+
+        // bytes per pixel: first layer's copy (read + write), then each other layer's blend
+        // (source read + destination read & write)
+
+        [self timeKernel: @"linearMergeLayers"
+                canvasDimension: dimension
+                parameters: [NSDictionary dictionaryWithObject:
+                                                    [NSNumber numberWithUnsignedInt: numLayers]
+                                            forKey: @"layerCount"]
+                numPixelsPerIteration: numPixels * numLayers
+                bytesPerPixel: (2.0 * linearBytesPerPixel
+                                    + 3.0 * linearBytesPerPixel * (numLayers - 1))
+                                / numLayers
+                kernelBlock: ^{
+                    unsigned layerCounter = numLayers - 1;
+
+                    [mergedLinearBitmap ppLinearCopyFromLinearBitmap: sourceLinearBitmap
+                                        opacity: 1.0f
+                                        inBounds: canvasFrame];
+
+                    while (layerCounter--)
+                    {
+                        [mergedLinearBitmap
+                                    ppLinearBlendFromLinearBitmapUnderneath: sourceLinearBitmap
+                                    sourceOpacity: 0.5f
+                                    inBounds: canvasFrame];
+                    }
+                }];
+    }
+}
+
+// Scaled copy with grid (as drawn to the canvas view at each zoom factor)
+
+- (void) runScaledCopyCasesWithCanvasDimension: (unsigned) dimension
+{
+    NSBitmapImageRep *sourceBitmap, *destinationBitmap;
+    unsigned zoomFactorIndex;
+
+    sourceBitmap = BenchmarkImageBitmap(dimension, 0.5f);
+    destinationBitmap =
+            [NSBitmapImageRep ppImageBitmapOfSize:
+                                            NSMakeSize(kScaledCopyDestinationDimension,
+                                                        kScaledCopyDestinationDimension)];
+
+    if (!sourceBitmap || !destinationBitmap)
+    {
+        return;
+    }
+
+    for (zoomFactorIndex=0;
+        zoomFactorIndex<(sizeof(kZoomFactors) / sizeof(*kZoomFactors));
+        zoomFactorIndex++)
+    {
+        unsigned zoomFactor = kZoomFactors[zoomFactorIndex], sourceDimension;
+        NSRect sourceRect;
+
+        sourceDimension = MIN(dimension, kScaledCopyDestinationDimension / zoomFactor);
+        sourceRect = PPGeometry_OriginRectOfSize(NSMakeSize(sourceDimension, sourceDimension));
+
+        // pixels are destination pixels; bytes per pixel: destination write + source read
+        // (amortized over the scaled source pixel)
+
+        [self timeKernel: @"scaledCopyWithGrid"
+                canvasDimension: dimension
+                parameters: [NSDictionary dictionaryWithObject:
+                                                    [NSNumber numberWithUnsignedInt: zoomFactor]
+                                            forKey: @"zoomFactor"]
+                numPixelsPerIteration: (double) sourceDimension * sourceDimension
+                                            * zoomFactor * zoomFactor
+                bytesPerPixel: sizeof(PPImageBitmapPixel)
+                                + sizeof(PPImageBitmapPixel)
+                                    / (double) (zoomFactor * zoomFactor)
+                kernelBlock: ^{
+                    [destinationBitmap ppScaledCopyFromImageBitmap: sourceBitmap
+                                        inRect: sourceRect
+                                        toPoint: NSZeroPoint
+                                        scalingFactor: zoomFactor
+                                        gridType: kPPGridType_Lines
+                                        gridPixelValue: kGridPixelValue];
+                }];
+    }
+}
+
+// Rotate & mirror
+
+- (void) runTransformCasesWithCanvasDimension: (unsigned) dimension
+{
+    NSBitmapImageRep *imageBitmap;
+    double numPixels = (double) dimension * dimension;
+
+    imageBitmap = BenchmarkImageBitmap(dimension, 0.5f);
+
+    if (!imageBitmap)
+        return;
+
+    // bytes per pixel: source read + new bitmap's write
+
+    [self timeKernel: @"mirrorHorizontally"
+            canvasDimension: dimension
+            parameters: nil
+            numPixelsPerIteration: numPixels
+            bytesPerPixel: 2 * sizeof(PPImageBitmapPixel)
+            kernelBlock: ^{
+                [imageBitmap ppBitmapMirroredHorizontally];
+            }];
+
+    [self timeKernel: @"mirrorVertically"
+            canvasDimension: dimension
+            parameters: nil
+            numPixelsPerIteration: numPixels
+            bytesPerPixel: 2 * sizeof(PPImageBitmapPixel)
+            kernelBlock: ^{
+                [imageBitmap ppBitmapMirroredVertically];
+            }];
+
+    [self timeKernel: @"rotate90Clockwise"
+            canvasDimension: dimension
+            parameters: nil
+            numPixelsPerIteration: numPixels
+            bytesPerPixel: 2 * sizeof(PPImageBitmapPixel)
+            kernelBlock: ^{
+                [imageBitmap ppBitmapRotated90Clockwise];
+            }];
+}
+
+// Mask bounds & hole closing
+
+- (void) runMaskCasesWithCanvasDimension: (unsigned) dimension
+{
+    double numPixels = (double) dimension * dimension;
+    unsigned densityIndex;
+
+    for (densityIndex=0;
+        densityIndex<(sizeof(kMaskDensities) / sizeof(*kMaskDensities));
+        densityIndex++)
+    {
+        NSBitmapImageRep *maskBitmap, *workingMaskBitmap;
+        NSDictionary *parameters;
+
+        maskBitmap = BenchmarkMaskBitmap(dimension, kMaskDensities[densityIndex]);
+        workingMaskBitmap = [[maskBitmap copy] autorelease];
+
+        if (!maskBitmap || !workingMaskBitmap)
+        {
+            continue;
+        }
+
+        parameters = [NSDictionary dictionaryWithObject:
+                                        [NSNumber numberWithFloat: kMaskDensities[densityIndex]]
+                                    forKey: @"maskDensity"];
+
+        [self timeKernel: @"maskBounds"
+                canvasDimension: dimension
+                parameters: parameters
+                numPixelsPerIteration: numPixels
+                bytesPerPixel: sizeof(PPMaskBitmapPixel)
+                kernelBlock: ^{
+                    [maskBitmap ppMaskBounds];
+                }];
+
+        if (dimension > kMaxHoleClosingCanvasDimension)
+        {
+            continue;
+        }
+
+        // hole closing modifies the mask, so each iteration starts from a fresh copy (the
+        // copy's included in the timing); bytes per pixel: mask read + write
+
+        [self timeKernel: @"closeMaskHoles"
+                canvasDimension: dimension
+                parameters: parameters
+                numPixelsPerIteration: numPixels
+                bytesPerPixel: 2 * sizeof(PPMaskBitmapPixel)
+                kernelBlock: ^{
+                    [workingMaskBitmap ppCopyFromBitmap: maskBitmap toPoint: NSZeroPoint];
+                    [workingMaskBitmap ppCloseHolesInMaskBitmap];
+                }];
+    }
+}
+
+- (void) timeKernel: (NSString *) kernelName
+            canvasDimension: (unsigned) dimension
+            parameters: (NSDictionary *) parameters
+            numPixelsPerIteration: (double) numPixelsPerIteration
+            bytesPerPixel: (double) bytesPerPixel
+            kernelBlock: (void (^)(void)) kernelBlock
+{
+    NSAutoreleasePool *autoreleasePool;
+    NSTimeInterval totalTime = 0, iterationTime, minIterationTime = 0;
+    unsigned numIterations = 0;
+    NSMutableDictionary *result;
+
+    // warm-up (untimed): page in the bitmaps & lazily-generated tables
+
+    autoreleasePool = [[NSAutoreleasePool alloc] init];
+
+    kernelBlock();
+
+    [autoreleasePool release];
+
+    while (((totalTime < kMinCaseDuration) || (numIterations < kMinCaseIterations))
+            && (numIterations < kMaxCaseIterations))
+    {
+        autoreleasePool = [[NSAutoreleasePool alloc] init];
+
+        iterationTime = [NSDate timeIntervalSinceReferenceDate];
+
+        kernelBlock();
+
+        iterationTime = [NSDate timeIntervalSinceReferenceDate] - iterationTime;
+
+        [autoreleasePool release];
+
+        if (!numIterations || (iterationTime < minIterationTime))
+        {
+            minIterationTime = iterationTime;
+        }
+
+        totalTime += iterationTime;
+        numIterations++;
+    }
+
+    if (minIterationTime <= 0)
+    {
+        // below the timer's resolution
+        minIterationTime = totalTime / numIterations;
+    }
+
+    result = [NSMutableDictionary dictionary];
+
+    if (parameters)
+    {
+        [result addEntriesFromDictionary: parameters];
+    }
+
+    [result setObject: kernelName forKey: @"kernel"];
+    [result setObject: [NSNumber numberWithUnsignedInt: dimension] forKey: @"canvasWidth"];
+    [result setObject: [NSNumber numberWithUnsignedInt: dimension] forKey: @"canvasHeight"];
+    [result setObject: [NSNumber numberWithUnsignedInt: numIterations]
+            forKey: @"iterations"];
+    [result setObject: [NSNumber numberWithDouble: minIterationTime]
+            forKey: @"secondsPerIteration"];
+    [result setObject: [NSNumber numberWithDouble: totalTime / numIterations]
+            forKey: @"meanSecondsPerIteration"];
+    [result setObject: [NSNumber numberWithDouble: numPixelsPerIteration / minIterationTime]
+            forKey: @"pixelsPerSecond"];
+    [result setObject: [NSNumber numberWithDouble: bytesPerPixel] forKey: @"bytesPerPixel"];
+
+    [_results addObject: result];
+
+    fprintf(stderr, "%-22s %4u x %-4u %-10s %10.3f ms %12.1f Mpixels/s\n",
+            [kernelName UTF8String], dimension, dimension,
+            (parameters) ?
+                [[[parameters allValues] componentsJoinedByString: @","] UTF8String] : "",
+            minIterationTime * 1000.0, numPixelsPerIteration / minIterationTime / 1.0e6);
+}
+
+- (NSData *) resultsJSONData
+{
+    NSDictionary *resultsDict;
+
+    resultsDict =
+        [NSDictionary dictionaryWithObjectsAndKeys:
+                        [NSNumber numberWithInt: kResultsFormatVersion], @"formatVersion",
+                        [[NSDate date] description], @"date",
+                        [[NSProcessInfo processInfo] operatingSystemVersionString],
+                            @"operatingSystem",
+                        [NSNumber numberWithUnsignedInteger:
+                                        [[NSProcessInfo processInfo] activeProcessorCount]],
+                            @"processorCount",
+                        ([NSBitmapImageRep ppLinearBitmapsUseCompactFormat]) ?
+                                @"Compact32" : @"LinearRGB16",
+                            @"linearBitmapFormat",
+                        [NSNumber numberWithBool: _isQuick], @"quick",
+                        _results, @"cases",
+                        nil];
+
+    return [NSJSONSerialization dataWithJSONObject: resultsDict
+                                options: NSJSONWritingPrettyPrinted
+                                error: NULL];
+}
+
+@end
+
+#pragma mark Private functions
+
+// BenchmarkImageBitmap() returns an opaque image of the background color, with the given
+// fraction of (randomly-placed) pixels set to the foreground color
+
+static NSBitmapImageRep *BenchmarkImageBitmap(unsigned dimension, float foregroundDensity)
+{
+    NSBitmapImageRep *imageBitmap;
+    unsigned char *bitmapRow;
+    unsigned bytesPerRow, row, col;
+    PPImageBitmapPixel *bitmapPixel;
+
+    imageBitmap = [NSBitmapImageRep ppImageBitmapOfSize: NSMakeSize(dimension, dimension)];
+    bitmapRow = [imageBitmap bitmapData];
+
+    if (!bitmapRow)
+        return nil;
+
+    bytesPerRow = [imageBitmap bytesPerRow];
+
+    for (row=0; row<dimension; row++)
+    {
+        bitmapPixel = (PPImageBitmapPixel *) bitmapRow;
+
+        for (col=0; col<dimension; col++)
+        {
+            bitmapPixel[col] = (RandomFlagWithProbability(foregroundDensity)) ?
+                                    kForegroundPixelValue : kBackgroundPixelValue;
+        }
+
+        bitmapRow += bytesPerRow;
+    }
+
+    return imageBitmap;
+}
+
+static NSBitmapImageRep *BenchmarkMaskBitmap(unsigned dimension, float density)
+{
+    NSBitmapImageRep *maskBitmap;
+    unsigned char *maskRow;
+    unsigned bytesPerRow, row, col;
+    PPMaskBitmapPixel *maskPixel;
+
+    maskBitmap = [NSBitmapImageRep ppMaskBitmapOfSize: NSMakeSize(dimension, dimension)];
+    maskRow = [maskBitmap bitmapData];
+
+    if (!maskRow)
+        return nil;
+
+    bytesPerRow = [maskBitmap bytesPerRow];
+
+    for (row=0; row<dimension; row++)
+    {
+        maskPixel = (PPMaskBitmapPixel *) maskRow;
+
+        for (col=0; col<dimension; col++)
+        {
+            maskPixel[col] = (RandomFlagWithProbability(density)) ?
+                                    kMaskPixelValue_ON : kMaskPixelValue_OFF;
+        }
+
+        maskRow += bytesPerRow;
+    }
+
+    return maskBitmap;
+}
+
+static bool RandomFlagWithProbability(float probability)
+{
+    if (probability >= 1.0f)
+    {
+        return YES;
+    }
+
+    return (random() < (long) (probability * RAND_MAX)) ? YES : NO;
+}
+
+#endif  // PP_OPTIONAL__BUILD_WITH_KERNEL_BENCHMARKS
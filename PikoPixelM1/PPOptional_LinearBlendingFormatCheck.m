@@ -0,0 +1,340 @@
+/*
+    PPOptional_LinearBlendingFormatCheck.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPOptional.h"
+#if PP_OPTIONAL__BUILD_WITH_LINEAR_BLENDING_FORMAT_CHECK
+
+#import <Cocoa/Cocoa.h>
+#import "PPAppBootUtilities.h"
+#import "PPApplication.h"
+#import "NSObject_PPUtilities.h"
+#import "PPDocumentWindowController.h"
+#import "PPDocument.h"
+#import "PPDocumentLayer.h"
+#import "NSBitmapImageRep_PPUtilities.h"
+#import "PPGeometry.h"
+#import "PPStartupTimeline.h"
+
+
+#define kFormatCheckMenuItem_Name                       @"Linear Blending Format Check"
+#define kFormatCheckMenuItem_KeyEquivalent              @"l"
+#define kFormatCheckMenuItem_KeyEquivalentModifierMask  \
+                                    (NSCommandKeyMask | NSShiftKeyMask | NSControlKeyMask)
+
+
+#define kNumFormatCheckMergePasses                      20
+
+
+// Linear Blending Format Check: merges the current document's layers repeatedly using both
+// linear working formats (LinearRGB16 & Compact32), then logs each format's merge time,
+// effective memory bandwidth, & the differences between the two formats' merged images
+
+@interface PPApplication (PPOptional_LinearBlendingFormatCheck)
+
+- (void) ppMenuItemSelected_LinearBlendingFormatCheck: (id) sender;
+
+@end
+
+static NSBitmapImageRep *MergedImageBitmapForLayersUsingLinearFormat(NSArray *layers,
+                                                                NSSize canvasSize,
+                                                                bool useCompactFormat,
+                                                                NSTimeInterval *returnedTime,
+                                                                double *returnedBytesPerPass);
+
+@implementation NSObject (PPOptional_LinearBlendingFormatCheck)
+
++ (void) load
+{
+    macroStartupTimelineMethodScope();
+
+    macroPerformNSObjectSelectorAfterAppLoads(
+                                    ppOptional_LinearBlendingFormatCheck_SetupMenuItem);
+}
+
++ (void) ppOptional_LinearBlendingFormatCheck_SetupMenuItem
+{
+    NSMenu *canvasMenu;
+    NSMenuItem *formatCheckItem;
+        // use PPSDKNativeType_NSMenuItemPtr for separatorItem, as -[NSMenu separatorItem]
+        // could return either (NSMenuItem *) or (id <NSMenuItem>), depending on the SDK
+    PPSDKNativeType_NSMenuItemPtr separatorItem;
+
+    canvasMenu = [[[NSApp mainMenu] itemWithTitle: @"Canvas"] submenu];
+
+    formatCheckItem =
+        [[[NSMenuItem alloc] initWithTitle: kFormatCheckMenuItem_Name
+                                action: @selector(ppMenuItemSelected_LinearBlendingFormatCheck:)
+                                keyEquivalent: kFormatCheckMenuItem_KeyEquivalent]
+                        autorelease];
+
+    [formatCheckItem setTarget: NSApp];
+    [formatCheckItem setKeyEquivalentModifierMask:
+                                            kFormatCheckMenuItem_KeyEquivalentModifierMask];
+
+    separatorItem = [NSMenuItem separatorItem];
+
+    if (!canvasMenu || !formatCheckItem || !separatorItem)
+    {
+        goto ERROR;
+    }
+
+    [canvasMenu addItem: separatorItem];
+    [canvasMenu addItem: formatCheckItem];
+
+    return;
+
+ERROR:
+    return;
+}
+
+@end
+
+@implementation PPApplication (PPOptional_LinearBlendingFormatCheck)
+
+- (void) ppMenuItemSelected_LinearBlendingFormatCheck: (id) sender
+{
+    NSAutoreleasePool *autoreleasePool;
+    PPDocumentWindowController *documentWindowController;
+    PPDocument *ppDocument;
+    NSMutableArray *layers;
+    NSSize canvasSize;
+    int layerIndex, numLayers, pixelsPerRow, rowCounter, pixelCounter, componentIndex,
+        componentDifference, maxComponentDifference = 0;
+    unsigned numDifferingPixels = 0;
+    double sumOfComponentDifferences = 0, rgb16BytesPerPass, compact32BytesPerPass;
+    NSTimeInterval rgb16Time, compact32Time;
+    NSBitmapImageRep *rgb16MergedBitmap, *compact32MergedBitmap;
+    unsigned char *rgb16Row, *compact32Row;
+    PPImageBitmapPixel *rgb16Pixel, *compact32Pixel;
+
+    autoreleasePool = [[NSAutoreleasePool alloc] init];
+
+    documentWindowController = [[NSApp mainWindow] windowController];
+
+    if (![documentWindowController isKindOfClass: [PPDocumentWindowController class]])
+    {
+        goto CLEANUP;
+    }
+
+    ppDocument = [documentWindowController document];
+    canvasSize = [ppDocument canvasSize];
+    numLayers = [ppDocument numLayers];
+
+    layers = [NSMutableArray array];
+
+    for (layerIndex=0; layerIndex<numLayers; layerIndex++)
+    {
+        PPDocumentLayer *layer = [ppDocument layerAtIndex: layerIndex];
+
+        if ([layer isEnabled] && ([layer opacity] > 0.0f))
+        {
+            [layers addObject: layer];
+        }
+    }
+
+    if (![layers count])
+    {
+        NSLog(@"Linear blending format check: NO VISIBLE LAYERS");
+        goto CLEANUP;
+    }
+
+    rgb16MergedBitmap =
+        MergedImageBitmapForLayersUsingLinearFormat(layers, canvasSize, NO, &rgb16Time,
+                                                    &rgb16BytesPerPass);
+
+    compact32MergedBitmap =
+        MergedImageBitmapForLayersUsingLinearFormat(layers, canvasSize, YES, &compact32Time,
+                                                    &compact32BytesPerPass);
+
+    if (!rgb16MergedBitmap || !compact32MergedBitmap)
+    {
+        goto CLEANUP;
+    }
+
+    // Fidelity: compare Compact32 merged image against LinearRGB16 merged image
+
+    rgb16Row = [rgb16MergedBitmap bitmapData];
+    compact32Row = [compact32MergedBitmap bitmapData];
+
+    pixelsPerRow = canvasSize.width;
+    rowCounter = canvasSize.height;
+
+    while (rowCounter--)
+    {
+        rgb16Pixel = (PPImageBitmapPixel *) rgb16Row;
+        compact32Pixel = (PPImageBitmapPixel *) compact32Row;
+
+        pixelCounter = pixelsPerRow;
+
+        while (pixelCounter--)
+        {
+            if (*rgb16Pixel != *compact32Pixel)
+            {
+                numDifferingPixels++;
+            }
+
+            for (componentIndex=0; componentIndex<kNumPPImagePixelComponents; componentIndex++)
+            {
+                componentDifference =
+                    abs((int) macroImagePixelComponent(rgb16Pixel, componentIndex)
+                            - (int) macroImagePixelComponent(compact32Pixel, componentIndex));
+
+                sumOfComponentDifferences += componentDifference;
+
+                if (componentDifference > maxComponentDifference)
+                {
+                    maxComponentDifference = componentDifference;
+                }
+            }
+
+            rgb16Pixel++;
+            compact32Pixel++;
+        }
+
+        rgb16Row += [rgb16MergedBitmap bytesPerRow];
+        compact32Row += [compact32MergedBitmap bytesPerRow];
+    }
+
+    NSLog(@"Linear blending format check: %d layers, %dx%d canvas, %d merge passes",
+            (int) [layers count], (int) canvasSize.width, (int) canvasSize.height,
+            kNumFormatCheckMergePasses);
+
+    NSLog(@"Linear blending format check: LINEAR RGB16 - time elapsed: %f, %.1f MB/pass, "
+                "%.1f MB/s",
+            (float) rgb16Time, rgb16BytesPerPass / 1.0e6,
+            (rgb16Time > 0) ?
+                rgb16BytesPerPass * kNumFormatCheckMergePasses / rgb16Time / 1.0e6 : 0.0);
+
+    NSLog(@"Linear blending format check: COMPACT32 - time elapsed: %f, %.1f MB/pass, "
+                "%.1f MB/s",
+            (float) compact32Time, compact32BytesPerPass / 1.0e6,
+            (compact32Time > 0) ?
+                compact32BytesPerPass * kNumFormatCheckMergePasses / compact32Time / 1.0e6
+                : 0.0);
+
+    NSLog(@"Linear blending format check: FIDELITY - differing pixels: %u of %u, "
+                "max component difference: %d, mean component difference: %f",
+            numDifferingPixels, (unsigned) (canvasSize.width * canvasSize.height),
+            maxComponentDifference,
+            sumOfComponentDifferences
+                / (canvasSize.width * canvasSize.height * kNumPPImagePixelComponents));
+
+CLEANUP:
+    [autoreleasePool release];
+}
+
+@end
+
+#pragma mark Private functions
+
+static NSBitmapImageRep *MergedImageBitmapForLayersUsingLinearFormat(NSArray *layers,
+                                                                NSSize canvasSize,
+                                                                bool useCompactFormat,
+                                                                NSTimeInterval *returnedTime,
+                                                                double *returnedBytesPerPass)
+{
+    NSMutableArray *linearLayerBitmaps;
+    NSBitmapImageRep *linearBitmap, *mergedLinearBitmap, *mergedImageBitmap;
+    NSRect canvasFrame;
+    int numLayers, layerIndex, passCounter;
+    double linearBitmapBytes;
+    NSTimeInterval startTime;
+
+    canvasFrame = PPGeometry_OriginRectOfSize(canvasSize);
+    numLayers = [layers count];
+
+    linearLayerBitmaps = [NSMutableArray arrayWithCapacity: numLayers];
+
+    for (layerIndex=0; layerIndex<numLayers; layerIndex++)
+    {
+        linearBitmap = (useCompactFormat) ?
+                            [NSBitmapImageRep ppLinearCompact32BitmapOfSize: canvasSize] :
+                            [NSBitmapImageRep ppLinearRGB16BitmapOfSize: canvasSize];
+
+        if (!linearBitmap)
+            goto ERROR;
+
+        [linearBitmap ppLinearCopyFromImageBitmap: [[layers objectAtIndex: layerIndex] bitmap]
+                        inBounds: canvasFrame];
+
+        [linearLayerBitmaps addObject: linearBitmap];
+    }
+
+    mergedLinearBitmap = (useCompactFormat) ?
+                            [NSBitmapImageRep ppLinearCompact32BitmapOfSize: canvasSize] :
+                            [NSBitmapImageRep ppLinearRGB16BitmapOfSize: canvasSize];
+
+    mergedImageBitmap = [NSBitmapImageRep ppImageBitmapOfSize: canvasSize];
+
+    if (!mergedLinearBitmap || !mergedImageBitmap)
+    {
+        goto ERROR;
+    }
+
+    startTime = [NSDate timeIntervalSinceReferenceDate];
+
+    for (passCounter=0; passCounter<kNumFormatCheckMergePasses; passCounter++)
+    {
+        // same merge order as -[PPDocument mergedLayersBitmapFromIndex:toIndex:]: topmost
+        // layer is copied, lower layers are blended underneath
+
+        layerIndex = numLayers - 1;
+
+        [mergedLinearBitmap ppLinearCopyFromLinearBitmap:
+                                            [linearLayerBitmaps objectAtIndex: layerIndex]
+                            opacity: [[layers objectAtIndex: layerIndex] opacity]
+                            inBounds: canvasFrame];
+
+        while (layerIndex--)
+        {
+            [mergedLinearBitmap ppLinearBlendFromLinearBitmapUnderneath:
+                                            [linearLayerBitmaps objectAtIndex: layerIndex]
+                                sourceOpacity: [[layers objectAtIndex: layerIndex] opacity]
+                                inBounds: canvasFrame];
+        }
+
+        [mergedLinearBitmap ppLinearCopyToImageBitmap: mergedImageBitmap inBounds: canvasFrame];
+    }
+
+    *returnedTime = [NSDate timeIntervalSinceReferenceDate] - startTime;
+
+    // bytes moved per pass: copy (read source, write merged), blends (read source, read &
+    // write merged), conversion (read merged, write image)
+
+    linearBitmapBytes = (double) [mergedLinearBitmap bytesPerRow] * canvasSize.height;
+
+    *returnedBytesPerPass =
+        linearBitmapBytes * (2 + 3 * (numLayers - 1) + 1)
+        + (double) [mergedImageBitmap bytesPerRow] * canvasSize.height;
+
+    return mergedImageBitmap;
+
+ERROR:
+    *returnedTime = 0;
+    *returnedBytesPerPass = 0;
+
+    return nil;
+}
+
+#endif  // PP_OPTIONAL__BUILD_WITH_LINEAR_BLENDING_FORMAT_CHECK
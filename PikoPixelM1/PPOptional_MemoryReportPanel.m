@@ -0,0 +1,250 @@
+/*
+    PPOptional_MemoryReportPanel.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPOptional.h"
+#if PP_OPTIONAL__BUILD_WITH_MEMORY_REPORT_PANEL
+
+#import <Cocoa/Cocoa.h>
+#import "PPAppBootUtilities.h"
+#import "PPApplication.h"
+#import "PPDocument.h"
+#import "PPStartupTimeline.h"
+
+
+#define kMemoryReportPanelMenuItemTitle     @"Show Memory Report Panel"
+
+#define kMemoryReportPanelTitle             @"Memory Report"
+#define kMemoryReportPanelSize              NSMakeSize(340.0f, 230.0f)
+#define kMemoryReportPanelFontSize          11.0f
+
+#define kMemoryReportUpdateInterval         1.0
+
+
+static NSPanel *gMemoryReportPanel = nil;
+static NSTextField *gMemoryReportTextField = nil;
+static NSTimer *gMemoryReportUpdateTimer = nil;
+
+
+@interface PPApplication (PPOptional_MemoryReportPanel)
+
+- (void) ppMenuItemSelected_ShowMemoryReportPanel: (id) sender;
+
+- (bool) ppMemoryReportPanel_SetupPanel;
+- (void) ppMemoryReportPanel_UpdateTimerDidFire: (NSTimer *) timer;
+
+@end
+
+static NSString *MemoryReportTextForDocument(PPDocument *ppDocument);
+
+
+@implementation NSObject (PPOptional_MemoryReportPanel)
+
++ (void) load
+{
+    macroStartupTimelineMethodScope();
+
+    macroPerformNSObjectSelectorAfterAppLoads(ppOptional_MemoryReportPanel_SetupMenuItem);
+}
+
++ (void) ppOptional_MemoryReportPanel_SetupMenuItem
+{
+    NSMenu *panelMenu;
+    NSMenuItem *memoryReportItem;
+        // use PPSDKNativeType_NSMenuItemPtr for separatorItem, as -[NSMenu separatorItem]
+        // could return either (NSMenuItem *) or (id <NSMenuItem>), depending on the SDK
+    PPSDKNativeType_NSMenuItemPtr separatorItem;
+
+    panelMenu = [[[NSApp mainMenu] itemWithTitle: @"Panel"] submenu];
+
+    memoryReportItem =
+        [[[NSMenuItem alloc] initWithTitle: kMemoryReportPanelMenuItemTitle
+                                action: @selector(ppMenuItemSelected_ShowMemoryReportPanel:)
+                                keyEquivalent: @""]
+                        autorelease];
+
+    [memoryReportItem setTarget: NSApp];
+
+    separatorItem = [NSMenuItem separatorItem];
+
+    if (!panelMenu || !memoryReportItem || !separatorItem)
+    {
+        goto ERROR;
+    }
+
+    [panelMenu addItem: separatorItem];
+    [panelMenu addItem: memoryReportItem];
+
+    return;
+
+ERROR:
+    return;
+}
+
+@end
+
+@implementation PPApplication (PPOptional_MemoryReportPanel)
+
+// the memory report panel shows the main window document's memory report, updated once per
+// second while the panel's visible
+
+- (void) ppMenuItemSelected_ShowMemoryReportPanel: (id) sender
+{
+    if (!gMemoryReportPanel && ![self ppMemoryReportPanel_SetupPanel])
+    {
+        goto ERROR;
+    }
+
+    if (!gMemoryReportUpdateTimer)
+    {
+        gMemoryReportUpdateTimer =
+            [[NSTimer scheduledTimerWithTimeInterval: kMemoryReportUpdateInterval
+                        target: self
+                        selector: @selector(ppMemoryReportPanel_UpdateTimerDidFire:)
+                        userInfo: nil
+                        repeats: YES]
+                    retain];
+    }
+
+    [self ppMemoryReportPanel_UpdateTimerDidFire: nil];
+
+    [gMemoryReportPanel orderFront: self];
+
+    return;
+
+ERROR:
+    return;
+}
+
+#pragma mark Private methods
+
+- (bool) ppMemoryReportPanel_SetupPanel
+{
+    NSRect contentFrame;
+
+    contentFrame.origin = NSZeroPoint;
+    contentFrame.size = kMemoryReportPanelSize;
+
+    gMemoryReportPanel =
+        [[NSPanel alloc] initWithContentRect: contentFrame
+                            styleMask: NSTitledWindowMask | NSClosableWindowMask
+                                        | NSUtilityWindowMask
+                            backing: NSBackingStoreBuffered
+                            defer: YES];
+
+    gMemoryReportTextField =
+                    [[NSTextField alloc] initWithFrame: NSInsetRect(contentFrame, 8.0f, 8.0f)];
+
+    if (!gMemoryReportPanel || !gMemoryReportTextField)
+    {
+        goto ERROR;
+    }
+
+    [gMemoryReportPanel setTitle: kMemoryReportPanelTitle];
+    [gMemoryReportPanel setFloatingPanel: YES];
+    [gMemoryReportPanel setHidesOnDeactivate: YES];
+    [gMemoryReportPanel setReleasedWhenClosed: NO];
+
+    [gMemoryReportTextField setEditable: NO];
+    [gMemoryReportTextField setSelectable: YES];
+    [gMemoryReportTextField setBordered: NO];
+    [gMemoryReportTextField setDrawsBackground: NO];
+    [gMemoryReportTextField setFont: [NSFont userFixedPitchFontOfSize:
+                                                            kMemoryReportPanelFontSize]];
+    [gMemoryReportTextField setAutoresizingMask: NSViewWidthSizable | NSViewHeightSizable];
+
+    [[gMemoryReportPanel contentView] addSubview: gMemoryReportTextField];
+
+    [gMemoryReportPanel center];
+
+    return YES;
+
+ERROR:
+    [gMemoryReportPanel release];
+    gMemoryReportPanel = nil;
+
+    [gMemoryReportTextField release];
+    gMemoryReportTextField = nil;
+
+    return NO;
+}
+
+- (void) ppMemoryReportPanel_UpdateTimerDidFire: (NSTimer *) timer
+{
+    PPDocument *ppDocument;
+
+    if (timer && ![gMemoryReportPanel isVisible])
+    {
+        // panel was closed: stop updating until it's shown again
+
+        [gMemoryReportUpdateTimer invalidate];
+        [gMemoryReportUpdateTimer release];
+        gMemoryReportUpdateTimer = nil;
+
+        return;
+    }
+
+    ppDocument = [[[NSApp mainWindow] windowController] document];
+
+    if (![ppDocument isKindOfClass: [PPDocument class]])
+    {
+        ppDocument = nil;
+    }
+
+    [gMemoryReportTextField setStringValue: MemoryReportTextForDocument(ppDocument)];
+}
+
+@end
+
+#pragma mark Private functions
+
+static NSString *MemoryReportTextForDocument(PPDocument *ppDocument)
+{
+    NSDictionary *memoryReport;
+    NSMutableString *reportText;
+    NSEnumerator *keyEnumerator;
+    NSString *key;
+
+    if (!ppDocument)
+    {
+        return @"(No document)";
+    }
+
+    memoryReport = [ppDocument memoryReport];
+
+    reportText = [NSMutableString stringWithFormat: @"%@\n\n", [ppDocument displayName]];
+
+    keyEnumerator = [[PPDocument memoryReportKeys] objectEnumerator];
+
+    while (key = [keyEnumerator nextObject])
+    {
+        [reportText appendFormat: @"%-30s%10.2f MB\n",
+                                    [key UTF8String],
+                                    [[memoryReport objectForKey: key] unsignedLongLongValue]
+                                        / (1024.0 * 1024.0)];
+    }
+
+    return reportText;
+}
+
+#endif  // PP_OPTIONAL__BUILD_WITH_MEMORY_REPORT_PANEL
@@ -0,0 +1,45 @@
+/*
+    PPOptional_PNGEncoderCheck.h
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPOptional.h"
+#if PP_OPTIONAL__BUILD_WITH_PNG_ENCODER_CHECK
+
+// PNG encoder check: Round-trips random images through PPPNGEncoder at several strip & call
+// layouts (a single strip, strip counts that don't divide the image's height, calls that end
+// mid-strip), decodes each PNG independently with zlib (chunk CRCs, the zlib stream's
+// checksum, & the unfiltered rows) and with ImageIO (NSBitmapImageRep), & compares the
+// decoded pixels against the source. Runs headless (no NSApplication) when the executable's
+// first argument is kPPPNGEncoderCheckCommandLineFlag (see main.m):
+//
+//  PikoPixel -ppCheckPNGEncoder
+//
+// (prints one result line per case; the exit status is nonzero if any case fails)
+
+#define kPPPNGEncoderCheckCommandLineFlag       "-ppCheckPNGEncoder"
+
+
+// returns the process exit status
+int PPPNGEncoderCheck_RunWithCommandLineArguments(int argc, char **argv);
+
+#endif  // PP_OPTIONAL__BUILD_WITH_PNG_ENCODER_CHECK
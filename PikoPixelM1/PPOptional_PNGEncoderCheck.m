@@ -0,0 +1,642 @@
+/*
+    PPOptional_PNGEncoderCheck.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPOptional_PNGEncoderCheck.h"
+#if PP_OPTIONAL__BUILD_WITH_PNG_ENCODER_CHECK
+
+#import <Cocoa/Cocoa.h>
+#import <zlib.h>
+#import "PPAppBootUtilities.h"
+#import "PPPNGEncoder.h"
+#import "PPBitmapPixelTypes.h"
+#import "PPImagePixelAlphaPremultiplyTables.h"
+
+
+#define kPNGChunkType_IHDR                  'IHDR'
+#define kPNGChunkType_IDAT                  'IDAT'
+#define kPNGChunkType_IEND                  'IEND'
+
+#define kPNGSignatureLength                 8
+#define kPNGChunkOverheadLength             12  // length, type, & CRC fields
+#define kPNGHeaderChunkLength               13
+
+#define kPNGBitDepth                        8
+#define kPNGColorType_RGBA                  6
+
+#define kPNGBytesPerPixel                   4
+
+#define kPNGFilterType_None                 0
+#define kPNGFilterType_Sub                  1
+#define kPNGFilterType_Up                   2
+#define kPNGFilterType_Average              3
+#define kPNGFilterType_Paeth                4
+
+#define kRandomSeed                         1
+
+// each new random pixel is repeated for an average of kAverageRandomPixelRunLength pixels,
+// so the deflate strips have matches to find (purely random data would be stored)
+#define kAverageRandomPixelRunLength        4
+
+
+typedef struct
+{
+    unsigned width;
+    unsigned height;
+    unsigned numRowsPerStrip;   // 0: encoder's default strip length
+    unsigned numRowsPerCall;    // 0: all rows in a single call
+
+} PPPNGEncoderCheckCase;
+
+static const PPPNGEncoderCheckCase kCheckCases[] =
+{
+    // a single strip
+    {1, 1, 0, 0},
+    {64, 64, 0, 0},
+    {64, 64, 64, 0},
+
+    // heights that aren't a multiple of the strip's rows
+    {64, 100, 7, 0},
+    {301, 509, 16, 0},
+    {1024, 1024, 0, 0},
+
+    // one row per strip (strips shorter than the deflate window)
+    {700, 300, 1, 0},
+
+    // multiple calls, ending mid-strip
+    {301, 509, 13, 97},
+    {3, 1000, 3, 41},
+    {2048, 400, 0, 150},
+};
+
+#define kNumCheckCases      (sizeof(kCheckCases) / sizeof(kCheckCases[0]))
+
+
+static bool CheckCase(const PPPNGEncoderCheckCase *checkCase, unsigned long *returnedPNGLength,
+                        const char **returnedFailure);
+static void FillWithRandomPremultipliedPixels(PPImageBitmapPixel *pixels, unsigned numPixels);
+static void UnpremultiplyPixelsToPNGRows(const PPImageBitmapPixel *pixels, unsigned numPixels,
+                                            unsigned char *pngRows);
+static bool DecodePNGDataWithZlib(NSData *pngData, unsigned width, unsigned height,
+                                    unsigned char *pngRows, const char **returnedFailure);
+static bool UnfilterPNGRow(unsigned char filterType, const unsigned char *filteredRow,
+                            const unsigned char *previousRow, unsigned rowLength,
+                            unsigned char *row);
+static bool ImageIODecodedPNGDataMatchesPNGRows(NSData *pngData, unsigned width,
+                                                unsigned height, const unsigned char *pngRows,
+                                                const char **returnedFailure);
+static uint32_t BigEndianUInt32AtBytes(const unsigned char *bytes);
+
+
+int PPPNGEncoderCheck_RunWithCommandLineArguments(int argc, char **argv)
+{
+    NSAutoreleasePool *autoreleasePool;
+    unsigned caseIndex, numFailedCases = 0;
+    unsigned long pngLength;
+    const char *failure;
+
+    autoreleasePool = [[NSAutoreleasePool alloc] init];
+
+    // same setup as the batch converter (PPBatchConverter.m)
+
+    PPAppBootUtils_HandleAppDidFinishLoading();
+
+    if (argc > 2)
+    {
+        fprintf(stderr, "Usage: %s %s\n", argv[0], kPPPNGEncoderCheckCommandLineFlag);
+
+        goto ERROR;
+    }
+
+    if (!PPImageAlphaPremultiplyTables_Setup())
+        goto ERROR;
+
+    srandom(kRandomSeed);
+
+    for (caseIndex=0; caseIndex<kNumCheckCases; caseIndex++)
+    {
+        const PPPNGEncoderCheckCase *checkCase = &kCheckCases[caseIndex];
+        NSAutoreleasePool *caseAutoreleasePool = [[NSAutoreleasePool alloc] init];
+        bool didPass;
+
+        didPass = CheckCase(checkCase, &pngLength, &failure);
+
+        printf("PNG encoder check: %ux%u, %u rows per strip, %u rows per call: ",
+                checkCase->width, checkCase->height, checkCase->numRowsPerStrip,
+                checkCase->numRowsPerCall);
+
+        if (didPass)
+        {
+            printf("PASS (%lu bytes)\n", pngLength);
+        }
+        else
+        {
+            printf("FAIL - %s\n", failure);
+
+            numFailedCases++;
+        }
+
+        [caseAutoreleasePool release];
+    }
+
+    printf("PNG encoder check: %u of %u cases passed\n",
+            (unsigned) kNumCheckCases - numFailedCases, (unsigned) kNumCheckCases);
+
+    [autoreleasePool release];
+
+    return (numFailedCases) ? 1 : 0;
+
+ERROR:
+    [autoreleasePool release];
+
+    return 1;
+}
+
+#pragma mark Private functions
+
+static bool CheckCase(const PPPNGEncoderCheckCase *checkCase, unsigned long *returnedPNGLength,
+                        const char **returnedFailure)
+{
+    unsigned width = checkCase->width, height = checkCase->height, rowLength, bytesPerRow,
+                numRowsPerCall, row, numCallRows;
+    unsigned long pngRowsLength;
+    PPImageBitmapPixel *pixels = NULL;
+    unsigned char *expectedPNGRows = NULL, *decodedPNGRows = NULL;
+    PPPNGEncoder *encoder;
+    NSData *pngData;
+
+    *returnedPNGLength = 0;
+
+    rowLength = width * kPNGBytesPerPixel;
+    bytesPerRow = width * sizeof(PPImageBitmapPixel);
+    pngRowsLength = (unsigned long) height * rowLength;
+
+    pixels = (PPImageBitmapPixel *) malloc ((unsigned long) height * bytesPerRow);
+    expectedPNGRows = (unsigned char *) malloc (pngRowsLength);
+    decodedPNGRows = (unsigned char *) malloc (pngRowsLength);
+
+    if (!pixels || !expectedPNGRows || !decodedPNGRows)
+    {
+        *returnedFailure = "unable to allocate buffers";
+        goto ERROR;
+    }
+
+    FillWithRandomPremultipliedPixels(pixels, width * height);
+    UnpremultiplyPixelsToPNGRows(pixels, width * height, expectedPNGRows);
+
+    encoder = [[[PPPNGEncoder alloc] initWithImageSize: NSMakeSize(width, height)]
+                        autorelease];
+
+    if (!encoder)
+    {
+        *returnedFailure = "unable to create encoder";
+        goto ERROR;
+    }
+
+    if (checkCase->numRowsPerStrip)
+    {
+        [encoder setDeflateStripLength: checkCase->numRowsPerStrip * (1 + rowLength)];
+    }
+
+    numRowsPerCall = (checkCase->numRowsPerCall) ? checkCase->numRowsPerCall : height;
+
+    for (row=0; row<height; row+=numCallRows)
+    {
+        numCallRows = MIN(numRowsPerCall, height - row);
+
+        if (![encoder encodeRowsFromImagePixelData:
+                                        (const unsigned char *) &pixels[row * width]
+                        bytesPerRow: bytesPerRow
+                        numRows: numCallRows])
+        {
+            *returnedFailure = "encoder failed to encode rows";
+            goto ERROR;
+        }
+    }
+
+    pngData = [encoder finishEncoding];
+
+    if (!pngData)
+    {
+        *returnedFailure = "encoder failed to finish encoding";
+        goto ERROR;
+    }
+
+    if (!DecodePNGDataWithZlib(pngData, width, height, decodedPNGRows, returnedFailure))
+    {
+        goto ERROR;
+    }
+
+    if (memcmp(decodedPNGRows, expectedPNGRows, pngRowsLength))
+    {
+        *returnedFailure = "zlib-decoded pixels differ from the source";
+        goto ERROR;
+    }
+
+    if (!ImageIODecodedPNGDataMatchesPNGRows(pngData, width, height, expectedPNGRows,
+                                                returnedFailure))
+    {
+        goto ERROR;
+    }
+
+    *returnedPNGLength = [pngData length];
+
+    free(pixels);
+    free(expectedPNGRows);
+    free(decodedPNGRows);
+
+    return YES;
+
+ERROR:
+    if (pixels)
+    {
+        free(pixels);
+    }
+
+    if (expectedPNGRows)
+    {
+        free(expectedPNGRows);
+    }
+
+    if (decodedPNGRows)
+    {
+        free(decodedPNGRows);
+    }
+
+    return NO;
+}
+
+static void FillWithRandomPremultipliedPixels(PPImageBitmapPixel *pixels, unsigned numPixels)
+{
+    PPImageBitmapPixel pixel = 0;
+    PPImagePixelComponent alpha;
+
+    while (numPixels--)
+    {
+        if (!(random() % kAverageRandomPixelRunLength))
+        {
+            // transparent, opaque, & translucent pixels in equal proportions (premultiplied
+            // color components can't exceed alpha)
+
+            switch (random() % 3)
+            {
+                case 0:
+                    alpha = 0;
+                break;
+
+                case 1:
+                    alpha = kMaxImagePixelComponentValue;
+                break;
+
+                default:
+                    alpha = random() % (kMaxImagePixelComponentValue + 1);
+                break;
+            }
+
+            macroImagePixelComponent_Red(&pixel) = random() % (alpha + 1);
+            macroImagePixelComponent_Green(&pixel) = random() % (alpha + 1);
+            macroImagePixelComponent_Blue(&pixel) = random() % (alpha + 1);
+            macroImagePixelComponent_Alpha(&pixel) = alpha;
+        }
+
+        *pixels++ = pixel;
+    }
+}
+
+static void UnpremultiplyPixelsToPNGRows(const PPImageBitmapPixel *pixels, unsigned numPixels,
+                                            unsigned char *pngRows)
+{
+    PPImagePixelComponent *unpremultiplyTable;
+
+    while (numPixels--)
+    {
+        unpremultiplyTable = macroAlphaUnpremultiplyTableForImagePixel(pixels);
+
+        pngRows[0] = unpremultiplyTable[macroImagePixelComponent_Red(pixels)];
+        pngRows[1] = unpremultiplyTable[macroImagePixelComponent_Green(pixels)];
+        pngRows[2] = unpremultiplyTable[macroImagePixelComponent_Blue(pixels)];
+        pngRows[3] = macroImagePixelComponent_Alpha(pixels);
+
+        pixels++;
+        pngRows += kPNGBytesPerPixel;
+    }
+}
+
+static bool DecodePNGDataWithZlib(NSData *pngData, unsigned width, unsigned height,
+                                    unsigned char *pngRows, const char **returnedFailure)
+{
+    static const unsigned char pngSignature[kPNGSignatureLength] =
+                                            {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+    const unsigned char *pngBytes, *chunkBytes;
+    unsigned long pngLength, offset, filteredRowsLength, zeroRowLength;
+    uint32_t chunkLength, chunkType;
+    uLongf decompressedLength;
+    NSMutableData *idatData;
+    unsigned char *filteredRows = NULL, *zeroRow = NULL;
+    const unsigned char *filteredRow, *previousRow;
+    unsigned rowLength, row;
+    bool didReadHeader = NO, didReadEnd = NO;
+
+    pngBytes = [pngData bytes];
+    pngLength = [pngData length];
+
+    if ((pngLength < kPNGSignatureLength)
+        || memcmp(pngBytes, pngSignature, kPNGSignatureLength))
+    {
+        *returnedFailure = "missing PNG signature";
+        goto ERROR;
+    }
+
+    idatData = [NSMutableData data];
+
+    offset = kPNGSignatureLength;
+
+    while (!didReadEnd && (pngLength - offset >= kPNGChunkOverheadLength))
+    {
+        chunkLength = BigEndianUInt32AtBytes(&pngBytes[offset]);
+        chunkType = BigEndianUInt32AtBytes(&pngBytes[offset + 4]);
+        chunkBytes = &pngBytes[offset + 8];
+
+        if (chunkLength > pngLength - offset - kPNGChunkOverheadLength)
+        {
+            *returnedFailure = "truncated chunk";
+            goto ERROR;
+        }
+
+        // the CRC covers the chunk's type & data
+        if (crc32(crc32(0L, Z_NULL, 0), &pngBytes[offset + 4], 4 + chunkLength)
+                != BigEndianUInt32AtBytes(&chunkBytes[chunkLength]))
+        {
+            *returnedFailure = "chunk CRC mismatch";
+            goto ERROR;
+        }
+
+        if (chunkType == kPNGChunkType_IHDR)
+        {
+            if ((chunkLength != kPNGHeaderChunkLength)
+                || (BigEndianUInt32AtBytes(&chunkBytes[0]) != width)
+                || (BigEndianUInt32AtBytes(&chunkBytes[4]) != height)
+                || (chunkBytes[8] != kPNGBitDepth)
+                || (chunkBytes[9] != kPNGColorType_RGBA)
+                || chunkBytes[10] || chunkBytes[11] || chunkBytes[12])
+            {
+                *returnedFailure = "unexpected IHDR values";
+                goto ERROR;
+            }
+
+            didReadHeader = YES;
+        }
+        else if (chunkType == kPNGChunkType_IDAT)
+        {
+            [idatData appendBytes: chunkBytes length: chunkLength];
+        }
+        else if (chunkType == kPNGChunkType_IEND)
+        {
+            didReadEnd = YES;
+        }
+
+        offset += kPNGChunkOverheadLength + chunkLength;
+    }
+
+    if (!didReadHeader || !didReadEnd || (offset != pngLength))
+    {
+        *returnedFailure = "missing IHDR or IEND chunk, or data after IEND";
+        goto ERROR;
+    }
+
+    rowLength = width * kPNGBytesPerPixel;
+    filteredRowsLength = (unsigned long) height * (1 + rowLength);
+    zeroRowLength = rowLength;
+
+    // one extra byte, so a stream that decompresses to more than the filtered rows is caught
+    filteredRows = (unsigned char *) malloc (filteredRowsLength + 1);
+    zeroRow = (unsigned char *) calloc(zeroRowLength, 1);
+
+    if (!filteredRows || !zeroRow)
+    {
+        *returnedFailure = "unable to allocate buffers";
+        goto ERROR;
+    }
+
+    // uncompress() also checks the zlib stream's header & adler32 checksum
+
+    decompressedLength = filteredRowsLength + 1;
+
+    if ((uncompress(filteredRows, &decompressedLength, [idatData bytes], [idatData length])
+            != Z_OK)
+        || (decompressedLength != filteredRowsLength))
+    {
+        *returnedFailure = "IDAT data isn't a zlib stream of the image's filtered rows";
+        goto ERROR;
+    }
+
+    previousRow = zeroRow;
+
+    for (row=0; row<height; row++)
+    {
+        filteredRow = &filteredRows[row * (1 + rowLength)];
+
+        if (!UnfilterPNGRow(filteredRow[0], &filteredRow[1], previousRow, rowLength,
+                            &pngRows[row * rowLength]))
+        {
+            *returnedFailure = "invalid filter type";
+            goto ERROR;
+        }
+
+        previousRow = &pngRows[row * rowLength];
+    }
+
+    free(filteredRows);
+    free(zeroRow);
+
+    return YES;
+
+ERROR:
+    if (filteredRows)
+    {
+        free(filteredRows);
+    }
+
+    if (zeroRow)
+    {
+        free(zeroRow);
+    }
+
+    return NO;
+}
+
+// UnfilterPNGRow() follows the PNG spec's reconstruction functions directly (rather than
+// sharing the encoder's predictor macros), so it's an independent check of the filtering
+
+static bool UnfilterPNGRow(unsigned char filterType, const unsigned char *filteredRow,
+                            const unsigned char *previousRow, unsigned rowLength,
+                            unsigned char *row)
+{
+    unsigned byteIndex;
+    int left, up, upLeft, predictor, leftDistance, upDistance, upLeftDistance;
+
+    if (filterType > kPNGFilterType_Paeth)
+    {
+        return NO;
+    }
+
+    for (byteIndex=0; byteIndex<rowLength; byteIndex++)
+    {
+        left = (byteIndex >= kPNGBytesPerPixel) ? row[byteIndex - kPNGBytesPerPixel] : 0;
+        up = previousRow[byteIndex];
+        upLeft = (byteIndex >= kPNGBytesPerPixel) ?
+                    previousRow[byteIndex - kPNGBytesPerPixel] : 0;
+
+        switch (filterType)
+        {
+            case kPNGFilterType_Sub:
+                predictor = left;
+            break;
+
+            case kPNGFilterType_Up:
+                predictor = up;
+            break;
+
+            case kPNGFilterType_Average:
+                predictor = (left + up) / 2;
+            break;
+
+            case kPNGFilterType_Paeth:
+                leftDistance = abs(up - upLeft);
+                upDistance = abs(left - upLeft);
+                upLeftDistance = abs(left + up - 2 * upLeft);
+
+                if ((leftDistance <= upDistance) && (leftDistance <= upLeftDistance))
+                {
+                    predictor = left;
+                }
+                else if (upDistance <= upLeftDistance)
+                {
+                    predictor = up;
+                }
+                else
+                {
+                    predictor = upLeft;
+                }
+            break;
+
+            case kPNGFilterType_None:
+            default:
+                predictor = 0;
+            break;
+        }
+
+        row[byteIndex] = (unsigned char) (filteredRow[byteIndex] + predictor);
+    }
+
+    return YES;
+}
+
+// ImageIODecodedPNGDataMatchesPNGRows(): ImageIO may return premultiplied pixels, in which
+// case only the alpha of translucent pixels is compared (premultiplying loses their exact
+// color values)
+
+static bool ImageIODecodedPNGDataMatchesPNGRows(NSData *pngData, unsigned width,
+                                                unsigned height, const unsigned char *pngRows,
+                                                const char **returnedFailure)
+{
+    NSBitmapImageRep *bitmap;
+    NSBitmapFormat bitmapFormat;
+    unsigned char *bitmapRow, *decodedPixel;
+    const unsigned char *expectedPixel;
+    int bytesPerRow;
+    unsigned alphaIndex, firstColorIndex, row, col, colorIndex;
+    bool isPremultiplied;
+
+    bitmap = [NSBitmapImageRep imageRepWithData: pngData];
+
+    if (!bitmap || ((unsigned) [bitmap pixelsWide] != width)
+        || ((unsigned) [bitmap pixelsHigh] != height))
+    {
+        *returnedFailure = "ImageIO was unable to decode the PNG at the image's size";
+        goto ERROR;
+    }
+
+    bitmapRow = [bitmap bitmapData];
+    bytesPerRow = [bitmap bytesPerRow];
+
+    if (!bitmapRow || ([bitmap bitsPerSample] != kPNGBitDepth)
+        || ([bitmap samplesPerPixel] != kPNGBytesPerPixel) || [bitmap isPlanar]
+        || ([bitmap bitsPerPixel] != kPNGBitDepth * kPNGBytesPerPixel))
+    {
+        *returnedFailure = "ImageIO decoded the PNG to an unexpected bitmap layout";
+        goto ERROR;
+    }
+
+    bitmapFormat = [bitmap bitmapFormat];
+
+    alphaIndex = (bitmapFormat & NSAlphaFirstBitmapFormat) ? 0 : 3;
+    firstColorIndex = (alphaIndex) ? 0 : 1;
+    isPremultiplied = (bitmapFormat & NSAlphaNonpremultipliedBitmapFormat) ? NO : YES;
+
+    for (row=0; row<height; row++)
+    {
+        decodedPixel = bitmapRow;
+        expectedPixel = &pngRows[row * width * kPNGBytesPerPixel];
+
+        for (col=0; col<width; col++)
+        {
+            if (decodedPixel[alphaIndex] != expectedPixel[3])
+            {
+                *returnedFailure = "ImageIO-decoded alpha differs from the source";
+                goto ERROR;
+            }
+
+            if (!isPremultiplied || (expectedPixel[3] == kMaxImagePixelComponentValue))
+            {
+                for (colorIndex=0; colorIndex<3; colorIndex++)
+                {
+                    if (decodedPixel[firstColorIndex + colorIndex]
+                            != expectedPixel[colorIndex])
+                    {
+                        *returnedFailure = "ImageIO-decoded colors differ from the source";
+                        goto ERROR;
+                    }
+                }
+            }
+
+            decodedPixel += kPNGBytesPerPixel;
+            expectedPixel += kPNGBytesPerPixel;
+        }
+
+        bitmapRow += bytesPerRow;
+    }
+
+    return YES;
+
+ERROR:
+    return NO;
+}
+
+static uint32_t BigEndianUInt32AtBytes(const unsigned char *bytes)
+{
+    return ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16)
+            | ((uint32_t) bytes[2] << 8) | (uint32_t) bytes[3];
+}
+
+#endif  // PP_OPTIONAL__BUILD_WITH_PNG_ENCODER_CHECK
@@ -29,6 +29,7 @@
 #import "PPScreencastController.h"
 #import "NSObject_PPUtilities.h"
 #import "PPApplication.h"
+#import "PPStartupTimeline.h"
 
 
 #define kScreencastingMenuItemTitle         @"Enable Screencast Popup Panel"
@@ -50,6 +51,8 @@ static PPScreencastController *gScreencastController = nil;
 
 + (void) load
 {
+    macroStartupTimelineMethodScope();
+
     macroPerformNSObjectSelectorAfterAppLoads(ppOptional_Screencasting_SetupMenuItem);
 }
 
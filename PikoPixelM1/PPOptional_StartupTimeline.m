@@ -0,0 +1,58 @@
+/*
+    PPOptional_StartupTimeline.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPOptional.h"
+#if PP_OPTIONAL__BUILD_WITH_STARTUP_TIMELINE
+
+#import <Cocoa/Cocoa.h>
+#import "PPAppBootUtilities.h"
+#import "NSObject_PPUtilities.h"
+#import "PPStartupTimeline.h"
+
+
+@implementation NSObject (PPOptional_StartupTimeline)
+
++ (void) load
+{
+    macroStartupTimelineMethodScope();
+
+    macroPerformNSObjectSelectorAfterAppLoads(ppOptional_StartupTimeline_Setup);
+}
+
++ (void) ppOptional_StartupTimeline_Setup
+{
+    // the timeline's logged from a new stack frame once the app's run loop starts, so it
+    // includes the rest of finishLaunching (opening the initial untitled document, etc.)
+
+    [self ppPerformSelectorFromNewStackFrame: @selector(ppOptional_StartupTimeline_Log)];
+}
+
++ (void) ppOptional_StartupTimeline_Log
+{
+    PPStartupTimeline_LogTimeline();
+}
+
+@end
+
+#endif  // PP_OPTIONAL__BUILD_WITH_STARTUP_TIMELINE
@@ -0,0 +1,80 @@
+/*
+    PPPNGEncoder.h
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import <Cocoa/Cocoa.h>
+#import <zlib.h>
+
+
+// PPPNGEncoder: Writes a PNG (8-bit RGBA, sRGB) from image bitmap rows that are passed in
+// top-to-bottom order, in as many calls as needed, so an image can be encoded without the whole
+// image ever being in memory at once.
+//
+// The rows passed in each call are filtered & deflated in parallel: the rows are split into
+// strips that are compressed independently (each strip's deflate stream is primed with the
+// preceding 32 KB of filtered data, and ends with a sync flush, so the concatenated strips
+// form a single standard zlib stream).
+
+@interface PPPNGEncoder : NSObject
+{
+    NSMutableData *_pngData;
+    NSMutableData *_idatData;
+
+    unsigned _width;
+    unsigned _height;
+    unsigned _numEncodedRows;
+
+    unsigned char *_previousRow;
+    unsigned char *_deflateDictionary;
+    unsigned _deflateDictionaryLength;
+    uLong _adler32Checksum;
+
+    unsigned _deflateStripLength;
+
+    bool _didFinishEncoding;
+}
+
++ (NSData *) pngDataFromImageBitmap: (NSBitmapImageRep *) bitmap;
+
+- initWithImageSize: (NSSize) imageSize;
+
+// deflateStripLength: approximate length of filtered data per strip (at least one row per
+// strip); defaults to 128 KB - smaller lengths are only useful for checking the encoder's
+// output with many strips (PPOptional_PNGEncoderCheck.m)
+- (void) setDeflateStripLength: (unsigned) deflateStripLength;
+
+// firstRow is a row index (top-down) in bitmap; bitmap's width must match the image's
+- (bool) encodeRowsOfImageBitmap: (NSBitmapImageRep *) bitmap
+            fromRow: (unsigned) firstRow
+            numRows: (unsigned) numRows;
+
+// pixelData: premultiplied PPImageBitmapPixel rows (doesn't require AppKit, so the encoder can
+// also be used headless)
+- (bool) encodeRowsFromImagePixelData: (const unsigned char *) pixelData
+            bytesPerRow: (unsigned) bytesPerRow
+            numRows: (unsigned) numRows;
+
+// returns nil if not all of the image's rows were encoded
+- (NSData *) finishEncoding;
+
+@end
@@ -0,0 +1,883 @@
+/*
+    PPPNGEncoder.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPPNGEncoder.h"
+
+#import <dispatch/dispatch.h>
+#import "NSBitmapImageRep_PPUtilities.h"
+#import "PPImagePixelAlphaPremultiplyTables.h"
+#import "PPGeometry.h"
+
+
+#define kPNGChunkType_IHDR                  'IHDR'
+#define kPNGChunkType_sRGB                  'sRGB'
+#define kPNGChunkType_IDAT                  'IDAT'
+#define kPNGChunkType_IEND                  'IEND'
+
+#define kPNGBitDepth                        8
+#define kPNGColorType_RGBA                  6
+#define kPNGRenderingIntent_Perceptual      0
+
+#define kPNGBytesPerPixel                   4
+
+#define kMaxPNGImageDimension               (1 << 24)
+
+// zlib stream header: deflate, 32K window, default compression level
+#define kZlibStreamHeaderByte0              0x78
+#define kZlibStreamHeaderByte1              0x9C
+
+#define kDeflateWindowSize                  (32 * 1024)
+
+// by default, filtered data is split into strips of about this length that are deflated in
+// parallel (see -[PPPNGEncoder setDeflateStripLength:])
+#define kDeflateStripLength                 (128 * 1024)
+
+// pngDataFromImageBitmap: encodes the bitmap's rows in batches of about this much filtered
+// data, which limits the encoder's working memory
+#define kEncodingBatchLength                (8 * 1024 * 1024)
+
+#define kIDATChunkLength                    (256 * 1024)
+
+// slack added to deflateBound() for a strip's sync-flush marker
+#define kDeflateSyncFlushSlack              64
+
+
+typedef enum
+{
+    kPPPNGFilterType_None,
+    kPPPNGFilterType_Sub,
+    kPPPNGFilterType_Up,
+    kPPPNGFilterType_Average,
+    kPPPNGFilterType_Paeth,
+
+    kNumPPPNGFilterTypes
+
+} PPPNGFilterType;
+
+typedef struct
+{
+    unsigned char *compressedBytes;
+    unsigned long compressedLength;
+    uLong adler32Checksum;
+    bool didFail;
+
+} PPPNGEncoderStripResult;
+
+
+static void AppendPNGChunk(NSMutableData *pngData, uint32_t chunkType, const void *chunkBytes,
+                            uint32_t chunkLength);
+static void AppendBigEndianUInt32(NSMutableData *data, uint32_t value);
+static void UnpremultiplyImagePixelsToPNGRow(const PPImageBitmapPixel *sourcePixel,
+                                                unsigned numPixels, unsigned char *pngRow);
+static void FilterPNGRowAdaptively(const unsigned char *row, const unsigned char *previousRow,
+                                    unsigned rowLength, unsigned char *filteredRow);
+static bool DeflateStrip(const unsigned char *stripBytes, unsigned long stripLength,
+                            const unsigned char *dictionary, unsigned dictionaryLength,
+                            bool isFinalStrip, PPPNGEncoderStripResult *stripResult);
+
+
+@interface PPPNGEncoder (PrivateMethods)
+
+- (void) appendCompressedBytes: (const unsigned char *) bytes length: (unsigned long) length;
+- (void) writeIDATChunksAndFlushAll: (bool) shouldFlushAll;
+
+- (void) updateDeflateDictionaryWithFilteredData: (const unsigned char *) filteredData
+            length: (unsigned long) length;
+
+@end
+
+@implementation PPPNGEncoder
+
++ (NSData *) pngDataFromImageBitmap: (NSBitmapImageRep *) bitmap
+{
+    NSSize bitmapSize;
+    PPPNGEncoder *encoder;
+    unsigned numRowsPerBatch, row, numRows, numBatchRows;
+
+    if (![bitmap ppIsImageBitmap])
+    {
+        goto ERROR;
+    }
+
+    bitmapSize = [bitmap ppSizeInPixels];
+
+    encoder = [[[PPPNGEncoder alloc] initWithImageSize: bitmapSize] autorelease];
+
+    if (!encoder)
+        goto ERROR;
+
+    numRowsPerBatch =
+        MAX(1, kEncodingBatchLength / (1 + bitmapSize.width * kPNGBytesPerPixel));
+
+    numRows = bitmapSize.height;
+
+    for (row=0; row<numRows; row+=numBatchRows)
+    {
+        numBatchRows = MIN(numRowsPerBatch, numRows - row);
+
+        if (![encoder encodeRowsOfImageBitmap: bitmap
+                        fromRow: row
+                        numRows: numBatchRows])
+        {
+            goto ERROR;
+        }
+    }
+
+    return [encoder finishEncoding];
+
+ERROR:
+    return nil;
+}
+
+- initWithImageSize: (NSSize) imageSize
+{
+    uint32_t ihdrValues[2];
+    unsigned char ihdrBytes[13], srgbByte, zlibStreamHeader[2];
+    static const unsigned char pngSignature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+
+    self = [super init];
+
+    if (!self)
+        goto ERROR;
+
+    imageSize = PPGeometry_SizeClippedToIntegerValues(imageSize);
+
+    if (PPGeometry_IsZeroSize(imageSize)
+        || (imageSize.width > kMaxPNGImageDimension)
+        || (imageSize.height > kMaxPNGImageDimension))
+    {
+        goto ERROR;
+    }
+
+    _width = imageSize.width;
+    _height = imageSize.height;
+
+    // the row preceding the image's first row is treated as all zeros when filtering
+    _previousRow = (unsigned char *) calloc(_width * kPNGBytesPerPixel, 1);
+
+    _deflateDictionary = (unsigned char *) malloc (kDeflateWindowSize);
+
+    _pngData = [[NSMutableData alloc] init];
+    _idatData = [[NSMutableData alloc] init];
+
+    if (!_previousRow || !_deflateDictionary || !_pngData || !_idatData)
+    {
+        goto ERROR;
+    }
+
+    _adler32Checksum = adler32(0L, Z_NULL, 0);
+
+    _deflateStripLength = kDeflateStripLength;
+
+    // signature & header chunks
+
+    [_pngData appendBytes: pngSignature length: sizeof(pngSignature)];
+
+    ihdrValues[0] = NSSwapHostIntToBig(_width);
+    ihdrValues[1] = NSSwapHostIntToBig(_height);
+
+    memcpy(ihdrBytes, ihdrValues, sizeof(ihdrValues));
+    ihdrBytes[8] = kPNGBitDepth;
+    ihdrBytes[9] = kPNGColorType_RGBA;
+    ihdrBytes[10] = 0;  // compression method: deflate
+    ihdrBytes[11] = 0;  // filter method: adaptive
+    ihdrBytes[12] = 0;  // interlace method: none
+
+    AppendPNGChunk(_pngData, kPNGChunkType_IHDR, ihdrBytes, sizeof(ihdrBytes));
+
+    // image bitmaps use the sRGB colorspace
+    srgbByte = kPNGRenderingIntent_Perceptual;
+
+    AppendPNGChunk(_pngData, kPNGChunkType_sRGB, &srgbByte, sizeof(srgbByte));
+
+    // the strips are raw deflate data, so the zlib stream's header & checksum are written
+    // by the encoder
+
+    zlibStreamHeader[0] = kZlibStreamHeaderByte0;
+    zlibStreamHeader[1] = kZlibStreamHeaderByte1;
+
+    [_idatData appendBytes: zlibStreamHeader length: sizeof(zlibStreamHeader)];
+
+    return self;
+
+ERROR:
+    [self release];
+
+    return nil;
+}
+
+- init
+{
+    return [self initWithImageSize: NSZeroSize];
+}
+
+- (void) dealloc
+{
+    if (_previousRow)
+    {
+        free(_previousRow);
+    }
+
+    if (_deflateDictionary)
+    {
+        free(_deflateDictionary);
+    }
+
+    [_pngData release];
+    [_idatData release];
+
+    [super dealloc];
+}
+
+- (void) setDeflateStripLength: (unsigned) deflateStripLength
+{
+    _deflateStripLength = (deflateStripLength) ? deflateStripLength : kDeflateStripLength;
+}
+
+- (bool) encodeRowsOfImageBitmap: (NSBitmapImageRep *) bitmap
+            fromRow: (unsigned) firstRow
+            numRows: (unsigned) numRows
+{
+    NSSize bitmapSize;
+    unsigned char *bitmapData;
+    int bytesPerRow;
+
+    if (![bitmap ppIsImageBitmap])
+    {
+        goto ERROR;
+    }
+
+    bitmapSize = [bitmap ppSizeInPixels];
+
+    if ((bitmapSize.width != _width) || (firstRow + numRows > bitmapSize.height))
+    {
+        goto ERROR;
+    }
+
+    bitmapData = [bitmap bitmapData];
+    bytesPerRow = [bitmap bytesPerRow];
+
+    if (!bitmapData || (bytesPerRow <= 0))
+    {
+        goto ERROR;
+    }
+
+    return [self encodeRowsFromImagePixelData: &bitmapData[firstRow * bytesPerRow]
+                    bytesPerRow: bytesPerRow
+                    numRows: numRows];
+
+ERROR:
+    return NO;
+}
+
+- (bool) encodeRowsFromImagePixelData: (const unsigned char *) pixelData
+            bytesPerRow: (unsigned) bytesPerRow
+            numRows: (unsigned) numRows
+{
+    unsigned width, rowLength, filteredRowLength, numRowsPerStrip, numStrips, stripIndex;
+    unsigned char *rows = NULL, *filteredRows = NULL, *previousDictionary = NULL;
+    unsigned long filteredDataLength, stripLength;
+    unsigned previousDictionaryLength;
+    PPPNGEncoderStripResult *stripResults = NULL;
+    bool isFinalBatch;
+    dispatch_queue_t queue;
+
+    if (_didFinishEncoding || !pixelData || !numRows
+        || (_numEncodedRows + numRows > _height))
+    {
+        goto ERROR;
+    }
+
+    width = _width;
+    rowLength = _width * kPNGBytesPerPixel;
+    filteredRowLength = 1 + rowLength;
+
+    if (bytesPerRow < rowLength)
+    {
+        goto ERROR;
+    }
+
+    if (!PPImageAlphaPremultiplyTables_Setup())
+        goto ERROR;
+
+    filteredDataLength = (unsigned long) numRows * filteredRowLength;
+
+    numRowsPerStrip = MAX(1, _deflateStripLength / filteredRowLength);
+    numStrips = (numRows + numRowsPerStrip - 1) / numRowsPerStrip;
+
+    // rows: the unpremultiplied rows, preceded by the last row of the previous call (filtering
+    // a row needs the row above it)
+
+    rows = (unsigned char *) malloc ((unsigned long) (numRows + 1) * rowLength);
+    filteredRows = (unsigned char *) malloc (filteredDataLength);
+    stripResults =
+            (PPPNGEncoderStripResult *) calloc(numStrips, sizeof(PPPNGEncoderStripResult));
+
+    if (!rows || !filteredRows || !stripResults)
+    {
+        goto ERROR;
+    }
+
+    memcpy(rows, _previousRow, rowLength);
+
+    previousDictionary = _deflateDictionary;
+    previousDictionaryLength = _deflateDictionaryLength;
+
+    isFinalBatch = (_numEncodedRows + numRows == _height) ? YES : NO;
+
+    queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+
+    // pass 1: unpremultiply & filter each strip's rows (filtering only reads unfiltered rows,
+    // so the strips are independent once all rows are unpremultiplied)
+
+    dispatch_apply(numStrips, queue,
+        ^(size_t strip)
+        {
+            unsigned firstRow = strip * numRowsPerStrip,
+                        lastRow = MIN(firstRow + numRowsPerStrip, numRows), row;
+
+            for (row=firstRow; row<lastRow; row++)
+            {
+                UnpremultiplyImagePixelsToPNGRow(
+                                (const PPImageBitmapPixel *) &pixelData[row * bytesPerRow],
+                                width, &rows[(row + 1) * rowLength]);
+            }
+        });
+
+    dispatch_apply(numStrips, queue,
+        ^(size_t strip)
+        {
+            unsigned firstRow = strip * numRowsPerStrip,
+                        lastRow = MIN(firstRow + numRowsPerStrip, numRows), row;
+
+            for (row=firstRow; row<lastRow; row++)
+            {
+                FilterPNGRowAdaptively(&rows[(row + 1) * rowLength], &rows[row * rowLength],
+                                        rowLength, &filteredRows[row * filteredRowLength]);
+            }
+        });
+
+    // pass 2: deflate each strip; each strip's dictionary is the 32K of filtered data
+    // preceding it (from this call's data, or the previous calls' data)
+
+    dispatch_apply(numStrips, queue,
+        ^(size_t strip)
+        {
+            unsigned long stripOffset, stripDataLength, dictionaryLength;
+            unsigned char *dictionary, *combinedDictionary = NULL;
+
+            stripOffset = (unsigned long) strip * numRowsPerStrip * filteredRowLength;
+            stripDataLength = MIN((unsigned long) numRowsPerStrip * filteredRowLength,
+                                    filteredDataLength - stripOffset);
+
+            if (stripOffset >= kDeflateWindowSize)
+            {
+                dictionary = &filteredRows[stripOffset - kDeflateWindowSize];
+                dictionaryLength = kDeflateWindowSize;
+            }
+            else if (!previousDictionaryLength)
+            {
+                dictionary = filteredRows;
+                dictionaryLength = stripOffset;
+            }
+            else
+            {
+                unsigned long numPreviousBytes =
+                            MIN(previousDictionaryLength, kDeflateWindowSize - stripOffset);
+
+                combinedDictionary = (unsigned char *) malloc (kDeflateWindowSize);
+
+                if (!combinedDictionary)
+                {
+                    stripResults[strip].didFail = YES;
+                    return;
+                }
+
+                memcpy(combinedDictionary,
+                        &previousDictionary[previousDictionaryLength - numPreviousBytes],
+                        numPreviousBytes);
+
+                memcpy(&combinedDictionary[numPreviousBytes], filteredRows, stripOffset);
+
+                dictionary = combinedDictionary;
+                dictionaryLength = numPreviousBytes + stripOffset;
+            }
+
+            if (!DeflateStrip(&filteredRows[stripOffset], stripDataLength, dictionary,
+                                dictionaryLength, (isFinalBatch && (strip == numStrips - 1)),
+                                &stripResults[strip]))
+            {
+                stripResults[strip].didFail = YES;
+            }
+
+            if (combinedDictionary)
+            {
+                free(combinedDictionary);
+            }
+        });
+
+    // append the strips in order
+
+    for (stripIndex=0; stripIndex<numStrips; stripIndex++)
+    {
+        if (stripResults[stripIndex].didFail)
+        {
+            goto ERROR;
+        }
+    }
+
+    for (stripIndex=0; stripIndex<numStrips; stripIndex++)
+    {
+        stripLength = MIN((unsigned long) numRowsPerStrip * filteredRowLength,
+                            filteredDataLength
+                                - (unsigned long) stripIndex * numRowsPerStrip
+                                    * filteredRowLength);
+
+        [self appendCompressedBytes: stripResults[stripIndex].compressedBytes
+                length: stripResults[stripIndex].compressedLength];
+
+        _adler32Checksum = adler32_combine(_adler32Checksum,
+                                            stripResults[stripIndex].adler32Checksum,
+                                            (z_off_t) stripLength);
+
+        free(stripResults[stripIndex].compressedBytes);
+        stripResults[stripIndex].compressedBytes = NULL;
+    }
+
+    [self updateDeflateDictionaryWithFilteredData: filteredRows length: filteredDataLength];
+
+    memcpy(_previousRow, &rows[numRows * rowLength], rowLength);
+
+    _numEncodedRows += numRows;
+
+    free(rows);
+    free(filteredRows);
+    free(stripResults);
+
+    return YES;
+
+ERROR:
+    if (stripResults)
+    {
+        for (stripIndex=0; stripIndex<numStrips; stripIndex++)
+        {
+            if (stripResults[stripIndex].compressedBytes)
+            {
+                free(stripResults[stripIndex].compressedBytes);
+            }
+        }
+
+        free(stripResults);
+    }
+
+    if (rows)
+    {
+        free(rows);
+    }
+
+    if (filteredRows)
+    {
+        free(filteredRows);
+    }
+
+    return NO;
+}
+
+- (NSData *) finishEncoding
+{
+    if (_didFinishEncoding || (_numEncodedRows != _height))
+    {
+        goto ERROR;
+    }
+
+    // the final strip ended the deflate stream, so only the zlib checksum remains
+
+    AppendBigEndianUInt32(_idatData, (uint32_t) _adler32Checksum);
+
+    [self writeIDATChunksAndFlushAll: YES];
+
+    AppendPNGChunk(_pngData, kPNGChunkType_IEND, NULL, 0);
+
+    _didFinishEncoding = YES;
+
+    return [[_pngData retain] autorelease];
+
+ERROR:
+    return nil;
+}
+
+#pragma mark Private methods
+
+- (void) appendCompressedBytes: (const unsigned char *) bytes length: (unsigned long) length
+{
+    if (!bytes || !length)
+        return;
+
+    [_idatData appendBytes: bytes length: length];
+
+    [self writeIDATChunksAndFlushAll: NO];
+}
+
+- (void) writeIDATChunksAndFlushAll: (bool) shouldFlushAll
+{
+    const unsigned char *idatBytes;
+    unsigned long idatLength, offset = 0, chunkLength;
+
+    idatBytes = [_idatData bytes];
+    idatLength = [_idatData length];
+
+    while (idatLength - offset >= kIDATChunkLength)
+    {
+        AppendPNGChunk(_pngData, kPNGChunkType_IDAT, &idatBytes[offset], kIDATChunkLength);
+        offset += kIDATChunkLength;
+    }
+
+    if (shouldFlushAll && (offset < idatLength))
+    {
+        chunkLength = idatLength - offset;
+
+        AppendPNGChunk(_pngData, kPNGChunkType_IDAT, &idatBytes[offset], chunkLength);
+        offset += chunkLength;
+    }
+
+    if (offset)
+    {
+        [_idatData replaceBytesInRange: NSMakeRange(0, offset) withBytes: NULL length: 0];
+    }
+}
+
+- (void) updateDeflateDictionaryWithFilteredData: (const unsigned char *) filteredData
+            length: (unsigned long) length
+{
+    unsigned numPreviousBytesToKeep;
+
+    if (length >= kDeflateWindowSize)
+    {
+        memcpy(_deflateDictionary, &filteredData[length - kDeflateWindowSize],
+                kDeflateWindowSize);
+
+        _deflateDictionaryLength = kDeflateWindowSize;
+
+        return;
+    }
+
+    numPreviousBytesToKeep = MIN(_deflateDictionaryLength, kDeflateWindowSize - length);
+
+    memmove(_deflateDictionary,
+            &_deflateDictionary[_deflateDictionaryLength - numPreviousBytesToKeep],
+            numPreviousBytesToKeep);
+
+    memcpy(&_deflateDictionary[numPreviousBytesToKeep], filteredData, length);
+
+    _deflateDictionaryLength = numPreviousBytesToKeep + length;
+}
+
+@end
+
+#pragma mark Private functions
+
+static void AppendPNGChunk(NSMutableData *pngData, uint32_t chunkType, const void *chunkBytes,
+                            uint32_t chunkLength)
+{
+    unsigned char chunkTypeBytes[4];
+    uLong crc;
+
+    chunkTypeBytes[0] = (chunkType >> 24) & 0xFF;
+    chunkTypeBytes[1] = (chunkType >> 16) & 0xFF;
+    chunkTypeBytes[2] = (chunkType >> 8) & 0xFF;
+    chunkTypeBytes[3] = chunkType & 0xFF;
+
+    crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, chunkTypeBytes, sizeof(chunkTypeBytes));
+
+    AppendBigEndianUInt32(pngData, chunkLength);
+    [pngData appendBytes: chunkTypeBytes length: sizeof(chunkTypeBytes)];
+
+    if (chunkBytes && chunkLength)
+    {
+        crc = crc32(crc, chunkBytes, chunkLength);
+
+        [pngData appendBytes: chunkBytes length: chunkLength];
+    }
+
+    AppendBigEndianUInt32(pngData, (uint32_t) crc);
+}
+
+static void AppendBigEndianUInt32(NSMutableData *data, uint32_t value)
+{
+    value = NSSwapHostIntToBig(value);
+
+    [data appendBytes: &value length: sizeof(value)];
+}
+
+static void UnpremultiplyImagePixelsToPNGRow(const PPImageBitmapPixel *sourcePixel,
+                                                unsigned numPixels, unsigned char *pngRow)
+{
+    PPImagePixelComponent *unpremultiplyTable;
+
+    while (numPixels--)
+    {
+        pngRow[3] = macroImagePixelComponent_Alpha(sourcePixel);
+
+        if (pngRow[3] == kMaxImagePixelComponentValue)
+        {
+            pngRow[0] = macroImagePixelComponent_Red(sourcePixel);
+            pngRow[1] = macroImagePixelComponent_Green(sourcePixel);
+            pngRow[2] = macroImagePixelComponent_Blue(sourcePixel);
+        }
+        else
+        {
+            unpremultiplyTable = macroAlphaUnpremultiplyTableForImagePixel(sourcePixel);
+
+            pngRow[0] = unpremultiplyTable[macroImagePixelComponent_Red(sourcePixel)];
+            pngRow[1] = unpremultiplyTable[macroImagePixelComponent_Green(sourcePixel)];
+            pngRow[2] = unpremultiplyTable[macroImagePixelComponent_Blue(sourcePixel)];
+        }
+
+        sourcePixel++;
+        pngRow += kPNGBytesPerPixel;
+    }
+}
+
+// Filter predictors & heuristic sums: Each filter type has its own branch-free loop over the
+// row's bytes, so the compiler can vectorize them (SSE/NEON); the leftmost pixel (no left
+// neighbor) is handled separately.
+
+#define macroAbsoluteValueOfFilteredByte(filteredByte)                                      \
+            ((unsigned) abs((int) ((signed char) (filteredByte))))
+
+#define macroPaethPredictor(left, up, upLeft)                                               \
+            ((abs((int) (up) - (int) (upLeft)) <= abs((int) (left) - (int) (upLeft))       \
+                && abs((int) (up) - (int) (upLeft))                                         \
+                    <= abs((int) (left) + (int) (up) - 2 * (int) (upLeft))) ?              \
+                (left) :                                                                    \
+                ((abs((int) (left) - (int) (upLeft))                                        \
+                        <= abs((int) (left) + (int) (up) - 2 * (int) (upLeft))) ?          \
+                    (up) : (upLeft)))
+
+static inline unsigned char FilteredByte(PPPNGFilterType filterType, unsigned char value,
+                                            unsigned char left, unsigned char up,
+                                            unsigned char upLeft)
+{
+    switch (filterType)
+    {
+        case kPPPNGFilterType_Sub:
+            return value - left;
+
+        case kPPPNGFilterType_Up:
+            return value - up;
+
+        case kPPPNGFilterType_Average:
+            return value - (unsigned char) (((unsigned) left + (unsigned) up) >> 1);
+
+        case kPPPNGFilterType_Paeth:
+            return value - (unsigned char) macroPaethPredictor(left, up, upLeft);
+
+        case kPPPNGFilterType_None:
+        default:
+            return value;
+    }
+}
+
+static unsigned FilterSumForRow(const unsigned char *row, const unsigned char *previousRow,
+                                unsigned rowLength, PPPNGFilterType filterType)
+{
+    unsigned byteIndex, sum = 0;
+
+    for (byteIndex=0; byteIndex<kPNGBytesPerPixel; byteIndex++)
+    {
+        sum += macroAbsoluteValueOfFilteredByte(
+                        FilteredByte(filterType, row[byteIndex], 0, previousRow[byteIndex], 0));
+    }
+
+    // separate loop per filter type (the switch is hoisted out of the vectorizable loops)
+
+    switch (filterType)
+    {
+        case kPPPNGFilterType_Sub:
+            for (; byteIndex<rowLength; byteIndex++)
+            {
+                sum += macroAbsoluteValueOfFilteredByte(
+                                    row[byteIndex] - row[byteIndex - kPNGBytesPerPixel]);
+            }
+        break;
+
+        case kPPPNGFilterType_Up:
+            for (; byteIndex<rowLength; byteIndex++)
+            {
+                sum += macroAbsoluteValueOfFilteredByte(
+                                    row[byteIndex] - previousRow[byteIndex]);
+            }
+        break;
+
+        case kPPPNGFilterType_Average:
+            for (; byteIndex<rowLength; byteIndex++)
+            {
+                sum += macroAbsoluteValueOfFilteredByte(
+                            row[byteIndex]
+                                - ((row[byteIndex - kPNGBytesPerPixel]
+                                        + previousRow[byteIndex]) >> 1));
+            }
+        break;
+
+        case kPPPNGFilterType_Paeth:
+            for (; byteIndex<rowLength; byteIndex++)
+            {
+                sum += macroAbsoluteValueOfFilteredByte(
+                            row[byteIndex]
+                                - macroPaethPredictor(row[byteIndex - kPNGBytesPerPixel],
+                                                previousRow[byteIndex],
+                                                previousRow[byteIndex - kPNGBytesPerPixel]));
+            }
+        break;
+
+        case kPPPNGFilterType_None:
+        default:
+            for (; byteIndex<rowLength; byteIndex++)
+            {
+                sum += macroAbsoluteValueOfFilteredByte(row[byteIndex]);
+            }
+        break;
+    }
+
+    return sum;
+}
+
+static void FilterPNGRow(const unsigned char *row, const unsigned char *previousRow,
+                            unsigned rowLength, PPPNGFilterType filterType,
+                            unsigned char *filteredRow)
+{
+    unsigned byteIndex;
+
+    filteredRow[0] = filterType;
+    filteredRow++;
+
+    for (byteIndex=0; byteIndex<kPNGBytesPerPixel; byteIndex++)
+    {
+        filteredRow[byteIndex] =
+                        FilteredByte(filterType, row[byteIndex], 0, previousRow[byteIndex], 0);
+    }
+
+    for (; byteIndex<rowLength; byteIndex++)
+    {
+        filteredRow[byteIndex] = FilteredByte(filterType, row[byteIndex],
+                                                row[byteIndex - kPNGBytesPerPixel],
+                                                previousRow[byteIndex],
+                                                previousRow[byteIndex - kPNGBytesPerPixel]);
+    }
+}
+
+// uses the filter type with the smallest sum of absolute values (as signed bytes), which
+// usually compresses best (same heuristic as libpng)
+static void FilterPNGRowAdaptively(const unsigned char *row, const unsigned char *previousRow,
+                                    unsigned rowLength, unsigned char *filteredRow)
+{
+    PPPNGFilterType filterType, bestFilterType = kPPPNGFilterType_None;
+    unsigned filterSum, bestFilterSum = UINT_MAX;
+
+    for (filterType=0; filterType<kNumPPPNGFilterTypes; filterType++)
+    {
+        filterSum = FilterSumForRow(row, previousRow, rowLength, filterType);
+
+        if (filterSum < bestFilterSum)
+        {
+            bestFilterSum = filterSum;
+            bestFilterType = filterType;
+        }
+    }
+
+    FilterPNGRow(row, previousRow, rowLength, bestFilterType, filteredRow);
+}
+
+static bool DeflateStrip(const unsigned char *stripBytes, unsigned long stripLength,
+                            const unsigned char *dictionary, unsigned dictionaryLength,
+                            bool isFinalStrip, PPPNGEncoderStripResult *stripResult)
+{
+    z_stream zStream;
+    bool zStreamIsInitialized = NO;
+    unsigned long maxCompressedLength;
+    int deflateResult;
+
+    memset(&zStream, 0, sizeof(zStream));
+
+    // raw deflate (negative windowBits): the strips are concatenated into a single zlib
+    // stream, so the zlib header & checksum are written separately
+
+    if (deflateInit2(&zStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_FILTERED)
+        != Z_OK)
+    {
+        goto ERROR;
+    }
+
+    zStreamIsInitialized = YES;
+
+    if (dictionary && dictionaryLength
+        && (deflateSetDictionary(&zStream, dictionary, dictionaryLength) != Z_OK))
+    {
+        goto ERROR;
+    }
+
+    maxCompressedLength = deflateBound(&zStream, stripLength) + kDeflateSyncFlushSlack;
+
+    stripResult->compressedBytes = (unsigned char *) malloc (maxCompressedLength);
+
+    if (!stripResult->compressedBytes)
+        goto ERROR;
+
+    zStream.next_in = (Bytef *) stripBytes;
+    zStream.avail_in = stripLength;
+    zStream.next_out = stripResult->compressedBytes;
+    zStream.avail_out = maxCompressedLength;
+
+    // non-final strips end with a sync flush (byte-aligned, without the final-block flag),
+    // so the next strip's data can follow directly
+
+    deflateResult = deflate(&zStream, (isFinalStrip) ? Z_FINISH : Z_SYNC_FLUSH);
+
+    if ((deflateResult != ((isFinalStrip) ? Z_STREAM_END : Z_OK)) || zStream.avail_in)
+    {
+        goto ERROR;
+    }
+
+    stripResult->compressedLength = maxCompressedLength - zStream.avail_out;
+    stripResult->adler32Checksum = adler32(adler32(0L, Z_NULL, 0), stripBytes, stripLength);
+
+    deflateEnd(&zStream);
+
+    return YES;
+
+ERROR:
+    if (zStreamIsInitialized)
+    {
+        deflateEnd(&zStream);
+    }
+
+    if (stripResult->compressedBytes)
+    {
+        free(stripResult->compressedBytes);
+        stripResult->compressedBytes = NULL;
+    }
+
+    return NO;
+}
@@ -0,0 +1,505 @@
+/*
+    PPPixelCore.c
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PPPixelCore.h"
+
+#include <string.h>
+
+
+#define macroPixelBufferRowAtPoint(buffer, x, y, pixelType)                          \
+            (&(buffer)->data[(y) * (buffer)->bytesPerRow + (x) * sizeof(pixelType)])
+
+
+// Mask buffers
+
+void PPPixelCore_GetMaskBoundsInRect(const PPPixelBuffer *mask, PPPixelRect rect,
+                                        PPPixelRect *returnedBounds)
+{
+    unsigned char *maskRow;
+    int lastCol, lastRow, maskLeft, maskRight, maskTop, maskBottom, row, col;
+    PPMaskBitmapPixel *maskPixel;
+
+    if (!returnedBounds)
+        return;
+
+    *returnedBounds = PPPixelRect_Make(0, 0, 0, 0);
+
+    if (!mask || !mask->data || PPPixelRect_IsEmpty(rect))
+    {
+        return;
+    }
+
+    lastCol = rect.x + rect.width - 1;
+    lastRow = rect.y + rect.height - 1;
+
+    maskLeft = lastCol;
+    maskRight = rect.x;
+    maskTop = lastRow + 1;
+    maskBottom = rect.y;
+
+    maskRow = macroPixelBufferRowAtPoint(mask, rect.x, rect.y, PPMaskBitmapPixel);
+
+    for (row=rect.y; row<=lastRow; row++)
+    {
+        maskPixel = (PPMaskBitmapPixel *) maskRow;
+
+        for (col=rect.x; col<=lastCol; col++)
+        {
+            if (*maskPixel)
+            {
+                if (maskLeft > col)
+                {
+                    maskLeft = col;
+                }
+
+                if (maskRight < col)
+                {
+                    maskRight = col;
+                }
+
+                if (maskTop > row)
+                {
+                    maskTop = row;
+                }
+
+                maskBottom = row;
+            }
+
+            maskPixel++;
+        }
+
+        maskRow += mask->bytesPerRow;
+    }
+
+    if (maskTop > lastRow)
+    {
+        return;
+    }
+
+    *returnedBounds = PPPixelRect_Make(maskLeft, maskTop, maskRight - maskLeft + 1,
+                                        maskBottom - maskTop + 1);
+}
+
+bool PPPixelCore_MaskHasNonzeroPixelsInRect(const PPPixelBuffer *mask, PPPixelRect rect)
+{
+    unsigned char *maskRow;
+    int rowCounter, pixelCounter;
+    PPMaskBitmapPixel *maskPixel;
+
+    if (!mask || !mask->data || PPPixelRect_IsEmpty(rect))
+    {
+        return false;
+    }
+
+    maskRow = macroPixelBufferRowAtPoint(mask, rect.x, rect.y, PPMaskBitmapPixel);
+    rowCounter = rect.height;
+
+    while (rowCounter--)
+    {
+        maskPixel = (PPMaskBitmapPixel *) maskRow;
+        pixelCounter = rect.width;
+
+        while (pixelCounter--)
+        {
+            if (*maskPixel++)
+            {
+                return true;
+            }
+        }
+
+        maskRow += mask->bytesPerRow;
+    }
+
+    return false;
+}
+
+bool PPPixelCore_MaskCoversAllPixelsInRect(const PPPixelBuffer *mask, PPPixelRect rect)
+{
+    unsigned char *maskRow;
+    int rowCounter, pixelCounter;
+    PPMaskBitmapPixel *maskPixel;
+
+    if (!mask || !mask->data || PPPixelRect_IsEmpty(rect))
+    {
+        return false;
+    }
+
+    maskRow = macroPixelBufferRowAtPoint(mask, rect.x, rect.y, PPMaskBitmapPixel);
+    rowCounter = rect.height;
+
+    while (rowCounter--)
+    {
+        maskPixel = (PPMaskBitmapPixel *) maskRow;
+        pixelCounter = rect.width;
+
+        while (pixelCounter--)
+        {
+            if (!*maskPixel++)
+            {
+                return false;
+            }
+        }
+
+        maskRow += mask->bytesPerRow;
+    }
+
+    return true;
+}
+
+void PPPixelCore_FillMaskInRect(const PPPixelBuffer *mask, PPPixelRect rect,
+                                PPMaskBitmapPixel pixelValue)
+{
+    unsigned char *maskRow;
+    int rowCounter;
+
+    if (!mask || !mask->data || PPPixelRect_IsEmpty(rect))
+    {
+        return;
+    }
+
+    maskRow = macroPixelBufferRowAtPoint(mask, rect.x, rect.y, PPMaskBitmapPixel);
+    rowCounter = rect.height;
+
+    while (rowCounter--)
+    {
+        memset(maskRow, pixelValue, rect.width * sizeof(PPMaskBitmapPixel));
+
+        maskRow += mask->bytesPerRow;
+    }
+}
+
+// The mask-combining operations are branch-free (ON & OFF values are all-ones & all-zeros, so
+// they combine with bitwise operations), so the compiler can vectorize the row loops; nonbinary
+// (intermediate) mask values are treated as ON, same as the previous per-pixel comparisons
+
+void PPPixelCore_IntersectMaskWithMaskInRect(const PPPixelBuffer *destinationMask,
+                                                const PPPixelBuffer *mask, PPPixelRect rect)
+{
+    unsigned char *destinationRow, *maskRow;
+    int rowCounter, col;
+    PPMaskBitmapPixel *destinationPixel, *maskPixel;
+
+    if (!destinationMask || !destinationMask->data || !mask || !mask->data
+        || PPPixelRect_IsEmpty(rect))
+    {
+        return;
+    }
+
+    destinationRow =
+            macroPixelBufferRowAtPoint(destinationMask, rect.x, rect.y, PPMaskBitmapPixel);
+    maskRow = macroPixelBufferRowAtPoint(mask, rect.x, rect.y, PPMaskBitmapPixel);
+    rowCounter = rect.height;
+
+    while (rowCounter--)
+    {
+        destinationPixel = (PPMaskBitmapPixel *) destinationRow;
+        maskPixel = (PPMaskBitmapPixel *) maskRow;
+
+        for (col=0; col<rect.width; col++)
+        {
+            // (0 - (maskPixel != 0)): all-ones if mask pixel's on, zero if off
+            destinationPixel[col] &= (PPMaskBitmapPixel) (0 - (maskPixel[col] != 0));
+        }
+
+        destinationRow += destinationMask->bytesPerRow;
+        maskRow += mask->bytesPerRow;
+    }
+}
+
+void PPPixelCore_SubtractMaskFromMaskInRect(const PPPixelBuffer *destinationMask,
+                                            const PPPixelBuffer *mask, PPPixelRect rect)
+{
+    unsigned char *destinationRow, *maskRow;
+    int rowCounter, col;
+    PPMaskBitmapPixel *destinationPixel, *maskPixel;
+
+    if (!destinationMask || !destinationMask->data || !mask || !mask->data
+        || PPPixelRect_IsEmpty(rect))
+    {
+        return;
+    }
+
+    destinationRow =
+            macroPixelBufferRowAtPoint(destinationMask, rect.x, rect.y, PPMaskBitmapPixel);
+    maskRow = macroPixelBufferRowAtPoint(mask, rect.x, rect.y, PPMaskBitmapPixel);
+    rowCounter = rect.height;
+
+    while (rowCounter--)
+    {
+        destinationPixel = (PPMaskBitmapPixel *) destinationRow;
+        maskPixel = (PPMaskBitmapPixel *) maskRow;
+
+        for (col=0; col<rect.width; col++)
+        {
+            // (0 - (maskPixel == 0)): zero if mask pixel's on, all-ones if off
+            destinationPixel[col] &= (PPMaskBitmapPixel) (0 - (maskPixel[col] == 0));
+        }
+
+        destinationRow += destinationMask->bytesPerRow;
+        maskRow += mask->bytesPerRow;
+    }
+}
+
+void PPPixelCore_MergeMaskWithMaskInRect(const PPPixelBuffer *destinationMask,
+                                            const PPPixelBuffer *mask, PPPixelRect rect)
+{
+    unsigned char *destinationRow, *maskRow;
+    int rowCounter, col;
+    PPMaskBitmapPixel *destinationPixel, *maskPixel;
+
+    if (!destinationMask || !destinationMask->data || !mask || !mask->data
+        || PPPixelRect_IsEmpty(rect))
+    {
+        return;
+    }
+
+    destinationRow =
+            macroPixelBufferRowAtPoint(destinationMask, rect.x, rect.y, PPMaskBitmapPixel);
+    maskRow = macroPixelBufferRowAtPoint(mask, rect.x, rect.y, PPMaskBitmapPixel);
+    rowCounter = rect.height;
+
+    while (rowCounter--)
+    {
+        destinationPixel = (PPMaskBitmapPixel *) destinationRow;
+        maskPixel = (PPMaskBitmapPixel *) maskRow;
+
+        for (col=0; col<rect.width; col++)
+        {
+            // unset destination pixels become ON where the mask's on; set pixels are unchanged
+            destinationPixel[col] |=
+                            (PPMaskBitmapPixel) ((0 - (maskPixel[col] != 0))
+                                                    & (0 - (destinationPixel[col] == 0)));
+        }
+
+        destinationRow += destinationMask->bytesPerRow;
+        maskRow += mask->bytesPerRow;
+    }
+}
+
+void PPPixelCore_InvertMaskInRect(const PPPixelBuffer *mask, PPPixelRect rect)
+{
+    unsigned char *maskRow;
+    int rowCounter, col;
+    PPMaskBitmapPixel *maskPixel;
+
+    if (!mask || !mask->data || PPPixelRect_IsEmpty(rect))
+    {
+        return;
+    }
+
+    maskRow = macroPixelBufferRowAtPoint(mask, rect.x, rect.y, PPMaskBitmapPixel);
+    rowCounter = rect.height;
+
+    while (rowCounter--)
+    {
+        maskPixel = (PPMaskBitmapPixel *) maskRow;
+
+        for (col=0; col<rect.width; col++)
+        {
+            maskPixel[col] = ~maskPixel[col];
+        }
+
+        maskRow += mask->bytesPerRow;
+    }
+}
+
+void PPPixelCore_ThresholdMaskInRect(const PPPixelBuffer *mask, PPPixelRect rect)
+{
+    unsigned char *maskRow;
+    int rowCounter, col;
+    PPMaskBitmapPixel *maskPixel;
+
+    if (!mask || !mask->data || PPPixelRect_IsEmpty(rect))
+    {
+        return;
+    }
+
+    maskRow = macroPixelBufferRowAtPoint(mask, rect.x, rect.y, PPMaskBitmapPixel);
+    rowCounter = rect.height;
+
+    while (rowCounter--)
+    {
+        maskPixel = (PPMaskBitmapPixel *) maskRow;
+
+        for (col=0; col<rect.width; col++)
+        {
+            maskPixel[col] =
+                (PPMaskBitmapPixel) (0 - (maskPixel[col] > kMaskPixelValue_Threshold));
+        }
+
+        maskRow += mask->bytesPerRow;
+    }
+}
+
+// Image buffers
+
+bool PPPixelCore_ImageHasTransparentPixelsInRect(const PPPixelBuffer *image,
+                                                    PPPixelRect rect)
+{
+    unsigned char *imageRow;
+    int rowCounter, pixelCounter;
+    PPImageBitmapPixel *imagePixel;
+
+    if (!image || !image->data || PPPixelRect_IsEmpty(rect))
+    {
+        return false;
+    }
+
+    imageRow = macroPixelBufferRowAtPoint(image, rect.x, rect.y, PPImageBitmapPixel);
+    rowCounter = rect.height;
+
+    while (rowCounter--)
+    {
+        imagePixel = (PPImageBitmapPixel *) imageRow;
+        pixelCounter = rect.width;
+
+        while (pixelCounter--)
+        {
+            if (macroImagePixelComponent_Alpha(imagePixel) != kMaxImagePixelComponentValue)
+            {
+                return true;
+            }
+
+            imagePixel++;
+        }
+
+        imageRow += image->bytesPerRow;
+    }
+
+    return false;
+}
+
+bool PPPixelCore_ImageIsClearInRect(const PPPixelBuffer *image, PPPixelRect rect)
+{
+    unsigned char *imageRow;
+    int rowCounter, pixelCounter;
+    PPImageBitmapPixel *imagePixel;
+
+    if (!image || !image->data || PPPixelRect_IsEmpty(rect))
+    {
+        return true;
+    }
+
+    imageRow = macroPixelBufferRowAtPoint(image, rect.x, rect.y, PPImageBitmapPixel);
+    rowCounter = rect.height;
+
+    while (rowCounter--)
+    {
+        imagePixel = (PPImageBitmapPixel *) imageRow;
+        pixelCounter = rect.width;
+
+        while (pixelCounter--)
+        {
+            if (*imagePixel++)
+            {
+                return false;
+            }
+        }
+
+        imageRow += image->bytesPerRow;
+    }
+
+    return true;
+}
+
+void PPPixelCore_MaskedFillImageInRect(const PPPixelBuffer *image,
+                                        const PPPixelBuffer *mask,
+                                        PPPixelRect rect,
+                                        PPImageBitmapPixel fillPixelValue)
+{
+    unsigned char *imageRow, *maskRow;
+    int rowCounter, col;
+    PPImageBitmapPixel *imagePixel;
+    PPMaskBitmapPixel *maskPixel;
+
+    if (!image || !image->data || !mask || !mask->data || PPPixelRect_IsEmpty(rect))
+    {
+        return;
+    }
+
+    imageRow = macroPixelBufferRowAtPoint(image, rect.x, rect.y, PPImageBitmapPixel);
+    maskRow = macroPixelBufferRowAtPoint(mask, rect.x, rect.y, PPMaskBitmapPixel);
+    rowCounter = rect.height;
+
+    while (rowCounter--)
+    {
+        imagePixel = (PPImageBitmapPixel *) imageRow;
+        maskPixel = (PPMaskBitmapPixel *) maskRow;
+
+        for (col=0; col<rect.width; col++)
+        {
+            if (maskPixel[col])
+            {
+                imagePixel[col] = fillPixelValue;
+            }
+        }
+
+        imageRow += image->bytesPerRow;
+        maskRow += mask->bytesPerRow;
+    }
+}
+
+void PPPixelCore_MaskedCopyImage(const PPPixelBuffer *destinationImage,
+                                    int destinationX, int destinationY,
+                                    const PPPixelBuffer *sourceImage,
+                                    const PPPixelBuffer *mask,
+                                    PPPixelRect sourceRect)
+{
+    unsigned char *destinationRow, *sourceRow, *maskRow;
+    int rowCounter, col;
+    PPImageBitmapPixel *destinationPixel, *sourcePixel;
+    PPMaskBitmapPixel *maskPixel;
+
+    if (!destinationImage || !destinationImage->data || !sourceImage || !sourceImage->data
+        || !mask || !mask->data || PPPixelRect_IsEmpty(sourceRect))
+    {
+        return;
+    }
+
+    destinationRow = macroPixelBufferRowAtPoint(destinationImage, destinationX, destinationY,
+                                                PPImageBitmapPixel);
+    sourceRow = macroPixelBufferRowAtPoint(sourceImage, sourceRect.x, sourceRect.y,
+                                            PPImageBitmapPixel);
+    maskRow = macroPixelBufferRowAtPoint(mask, sourceRect.x, sourceRect.y, PPMaskBitmapPixel);
+    rowCounter = sourceRect.height;
+
+    while (rowCounter--)
+    {
+        destinationPixel = (PPImageBitmapPixel *) destinationRow;
+        sourcePixel = (PPImageBitmapPixel *) sourceRow;
+        maskPixel = (PPMaskBitmapPixel *) maskRow;
+
+        for (col=0; col<sourceRect.width; col++)
+        {
+            if (maskPixel[col])
+            {
+                destinationPixel[col] = sourcePixel[col];
+            }
+        }
+
+        destinationRow += destinationImage->bytesPerRow;
+        sourceRow += sourceImage->bytesPerRow;
+        maskRow += mask->bytesPerRow;
+    }
+}
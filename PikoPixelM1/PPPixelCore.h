@@ -0,0 +1,124 @@
+/*
+    PPPixelCore.h
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// PPPixelCore: The mask & masked-image kernels of the bitmap utilities
+// (NSBitmapImageRep_PPUtilities_MaskBitmaps & _ImageBitmaps), as plain C functions on pixel
+// buffers, with no AppKit or Foundation dependencies (the bitmap categories' methods for these
+// kernels are thin wrappers that pass in their bitmapData). The other bitmap utilities' pixel
+// loops (blending, scaling, linear conversion, etc.) haven't been moved here.
+//
+// Buffer coordinates are top-down (row 0 is the first row of data), unlike the bottom-up
+// coordinates of NSRect bitmap bounds; rects passed to the functions must already be clipped
+// to the buffers' dimensions, & buffers passed together must have the same dimensions.
+
+#ifndef _PPPIXELCORE_H_
+#define _PPPIXELCORE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "PPBitmapPixelTypes.h"
+
+
+typedef struct
+{
+    unsigned char *data;
+    int width;
+    int height;
+    int bytesPerRow;
+
+} PPPixelBuffer;
+
+typedef struct
+{
+    int x;
+    int y;
+    int width;
+    int height;
+
+} PPPixelRect;
+
+
+static inline PPPixelRect PPPixelRect_Make(int x, int y, int width, int height)
+{
+    PPPixelRect rect = {x, y, width, height};
+
+    return rect;
+}
+
+static inline PPPixelRect PPPixelBuffer_Frame(const PPPixelBuffer *buffer)
+{
+    return PPPixelRect_Make(0, 0, buffer->width, buffer->height);
+}
+
+static inline bool PPPixelRect_IsEmpty(PPPixelRect rect)
+{
+    return ((rect.width <= 0) || (rect.height <= 0)) ? true : false;
+}
+
+
+// Mask buffers (PPMaskBitmapPixel)
+
+// returnedBounds is set to an empty rect if none of the pixels in rect are nonzero
+void PPPixelCore_GetMaskBoundsInRect(const PPPixelBuffer *mask, PPPixelRect rect,
+                                        PPPixelRect *returnedBounds);
+
+bool PPPixelCore_MaskHasNonzeroPixelsInRect(const PPPixelBuffer *mask, PPPixelRect rect);
+bool PPPixelCore_MaskCoversAllPixelsInRect(const PPPixelBuffer *mask, PPPixelRect rect);
+
+void PPPixelCore_FillMaskInRect(const PPPixelBuffer *mask, PPPixelRect rect,
+                                PPMaskBitmapPixel pixelValue);
+
+void PPPixelCore_IntersectMaskWithMaskInRect(const PPPixelBuffer *destinationMask,
+                                                const PPPixelBuffer *mask, PPPixelRect rect);
+void PPPixelCore_SubtractMaskFromMaskInRect(const PPPixelBuffer *destinationMask,
+                                            const PPPixelBuffer *mask, PPPixelRect rect);
+void PPPixelCore_MergeMaskWithMaskInRect(const PPPixelBuffer *destinationMask,
+                                            const PPPixelBuffer *mask, PPPixelRect rect);
+
+void PPPixelCore_InvertMaskInRect(const PPPixelBuffer *mask, PPPixelRect rect);
+void PPPixelCore_ThresholdMaskInRect(const PPPixelBuffer *mask, PPPixelRect rect);
+
+
+// Image buffers (PPImageBitmapPixel)
+
+bool PPPixelCore_ImageHasTransparentPixelsInRect(const PPPixelBuffer *image,
+                                                    PPPixelRect rect);
+bool PPPixelCore_ImageIsClearInRect(const PPPixelBuffer *image, PPPixelRect rect);
+
+// mask must have the same dimensions as image
+void PPPixelCore_MaskedFillImageInRect(const PPPixelBuffer *image,
+                                        const PPPixelBuffer *mask,
+                                        PPPixelRect rect,
+                                        PPImageBitmapPixel fillPixelValue);
+
+// copies the source pixels in sourceRect that are covered by mask (same dimensions as source)
+// to destination's pixels at (destinationX, destinationY); the copied area must be within
+// destination's dimensions
+void PPPixelCore_MaskedCopyImage(const PPPixelBuffer *destinationImage,
+                                    int destinationX, int destinationY,
+                                    const PPPixelBuffer *sourceImage,
+                                    const PPPixelBuffer *mask,
+                                    PPPixelRect sourceRect);
+
+#endif  // _PPPIXELCORE_H_
@@ -0,0 +1,67 @@
+/*
+    PPPooledBitmapImageRep.h
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// PPPooledBitmapImageRep: Bitmap whose pixel buffer comes from a pool of recycled buffers.
+//
+// Pool buffers are grouped in size classes (8 classes per power of two, so a buffer's at most
+// 12.5% larger than requested); when a pooled bitmap deallocates, its buffer goes back on its
+// size class's free list for reuse by the next bitmap of a similar size, instead of being
+// returned to the system & faulted in again. Buffers smaller than a size class's minimum (or
+// larger than its maximum) aren't pooled.
+//
+// Idle pool buffers are capped in total size, & are registered with the cache registry
+// (PPCacheRegistry), which frees them when the caches are over budget or the system is low on
+// memory.
+//
+// Uncleared pooled bitmaps skip zero-filling the buffer, so their contents are undefined - the
+// caller must overwrite every pixel. Copies of a pooled bitmap are regular (unpooled) bitmaps.
+//
+// Pooling's only for short-lived scratch bitmaps that are never drawn: a drawn bitmap's bytes
+// may still be referenced by a cached CGImage after the bitmap deallocates (& are recycled),
+// and a long-lived bitmap would waste its buffer's size-class rounding.
+//
+// Pooled bitmaps can be allocated & deallocated on any thread.
+
+#import <Cocoa/Cocoa.h>
+
+
+@interface PPPooledBitmapImageRep : NSBitmapImageRep
+{
+    unsigned char *_pooledBuffer;
+    size_t _pooledBufferCapacity;
+}
+
++ (NSBitmapImageRep *) pooledBitmapWithPixelsWide: (int) pixelsWide
+                        pixelsHigh: (int) pixelsHigh
+                        bitsPerSample: (int) bitsPerSample
+                        samplesPerPixel: (int) samplesPerPixel
+                        hasAlpha: (bool) hasAlpha
+                        colorSpaceName: (NSString *) colorSpaceName
+                        shouldClear: (bool) shouldClear;
+
++ (size_t) idlePoolBuffersMemorySize;
+
++ (void) freeIdlePoolBuffers;
+
+@end
@@ -0,0 +1,417 @@
+/*
+    PPPooledBitmapImageRep.m
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#import "PPPooledBitmapImageRep.h"
+
+#import <pthread.h>
+#import "NSBitmapImageRep_PPUtilities.h"
+#import "PPCacheRegistry.h"
+#import "PPAppBootUtilities.h"
+#import "PPStartupTimeline.h"
+
+
+// size classes: kNumSizeClassSubdivisions classes per power of two, from
+// 2^kMinPooledBufferSizeLog2 to 2^kMaxPooledBufferSizeLog2 bytes
+
+#define kMinPooledBufferSizeLog2            16      // 64 KB
+#define kMaxPooledBufferSizeLog2            30      // 1 GB
+
+#define kNumSizeClassSubdivisionsLog2       3
+#define kNumSizeClassSubdivisions           (1 << kNumSizeClassSubdivisionsLog2)
+
+#define kNumSizeClasses                                                                 \
+            ((kMaxPooledBufferSizeLog2 - kMinPooledBufferSizeLog2)                      \
+                * kNumSizeClassSubdivisions + 1)
+
+#define kMinPooledBufferSize                ((size_t) 1 << kMinPooledBufferSizeLog2)
+#define kMaxPooledBufferSize                ((size_t) 1 << kMaxPooledBufferSizeLog2)
+
+#define kMaxIdlePoolBuffersMemorySize       ((size_t) 128 * 1024 * 1024)
+
+
+// free lists are singly-linked through the first bytes of each idle buffer
+
+typedef struct PPIdlePoolBuffer
+{
+    struct PPIdlePoolBuffer *nextIdleBuffer;
+
+} PPIdlePoolBuffer;
+
+
+static pthread_mutex_t gPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+static PPIdlePoolBuffer *gIdleBufferLists[kNumSizeClasses];
+static size_t gIdleBuffersMemorySize = 0;
+
+static PPCacheRegistryEntry *gPoolCacheRegistryEntry = nil;
+
+
+static int SizeClassIndexForNumBytes(size_t numBytes, size_t *returnedCapacity);
+static unsigned char *AllocatePoolBuffer(size_t numBytes, bool shouldClear,
+                                            size_t *returnedCapacity);
+static void RecyclePoolBuffer(unsigned char *buffer, size_t capacity);
+
+
+@interface PPPooledBitmapImageRep (PrivateMethods)
+
+- initWithPooledBuffer: (unsigned char *) pooledBuffer
+    pooledBufferCapacity: (size_t) pooledBufferCapacity
+    pixelsWide: (int) pixelsWide
+    pixelsHigh: (int) pixelsHigh
+    bitsPerSample: (int) bitsPerSample
+    samplesPerPixel: (int) samplesPerPixel
+    hasAlpha: (bool) hasAlpha
+    colorSpaceName: (NSString *) colorSpaceName
+    bytesPerRow: (int) bytesPerRow;
+
++ (size_t) memorySizeOfCacheForCacheRegistryEntry: (PPCacheRegistryEntry *) entry;
++ (bool) evictCacheForCacheRegistryEntry: (PPCacheRegistryEntry *) entry;
+
+@end
+
+@implementation NSObject (PPPooledBitmapImageRep)
+
++ (void) ppPooledBitmapImageRep_SetupGlobals
+{
+    // registry isn't thread-safe, so the entry's only created & noted on the main thread
+
+    gPoolCacheRegistryEntry =
+        [[[PPCacheRegistry sharedRegistry]
+                                addEntryForClient: (id) [PPPooledBitmapImageRep class]
+                                rebuildCost: kPPCacheRebuildCost_Low]
+                        retain];
+}
+
++ (void) load
+{
+    macroStartupTimelineMethodScope();
+
+    macroPerformNSObjectSelectorAfterAppLoads(ppPooledBitmapImageRep_SetupGlobals);
+}
+
+@end
+
+@implementation PPPooledBitmapImageRep
+
++ (NSBitmapImageRep *) pooledBitmapWithPixelsWide: (int) pixelsWide
+                        pixelsHigh: (int) pixelsHigh
+                        bitsPerSample: (int) bitsPerSample
+                        samplesPerPixel: (int) samplesPerPixel
+                        hasAlpha: (bool) hasAlpha
+                        colorSpaceName: (NSString *) colorSpaceName
+                        shouldClear: (bool) shouldClear
+{
+    int bytesPerRow;
+    unsigned char *pooledBuffer;
+    size_t pooledBufferCapacity;
+    PPPooledBitmapImageRep *pooledBitmap;
+
+    if ((pixelsWide <= 0) || (pixelsHigh <= 0) || (bitsPerSample <= 0)
+        || (samplesPerPixel <= 0))
+    {
+        goto ERROR;
+    }
+
+    bytesPerRow = pixelsWide * ((bitsPerSample * samplesPerPixel + 7) / 8);
+
+    pooledBuffer = AllocatePoolBuffer((size_t) bytesPerRow * (size_t) pixelsHigh, shouldClear,
+                                        &pooledBufferCapacity);
+
+    if (!pooledBuffer)
+        goto ERROR;
+
+    // on failure, the initializer recycles the buffer
+
+    pooledBitmap = [[[self alloc] initWithPooledBuffer: pooledBuffer
+                                    pooledBufferCapacity: pooledBufferCapacity
+                                    pixelsWide: pixelsWide
+                                    pixelsHigh: pixelsHigh
+                                    bitsPerSample: bitsPerSample
+                                    samplesPerPixel: samplesPerPixel
+                                    hasAlpha: hasAlpha
+                                    colorSpaceName: colorSpaceName
+                                    bytesPerRow: bytesPerRow]
+                                autorelease];
+
+    if (!pooledBitmap)
+        goto ERROR;
+
+    if ([NSThread isMainThread])
+    {
+        [gPoolCacheRegistryEntry noteUse];
+    }
+
+    return pooledBitmap;
+
+ERROR:
+    return nil;
+}
+
++ (size_t) idlePoolBuffersMemorySize
+{
+    size_t idleBuffersMemorySize;
+
+    pthread_mutex_lock(&gPoolMutex);
+
+    idleBuffersMemorySize = gIdleBuffersMemorySize;
+
+    pthread_mutex_unlock(&gPoolMutex);
+
+    return idleBuffersMemorySize;
+}
+
++ (void) freeIdlePoolBuffers
+{
+    PPIdlePoolBuffer *idleBufferLists[kNumSizeClasses], *idleBuffer, *nextIdleBuffer;
+    int classIndex;
+
+    // detach the free lists while locked, free the buffers after unlocking
+
+    pthread_mutex_lock(&gPoolMutex);
+
+    memcpy(idleBufferLists, gIdleBufferLists, sizeof(gIdleBufferLists));
+    memset(gIdleBufferLists, 0, sizeof(gIdleBufferLists));
+
+    gIdleBuffersMemorySize = 0;
+
+    pthread_mutex_unlock(&gPoolMutex);
+
+    for (classIndex=0; classIndex<kNumSizeClasses; classIndex++)
+    {
+        idleBuffer = idleBufferLists[classIndex];
+
+        while (idleBuffer)
+        {
+            nextIdleBuffer = idleBuffer->nextIdleBuffer;
+
+            free(idleBuffer);
+
+            idleBuffer = nextIdleBuffer;
+        }
+    }
+}
+
+- (void) dealloc
+{
+    unsigned char *pooledBuffer = _pooledBuffer;
+    size_t pooledBufferCapacity = _pooledBufferCapacity;
+
+    // the superclass doesn't own the buffer, so it's not recycled until after the superclass
+    // is finished with it
+
+    [super dealloc];
+
+    RecyclePoolBuffer(pooledBuffer, pooledBufferCapacity);
+
+    if (pooledBuffer && [NSThread isMainThread])
+    {
+        [gPoolCacheRegistryEntry noteGrowth];
+    }
+}
+
+#pragma mark NSCopying protocol
+
+- (id) copyWithZone: (NSZone *) zone
+{
+    // the superclass' copy may share the pixel buffer, which would outlive this bitmap, so
+    // copies get their own (unpooled) buffer
+
+    return [[self ppBitmapCroppedToBounds: [self ppFrameInPixels]] retain];
+}
+
+#pragma mark NSCoding overrides
+
+- (Class) classForCoder
+{
+    return [NSBitmapImageRep class];
+}
+
+- (Class) classForKeyedArchiver
+{
+    return [NSBitmapImageRep class];
+}
+
+#pragma mark Private methods
+
+- initWithPooledBuffer: (unsigned char *) pooledBuffer
+    pooledBufferCapacity: (size_t) pooledBufferCapacity
+    pixelsWide: (int) pixelsWide
+    pixelsHigh: (int) pixelsHigh
+    bitsPerSample: (int) bitsPerSample
+    samplesPerPixel: (int) samplesPerPixel
+    hasAlpha: (bool) hasAlpha
+    colorSpaceName: (NSString *) colorSpaceName
+    bytesPerRow: (int) bytesPerRow
+{
+    self = [super initWithBitmapDataPlanes: &pooledBuffer
+                    pixelsWide: pixelsWide
+                    pixelsHigh: pixelsHigh
+                    bitsPerSample: bitsPerSample
+                    samplesPerPixel: samplesPerPixel
+                    hasAlpha: hasAlpha
+                    isPlanar: NO
+                    colorSpaceName: colorSpaceName
+                    bytesPerRow: bytesPerRow
+                    bitsPerPixel: 0];
+
+    if (!self)
+        goto ERROR;
+
+    _pooledBuffer = pooledBuffer;
+    _pooledBufferCapacity = pooledBufferCapacity;
+
+    return self;
+
+ERROR:
+    RecyclePoolBuffer(pooledBuffer, pooledBufferCapacity);
+
+    return nil;
+}
+
++ (size_t) memorySizeOfCacheForCacheRegistryEntry: (PPCacheRegistryEntry *) entry
+{
+    return [self idlePoolBuffersMemorySize];
+}
+
++ (bool) evictCacheForCacheRegistryEntry: (PPCacheRegistryEntry *) entry
+{
+    [self freeIdlePoolBuffers];
+
+    return YES;
+}
+
+@end
+
+#pragma mark Private functions
+
+// returns -1 if numBytes is outside the pooled size range (returnedCapacity is then numBytes)
+
+static int SizeClassIndexForNumBytes(size_t numBytes, size_t *returnedCapacity)
+{
+    int sizeLog2;
+    size_t classStepSize, capacity;
+
+    if ((numBytes < kMinPooledBufferSize) || (numBytes > kMaxPooledBufferSize))
+    {
+        *returnedCapacity = numBytes;
+
+        return -1;
+    }
+
+    sizeLog2 = (sizeof(unsigned long long) * 8 - 1)
+                    - __builtin_clzll((unsigned long long) numBytes);
+
+    classStepSize = (size_t) 1 << (sizeLog2 - kNumSizeClassSubdivisionsLog2);
+
+    capacity = (numBytes + classStepSize - 1) & ~(classStepSize - 1);
+
+    *returnedCapacity = capacity;
+
+    // a capacity that rounded up to the next power of two gets that power's first class index
+
+    return (sizeLog2 - kMinPooledBufferSizeLog2) * kNumSizeClassSubdivisions
+            + (int) (capacity / classStepSize) - kNumSizeClassSubdivisions;
+}
+
+static unsigned char *AllocatePoolBuffer(size_t numBytes, bool shouldClear,
+                                            size_t *returnedCapacity)
+{
+    int classIndex;
+    size_t capacity;
+    PPIdlePoolBuffer *idleBuffer = NULL;
+
+    if (!numBytes || !returnedCapacity)
+    {
+        return NULL;
+    }
+
+    classIndex = SizeClassIndexForNumBytes(numBytes, &capacity);
+
+    if (classIndex >= 0)
+    {
+        pthread_mutex_lock(&gPoolMutex);
+
+        idleBuffer = gIdleBufferLists[classIndex];
+
+        if (idleBuffer)
+        {
+            gIdleBufferLists[classIndex] = idleBuffer->nextIdleBuffer;
+            gIdleBuffersMemorySize -= capacity;
+        }
+
+        pthread_mutex_unlock(&gPoolMutex);
+    }
+
+    *returnedCapacity = capacity;
+
+    if (idleBuffer)
+    {
+        if (shouldClear)
+        {
+            memset(idleBuffer, 0, numBytes);
+        }
+
+        return (unsigned char *) idleBuffer;
+    }
+
+    // new buffers: calloc's zero-filled pages are cheaper than clearing after malloc
+
+    return (unsigned char *) ((shouldClear) ? calloc(1, capacity) : malloc(capacity));
+}
+
+static void RecyclePoolBuffer(unsigned char *buffer, size_t capacity)
+{
+    int classIndex;
+    size_t classCapacity;
+    PPIdlePoolBuffer *idleBuffer;
+    bool didRecycleBuffer = NO;
+
+    if (!buffer)
+        return;
+
+    classIndex = SizeClassIndexForNumBytes(capacity, &classCapacity);
+
+    if ((classIndex >= 0) && (classCapacity == capacity))
+    {
+        pthread_mutex_lock(&gPoolMutex);
+
+        if (gIdleBuffersMemorySize + capacity <= kMaxIdlePoolBuffersMemorySize)
+        {
+            idleBuffer = (PPIdlePoolBuffer *) buffer;
+
+            idleBuffer->nextIdleBuffer = gIdleBufferLists[classIndex];
+            gIdleBufferLists[classIndex] = idleBuffer;
+
+            gIdleBuffersMemorySize += capacity;
+
+            didRecycleBuffer = YES;
+        }
+
+        pthread_mutex_unlock(&gPoolMutex);
+    }
+
+    if (!didRecycleBuffer)
+    {
+        free(buffer);
+    }
+}
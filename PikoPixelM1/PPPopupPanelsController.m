@@ -30,6 +30,7 @@
 #import "PPSamplerImagePopupPanelController.h"
 #import "PPLayerControlsPopupPanelController.h"
 #import "PPHotkeys.h"
+#import "PPStartupTimeline.h"
 
 
 static NSDictionary *gHotkeyToPopupPanelTypeMapping = nil;
@@ -55,6 +56,8 @@ static NSArray *PopupControllersArray(void);
 
 + (void) initialize
 {
+    macroStartupTimelineMethodScope();
+
     if ([self class] != [PPPopupPanelsController class])
     {
         return;
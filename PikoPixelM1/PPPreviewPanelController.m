@@ -29,6 +29,7 @@
 #import "PPDocumentWindowController.h"
 #import "PPPanelDefaultFramePinnings.h"
 #import "PPGeometry.h"
+#import "PPDocumentUpdateBus.h"
 
 
 #define kPreviewPanelNibName                            @"PreviewPanel"
@@ -46,16 +47,6 @@ typedef enum
 
 @interface PPPreviewPanelController (PrivateMethods)
 
-- (void) handlePPDocumentNotification_UpdatedMergedVisibleArea:
-                                                            (NSNotification *) notification;
-- (void) handlePPDocumentNotification_UpdatedDrawingLayerArea: (NSNotification *) notification;
-
-- (void) handlePPDocumentNotification_UpdatedMergedVisibleThumbnailImage:
-                                                                (NSNotification *) notification;
-
-- (void) handlePPDocumentNotification_UpdatedDrawingLayerThumbnailImage:
-                                                                (NSNotification *) notification;
-
 - (void) setupPreviewImage;
 
 - (void) clearPreviewImage;
@@ -100,18 +91,8 @@ typedef enum
     if (!_ppDocument)
         return;
 
-    [notificationCenter
-                addObserver: self
-                selector: @selector(handlePPDocumentNotification_UpdatedMergedVisibleArea:)
-                name: PPDocumentNotification_UpdatedMergedVisibleArea
-                object: _ppDocument];
-
-    [notificationCenter
-                addObserver: self
-                selector:
-                    @selector(handlePPDocumentNotification_UpdatedMergedVisibleThumbnailImage:)
-                name: PPDocumentNotification_UpdatedMergedVisibleThumbnailImage
-                object: _ppDocument];
+    [[_ppDocument updateBus] addUpdateObserver: self
+                                deliveryMode: kPPDocumentUpdateDeliveryMode_Coalesced];
 
     [notificationCenter
                 addObserver: self
@@ -122,19 +103,11 @@ typedef enum
 
 - (void) removeAsObserverForPPDocumentNotifications
 {
-    NSNotificationCenter *notificationCenter = [NSNotificationCenter defaultCenter];
-
-    [notificationCenter removeObserver: self
-                        name: PPDocumentNotification_UpdatedMergedVisibleArea
-                        object: _ppDocument];
+    [[_ppDocument updateBus] removeUpdateObserver: self];
 
-    [notificationCenter removeObserver: self
-                        name: PPDocumentNotification_UpdatedMergedVisibleThumbnailImage
-                        object: _ppDocument];
-
-    [notificationCenter removeObserver: self
-                        name: PPDocumentNotification_ReloadedDocument
-                        object: _ppDocument];
+    [[NSNotificationCenter defaultCenter] removeObserver: self
+                                            name: PPDocumentNotification_ReloadedDocument
+                                            object: _ppDocument];
 }
 
 - (bool) defaultPanelEnabledState
@@ -193,9 +166,10 @@ typedef enum
     [self forceWindowTitleRedisplay];
 }
 
-#pragma mark PPDocument notifications
+#pragma mark PPDocumentUpdateObserver methods
 
-- (void) handlePPDocumentNotification_UpdatedMergedVisibleArea: (NSNotification *) notification
+- (void) ppDocument: (PPDocument *) ppDocument
+            updatedMergedVisibleAreaInRect: (NSRect) updateRect
 {
     if (_previewImageUpdateMode == kPPPreviewImageUpdateMode_ThumbnailUpdatesOnly)
     {
@@ -204,15 +178,7 @@ typedef enum
 
     if ([self panelIsVisible])
     {
-        NSValue *updateAreaRectValue =
-                    [[notification userInfo]
-                                    objectForKey:
-                                            PPDocumentNotification_UserInfoKey_UpdateAreaRect];
-
-        if (updateAreaRectValue)
-        {
-            [_previewView handleUpdateToImageInRect: [updateAreaRectValue rectValue]];
-        }
+        [_previewView handleUpdateToImageInRect: updateRect];
     }
     else
     {
@@ -220,8 +186,7 @@ typedef enum
     }
 }
 
-- (void) handlePPDocumentNotification_UpdatedMergedVisibleThumbnailImage:
-                                                                (NSNotification *) notification
+- (void) ppDocumentUpdatedMergedVisibleThumbnailImage: (PPDocument *) ppDocument
 {
     if (_previewImageUpdateMode != kPPPreviewImageUpdateMode_ThumbnailUpdatesOnly)
     {
@@ -238,6 +203,8 @@ typedef enum
     }
 }
 
+#pragma mark PPDocument notifications
+
 - (void) handlePPDocumentNotification_ReloadedDocument: (NSNotification *) notification
 {
     // the document's thumbnail image may remain the same object, and -[PPPreviewView setImage:]
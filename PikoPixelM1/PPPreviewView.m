@@ -28,6 +28,7 @@
 #import "PPGeometry.h"
 #import "PPResizableDirectionsMasks.h"
 #import "NSObject_PPUtilities.h"
+#import "PPStartupTimeline.h"
 
 
 #define kMaxPreviewScale                        12
@@ -74,6 +75,8 @@ static NSColor *gLightCheckerboardColor = nil, *gDarkCheckerboardColor = nil;
 
 + (void) initialize
 {
+    macroStartupTimelineMethodScope();
+
     if ([self class] != [PPPreviewView class])
     {
         return;
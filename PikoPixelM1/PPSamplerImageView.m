@@ -32,6 +32,7 @@
 #import "PPCursorManager.h"
 #import "NSColor_PPUtilities.h"
 #import "NSBitmapImageRep_PPUtilities.h"
+#import "PPStartupTimeline.h"
 
 
 #define kMinAllowedValueForMinViewDimension         30
@@ -83,6 +84,8 @@ static NSColor *gSamplerBackgroundColor = nil;
 
 + (void) initialize
 {
+    macroStartupTimelineMethodScope();
+
     if ([self class] != [PPSamplerImageView class])
     {
         return;
@@ -0,0 +1,230 @@
+/*
+    PPStartupTimeline.c
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PPStartupTimeline.h"
+
+#if PP_OPTIONAL__BUILD_WITH_STARTUP_TIMELINE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __APPLE__
+#   include <mach/mach_time.h>
+#else
+#   include <time.h>
+#endif
+
+
+#define kMaxNumTimelineEvents                       1024
+
+
+typedef struct
+{
+    const char *name;
+    uint64_t startTime;
+    uint64_t endTime;
+    int depth;
+
+} PPStartupTimelineEvent;
+
+
+static PPStartupTimelineEvent gTimelineEvents[kMaxNumTimelineEvents];
+
+// incremented atomically (+initialize can run on any thread); may exceed the array's capacity
+static int gNumTimelineEvents = 0;
+
+static uint64_t gTimelineStartTime = 0;
+
+static __thread int gCurrentThreadScopeDepth = 0;
+
+
+static uint64_t CurrentTimelineTime(void);
+static double MillisecondsFromTimelineTime(uint64_t timelineTime);
+static int CompareTimelineEventsByStartTime(const void *event1, const void *event2);
+
+
+#pragma mark Public functions
+
+PPStartupTimelineScope PPStartupTimeline_BeginScope(const char *name)
+{
+    PPStartupTimelineScope scope;
+    uint64_t noStartTime = 0;
+
+    scope.name = name;
+    scope.startTime = CurrentTimelineTime();
+    scope.depth = gCurrentThreadScopeDepth++;
+
+    // the first scope to begin sets the timeline's start time
+
+    __atomic_compare_exchange_n(&gTimelineStartTime, &noStartTime, scope.startTime, false,
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+
+    return scope;
+}
+
+void PPStartupTimeline_EndScope(PPStartupTimelineScope *scope)
+{
+    uint64_t endTime = CurrentTimelineTime();
+    int eventIndex;
+    PPStartupTimelineEvent *event;
+
+    gCurrentThreadScopeDepth--;
+
+    if (!scope)
+        return;
+
+    eventIndex = __atomic_fetch_add(&gNumTimelineEvents, 1, __ATOMIC_RELAXED);
+
+    if (eventIndex >= kMaxNumTimelineEvents)
+        return;
+
+    event = &gTimelineEvents[eventIndex];
+
+    event->name = scope->name;
+    event->startTime = scope->startTime;
+    event->endTime = endTime;
+    event->depth = scope->depth;
+}
+
+void PPStartupTimeline_LogTimeline(void)
+{
+    int numEvents, numDroppedEvents, eventIndex;
+    PPStartupTimelineEvent *events;
+    double totalTopLevelDuration = 0;
+
+    numEvents = __atomic_load_n(&gNumTimelineEvents, __ATOMIC_RELAXED);
+
+    numDroppedEvents = 0;
+
+    if (numEvents > kMaxNumTimelineEvents)
+    {
+        numDroppedEvents = numEvents - kMaxNumTimelineEvents;
+        numEvents = kMaxNumTimelineEvents;
+    }
+
+    // events are stored in end order (nested scopes end first); sort a copy by start time
+
+    events = (PPStartupTimelineEvent *) malloc (numEvents * sizeof(PPStartupTimelineEvent));
+
+    if (!events && numEvents)
+        goto ERROR;
+
+    if (numEvents)
+    {
+        memcpy(events, gTimelineEvents, numEvents * sizeof(PPStartupTimelineEvent));
+
+        qsort(events, numEvents, sizeof(PPStartupTimelineEvent),
+                CompareTimelineEventsByStartTime);
+    }
+
+    fprintf(stderr, "Startup timeline (ms, from the first recorded event):\n");
+    fprintf(stderr, "%10s %10s  %s\n", "start", "duration", "name");
+
+    for (eventIndex=0; eventIndex<numEvents; eventIndex++)
+    {
+        PPStartupTimelineEvent *event = &events[eventIndex];
+        double duration = MillisecondsFromTimelineTime(event->endTime - event->startTime);
+
+        if (!event->depth)
+        {
+            totalTopLevelDuration += duration;
+        }
+
+        fprintf(stderr, "%10.3f %10.3f  %*s%s\n",
+                MillisecondsFromTimelineTime(event->startTime - gTimelineStartTime),
+                duration, 2 * event->depth, "", event->name);
+    }
+
+    fprintf(stderr, "Total (top-level events): %.3f ms\n", totalTopLevelDuration);
+
+    if (numDroppedEvents)
+    {
+        fprintf(stderr, "(%d events dropped - increase kMaxNumTimelineEvents in "
+                        "PPStartupTimeline.c)\n", numDroppedEvents);
+    }
+
+    if (events)
+    {
+        free(events);
+    }
+
+    return;
+
+ERROR:
+    return;
+}
+
+#pragma mark Private functions
+
+static uint64_t CurrentTimelineTime(void)
+{
+#ifdef __APPLE__
+    return mach_absolute_time();
+#else
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t) time.tv_sec * 1000000000ull + (uint64_t) time.tv_nsec;
+#endif
+}
+
+static double MillisecondsFromTimelineTime(uint64_t timelineTime)
+{
+#ifdef __APPLE__
+    static double nanosecondsPerTimelineTimeUnit = 0;
+
+    if (!nanosecondsPerTimelineTimeUnit)
+    {
+        mach_timebase_info_data_t timebaseInfo;
+
+        mach_timebase_info(&timebaseInfo);
+
+        nanosecondsPerTimelineTimeUnit = (double) timebaseInfo.numer / timebaseInfo.denom;
+    }
+
+    return timelineTime * nanosecondsPerTimelineTimeUnit / 1000000.0;
+#else
+    return timelineTime / 1000000.0;
+#endif
+}
+
+static int CompareTimelineEventsByStartTime(const void *event1, const void *event2)
+{
+    uint64_t startTime1 = ((const PPStartupTimelineEvent *) event1)->startTime,
+                startTime2 = ((const PPStartupTimelineEvent *) event2)->startTime;
+
+    // equal start times (low-resolution clocks): outer (shallower) scopes first
+
+    if (startTime1 == startTime2)
+    {
+        return ((const PPStartupTimelineEvent *) event1)->depth
+                - ((const PPStartupTimelineEvent *) event2)->depth;
+    }
+
+    return (startTime1 < startTime2) ? -1 : 1;
+}
+
+#endif  // PP_OPTIONAL__BUILD_WITH_STARTUP_TIMELINE
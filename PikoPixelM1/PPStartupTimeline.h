@@ -0,0 +1,94 @@
+/*
+    PPStartupTimeline.h
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// PPStartupTimeline: Timing of the app's launch-time work - every +load & +initialize method,
+// each setup selector deferred until the app loads (PPAppBootUtilities), & the app's
+// finishLaunching. Built only with PP_OPTIONAL__ENABLE_STARTUP_TIMELINE (otherwise the
+// timeline macros expand to nothing).
+//
+// Timeline scopes record their start & end times when they go out of scope, into a fixed-size
+// array (events past its capacity are counted, but dropped). PPStartupTimeline_LogTimeline()
+// writes the recorded events to stderr, in start order & indented by nesting depth, with each
+// event's start time relative to the first recorded event.
+//
+// Scope names must be static strings - macroStartupTimelineMethodScope() uses __func__, which
+// for ObjC methods is the method's full name, e.g. "+[PPHotkeys initialize]".
+
+#ifndef _PPSTARTUPTIMELINE_H_
+#define _PPSTARTUPTIMELINE_H_
+
+// PPOptional.h's flags are true/false, so stdbool.h is needed for C sources
+#include <stdbool.h>
+#include "PPOptional.h"
+
+
+#if PP_OPTIONAL__BUILD_WITH_STARTUP_TIMELINE
+
+#   include <stdint.h>
+
+
+typedef struct
+{
+    const char *name;
+    uint64_t startTime;
+    int depth;
+
+} PPStartupTimelineScope;
+
+
+PPStartupTimelineScope PPStartupTimeline_BeginScope(const char *name);
+void PPStartupTimeline_EndScope(PPStartupTimelineScope *scope);
+
+void PPStartupTimeline_LogTimeline(void);
+
+
+#   define macroStartupTimelineScope(name)                                                  \
+                macroStartupTimelineScope_Declare(name, __LINE__)
+
+#   define macroStartupTimelineMethodScope()                                                \
+                macroStartupTimelineScope(__func__)
+
+    // same declaration scheme as PPTrace.h's trace scopes: the variable name includes the
+    // line number (the extra DeclareWithLine level lets __LINE__ expand before it's pasted),
+    // & the scope should be placed before any goto statements in its block
+
+#   define macroStartupTimelineScope_Declare(name, line)                                    \
+                macroStartupTimelineScope_DeclareWithLine(name, line)
+
+#   define macroStartupTimelineScope_DeclareWithLine(name, line)                            \
+                macroStartupTimelineScope_DeclareVariable(name, ppStartupTimelineScope_##line)
+
+#   define macroStartupTimelineScope_DeclareVariable(name, variableName)                    \
+                PPStartupTimelineScope variableName                                         \
+                    __attribute__((cleanup(PPStartupTimeline_EndScope)))                    \
+                        = PPStartupTimeline_BeginScope(name)
+
+#else   // !PP_OPTIONAL__BUILD_WITH_STARTUP_TIMELINE
+
+#   define macroStartupTimelineScope(name)
+#   define macroStartupTimelineMethodScope()
+
+#endif  // PP_OPTIONAL__BUILD_WITH_STARTUP_TIMELINE
+
+#endif  // _PPSTARTUPTIMELINE_H_
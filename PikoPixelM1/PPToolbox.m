@@ -38,6 +38,7 @@
 #import "PPMagnifierTool.h"
 #import "PPColorRampTool.h"
 #import "PPHotkeys.h"
+#import "PPStartupTimeline.h"
 
 
 static NSDictionary *gHotkeyToToolTypeMapping = nil;
@@ -57,6 +58,8 @@ static NSDictionary *gHotkeyToToolTypeMapping = nil;
 
 + (void) initialize
 {
+    macroStartupTimelineMethodScope();
+
     if ([self class] != [PPToolbox class])
     {
         return;
@@ -31,6 +31,7 @@
 #import "PPHotkeyDisplayUtilities.h"
 #import "NSObject_PPUtilities.h"
 #import "PPPanelDefaultFramePinnings.h"
+#import "PPStartupTimeline.h"
 
 
 #define kToolsPanelNibName  @"ToolsPanel"
@@ -61,6 +62,8 @@ static NSString *UpdatedTooltipForTooltipAndDisplayKey(NSString *toolTip, NSStri
 
 + (void) initialize
 {
+    macroStartupTimelineMethodScope();
+
     if ([self class] != [PPToolsPanelController class])
     {
         return;
@@ -0,0 +1,264 @@
+/*
+    PPTrace.c
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PPTrace.h"
+
+#if PP_OPTIONAL__BUILD_WITH_HOT_PATH_TRACING
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#ifdef __APPLE__
+#   include <mach/mach_time.h>
+#else
+#   include <time.h>
+#endif
+
+
+#define kTraceThreadBufferNumEvents                 (1 << 14)  // power of 2
+
+
+typedef struct
+{
+    const char *name;
+    uint64_t startTime;
+    uint64_t endTime;
+
+} PPTraceEvent;
+
+typedef struct PPTraceThreadBuffer
+{
+    struct PPTraceThreadBuffer *nextBuffer;
+    uint64_t threadID;
+
+    // written only by the owning thread; read (with acquire ordering) when dumping
+    uint64_t numWrittenEvents;
+
+    PPTraceEvent events[kTraceThreadBufferNumEvents];
+
+} PPTraceThreadBuffer;
+
+
+// buffers are added to the list with a compare-and-swap & never removed (GCD reuses its
+// worker threads, so the number of buffers stays bounded by the number of threads)
+static PPTraceThreadBuffer *gTraceThreadBuffersList = NULL;
+
+static __thread PPTraceThreadBuffer *gCurrentThreadTraceBuffer = NULL;
+
+
+static PPTraceThreadBuffer *CurrentThreadTraceBuffer(void);
+static uint64_t CurrentTraceTime(void);
+static double MicrosecondsFromTraceTime(uint64_t traceTime);
+static void WriteJSONStringToFile(const char *string, FILE *file);
+
+
+#pragma mark Public functions
+
+PPTraceScope PPTrace_BeginScope(const char *name)
+{
+    PPTraceScope scope;
+
+    scope.name = name;
+    scope.startTime = CurrentTraceTime();
+
+    return scope;
+}
+
+void PPTrace_EndScope(PPTraceScope *scope)
+{
+    uint64_t endTime = CurrentTraceTime();
+    PPTraceThreadBuffer *buffer;
+    uint64_t eventIndex;
+    PPTraceEvent *event;
+
+    buffer = CurrentThreadTraceBuffer();
+
+    if (!buffer || !scope)
+        return;
+
+    eventIndex = buffer->numWrittenEvents;
+    event = &buffer->events[eventIndex & (kTraceThreadBufferNumEvents - 1)];
+
+    event->name = scope->name;
+    event->startTime = scope->startTime;
+    event->endTime = endTime;
+
+    __atomic_store_n(&buffer->numWrittenEvents, eventIndex + 1, __ATOMIC_RELEASE);
+}
+
+bool PPTrace_WriteChromeTraceFile(const char *filepath)
+{
+    FILE *file;
+    PPTraceThreadBuffer *buffer;
+    int processID;
+    bool isFirstEvent = true;
+
+    if (!filepath)
+        goto ERROR;
+
+    file = fopen(filepath, "w");
+
+    if (!file)
+        goto ERROR;
+
+    processID = (int) getpid();
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    buffer = __atomic_load_n(&gTraceThreadBuffersList, __ATOMIC_ACQUIRE);
+
+    while (buffer)
+    {
+        uint64_t numWrittenEvents, firstEventIndex, eventIndex;
+
+        numWrittenEvents = __atomic_load_n(&buffer->numWrittenEvents, __ATOMIC_ACQUIRE);
+
+        // skip the oldest slot, in case the owning thread is overwriting it
+        firstEventIndex = (numWrittenEvents >= kTraceThreadBufferNumEvents) ?
+                                numWrittenEvents - kTraceThreadBufferNumEvents + 1 : 0;
+
+        for (eventIndex=firstEventIndex; eventIndex<numWrittenEvents; eventIndex++)
+        {
+            PPTraceEvent event = buffer->events[eventIndex & (kTraceThreadBufferNumEvents - 1)];
+
+            if (!event.name || (event.endTime < event.startTime))
+            {
+                continue;
+            }
+
+            fprintf(file, "%s\n{\"name\":", (isFirstEvent) ? "" : ",");
+            WriteJSONStringToFile(event.name, file);
+            fprintf(file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%llu}",
+                    MicrosecondsFromTraceTime(event.startTime),
+                    MicrosecondsFromTraceTime(event.endTime - event.startTime),
+                    processID, (unsigned long long) buffer->threadID);
+
+            isFirstEvent = false;
+        }
+
+        buffer = buffer->nextBuffer;
+    }
+
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0)
+        goto ERROR;
+
+    return true;
+
+ERROR:
+    return false;
+}
+
+#pragma mark Private functions
+
+static PPTraceThreadBuffer *CurrentThreadTraceBuffer(void)
+{
+    PPTraceThreadBuffer *buffer = gCurrentThreadTraceBuffer;
+
+    if (buffer)
+        return buffer;
+
+    buffer = (PPTraceThreadBuffer *) calloc(1, sizeof(PPTraceThreadBuffer));
+
+    if (!buffer)
+        return NULL;
+
+#ifdef __APPLE__
+    pthread_threadid_np(NULL, &buffer->threadID);
+#else
+    buffer->threadID = (uint64_t) (uintptr_t) pthread_self();
+#endif
+
+    buffer->nextBuffer = __atomic_load_n(&gTraceThreadBuffersList, __ATOMIC_RELAXED);
+
+    while (!__atomic_compare_exchange_n(&gTraceThreadBuffersList, &buffer->nextBuffer,
+                                        buffer, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    {
+    }
+
+    gCurrentThreadTraceBuffer = buffer;
+
+    return buffer;
+}
+
+static uint64_t CurrentTraceTime(void)
+{
+#ifdef __APPLE__
+    return mach_absolute_time();
+#else
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t) time.tv_sec * 1000000000ull + (uint64_t) time.tv_nsec;
+#endif
+}
+
+static double MicrosecondsFromTraceTime(uint64_t traceTime)
+{
+#ifdef __APPLE__
+    static double nanosecondsPerTraceTimeUnit = 0;
+
+    if (!nanosecondsPerTraceTimeUnit)
+    {
+        mach_timebase_info_data_t timebaseInfo;
+
+        mach_timebase_info(&timebaseInfo);
+
+        nanosecondsPerTraceTimeUnit = (double) timebaseInfo.numer / timebaseInfo.denom;
+    }
+
+    return traceTime * nanosecondsPerTraceTimeUnit / 1000.0;
+#else
+    return traceTime / 1000.0;
+#endif
+}
+
+static void WriteJSONStringToFile(const char *string, FILE *file)
+{
+    fputc('"', file);
+
+    while (*string)
+    {
+        if ((*string == '"') || (*string == '\\'))
+        {
+            fputc('\\', file);
+        }
+
+        if ((unsigned char) *string >= 0x20)
+        {
+            fputc(*string, file);
+        }
+
+        string++;
+    }
+
+    fputc('"', file);
+}
+
+#endif  // PP_OPTIONAL__BUILD_WITH_HOT_PATH_TRACING
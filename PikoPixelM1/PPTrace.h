@@ -0,0 +1,94 @@
+/*
+    PPTrace.h
+
+    Copyright 2013-2018 Josh Freeman
+    http://www.twilightedge.com
+
+    This file is part of PikoPixel for Mac OS X and GNUstep.
+    PikoPixel is a graphical application for drawing & editing pixel-art images.
+
+    PikoPixel is free software: you can redistribute it and/or modify it under
+    the terms of the GNU Affero General Public License as published by the
+    Free Software Foundation, either version 3 of the License, or (at your
+    option) any later version approved for PikoPixel by its copyright holder (or
+    an authorized proxy).
+
+    PikoPixel is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+    details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// PPTrace: Scoped timing trace points for the document & canvas update paths and the bitmap
+// kernels. Built only with PP_OPTIONAL__ENABLE_HOT_PATH_TRACING (otherwise the trace macros
+// expand to nothing).
+//
+// A trace scope records its start & end times when it goes out of scope; events are written
+// to a fixed-size ring buffer owned by the recording thread (no locks or atomic read-modify-
+// writes on the recording path), so only each thread's most recent events are kept.
+// PPTrace_WriteChromeTraceFile() dumps the buffers in Chrome trace-event JSON format (viewable
+// in chrome://tracing or Perfetto); events being written while the buffers are dumped may be
+// skipped.
+//
+// Scope names must be static strings - macroTraceMethodScope() uses __func__, which for ObjC
+// methods is the method's full name, e.g. "-[PPCanvasView drawRect:]".
+
+#ifndef _PPTRACE_H_
+#define _PPTRACE_H_
+
+// PPOptional.h's flags are true/false, so stdbool.h is needed for C sources
+#include <stdbool.h>
+#include "PPOptional.h"
+
+
+#if PP_OPTIONAL__BUILD_WITH_HOT_PATH_TRACING
+
+#   include <stdint.h>
+
+
+typedef struct
+{
+    const char *name;
+    uint64_t startTime;
+
+} PPTraceScope;
+
+
+PPTraceScope PPTrace_BeginScope(const char *name);
+void PPTrace_EndScope(PPTraceScope *scope);
+
+bool PPTrace_WriteChromeTraceFile(const char *filepath);
+
+
+#   define macroTraceScope(name)                                                            \
+                macroTraceScope_Declare(name, __LINE__)
+
+#   define macroTraceMethodScope()                                                          \
+                macroTraceScope(__func__)
+
+    // the scope's variable name includes the line number (__LINE__ is passed through the
+    // extra DeclareWithLine level so it's expanded before the DeclareVariable level pastes
+    // it); trace scopes should be placed before any goto statements in their block, as
+    // jumping past a cleanup variable's declaration is an error
+
+#   define macroTraceScope_Declare(name, line)                                              \
+                macroTraceScope_DeclareWithLine(name, line)
+
+#   define macroTraceScope_DeclareWithLine(name, line)                                      \
+                macroTraceScope_DeclareVariable(name, ppTraceScope_##line)
+
+#   define macroTraceScope_DeclareVariable(name, variableName)                              \
+                PPTraceScope variableName __attribute__((cleanup(PPTrace_EndScope)))        \
+                    = PPTrace_BeginScope(name)
+
+#else   // !PP_OPTIONAL__BUILD_WITH_HOT_PATH_TRACING
+
+#   define macroTraceScope(name)
+#   define macroTraceMethodScope()
+
+#endif  // PP_OPTIONAL__BUILD_WITH_HOT_PATH_TRACING
+
+#endif  // _PPTRACE_H_
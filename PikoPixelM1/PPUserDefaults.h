@@ -54,5 +54,13 @@
 + (void) setColorPickerPopupPanelContentSize: (NSSize) size;
 + (NSSize) colorPickerPopupPanelContentSize;
 
+// No UI for this setting - it's read once at launch (PPApplication), so changes take effect
+// the next time PikoPixel starts
++ (bool) linearBlendingUsesCompactFormat;
+
+// No UI for this setting - a value of zero (the default) lets the cache registry pick a
+// budget based on the machine's physical memory (PPCacheRegistry)
++ (int) cacheMemoryBudgetInMegabytes;
+
 @end
 
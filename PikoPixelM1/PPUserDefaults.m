@@ -28,6 +28,7 @@
 #import "PPBackgroundPattern.h"
 #import "PPGridPattern.h"
 #import "NSColor_PPUtilities.h"
+#import "PPStartupTimeline.h"
 
 
 #define kPPUserDefaultsKey_DefaultBackgroundPattern         @"DefaultBackgroundPattern"
@@ -37,6 +38,8 @@
 #define kPPUserDefaultsKey_ColorPickerPopupPanelMode        @"DefaultColorPickerPopupPanelMode"
 #define kPPUserDefaultsKey_ColorPickerPopupPanelContentSize \
                                                     @"DefaultColorPickerPopupPanelContentSize"
+#define kPPUserDefaultsKey_LinearBlendingUsesCompactFormat  @"LinearBlendingUsesCompactFormat"
+#define kPPUserDefaultsKey_CacheMemoryBudgetInMegabytes     @"CacheMemoryBudgetInMegabytes"
 
 
 static NSDictionary *DefaultsRegistrationDictionary(void);
@@ -47,6 +50,8 @@ static NSString *EnabledStateDefaultsKeyForPanelWithNibName(NSString *nibName);
 
 + (void) initialize
 {
+    macroStartupTimelineMethodScope();
+
     if (self != [PPUserDefaults class])
     {
         return;
@@ -284,6 +289,34 @@ ERROR:
     return size;
 }
 
++ (bool) linearBlendingUsesCompactFormat
+{
+    NSNumber *compactFormatFlagAsNumber =
+        [[NSUserDefaults standardUserDefaults]
+                            objectForKey: kPPUserDefaultsKey_LinearBlendingUsesCompactFormat];
+
+    if (!compactFormatFlagAsNumber)
+    {
+        return kUserDefaultsInitialValue_LinearBlendingUsesCompactFormat;
+    }
+
+    return [compactFormatFlagAsNumber boolValue];
+}
+
++ (int) cacheMemoryBudgetInMegabytes
+{
+    NSNumber *budgetAsNumber =
+        [[NSUserDefaults standardUserDefaults]
+                            objectForKey: kPPUserDefaultsKey_CacheMemoryBudgetInMegabytes];
+
+    if (!budgetAsNumber || ([budgetAsNumber intValue] < 0))
+    {
+        return kUserDefaultsInitialValue_CacheMemoryBudgetInMegabytes;
+    }
+
+    return [budgetAsNumber intValue];
+}
+
 @end
 
 #pragma mark Private functions
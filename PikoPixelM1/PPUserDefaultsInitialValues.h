@@ -47,6 +47,10 @@
 
 #define kUserDefaultsInitialValue_ShouldDisplayFlattenedSaveNotice      YES
 
+#define kUserDefaultsInitialValue_LinearBlendingUsesCompactFormat       NO
+
+#define kUserDefaultsInitialValue_CacheMemoryBudgetInMegabytes          0
+
 
 #if defined(__APPLE__)
 
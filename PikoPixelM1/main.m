@@ -23,9 +23,36 @@
 */
 
 #import <Cocoa/Cocoa.h>
+#import "PPBatchConverter.h"
+#import "PPOptional_KernelBenchmarks.h"
+#import "PPOptional_PNGEncoderCheck.h"
 
 
 int main(int argc, char *argv[])
 {
+    // batch conversion runs headless, without starting the application
+    if ((argc > 1) && !strcmp(argv[1], kPPBatchConverterCommandLineFlag))
+    {
+        return [PPBatchConverter runWithCommandLineArgumentCount: argc values: argv];
+    }
+
+#if PP_OPTIONAL__BUILD_WITH_KERNEL_BENCHMARKS
+
+    if ((argc > 1) && !strcmp(argv[1], kPPKernelBenchmarksCommandLineFlag))
+    {
+        return PPKernelBenchmarks_RunWithCommandLineArguments(argc, argv);
+    }
+
+#endif  // PP_OPTIONAL__BUILD_WITH_KERNEL_BENCHMARKS
+
+#if PP_OPTIONAL__BUILD_WITH_PNG_ENCODER_CHECK
+
+    if ((argc > 1) && !strcmp(argv[1], kPPPNGEncoderCheckCommandLineFlag))
+    {
+        return PPPNGEncoderCheck_RunWithCommandLineArguments(argc, argv);
+    }
+
+#endif  // PP_OPTIONAL__BUILD_WITH_PNG_ENCODER_CHECK
+
     return NSApplicationMain(argc, (const char **) argv);
 }